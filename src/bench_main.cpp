@@ -0,0 +1,404 @@
+#include "models/autoencoder.h"
+#include "nn/mse_loss.h"
+#include "nn/relu.h"
+#include "nn/sigmoid.h"
+#include "optim/adam.h"
+#include "math/cpu.h"
+#include "math/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Count every heap allocation in the process, so each case reports what it
+// allocates at steady state
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// Tensor storage is allocated with 64-byte alignment
+void* operator new(size_t size, std::align_val_t align) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t a = static_cast<size_t>(align);
+    if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+
+// Layer widths of the autoencoder: 12288 -> 512 -> 128 -> 64 -> 128 -> 512 -> 12288
+const size_t WIDTHS[] = {12288, 512, 128, 64, 128, 512, 12288};
+constexpr size_t NUM_LAYERS = sizeof(WIDTHS) / sizeof(WIDTHS[0]) - 1;
+
+// One measured operation. flops, bytes and elements are per call: bytes is the
+// minimum memory traffic (every operand read once, every result written once) and
+// elements the number of values produced or updated, or of samples for the full model.
+struct Case {
+    std::string name;
+    std::string shape;
+    size_t batch = 0;  // 0 for cases that do not depend on the batch size
+    double flops = 0.0;
+    double bytes = 0.0;
+    double elements = 0.0;
+    std::function<void()> run;
+};
+
+struct Result {
+    size_t iterations = 0;
+    double ns_median = 0.0;  // per call, median over the samples
+    double ns_min = 0.0;
+    double allocations = 0.0;  // per call
+};
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// The first two calls are not measured: they size every buffer, including the
+// second pool block a value-API result needs while the previous result is still
+// held. The rest of the time budget is split into SAMPLES runs of equal length.
+Result measure(const Case& c, double min_time) {
+    constexpr int SAMPLES = 5;
+    c.run();
+    auto t0 = Clock::now();
+    c.run();
+    double first = seconds_since(t0);
+    size_t per_sample = static_cast<size_t>(min_time / SAMPLES / std::max(first, 1e-9));
+    per_sample = std::max<size_t>(per_sample, 1);
+
+    std::vector<double> ns;
+    ns.reserve(SAMPLES);
+    size_t allocations_before = g_allocations.load();
+    for (int s = 0; s < SAMPLES; ++s) {
+        t0 = Clock::now();
+        for (size_t i = 0; i < per_sample; ++i) {
+            c.run();
+        }
+        ns.push_back(seconds_since(t0) * 1e9 / static_cast<double>(per_sample));
+    }
+    size_t allocations = g_allocations.load() - allocations_before;
+
+    Result r;
+    r.iterations = per_sample * SAMPLES;
+    std::sort(ns.begin(), ns.end());
+    r.ns_median = ns[SAMPLES / 2];
+    r.ns_min = ns.front();
+    r.allocations = static_cast<double>(allocations) / static_cast<double>(r.iterations);
+    return r;
+}
+
+std::string dims(std::initializer_list<size_t> sizes) {
+    std::string s;
+    for (size_t n : sizes) {
+        s += (s.empty() ? "" : "x") + std::to_string(n);
+    }
+    return s;
+}
+
+void add_matmul_cases(std::vector<Case>& cases, size_t B) {
+    for (size_t l = 0; l < NUM_LAYERS; ++l) {
+        size_t K = WIDTHS[l], N = WIDTHS[l + 1];
+        auto X = std::make_shared<Tensor>(Tensor::randn(B, K, 0.0f, 1.0f));
+        auto W = std::make_shared<Tensor>(Tensor::randn(K, N, 0.0f, 0.05f));
+        auto C = std::make_shared<Tensor>();
+        double b = static_cast<double>(B), k = static_cast<double>(K), n = static_cast<double>(N);
+        cases.push_back({"matmul", dims({B, K, N}), B, 2.0 * b * k * n,
+                         4.0 * (b * k + k * n + b * n), b * n,
+                         [X, W, C] { *C = Tensor::matmul(*X, *W); }});
+    }
+}
+
+void add_elementwise_cases(std::vector<Case>& cases, size_t B) {
+    const size_t widths[] = {12288, 512, 128, 64};
+    for (size_t N : widths) {
+        double e = static_cast<double>(B * N);
+        auto X = std::make_shared<Tensor>(Tensor::randn(B, N, 0.0f, 1.0f));
+        auto bias = std::make_shared<Tensor>(Tensor::randn(1, N, 0.0f, 1.0f));
+        auto out = std::make_shared<Tensor>();
+        cases.push_back({"transpose", dims({B, N}), B, 0.0, 8.0 * e, e,
+                         [X, out] { *out = Tensor::transpose(*X); }});
+        cases.push_back({"add_broadcast", dims({B, N}), B, e, 4.0 * (2.0 * e + N), e,
+                         [X, bias, out] { *out = Tensor::add(*X, *bias); }});
+    }
+
+    // Activations at the widths they run at: ReLU after each hidden layer, Sigmoid
+    // on the output
+    auto add_activation = [&](const std::string& name, std::shared_ptr<Layer> layer, size_t N) {
+        double e = static_cast<double>(B * N);
+        auto X = std::make_shared<Tensor>(Tensor::randn(B, N, 0.0f, 1.0f));
+        auto grad = std::make_shared<Tensor>(Tensor::randn(B, N, 0.0f, 1.0f));
+        auto y = std::make_shared<Tensor>();
+        auto dx = std::make_shared<Tensor>();
+        cases.push_back({name + "_forward", dims({B, N}), B, 0.0, 8.0 * e, e,
+                         [layer, X, y] { layer->forward_into(*X, *y); }});
+        cases.push_back({name + "_backward", dims({B, N}), B, 0.0, 12.0 * e, e,
+                         [layer, X, y, grad, dx] {
+                             layer->forward_into(*X, *y);
+                             layer->backward_into(*grad, dx.get());
+                         }});
+    };
+    for (size_t N : {512, 128, 64}) {
+        add_activation("relu", std::make_shared<ReLU>(), N);
+    }
+    add_activation("sigmoid", std::make_shared<Sigmoid>(), 12288);
+
+    size_t N = WIDTHS[0];
+    double e = static_cast<double>(B * N);
+    auto prediction = std::make_shared<Tensor>(Tensor::randn(B, N, 0.5f, 0.2f));
+    auto target = std::make_shared<Tensor>(Tensor::randn(B, N, 0.5f, 0.2f));
+    auto grad = std::make_shared<Tensor>();
+    auto loss = std::make_shared<MSELoss>();
+    cases.push_back({"mse_loss", dims({B, N}), B, 4.0 * e, 12.0 * e, e,
+                     [prediction, target, grad, loss] {
+                         loss->forward_backward(*prediction, *target, *grad);
+                     }});
+}
+
+// Total weights of the Dense layers
+double weight_count() {
+    double n = 0.0;
+    for (size_t l = 0; l < NUM_LAYERS; ++l) {
+        n += static_cast<double>(WIDTHS[l] * WIDTHS[l + 1]);
+    }
+    return n;
+}
+
+void add_model_cases(std::vector<Case>& cases, size_t B) {
+    double b = static_cast<double>(B);
+    double P = weight_count();
+    // The first layer's input gradient is skipped (grad_input is null)
+    double first = static_cast<double>(WIDTHS[0] * WIDTHS[1]);
+    double io = 4.0 * b * static_cast<double>(WIDTHS[0]);
+
+    struct Variant {
+        const char* suffix;
+        Precision precision;
+        double weight_bytes;
+    };
+    const Variant variants[] = {
+        {"", Precision::Float32, 4.0}, {"_bf16", Precision::BF16, 2.0}, {"_int8", Precision::Int8, 1.0},
+    };
+    for (const Variant& v : variants) {
+        auto model = std::make_shared<Autoencoder>();
+        if (v.precision == Precision::BF16) {
+            // Mixed precision: float32 master weights, bf16 copies in the GEMMs
+            model->use_bf16_weights(true);
+        } else if (v.precision == Precision::Int8) {
+            model->quantize();
+        }
+        auto x = std::make_shared<Tensor>(Tensor::randn(B, WIDTHS[0], 0.5f, 0.2f));
+        auto y = std::make_shared<Tensor>();
+        cases.push_back({std::string("autoencoder_forward") + v.suffix, dims({B, WIDTHS[0]}), B,
+                         2.0 * b * P, v.weight_bytes * P + 2.0 * io, b,
+                         [model, x, y] { model->forward_into(*x, *y); }});
+        if (v.precision == Precision::Int8) {
+            continue;  // inference only
+        }
+        // Weight gradients are float32 in both variants
+        auto grad = std::make_shared<Tensor>(Tensor::randn(B, WIDTHS[0], 0.0f, 0.01f));
+        model->forward_into(*x, *y);
+        cases.push_back({std::string("autoencoder_backward") + v.suffix, dims({B, WIDTHS[0]}), B,
+                         2.0 * b * (2.0 * P - first), (v.weight_bytes + 4.0) * P + 2.0 * io, b,
+                         [model, grad] { model->backward_into(*grad, nullptr); }});
+    }
+}
+
+// Float32 forward and backward of the model a spec describes, as
+// autoencoder_<name>_forward and autoencoder_<name>_backward
+void add_spec_model_cases(std::vector<Case>& cases, size_t B, const std::string& name,
+                          const ModelSpec& spec) {
+    double b = static_cast<double>(B);
+    auto model = std::make_shared<Autoencoder>(spec);
+    double P = 0.0;
+    for (const Parameter& p : model->parameters()) {
+        P += static_cast<double>(p.value->size());
+    }
+    double macs = static_cast<double>(spec.multiply_adds());
+    // The first layer's input gradient is skipped
+    double first = static_cast<double>(spec.encoder.front().multiply_adds());
+    size_t in = spec.input_size();
+    double io = 4.0 * b * static_cast<double>(in);
+    auto x = std::make_shared<Tensor>(Tensor::randn(B, in, 0.5f, 0.2f));
+    auto y = std::make_shared<Tensor>();
+    cases.push_back({"autoencoder_" + name + "_forward", dims({B, in}), B, 2.0 * b * macs,
+                     4.0 * P + 2.0 * io, b, [model, x, y] { model->forward_into(*x, *y); }});
+    auto grad = std::make_shared<Tensor>(Tensor::randn(B, in, 0.0f, 0.01f));
+    model->forward_into(*x, *y);
+    cases.push_back({"autoencoder_" + name + "_backward", dims({B, in}), B,
+                     2.0 * b * (2.0 * macs - first), 8.0 * P + 2.0 * io, b,
+                     [model, grad] { model->backward_into(*grad, nullptr); }});
+}
+
+void add_adam_case(std::vector<Case>& cases) {
+    auto model = std::make_shared<Autoencoder>();
+    auto params = model->parameters();
+    double n = 0.0;
+    for (const Parameter& p : params) {
+        for (size_t i = 0; i < p.gradient->size(); ++i) {
+            (*p.gradient)[i] = 1e-3f;
+        }
+        n += static_cast<double>(p.value->size());
+    }
+    auto optimizer = std::make_shared<Adam>(params, 1e-4f);
+    // Reads parameter, gradient and both moments, writes parameter and moments
+    cases.push_back({"adam_step", std::to_string(static_cast<size_t>(n)), 0, 0.0, 28.0 * n, n,
+                     [model, optimizer] { optimizer->step(); }});
+}
+
+std::vector<size_t> parse_sizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        long n = std::atol(item.c_str());
+        if (n < 1) {
+            throw std::invalid_argument("Invalid batch size: " + item);
+        }
+        sizes.push_back(static_cast<size_t>(n));
+    }
+    return sizes;
+}
+
+void write_json(std::ostream& out, const std::vector<Case>& cases,
+                const std::vector<Result>& results, double min_time) {
+    out.precision(6);
+    out << "{\n"
+        << "  \"isa\": \"" << isa_name(active_isa()) << "\",\n"
+        << "  \"threads\": " << ThreadPool::global().num_threads() << ",\n"
+        << "  \"min_time\": " << min_time << ",\n"
+        << "  \"results\": [";
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const Case& c = cases[i];
+        const Result& r = results[i];
+        double seconds = r.ns_median * 1e-9;
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << c.name << "\", \"shape\": \"" << c.shape
+            << "\", \"batch\": " << c.batch << ", \"iterations\": " << r.iterations
+            << ", \"ns_per_iter\": " << r.ns_median << ", \"ns_per_iter_min\": " << r.ns_min;
+        if (c.flops > 0.0) {
+            out << ", \"gflops\": " << c.flops / seconds * 1e-9;
+        }
+        out << ", \"gb_per_s\": " << c.bytes / seconds * 1e-9
+            << ", \"ns_per_element\": " << r.ns_median / c.elements
+            << ", \"allocations_per_iter\": " << r.allocations << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog
+              << " [--batch-sizes 1,16,64] [--filter SUBSTR] [--min-time SECONDS]"
+              << " [--threads N] [--out PATH] [--arch PATH]" << std::endl
+              << "  Times tensor kernels, layers, the optimizer and the full autoencoder at"
+              << " the model's shapes and writes the results as JSON (stdout by default)."
+              << " --filter keeps the cases whose name contains SUBSTR" << std::endl
+              << "  --arch also times the model a spec file describes (see models/model_spec.h)"
+              << " as autoencoder_arch_forward/backward" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string batch_list = "1,16,64";
+    std::string filter;
+    double min_time = 0.25;  // seconds per case
+    int threads = 0;  // 0 = keep the default (AE_NUM_THREADS or all cores)
+    std::string out_path;
+    std::string arch_path;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--batch-sizes") == 0 && i + 1 < argc) {
+            batch_list = argv[++i];
+        } else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--arch") == 0 && i + 1 < argc) {
+            arch_path = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (threads > 0) {
+        ThreadPool::set_global_threads(static_cast<size_t>(threads));
+    }
+
+    std::vector<Case> cases;
+    try {
+        ModelSpec arch;
+        if (!arch_path.empty()) {
+            arch = ModelSpec::load(arch_path);
+        }
+        for (size_t B : parse_sizes(batch_list)) {
+            add_matmul_cases(cases, B);
+            add_elementwise_cases(cases, B);
+            add_model_cases(cases, B);
+            add_spec_model_cases(cases, B, "conv", ModelSpec::conv());
+            if (!arch_path.empty()) {
+                add_spec_model_cases(cases, B, "arch", arch);
+            }
+        }
+        add_adam_case(cases);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    cases.erase(std::remove_if(cases.begin(), cases.end(),
+                               [&](const Case& c) {
+                                   return c.name.find(filter) == std::string::npos;
+                               }),
+                cases.end());
+
+    // Progress goes to stderr so stdout stays valid JSON
+    std::vector<Result> results;
+    for (const Case& c : cases) {
+        results.push_back(measure(c, min_time));
+        std::cerr << c.name << " " << c.shape << ": " << results.back().ns_median / 1e3 << " us"
+                  << std::endl;
+    }
+
+    if (out_path.empty()) {
+        write_json(std::cout, cases, results, min_time);
+    } else {
+        std::ofstream out(out_path);
+        write_json(out, cases, results, min_time);
+        if (!out) {
+            std::cerr << "Failed to write " << out_path << std::endl;
+            return 1;
+        }
+        std::cerr << "Results written to " << out_path << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,287 @@
+#include "models/autoencoder.h"
+#include "io/dataset.h"
+#include "io/image_codec.h"
+#include "io/image_io.h"
+#include "io/model_io.h"
+#include "io/tiled_image.h"
+#include "math/thread_pool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog
+              << " encode <model_path> <image> <output.aec> [--step F] [--tiled] [--threads N]"
+              << std::endl
+              << "       " << prog << " decode <model_path> <input.aec> <output_image> [--threads N]"
+              << std::endl
+              << "       " << prog
+              << " bench <model_path> <images> [--step F]... [--tiled] [--threads N]" << std::endl
+              << "  encode stores the image's latents quantized to multiples of --step (default"
+              << " 0.25) and range-coded (see io/image_codec.h); decode needs the same model"
+              << std::endl
+              << "  --tiled codes the image at its own size, one latent per 64x64 tile, instead"
+              << " of resized to 64x64" << std::endl
+              << "  bench codes every image at each --step (default 0.1 0.25 0.5 1 2) and"
+              << " reports bits per pixel, PSNR and throughput against PNG; <images> is a"
+              << " directory, list file or image" << std::endl;
+}
+
+// Inference model (no init, no gradients) of the file's layer stack, run as saved,
+// with its weights pointing at the memory-mapped model file
+static Autoencoder load_model(const std::string& path) {
+    std::string architecture = ModelIO::architecture(path);
+    Autoencoder model = Autoencoder::for_inference(precision_of(architecture),
+                                                   ModelSpec::of_architecture(architecture));
+    auto params = model.parameters();
+    ModelIO::map(params, path, model.architecture());
+    return model;
+}
+
+// Pixels the codec compresses: the image resized to 64x64, or at its own size when
+// tiled
+struct SourceImage {
+    size_t width = 0;
+    size_t height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+static SourceImage load_source(const std::string& path, bool tiled) {
+    SourceImage image;
+    if (tiled) {
+        std::unique_ptr<ImageRowReader> reader = ImageRowReader::open(path);
+        image.width = reader->width();
+        image.height = reader->height();
+        image.pixels.resize(image.width * image.height * ImageIO::CHANNELS);
+        reader->read_rows(image.pixels.data(), image.height);
+    } else {
+        image.width = image.height = ImageIO::TARGET_SIZE;
+        image.pixels.resize(ImageIO::FLAT_SIZE);
+        ImageIO::load_pixels(path, image.pixels.data());
+    }
+    return image;
+}
+
+static Tensor to_tiles(const SourceImage& image, bool tiled) {
+    if (tiled) {
+        return ImageCodec::split_tiles(image.pixels.data(), image.width, image.height);
+    }
+    Tensor input = Tensor::uninitialized(1, ImageIO::FLAT_SIZE);
+    ImageIO::from_pixels(image.pixels.data(), input.data.data());
+    return input;
+}
+
+static std::vector<unsigned char> compress(Autoencoder& model, const SourceImage& image,
+                                           bool tiled, float step) {
+    CodecHeader header;
+    header.width = image.width;
+    header.height = image.height;
+    header.tiled = tiled;
+    header.latent_size = model.latent_size();
+    header.step = step;
+    header.model_tag = ImageCodec::model_tag(model.architecture());
+    return ImageCodec::compress(header, model.encode(to_tiles(image, tiled)));
+}
+
+static SourceImage decompress(Autoencoder& model, const std::vector<unsigned char>& file) {
+    CodecHeader header;
+    Tensor latents = ImageCodec::decompress(file, header);
+    if (header.model_tag != ImageCodec::model_tag(model.architecture())) {
+        throw std::runtime_error("Compressed image was encoded by a model with different layers");
+    }
+    if (header.latent_size != model.latent_size()) {
+        throw std::runtime_error("Compressed image has " + std::to_string(header.latent_size) +
+                                 "-d latents, but the model's are " +
+                                 std::to_string(model.latent_size()) + "-d");
+    }
+    Tensor tiles = model.decode(latents);
+    SourceImage image;
+    image.width = header.width;
+    image.height = header.height;
+    image.pixels.resize(image.width * image.height * ImageIO::CHANNELS);
+    if (header.tiled) {
+        ImageCodec::join_tiles(tiles, image.width, image.height, image.pixels.data());
+    } else {
+        ImageIO::to_pixels(tiles.data.data(), image.pixels.data());
+    }
+    return image;
+}
+
+static double psnr(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+    double squared_error = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        double diff = static_cast<double>(a[i]) - static_cast<double>(b[i]);
+        squared_error += diff * diff;
+    }
+    if (squared_error == 0.0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return 10.0 * std::log10(255.0 * 255.0 * static_cast<double>(a.size()) / squared_error);
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Totals of one codec setting over the benchmark images
+struct BenchRow {
+    double bytes = 0.0;
+    double psnr = 0.0;
+    double encode_seconds = 0.0;
+    double decode_seconds = 0.0;
+};
+
+static void print_row(const char* name, const BenchRow& row, size_t images, double pixels) {
+    double n = static_cast<double>(images);
+    std::printf("%-12s %9.4f %9.2f %9.0f %11.3f %11.3f %10.2f %10.2f\n", name,
+                row.bytes * 8.0 / pixels, row.psnr / n, row.bytes / n,
+                row.encode_seconds * 1000.0 / n, row.decode_seconds * 1000.0 / n,
+                pixels / row.encode_seconds / 1e6, pixels / row.decode_seconds / 1e6);
+}
+
+// Each image is coded on its own, as the tool codes files. PSNR is averaged over
+// images, against the same pixels the codec is given (resized to 64x64 unless tiled).
+static int bench(Autoencoder& model, const std::string& images_path, bool tiled,
+                 const std::vector<float>& steps) {
+    ImageDataset dataset = ImageDataset::from_path(images_path);
+    if (dataset.is_packed()) {
+        std::cerr << "bench needs image files, not a pack file" << std::endl;
+        return 1;
+    }
+    std::vector<SourceImage> images;
+    double pixels = 0.0;
+    for (const std::string& path : dataset.paths()) {
+        images.push_back(load_source(path, tiled));
+        pixels += static_cast<double>(images.back().width * images.back().height);
+    }
+    std::cout << "Coding " << images.size() << " images (" << pixels / 1e6 << " MP, "
+              << (tiled ? "tiled at their own size" : "resized to 64x64") << ") on "
+              << ThreadPool::global().num_threads() << " threads" << std::endl;
+    std::printf("%-12s %9s %9s %9s %11s %11s %10s %10s\n", "", "bpp", "PSNR dB", "bytes",
+                "enc ms/img", "dec ms/img", "enc MP/s", "dec MP/s");
+
+    BenchRow png;
+    for (const SourceImage& image : images) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<unsigned char> file =
+            ImageIO::encode_png(image.pixels.data(), image.width, image.height);
+        png.encode_seconds += seconds_since(start);
+        std::vector<unsigned char> decoded(image.pixels.size());
+        start = std::chrono::steady_clock::now();
+        ImageIO::decode_png(file, image.width, image.height, decoded.data());
+        png.decode_seconds += seconds_since(start);
+        png.bytes += static_cast<double>(file.size());
+        if (decoded != image.pixels) {
+            std::cerr << "PNG round trip changed the pixels" << std::endl;
+            return 1;
+        }
+    }
+    png.psnr = std::numeric_limits<double>::infinity();
+    print_row("png", png, images.size(), pixels);
+
+    for (float step : steps) {
+        BenchRow row;
+        for (const SourceImage& image : images) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<unsigned char> file = compress(model, image, tiled, step);
+            row.encode_seconds += seconds_since(start);
+            start = std::chrono::steady_clock::now();
+            SourceImage decoded = decompress(model, file);
+            row.decode_seconds += seconds_since(start);
+            row.bytes += static_cast<double>(file.size());
+            row.psnr += psnr(image.pixels, decoded.pixels);
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), "step %g", step);
+        print_row(name, row, images.size(), pixels);
+    }
+    std::cout << "bytes include the " << ImageCodec::HEADER_SIZE << "-byte header; a float32"
+              << " latent alone is " << model.latent_size() * 4 << " bytes per tile" << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    std::vector<float> steps;
+    bool tiled = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+            steps.push_back(std::strtof(argv[++i], nullptr));
+        } else if (std::strcmp(argv[i], "--tiled") == 0) {
+            tiled = true;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            int threads = std::atoi(argv[++i]);
+            if (threads > 0) {
+                ThreadPool::set_global_threads(static_cast<size_t>(threads));
+            }
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    const std::string command = positional.empty() ? "" : positional[0];
+    size_t expected = command == "bench" ? 3 : 4;
+    if ((command != "encode" && command != "decode" && command != "bench") ||
+        positional.size() != expected) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    for (float step : steps) {
+        if (!(step > 0.0f) || !std::isfinite(step)) {
+            std::cerr << "--step must be positive" << std::endl;
+            return 1;
+        }
+    }
+
+    Autoencoder model = load_model(positional[1]);
+    if (model.input_size() != static_cast<size_t>(ImageIO::FLAT_SIZE)) {
+        std::cerr << positional[1] << " takes " << model.input_size() << " inputs, not 64x64 RGB"
+                  << " images" << std::endl;
+        return 1;
+    }
+
+    if (command == "bench") {
+        if (steps.empty()) {
+            steps = {0.1f, 0.25f, 0.5f, 1.0f, 2.0f};
+        }
+        return bench(model, positional[2], tiled, steps);
+    }
+
+    if (command == "encode") {
+        if (steps.size() > 1) {
+            std::cerr << "encode takes one --step" << std::endl;
+            return 1;
+        }
+        float step = steps.empty() ? 0.25f : steps[0];
+        SourceImage image = load_source(positional[2], tiled);
+        std::vector<unsigned char> file = compress(model, image, tiled, step);
+        ImageCodec::save(positional[3], file);
+        SourceImage decoded = decompress(model, file);
+        double pixels = static_cast<double>(image.width * image.height);
+        std::cout << "Compressed " << positional[2] << " (" << image.width << "x" << image.height
+                  << ") to " << file.size() << " bytes, " << file.size() * 8.0 / pixels
+                  << " bits per pixel, PSNR " << psnr(image.pixels, decoded.pixels) << " dB"
+                  << std::endl;
+        std::cout << "Saved " << positional[3] << std::endl;
+        return 0;
+    }
+
+    SourceImage image = decompress(model, ImageCodec::load(positional[2]));
+    ImageRowWriter output(positional[3], image.width, image.height);
+    output.write_rows(image.pixels.data(), image.height);
+    output.finish();
+    std::cout << "Decoded " << positional[2] << " to " << positional[3] << " (" << image.width
+              << "x" << image.height << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "models/autoencoder.h"
+#include "io/dataset.h"
+#include "io/data_loader.h"
+#include "io/latent_file.h"
+#include "io/model_io.h"
+#include "math/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog
+              << " <model_path> <images> <output_latents> [--batch-size B] [--threads N]"
+              << " [--loader-threads N] [--names PATH] [--quantized|--bf16]" << std::endl
+              << "  Runs the encoder only over every image and writes the latents as a"
+              << " matrix file, one row per image"
+              << " in dataset order (see io/latent_file.h)" << std::endl
+              << "  <images> is a pack file, a directory of images, a text file listing one"
+              << " image path per line, or a single image" << std::endl
+              << "  --names writes the image names in row order, one per line; --quantized"
+              << " and --bf16 convert a float32 model after loading" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    int batch_size = 64;
+    int loader_threads = 4;
+    std::string names_path;
+    Precision precision = Precision::Float32;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--batch-size") == 0 && i + 1 < argc) {
+            batch_size = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            int threads = std::atoi(argv[++i]);
+            if (threads > 0) {
+                ThreadPool::set_global_threads(static_cast<size_t>(threads));
+            }
+        } else if (std::strcmp(argv[i], "--loader-threads") == 0 && i + 1 < argc) {
+            loader_threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--names") == 0 && i + 1 < argc) {
+            names_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--quantized") == 0) {
+            precision = Precision::Int8;
+        } else if (std::strcmp(argv[i], "--bf16") == 0) {
+            precision = Precision::BF16;
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    if (positional.size() != 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (batch_size < 1) {
+        std::cerr << "--batch-size must be at least 1" << std::endl;
+        return 1;
+    }
+    const std::string& model_path = positional[0];
+    const std::string& data_path = positional[1];
+    const std::string& output_path = positional[2];
+
+    // Inference model mapped from the model file; only the encoder runs
+    std::string architecture = ModelIO::architecture(model_path);
+    Precision stored = precision_of(architecture);
+    if (stored != Precision::Float32 && precision != Precision::Float32 && precision != stored) {
+        std::cerr << model_path << " is a " << precision_name(stored)
+                  << " model and cannot be converted to " << precision_name(precision)
+                  << std::endl;
+        return 1;
+    }
+    Autoencoder model = Autoencoder::for_inference(stored, ModelSpec::of_architecture(architecture));
+    auto params = model.parameters();
+    ModelIO::map(params, model_path, model.architecture());
+    if (stored == Precision::Float32 && precision == Precision::Int8) {
+        model.quantize();
+    } else if (stored == Precision::Float32 && precision == Precision::BF16) {
+        model.use_bf16_weights(false);
+    } else {
+        precision = stored;
+    }
+    std::cout << "Loaded " << precision_name(precision) << " model from " << model_path
+              << std::endl;
+
+    // Background workers decode and resize images into batches in dataset order
+    // while the encoder runs on the previous batch
+    ImageDataset dataset = ImageDataset::from_path(data_path);
+    DataLoaderOptions loader_opts;
+    loader_opts.batch_size = static_cast<size_t>(batch_size);
+    loader_opts.num_workers = static_cast<size_t>(std::max(loader_threads, 1));
+    loader_opts.shuffle = false;
+    loader_opts.epochs = 1;
+    DataLoader loader(dataset, loader_opts);
+    std::cout << "Encoding " << dataset.size() << " images from " << data_path << " on "
+              << ThreadPool::global().num_threads() << " threads" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    LatentWriter writer(output_path, model.latent_size());
+    Tensor latent;
+    while (const Tensor* batch = loader.next()) {
+        model.encode_into(*batch, latent);
+        writer.append(latent);
+    }
+    writer.finish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!names_path.empty()) {
+        std::ofstream names(names_path);
+        for (size_t i = 0; i < dataset.size(); ++i) {
+            names << dataset.name(i) << '\n';
+        }
+        if (!names) {
+            std::cerr << "Failed to write " << names_path << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Encoded " << writer.rows() << " images in " << seconds << " s ("
+              << static_cast<double>(writer.rows()) / seconds << " images/s, data_wait="
+              << loader.take_wait_seconds() * 1000.0 << "ms)" << std::endl;
+    std::cout << "Saved " << writer.rows() << "x" << model.latent_size() << " latents to "
+              << output_path << std::endl;
+    return 0;
+}
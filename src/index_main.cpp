@@ -0,0 +1,155 @@
+#include "io/latent_file.h"
+#include "io/latent_index.h"
+#include "math/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog
+              << " <latents> <output_index> [--lists N] [--iterations I] [--sample-per-list S]"
+              << " [--eval Q] [--k K] [--threads N]" << std::endl
+              << "  Builds a nearest-neighbour index over a latent file written by encode"
+              << " (see io/latent_index.h)" << std::endl
+              << "  --lists sets the number of k-means cells (default about sqrt(rows));"
+              << " --iterations (default 10) and --sample-per-list (default 64) control"
+              << " k-means training" << std::endl
+              << "  --eval Q searches Q random rows of the index and reports recall@K"
+              << " (default K 10) against exact search and queries/s for each nprobe"
+              << std::endl;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Search every query on the thread pool; returns the elapsed seconds
+static double run_queries(const LatentIndex& index, const LatentFile& latents,
+                          const std::vector<uint64_t>& queries, size_t k, size_t nprobe,
+                          std::vector<std::vector<Neighbor>>& results) {
+    results.assign(queries.size(), {});
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool::global().parallel_for(queries.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t q = begin; q < end; ++q) {
+            results[q] = index.search(latents.row(queries[q]), k, nprobe);
+        }
+    });
+    return seconds_since(start);
+}
+
+// Share of the exact top-k rows that the approximate search also returned
+static double recall(const std::vector<std::vector<Neighbor>>& exact,
+                     const std::vector<std::vector<Neighbor>>& approx) {
+    size_t found = 0, total = 0;
+    for (size_t q = 0; q < exact.size(); ++q) {
+        std::unordered_set<uint64_t> truth;
+        for (const Neighbor& n : exact[q]) {
+            truth.insert(n.row);
+        }
+        for (const Neighbor& n : approx[q]) {
+            found += truth.count(n.row);
+        }
+        total += exact[q].size();
+    }
+    return total ? static_cast<double>(found) / static_cast<double>(total) : 1.0;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    IndexBuildOptions opts;
+    size_t eval_queries = 0;
+    size_t k = 10;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--lists") == 0 && i + 1 < argc) {
+            opts.lists = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            opts.iterations = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (std::strcmp(argv[i], "--sample-per-list") == 0 && i + 1 < argc) {
+            opts.sample_per_list = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (std::strcmp(argv[i], "--eval") == 0 && i + 1 < argc) {
+            eval_queries = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (std::strcmp(argv[i], "--k") == 0 && i + 1 < argc) {
+            k = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            int threads = std::atoi(argv[++i]);
+            if (threads > 0) {
+                ThreadPool::set_global_threads(static_cast<size_t>(threads));
+            }
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    if (positional.size() != 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (k < 1) {
+        std::cerr << "--k must be at least 1" << std::endl;
+        return 1;
+    }
+    const std::string& latents_path = positional[0];
+    const std::string& index_path = positional[1];
+
+    LatentFile latents(latents_path);
+    std::cout << "Indexing " << latents.rows() << "x" << latents.cols() << " latents from "
+              << latents_path << " on " << ThreadPool::global().num_threads() << " threads"
+              << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    LatentIndex::build(latents, index_path, opts);
+    double build_seconds = seconds_since(start);
+    LatentIndex index(index_path);
+    std::cout << "Built " << index.lists() << "-cell index in " << build_seconds << " s, saved to "
+              << index_path << std::endl;
+
+    if (eval_queries == 0) {
+        return 0;
+    }
+
+    // Queries are rows of the indexed set, so each one's nearest neighbour is itself
+    eval_queries = std::min(eval_queries, latents.rows());
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<uint64_t> pick(0, latents.rows() - 1);
+    std::vector<uint64_t> queries(eval_queries);
+    for (uint64_t& q : queries) {
+        q = pick(rng);
+    }
+
+    std::vector<std::vector<Neighbor>> exact, approx;
+    double exact_seconds = run_queries(index, latents, queries, k, index.lists(), exact);
+    std::vector<size_t> probes;
+    for (size_t nprobe = 1; nprobe < index.lists(); nprobe *= 2) {
+        probes.push_back(nprobe);
+    }
+
+    std::cout << "Searching " << eval_queries << " queries for their " << k
+              << " nearest neighbours" << std::endl;
+    std::cout << std::fixed << std::right << std::setw(8) << "nprobe" << std::setw(11) << "recall@"
+              << std::left << std::setw(4) << k << std::right << std::setw(12) << "queries/s"
+              << std::setw(12) << "ms/query" << std::endl;
+    auto print_row = [&](const std::string& label, double r, double seconds) {
+        std::cout << std::setw(8) << label << std::setprecision(4) << std::setw(15) << r
+                  << std::setprecision(1) << std::setw(12)
+                  << static_cast<double>(eval_queries) / seconds << std::setprecision(3)
+                  << std::setw(12) << seconds * 1e3 / static_cast<double>(eval_queries)
+                  << std::endl;
+    };
+    for (size_t nprobe : probes) {
+        double seconds = run_queries(index, latents, queries, k, nprobe, approx);
+        print_row(std::to_string(nprobe), recall(exact, approx), seconds);
+    }
+    print_row("exact", 1.0, exact_seconds);
+    return 0;
+}
@@ -0,0 +1,496 @@
+#include "io/allreduce.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t HELLO_MAGIC = 0x47524541;  // "AERG"
+// How long a rank keeps retrying to reach a peer that has not started listening
+// yet, and how long a listener waits for its peers to connect
+constexpr auto CONNECT_TIMEOUT = std::chrono::seconds(60);
+constexpr auto ACCEPT_TIMEOUT = std::chrono::seconds(300);
+// How often a waiting listener calls back into its caller
+constexpr int WAITING_INTERVAL_MS = 1000;
+
+[[noreturn]] void fail(const std::string& what) {
+    throw std::runtime_error("Ring: " + what + ": " + std::strerror(errno));
+}
+
+void send_all(int fd, const void* data, size_t n) {
+    const char* p = static_cast<const char*>(data);
+    while (n > 0) {
+        ssize_t sent = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("send failed");
+        }
+        p += sent;
+        n -= static_cast<size_t>(sent);
+    }
+}
+
+void recv_all(int fd, void* data, size_t n) {
+    char* p = static_cast<char*>(data);
+    while (n > 0) {
+        ssize_t got = ::recv(fd, p, n, 0);
+        if (got == 0) {
+            throw std::runtime_error("Ring: peer closed the connection during setup");
+        }
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("receive failed");
+        }
+        p += got;
+        n -= static_cast<size_t>(got);
+    }
+}
+
+int listen_on(uint16_t port, uint16_t* bound_port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fail("failed to create socket");
+    }
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    socklen_t len = sizeof(addr);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(fd, 64) < 0 ||
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        fail("failed to listen on port " + std::to_string(port));
+    }
+    *bound_port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// Connect to addr:port (network byte order address), retrying while nobody listens
+int connect_to(uint32_t addr, uint16_t port) {
+    auto deadline = std::chrono::steady_clock::now() + CONNECT_TIMEOUT;
+    while (true) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            fail("failed to create socket");
+        }
+        sockaddr_in sa{};
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = addr;
+        sa.sin_port = htons(port);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == 0) {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return fd;
+        }
+        int err = errno;
+        ::close(fd);
+        if ((err != ECONNREFUSED && err != EINTR) ||
+            std::chrono::steady_clock::now() > deadline) {
+            char text[INET_ADDRSTRLEN];
+            ::inet_ntop(AF_INET, &addr, text, sizeof(text));
+            errno = err;
+            fail(std::string("failed to connect to ") + text + ":" + std::to_string(port));
+        }
+        ::usleep(100 * 1000);
+    }
+}
+
+int accept_from(int listen_fd, const std::function<void()>& waiting) {
+    auto deadline = std::chrono::steady_clock::now() + ACCEPT_TIMEOUT;
+    while (true) {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, WAITING_INTERVAL_MS);
+        if (ready == 0) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                throw std::runtime_error("Ring: timed out waiting for the other ranks to connect");
+            }
+            if (waiting) {
+                waiting();
+            }
+            continue;
+        }
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("poll failed");
+        }
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd >= 0) {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return fd;
+        }
+        if (errno != EINTR) {
+            fail("accept failed");
+        }
+    }
+}
+
+uint32_t resolve(const std::string& host) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    int rc = ::getaddrinfo(host.c_str(), nullptr, &hints, &result);
+    if (rc != 0 || !result) {
+        throw std::runtime_error("Ring: cannot resolve " + host + ": " + ::gai_strerror(rc));
+    }
+    uint32_t addr = reinterpret_cast<sockaddr_in*>(result->ai_addr)->sin_addr.s_addr;
+    ::freeaddrinfo(result);
+    return addr;
+}
+
+// Rendezvous message of a rank: who it is and the port its ring listener is on
+struct Hello {
+    uint32_t magic;
+    uint32_t rank;
+    uint32_t size;
+    uint32_t port;
+};
+
+}  // namespace
+
+Ring::Listener::Listener(uint16_t port) {
+    fd_ = listen_on(port, &port_);
+}
+
+Ring::Listener::~Listener() {
+    close();
+}
+
+void Ring::Listener::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+Ring::Ring(Listener& listener, size_t size, const std::function<void()>& waiting)
+    : rank_(0), size_(size) {
+    if (size == 0) {
+        throw std::invalid_argument("Ring: size must be at least 1");
+    }
+    if (size == 1) {
+        return;
+    }
+    if (listener.fd_ < 0) {
+        throw std::invalid_argument("Ring: listener is closed");
+    }
+    // Collect every rank's address as rank 0 sees it, then tell everyone
+    std::vector<std::pair<uint32_t, uint16_t>> addresses(size, {0, 0});
+    std::vector<int> peers(size, -1);
+    auto close_peers = [&peers] {
+        for (int peer : peers) {
+            if (peer >= 0) {
+                ::close(peer);
+            }
+        }
+    };
+    for (size_t i = 1; i < size; ++i) {
+        int fd;
+        try {
+            fd = accept_from(listener.fd_, waiting);
+        } catch (...) {
+            close_peers();
+            throw;
+        }
+        Hello hello;
+        recv_all(fd, &hello, sizeof(hello));
+        if (hello.magic != HELLO_MAGIC || hello.size != size || hello.rank == 0 ||
+            hello.rank >= size || peers[hello.rank] >= 0) {
+            ::close(fd);
+            close_peers();
+            throw std::runtime_error("Ring: unexpected rendezvous from rank " +
+                                     std::to_string(hello.rank) + " of " +
+                                     std::to_string(hello.size));
+        }
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        ::getpeername(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+        addresses[hello.rank] = {addr.sin_addr.s_addr, static_cast<uint16_t>(hello.port)};
+        peers[hello.rank] = fd;
+    }
+    // Rank 0's own entry stays 0: the others reach it at the address they joined with
+    addresses[0] = {0, listener.port_};
+    for (size_t i = 1; i < size; ++i) {
+        for (const auto& entry : addresses) {
+            uint32_t wire[2] = {entry.first, entry.second};
+            send_all(peers[i], wire, sizeof(wire));
+        }
+        ::close(peers[i]);
+    }
+    connect_ring(addresses, listener.fd_, waiting);
+}
+
+Ring::Ring(const std::string& host, uint16_t port, size_t rank, size_t size)
+    : rank_(rank), size_(size) {
+    if (rank == 0 || rank >= size) {
+        throw std::invalid_argument("Ring: rank " + std::to_string(rank) + " is not a joining"
+                                    " rank of " + std::to_string(size));
+    }
+    Listener own;
+    uint32_t root = resolve(host);
+    int fd = connect_to(root, port);
+    Hello hello{HELLO_MAGIC, static_cast<uint32_t>(rank), static_cast<uint32_t>(size), own.port()};
+    std::vector<std::pair<uint32_t, uint16_t>> addresses(size);
+    try {
+        send_all(fd, &hello, sizeof(hello));
+        for (auto& entry : addresses) {
+            uint32_t wire[2];
+            recv_all(fd, wire, sizeof(wire));
+            entry = {wire[0], static_cast<uint16_t>(wire[1])};
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    addresses[0].first = root;
+    connect_ring(addresses, own.fd_, nullptr);
+}
+
+// Connecting never waits for the peer to accept (the listen backlog takes it), so
+// every rank can connect to the next one first and then accept the previous one
+void Ring::connect_ring(const std::vector<std::pair<uint32_t, uint16_t>>& addresses,
+                        int listen_fd, const std::function<void()>& waiting) {
+    size_t next = (rank_ + 1) % size_;
+    size_t prev = (rank_ + size_ - 1) % size_;
+    next_fd_ = connect_to(addresses[next].first, addresses[next].second);
+    uint32_t me = static_cast<uint32_t>(rank_);
+    send_all(next_fd_, &me, sizeof(me));
+    prev_fd_ = accept_from(listen_fd, waiting);
+    uint32_t from;
+    recv_all(prev_fd_, &from, sizeof(from));
+    if (from != prev) {
+        throw std::runtime_error("Ring: rank " + std::to_string(rank_) + " expected rank " +
+                                 std::to_string(prev) + " but rank " + std::to_string(from) +
+                                 " connected");
+    }
+    for (int fd : {next_fd_, prev_fd_}) {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+}
+
+Ring::~Ring() {
+    for (int fd : {next_fd_, prev_fd_}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+void Ring::exchange(const float* send, size_t send_n, float* recv, size_t recv_n) {
+    const char* out = reinterpret_cast<const char*>(send);
+    char* in = reinterpret_cast<char*>(recv);
+    size_t out_left = send_n * sizeof(float);
+    size_t in_left = recv_n * sizeof(float);
+    while (out_left > 0 || in_left > 0) {
+        pollfd fds[2];
+        nfds_t count = 0;
+        if (out_left > 0) {
+            fds[count++] = {next_fd_, POLLOUT, 0};
+        }
+        if (in_left > 0) {
+            fds[count++] = {prev_fd_, POLLIN, 0};
+        }
+        if (::poll(fds, count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("poll failed");
+        }
+        for (nfds_t i = 0; i < count; ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            if (fds[i].fd == next_fd_ && out_left > 0) {
+                ssize_t sent = ::send(next_fd_, out, out_left, MSG_NOSIGNAL);
+                if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    fail("lost the connection to rank " + std::to_string((rank_ + 1) % size_));
+                }
+                if (sent > 0) {
+                    out += sent;
+                    out_left -= static_cast<size_t>(sent);
+                }
+            } else if (fds[i].fd == prev_fd_ && in_left > 0) {
+                ssize_t got = ::recv(prev_fd_, in, in_left, 0);
+                if (got == 0) {
+                    throw std::runtime_error("Ring: rank " +
+                                             std::to_string((rank_ + size_ - 1) % size_) +
+                                             " disconnected");
+                }
+                if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    fail("lost the connection to rank " +
+                         std::to_string((rank_ + size_ - 1) % size_));
+                }
+                if (got > 0) {
+                    in += got;
+                    in_left -= static_cast<size_t>(got);
+                }
+            }
+        }
+    }
+}
+
+void Ring::allreduce_sum(float* data, size_t n) {
+    if (size_ == 1 || n == 0) {
+        return;
+    }
+    // Chunk c is data[start(c), start(c + 1)); the last chunks may be short or empty
+    size_t chunk = (n + size_ - 1) / size_;
+    auto start = [&](size_t c) { return std::min(c * chunk, n); };
+    if (scratch_.size() < chunk) {
+        scratch_.resize(chunk);
+    }
+    // Reduce-scatter: after step s this rank holds s + 2 ranks' sum of chunk
+    // rank - s - 1, so it ends with the full sum of chunk rank + 1
+    for (size_t s = 0; s + 1 < size_; ++s) {
+        size_t send_c = (rank_ + size_ - s) % size_;
+        size_t recv_c = (rank_ + 2 * size_ - s - 1) % size_;
+        size_t recv_n = start(recv_c + 1) - start(recv_c);
+        exchange(data + start(send_c), start(send_c + 1) - start(send_c), scratch_.data(), recv_n);
+        float* dst = data + start(recv_c);
+        for (size_t i = 0; i < recv_n; ++i) {
+            dst[i] += scratch_[i];
+        }
+    }
+    // All-gather: pass the finished chunks around the ring
+    for (size_t s = 0; s + 1 < size_; ++s) {
+        size_t send_c = (rank_ + 1 + size_ - s) % size_;
+        size_t recv_c = (rank_ + size_ - s) % size_;
+        exchange(data + start(send_c), start(send_c + 1) - start(send_c),
+                 data + start(recv_c), start(recv_c + 1) - start(recv_c));
+    }
+}
+
+void Ring::broadcast(float* data, size_t n) {
+    if (rank_ != 0) {
+        std::fill(data, data + n, 0.0f);
+    }
+    allreduce_sum(data, n);
+}
+
+GradientAllReduce::GradientAllReduce(Ring& ring, std::vector<Parameter> params,
+                                     size_t bucket_bytes)
+    : ring_(ring), params_(std::move(params)), ready_(params_.size(), 0) {
+    size_t end = params_.size(), offset = 0;
+    while (end > 0) {
+        size_t begin = end, values = 0;
+        while (begin > 0 && values * sizeof(float) < bucket_bytes) {
+            --begin;
+            if (params_[begin].gradient) {
+                values += params_[begin].gradient->size();
+            }
+        }
+        buckets_.push_back({begin, end, offset, values});
+        offset += values;
+        end = begin;
+    }
+    flat_.resize(offset);
+    thread_ = std::thread(&GradientAllReduce::run, this);
+}
+
+GradientAllReduce::~GradientAllReduce() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    ready_cv_.notify_all();
+    thread_.join();
+}
+
+void GradientAllReduce::mark_ready(size_t begin, size_t end) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t p = begin; p < end; ++p) {
+            ready_[p] = step_;
+        }
+    }
+    ready_cv_.notify_all();
+}
+
+void GradientAllReduce::wait() {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] { return completed_ == step_ || error_; });
+    wait_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+    ++step_;
+}
+
+double GradientAllReduce::take_wait_seconds() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double seconds = wait_seconds_;
+    wait_seconds_ = 0.0;
+    return seconds;
+}
+
+void GradientAllReduce::run() {
+    const float scale = 1.0f / static_cast<float>(ring_.size());
+    try {
+        for (uint64_t step = 1;; ++step) {
+            for (const Bucket& b : buckets_) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    ready_cv_.wait(lock, [&] {
+                        return stop_ || std::all_of(ready_.begin() + b.first, ready_.begin() + b.last,
+                                                    [&](uint64_t s) { return s == step; });
+                    });
+                    if (stop_) {
+                        return;
+                    }
+                }
+                // Stage the bucket contiguously, sum it over the ring, write back the mean
+                float* flat = flat_.data() + b.offset;
+                for (size_t p = b.first; p < b.last; ++p) {
+                    if (const Tensor* g = params_[p].gradient) {
+                        std::memcpy(flat, g->data.data(), g->size() * sizeof(float));
+                        flat += g->size();
+                    }
+                }
+                ring_.allreduce_sum(flat_.data() + b.offset, b.size);
+                flat = flat_.data() + b.offset;
+                for (size_t p = b.first; p < b.last; ++p) {
+                    if (Tensor* g = params_[p].gradient) {
+                        float* dst = g->data.data();
+                        for (size_t i = 0; i < g->size(); ++i) {
+                            dst[i] = flat[i] * scale;
+                        }
+                        flat += g->size();
+                    }
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                completed_ = step;
+            }
+            done_cv_.notify_all();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+        done_cv_.notify_all();
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "nn/layer.h"
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The processes of a data-parallel training job, each connected over TCP to the
+// next rank and the previous one. Rank 0 also holds the rendezvous socket that the
+// other ranks connect to first, to learn each other's addresses.
+//
+// Every collective must be called by all ranks in the same order with the same
+// sizes. A rank that exits or loses its connection makes the others' calls throw
+// std::runtime_error instead of hanging.
+class Ring {
+public:
+    // Rank 0's rendezvous socket, listening on `port` on all interfaces (0 picks a
+    // free port). Open it before forking local workers so they know the port.
+    class Listener {
+    public:
+        explicit Listener(uint16_t port = 0);
+        ~Listener();
+        Listener(const Listener&) = delete;
+        Listener& operator=(const Listener&) = delete;
+
+        uint16_t port() const { return port_; }
+        // Close this process's copy, e.g. in a forked worker
+        void close();
+
+    private:
+        friend class Ring;
+        int fd_ = -1;
+        uint16_t port_ = 0;
+    };
+
+    // Rank 0 of `size`: wait for the other ranks on the listener, which then also
+    // takes the connection from the last rank. While it waits, `waiting` (if set) is
+    // called about once a second; an exception from it abandons the ring.
+    Ring(Listener& listener, size_t size, const std::function<void()>& waiting = nullptr);
+    // Rank 1..size-1: join the ring whose rank 0 listens at host:port
+    Ring(const std::string& host, uint16_t port, size_t rank, size_t size);
+    ~Ring();
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    size_t rank() const { return rank_; }
+    size_t size() const { return size_; }
+
+    // In-place sum of data[0..n) across all ranks: a reduce-scatter then an
+    // all-gather, each size - 1 steps that pass one n / size chunk to the next rank.
+    // Every rank ends up with bitwise identical sums.
+    void allreduce_sum(float* data, size_t n);
+
+    // Overwrite data[0..n) on every rank with rank 0's
+    void broadcast(float* data, size_t n);
+
+private:
+    void connect_ring(const std::vector<std::pair<uint32_t, uint16_t>>& addresses, int listen_fd,
+                      const std::function<void()>& waiting);
+    // Send to the next rank and receive from the previous one at the same time, so
+    // neither direction can fill the socket buffers and stall the ring
+    void exchange(const float* send, size_t send_n, float* recv, size_t recv_n);
+
+    size_t rank_ = 0;
+    size_t size_ = 1;
+    int next_fd_ = -1;
+    int prev_fd_ = -1;
+    std::vector<float> scratch_;
+};
+
+// Averages the gradients of data-parallel model replicas while the backward pass is
+// still running. The parameters are grouped into buckets of about bucket_bytes,
+// from the last parameter to the first, the order backward finishes them. A
+// communication thread all-reduces each bucket as soon as mark_ready has covered
+// it, so the later layers' gradients travel while the earlier layers compute theirs.
+//
+// Per step: call mark_ready from the backward pass (Autoencoder::set_gradient_hook)
+// until every parameter is covered, then wait() before the optimizer step. The Ring
+// is free for other collectives between wait() and the next mark_ready.
+class GradientAllReduce {
+public:
+    GradientAllReduce(Ring& ring, std::vector<Parameter> params,
+                      size_t bucket_bytes = 4u << 20);
+    ~GradientAllReduce();
+    GradientAllReduce(const GradientAllReduce&) = delete;
+    GradientAllReduce& operator=(const GradientAllReduce&) = delete;
+
+    // Gradients of parameters [begin, end) are final for this step
+    void mark_ready(size_t begin, size_t end);
+
+    // Block until every gradient is the mean over all ranks; rethrows communication
+    // errors
+    void wait();
+
+    size_t buckets() const { return buckets_.size(); }
+
+    // Seconds wait() spent blocked since the previous call: the communication the
+    // backward pass did not hide
+    double take_wait_seconds();
+
+private:
+    struct Bucket {
+        size_t first, last;   // parameters [first, last)
+        size_t offset, size;  // values in flat_
+    };
+
+    void run();
+
+    Ring& ring_;
+    std::vector<Parameter> params_;
+    std::vector<Bucket> buckets_;
+    std::vector<float> flat_;        // staging buffer of all bucketed gradients
+    std::vector<uint64_t> ready_;    // step each parameter was last marked ready in
+    uint64_t step_ = 1;              // step the backward pass is marking
+    uint64_t completed_ = 0;         // last step whose gradients are averaged
+    bool stop_ = false;
+    std::exception_ptr error_;
+    double wait_seconds_ = 0.0;
+
+    std::mutex mutex_;
+    std::condition_variable ready_cv_;
+    std::condition_variable done_cv_;
+    std::thread thread_;
+};
@@ -0,0 +1,152 @@
+#include "io/batcher.h"
+#include <algorithm>
+#include <stdexcept>
+
+DynamicBatcher::DynamicBatcher(RunBatch run, size_t input_size, const BatcherOptions& options)
+    : run_(std::move(run)), input_size_(input_size), options_(options) {
+    if (options_.max_batch == 0) {
+        throw std::invalid_argument("DynamicBatcher: max_batch must be at least 1");
+    }
+    options_.latency_window = std::max<size_t>(options_.latency_window, 1);
+    latencies_ms_.reserve(options_.latency_window);
+    staging_ = Tensor::uninitialized(options_.max_batch, input_size_);
+    working_ = Tensor::uninitialized(options_.max_batch, input_size_);
+    staging_done_.reserve(options_.max_batch);
+    working_done_.reserve(options_.max_batch);
+    staging_times_.reserve(options_.max_batch);
+    working_times_.reserve(options_.max_batch);
+    thread_ = std::thread(&DynamicBatcher::compute_loop, this);
+}
+
+DynamicBatcher::~DynamicBatcher() {
+    close();
+}
+
+void DynamicBatcher::submit(const float* input, Completion done) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_cv_.wait(lock, [&] { return count_ < options_.max_batch || closed_; });
+    if (closed_) {
+        throw std::runtime_error("DynamicBatcher: submit after close");
+    }
+    auto now = Clock::now();
+    std::copy(input, input + input_size_, &staging_(count_, 0));
+    staging_done_.push_back(std::move(done));
+    staging_times_.push_back(now);
+    ++count_;
+    {
+        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+        if (!started_) {
+            started_ = true;
+            first_submit_ = now;
+        }
+    }
+    ready_cv_.notify_one();
+}
+
+void DynamicBatcher::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    ready_cv_.notify_all();
+    space_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void DynamicBatcher::compute_loop() {
+    auto max_delay = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::milli>(options_.max_delay_ms));
+
+    for (;;) {
+        size_t n;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_cv_.wait(lock, [&] { return count_ > 0 || closed_; });
+            if (count_ == 0) {
+                return;  // closed and drained
+            }
+            // Wait for the batch to fill, but never past the oldest request's deadline
+            ready_cv_.wait_until(lock, staging_times_.front() + max_delay, [&] {
+                return count_ == options_.max_batch || closed_;
+            });
+            n = count_;
+            count_ = 0;
+            std::swap(staging_, working_);
+            std::swap(staging_done_, working_done_);
+            std::swap(staging_times_, working_times_);
+        }
+        space_cv_.notify_all();
+
+        // Shrinking keeps the allocation, so the swap back can regrow it for free
+        working_.resize(n, input_size_);
+        run_(working_, outputs_, latents_);
+        working_.resize(options_.max_batch, input_size_);
+
+        {
+            std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+            ++batches_;
+        }
+        for (size_t r = 0; r < n; ++r) {
+            const float* in = &working_(r, 0);
+            const float* out = &outputs_(r, 0);
+            double sum = 0.0;
+            for (size_t j = 0; j < input_size_; ++j) {
+                double d = static_cast<double>(out[j]) - in[j];
+                sum += d * d;
+            }
+            InferenceResult result;
+            result.reconstruction = out;
+            result.latent = &latents_(r, 0);
+            result.latent_size = latents_.cols;
+            result.mse = static_cast<float>(sum / static_cast<double>(input_size_));
+            auto now = Clock::now();
+            result.latency_ms =
+                std::chrono::duration<double, std::milli>(now - working_times_[r]).count();
+            {
+                // Recorded first, so a client that sees the response also sees it in stats
+                std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+                if (latencies_ms_.size() < options_.latency_window) {
+                    latencies_ms_.push_back(result.latency_ms);
+                } else {
+                    latencies_ms_[requests_ % options_.latency_window] = result.latency_ms;
+                }
+                ++requests_;
+                last_done_ = now;
+            }
+            working_done_[r](result);
+        }
+        working_done_.clear();
+        working_times_.clear();
+    }
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size()) + 0.999999);
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+LatencyStats DynamicBatcher::stats() const {
+    std::vector<double> sorted;
+    LatencyStats s;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        sorted = latencies_ms_;
+        s.requests = requests_;
+        s.batches = batches_;
+        if (requests_ > 0) {
+            double seconds = std::chrono::duration<double>(last_done_ - first_submit_).count();
+            s.throughput = seconds > 0.0 ? static_cast<double>(requests_) / seconds : 0.0;
+        }
+    }
+    std::sort(sorted.begin(), sorted.end());
+    s.mean_batch = s.batches ? static_cast<double>(s.requests) / static_cast<double>(s.batches) : 0.0;
+    s.p50_ms = percentile(sorted, 50.0);
+    s.p99_ms = percentile(sorted, 99.0);
+    return s;
+}
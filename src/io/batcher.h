@@ -0,0 +1,98 @@
+#pragma once
+
+#include "math/tensor.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct BatcherOptions {
+    size_t max_batch = 16;       // rows per model call
+    double max_delay_ms = 5.0;   // longest a request waits for its batch to fill
+    size_t latency_window = 4096;  // most recent requests the percentiles cover
+};
+
+// Result of one request, passed to its completion callback. The pointers refer to
+// the batch outputs and are only valid during the callback.
+struct InferenceResult {
+    const float* reconstruction;  // input_size values
+    const float* latent;
+    size_t latent_size;
+    float mse;                    // mean squared error of reconstruction vs input
+    double latency_ms;            // submit to completion
+};
+
+struct LatencyStats {
+    size_t requests = 0;
+    size_t batches = 0;
+    double mean_batch = 0.0;
+    double p50_ms = 0.0;          // over the last latency_window requests
+    double p99_ms = 0.0;
+    double throughput = 0.0;      // requests per second since the first submit
+};
+
+// Dynamic batcher for a reconstruction model. Any thread may submit single inputs;
+// one compute thread collects them into a batch and runs it once max_batch requests
+// are queued or the oldest has waited max_delay_ms, whichever comes first. Requests
+// complete in submission order. Inputs are copied into a pre-allocated staging batch
+// that is swapped with the compute batch, so submitters keep filling one batch while
+// the previous one runs.
+class DynamicBatcher {
+public:
+    // run(inputs, outputs, latents) computes a (rows, input_size) reconstruction and
+    // a (rows, latent_size) latent for each input row. It is only ever called from
+    // the compute thread.
+    using RunBatch = std::function<void(const Tensor& inputs, Tensor& outputs, Tensor& latents)>;
+    using Completion = std::function<void(const InferenceResult& result)>;
+
+    DynamicBatcher(RunBatch run, size_t input_size, const BatcherOptions& options);
+    ~DynamicBatcher();
+    DynamicBatcher(const DynamicBatcher&) = delete;
+    DynamicBatcher& operator=(const DynamicBatcher&) = delete;
+
+    // Queue one input of input_size floats; blocks while the staging batch is full.
+    // done is called on the compute thread and must not throw.
+    void submit(const float* input, Completion done);
+
+    // Finish all queued requests and stop the compute thread. Further submits throw.
+    void close();
+
+    LatencyStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void compute_loop();
+
+    RunBatch run_;
+    size_t input_size_;
+    BatcherOptions options_;
+
+    // Staging batch, filled by submit
+    Tensor staging_;
+    std::vector<Completion> staging_done_;
+    std::vector<Clock::time_point> staging_times_;
+    size_t count_ = 0;
+    bool closed_ = false;
+
+    // Batch being run by the compute thread
+    Tensor working_;
+    std::vector<Completion> working_done_;
+    std::vector<Clock::time_point> working_times_;
+    Tensor outputs_, latents_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_cv_;   // compute thread: requests queued or closed
+    std::condition_variable space_cv_;   // submitters: staging batch has room
+
+    mutable std::mutex stats_mutex_;
+    std::vector<double> latencies_ms_;   // ring of the last latency_window latencies
+    size_t requests_ = 0;                // completed; the next latency goes to requests_ % window
+    size_t batches_ = 0;
+    bool started_ = false;
+    Clock::time_point first_submit_, last_done_;
+
+    std::thread thread_;
+};
@@ -0,0 +1,257 @@
+#include "io/checkpoint.h"
+#include "io/checksum.h"
+#include "math/bf16.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr char MAGIC[8] = {'A', 'E', 'C', 'K', 'P', 'T', '\0', '\0'};
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_params;
+    uint64_t adam_step;
+    uint64_t batches_done;
+    uint64_t batch_size;
+    uint32_t seed;
+    uint32_t arch_size;
+    uint64_t body_size;
+    uint64_t checksum;
+};
+static_assert(sizeof(CheckpointHeader) == 64, "header layout is part of the file format");
+
+class BodyWriter {
+public:
+    explicit BodyWriter(std::ofstream& out) : out_(out) {}
+
+    void write(const void* data, size_t n) {
+        out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+        checksum_.update(data, n);
+        size_ += n;
+    }
+
+    void write_tensor(const Tensor& t) {
+        uint64_t shape[2] = {t.rows, t.cols};
+        write(shape, sizeof(shape));
+        write(t.data.data(), t.size() * sizeof(float));
+    }
+
+    uint64_t size() const { return size_; }
+    uint64_t checksum() { return checksum_.finish(); }
+
+private:
+    std::ofstream& out_;
+    Checksum checksum_;
+    uint64_t size_ = 0;
+};
+
+class BodyReader {
+public:
+    BodyReader(std::ifstream& in, const std::string& path) : in_(in), path_(path) {}
+
+    void read(void* data, size_t n) {
+        in_.read(static_cast<char*>(data), static_cast<std::streamsize>(n));
+        if (!in_) {
+            throw std::runtime_error("Truncated checkpoint: " + path_);
+        }
+        checksum_.update(data, n);
+    }
+
+    // Reads into `t`, reusing its storage
+    void read_tensor(Tensor& t, uint64_t max_elements) {
+        uint64_t shape[2];
+        read(shape, sizeof(shape));
+        if (shape[1] != 0 && shape[0] > max_elements / shape[1]) {
+            throw std::runtime_error("Corrupt checkpoint: " + path_);
+        }
+        t.resize(shape[0], shape[1]);
+        read(t.data.data(), t.size() * sizeof(float));
+    }
+
+    uint64_t checksum() { return checksum_.finish(); }
+
+private:
+    std::ifstream& in_;
+    const std::string& path_;
+    Checksum checksum_;
+};
+
+}  // namespace
+
+void Checkpoint::capture(const std::vector<Parameter>& model_params, const Adam& optimizer) {
+    params.resize(model_params.size());
+    for (size_t i = 0; i < model_params.size(); ++i) {
+        params[i] = *model_params[i].value;
+    }
+    adam_m = optimizer.first_moment();
+    adam_v = optimizer.second_moment();
+    adam_step = optimizer.timestep();
+}
+
+void Checkpoint::restore(std::vector<Parameter>& model_params, Adam& optimizer) const {
+    if (params.size() != model_params.size()) {
+        throw std::runtime_error("Checkpoint parameter count mismatch: checkpoint has " +
+            std::to_string(params.size()) + ", model has " + std::to_string(model_params.size()));
+    }
+    for (size_t i = 0; i < params.size(); ++i) {
+        Tensor& value = *model_params[i].value;
+        if (params[i].rows != value.rows || params[i].cols != value.cols) {
+            throw std::runtime_error("Shape mismatch for checkpoint parameter " + std::to_string(i));
+        }
+        value.data.assign(params[i].data.begin(), params[i].data.end());
+        if (Tensor* half = model_params[i].bf16_copy) {
+            convert_to_bf16(value.data.data(), reinterpret_cast<uint16_t*>(half->data.data()),
+                            value.size());
+        }
+    }
+    optimizer.restore_state(adam_m, adam_v, static_cast<int>(adam_step));
+}
+
+void CheckpointIO::save(const Checkpoint& checkpoint, const std::string& path) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Failed to open file for writing: " + tmp);
+        }
+
+        CheckpointHeader h{};
+        std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.version = VERSION;
+        h.num_params = static_cast<uint32_t>(checkpoint.params.size());
+        h.adam_step = static_cast<uint64_t>(checkpoint.adam_step);
+        h.batches_done = checkpoint.batches_done;
+        h.batch_size = checkpoint.batch_size;
+        h.seed = checkpoint.seed;
+        h.arch_size = static_cast<uint32_t>(checkpoint.architecture.size());
+
+        // The header is written last, once the checksum is known
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        BodyWriter body(out);
+        body.write(checkpoint.architecture.data(), checkpoint.architecture.size());
+        for (const Tensor& t : checkpoint.params) {
+            body.write_tensor(t);
+        }
+        body.write_tensor(checkpoint.adam_m);
+        body.write_tensor(checkpoint.adam_v);
+
+        h.body_size = body.size();
+        h.checksum = body.checksum();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Failed to write checkpoint: " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Failed to move checkpoint into place: " + path);
+    }
+}
+
+Checkpoint CheckpointIO::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open file for reading: " + path);
+    }
+    CheckpointHeader h;
+    in.read(reinterpret_cast<char*>(&h), sizeof(h));
+    if (!in || std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a checkpoint file: " + path);
+    }
+    if (h.version != VERSION) {
+        throw std::runtime_error("Unsupported checkpoint version " + std::to_string(h.version) +
+                                 ": " + path);
+    }
+    if (h.arch_size > h.body_size) {
+        throw std::runtime_error("Corrupt checkpoint: " + path);
+    }
+
+    // Every size read from the body is bounded by the body size, so a corrupt shape
+    // fails cleanly instead of allocating without limit
+    uint64_t max_elements = h.body_size / sizeof(float);
+    Checkpoint c;
+    c.adam_step = static_cast<int64_t>(h.adam_step);
+    c.batches_done = h.batches_done;
+    c.batch_size = h.batch_size;
+    c.seed = h.seed;
+    BodyReader body(in, path);
+    c.architecture.resize(h.arch_size);
+    body.read(&c.architecture[0], h.arch_size);
+    if (h.num_params > h.body_size / (2 * sizeof(uint64_t))) {
+        throw std::runtime_error("Corrupt checkpoint: " + path);
+    }
+    c.params.resize(h.num_params);
+    for (Tensor& t : c.params) {
+        body.read_tensor(t, max_elements);
+    }
+    body.read_tensor(c.adam_m, max_elements);
+    body.read_tensor(c.adam_v, max_elements);
+    if (body.checksum() != h.checksum) {
+        throw std::runtime_error("Checkpoint checksum mismatch: " + path);
+    }
+    return c;
+}
+
+CheckpointWriter::CheckpointWriter(std::string path)
+    : path_(std::move(path)), thread_(&CheckpointWriter::writer_loop, this) {}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wait_idle(lock);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void CheckpointWriter::wait_idle(std::unique_lock<std::mutex>& lock) {
+    cv_.wait(lock, [&] { return !pending_; });
+}
+
+void CheckpointWriter::submit(const std::function<void(Checkpoint&)>& fill) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    wait_idle(lock);
+    if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+    // The writer thread only touches the snapshot while pending_ is set
+    fill(snapshot_);
+    pending_ = true;
+    cv_.notify_all();
+}
+
+void CheckpointWriter::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    wait_idle(lock);
+    if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+void CheckpointWriter::writer_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cv_.wait(lock, [&] { return pending_ || stop_; });
+        if (!pending_) {
+            return;
+        }
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            CheckpointIO::save(snapshot_, path_);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        error_ = error;
+        pending_ = false;
+        cv_.notify_all();
+    }
+}
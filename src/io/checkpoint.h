@@ -0,0 +1,87 @@
+#pragma once
+
+#include "nn/layer.h"
+#include "optim/adam.h"
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Everything needed to resume training exactly where it stopped. The data loader's
+// shuffle RNG is fully determined by `seed` and `batches_done` (see
+// DataLoaderOptions::start_batch), so those two fields capture its state.
+struct Checkpoint {
+    std::string architecture;
+    std::vector<Tensor> params;
+    Tensor adam_m, adam_v;     // Adam moments (see Adam::first_moment)
+    int64_t adam_step = 0;
+    uint64_t batches_done = 0;  // data loader position: batches consumed so far
+    uint64_t batch_size = 0;
+    uint32_t seed = 0;          // data loader seed
+
+    // Copy parameter values and optimizer state in, reusing this checkpoint's
+    // buffers, so repeated captures stop allocating
+    void capture(const std::vector<Parameter>& params, const Adam& optimizer);
+    // Copy them back into a model and optimizer of the same shape, refreshing the
+    // parameters' bf16 copies (mixed precision)
+    void restore(std::vector<Parameter>& params, Adam& optimizer) const;
+};
+
+// Checkpoint file format, version 1 (all integers little-endian):
+//
+//   header (64 bytes)
+//     char[8]  magic "AECKPT\0\0"
+//     u32      version, num_params
+//     u64      adam_step, batches_done, batch_size
+//     u32      seed, arch_size
+//     u64      body_size (bytes after the header)
+//     u64      checksum of the body (see io/checksum.h)
+//   body: the architecture description (arch_size bytes), then num_params parameter
+//   tensors followed by the two Adam moments, each as u64 rows, u64 cols, floats
+class CheckpointIO {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    // Writes `path`.tmp and renames it over `path`, so a crash mid-write never
+    // leaves a partial checkpoint behind
+    static void save(const Checkpoint& checkpoint, const std::string& path);
+    static Checkpoint load(const std::string& path);
+};
+
+// Writes checkpoints on a background thread so training does not wait for the disk.
+// submit() copies the state into a snapshot owned by the writer, which is the only
+// part that runs on the caller's thread, then returns while the snapshot is written.
+// The snapshot's buffers are reused, so steady-state checkpoints do not allocate.
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(std::string path);
+    ~CheckpointWriter();  // finishes the write in flight
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // Waits for the previous write, lets `fill` copy the state into the snapshot,
+    // then starts writing it. Rethrows the error of a failed previous write.
+    void submit(const std::function<void(Checkpoint&)>& fill);
+
+    // Block until no write is in flight; rethrows a write error
+    void wait();
+
+    const std::string& path() const { return path_; }
+
+private:
+    void writer_loop();
+    void wait_idle(std::unique_lock<std::mutex>& lock);
+
+    std::string path_;
+    Checkpoint snapshot_;
+    bool pending_ = false;
+    bool stop_ = false;
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
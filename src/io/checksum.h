@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Checksum of the model and checkpoint file formats: FNV-1a style over 64-bit
+// little-endian words, with a final partial word zero-padded. Each step also folds
+// the high half of the state back into the low half: a multiply only carries a
+// difference towards the high bits, so plain word-wise FNV never lets a change in
+// bit 63 reach the rest of the state, and two such changes cancel. Incremental, so
+// files can be hashed while they are streamed; the result does not depend on how the
+// input is split across update() calls.
+class Checksum {
+public:
+    void update(const void* data, size_t n) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        while (n > 0 && pending_ > 0) {
+            add_byte(*p++);
+            --n;
+        }
+        for (; n >= 8; p += 8, n -= 8) {
+            uint64_t w;
+            std::memcpy(&w, p, 8);
+            mix(w);
+        }
+        while (n-- > 0) {
+            add_byte(*p++);
+        }
+    }
+
+    uint64_t finish() {
+        if (pending_ > 0) {
+            mix(partial_);
+            partial_ = 0;
+            pending_ = 0;
+        }
+        return hash_;
+    }
+
+private:
+    void mix(uint64_t w) {
+        hash_ = (hash_ ^ w) * 0x100000001b3ull;
+        hash_ ^= hash_ >> 32;
+    }
+
+    void add_byte(unsigned char b) {
+        partial_ |= static_cast<uint64_t>(b) << (8 * pending_);
+        if (++pending_ == 8) {
+            mix(partial_);
+            partial_ = 0;
+            pending_ = 0;
+        }
+    }
+
+    uint64_t hash_ = 0xcbf29ce484222325ull;
+    uint64_t partial_ = 0;
+    size_t pending_ = 0;
+};
@@ -0,0 +1,162 @@
+#include "io/data_loader.h"
+#include "io/image_io.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+
+static constexpr uint64_t NOT_READY = std::numeric_limits<uint64_t>::max();
+
+DataLoader::DataLoader(const ImageDataset& dataset, const DataLoaderOptions& options)
+    : dataset_(dataset), options_(options), rng_(options.seed) {
+    if (options_.batch_size == 0) {
+        throw std::invalid_argument("DataLoader: batch_size must be at least 1");
+    }
+    if (options_.shard_count == 0 || options_.shard_index >= options_.shard_count) {
+        throw std::invalid_argument("DataLoader: shard_index must be below shard_count");
+    }
+    size_t shard_size = (dataset_.size() + options_.shard_count - 1) / options_.shard_count;
+    for (size_t k = 0; k < shard_size; ++k) {
+        shard_.push_back((options_.shard_index + k * options_.shard_count) % dataset_.size());
+    }
+    options_.batch_size = std::min(options_.batch_size, shard_.size());
+    options_.prefetch = std::max<size_t>(options_.prefetch, 1);
+    options_.num_workers = std::max<size_t>(options_.num_workers, 1);
+    batches_per_epoch_ = (shard_.size() + options_.batch_size - 1) / options_.batch_size;
+
+    for (size_t i = 0; i < options_.prefetch; ++i) {
+        ring_.emplace_back(options_.batch_size, ImageIO::FLAT_SIZE);
+    }
+    ready_.assign(options_.prefetch, NOT_READY);
+
+    // Skip to the resume position, drawing the shuffles of the skipped epochs so
+    // rng_ is where the earlier run left it
+    next_claim_ = consumed_ = options_.start_batch;
+    uint64_t start_epoch = options_.start_batch / batches_per_epoch_;
+    if (options_.shuffle) {
+        std::vector<size_t> order;
+        for (uint64_t e = 0; e < start_epoch; ++e) {
+            order = shard_;
+            std::shuffle(order.begin(), order.end(), rng_);
+        }
+    }
+
+    for (size_t i = 0; i < options_.num_workers; ++i) {
+        workers_.emplace_back(&DataLoader::worker_loop, this);
+    }
+}
+
+DataLoader::~DataLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& w : workers_) {
+        w.join();
+    }
+}
+
+const Tensor* DataLoader::next() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (holding_) {
+        // Hand the previous slot back to the workers
+        ++consumed_;
+        holding_ = false;
+        work_cv_.notify_all();
+    }
+    if (epoch_done_) {
+        epoch_done_ = false;
+        return nullptr;
+    }
+    if (options_.epochs != 0 && consumed_ >= options_.epochs * batches_per_epoch_) {
+        return nullptr;
+    }
+
+    uint64_t id = consumed_;
+    size_t slot = id % ring_.size();
+    auto wait_start = std::chrono::steady_clock::now();
+    ready_cv_.wait(lock, [&] { return ready_[slot] == id || error_; });
+    wait_seconds_ += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wait_start).count();
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+
+    holding_ = true;
+    epoch_done_ = (id + 1) % batches_per_epoch_ == 0;
+    return &ring_[slot];
+}
+
+double DataLoader::take_wait_seconds() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double s = wait_seconds_;
+    wait_seconds_ = 0.0;
+    return s;
+}
+
+// Called with mutex_ held. Epochs are requested in increasing order because batch
+// ids are claimed in order, so shuffles are drawn from rng_ in epoch order.
+const std::vector<size_t>& DataLoader::order_for_epoch(uint64_t epoch) {
+    while (!orders_.empty() && orders_.front().first < epoch) {
+        orders_.pop_front();
+    }
+    if (orders_.empty()) {
+        std::vector<size_t> order = shard_;
+        if (options_.shuffle) {
+            std::shuffle(order.begin(), order.end(), rng_);
+        }
+        orders_.emplace_back(epoch, std::move(order));
+    }
+    return orders_.front().second;
+}
+
+void DataLoader::worker_loop() {
+    std::vector<size_t> indices;
+    indices.reserve(options_.batch_size);
+    uint64_t limit = options_.epochs == 0 ? NOT_READY : options_.epochs * batches_per_epoch_;
+
+    while (true) {
+        uint64_t id;
+        size_t slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [&] {
+                return stop_ || (next_claim_ < consumed_ + ring_.size() && next_claim_ < limit);
+            });
+            if (stop_) {
+                return;
+            }
+            id = next_claim_++;
+            slot = id % ring_.size();
+            ready_[slot] = NOT_READY;
+
+            const auto& order = order_for_epoch(id / batches_per_epoch_);
+            size_t start = (id % batches_per_epoch_) * options_.batch_size;
+            size_t end = std::min(start + options_.batch_size, order.size());
+            indices.assign(order.begin() + start, order.begin() + end);
+        }
+
+        // The slot is free: the consumer released it before this id was claimable.
+        // Shrinking for the final partial batch keeps the allocation.
+        Tensor& batch = ring_[slot];
+        batch.rows = indices.size();
+        batch.data.resize(indices.size() * ImageIO::FLAT_SIZE);
+        try {
+            for (size_t r = 0; r < indices.size(); ++r) {
+                dataset_.load_into(indices[r], &batch(r, 0));
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+            ready_cv_.notify_all();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_[slot] = id;
+        }
+        ready_cv_.notify_all();
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "io/dataset.h"
+#include "math/tensor.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+struct DataLoaderOptions {
+    size_t batch_size = 16;
+    size_t num_workers = 2;   // background decode threads
+    size_t prefetch = 4;      // batches in the ring (ready or being filled)
+    bool shuffle = true;
+    unsigned seed = 42;
+    size_t epochs = 0;        // stop producing after this many epochs (0 = unlimited)
+    // Resume position: batches already consumed by an earlier run with the same seed
+    // and batch size. The loader continues with exactly the batches that run would
+    // have produced next.
+    uint64_t start_batch = 0;
+    // Data-parallel training: read only shard shard_index of shard_count, every
+    // shard_count-th image from shard_index on. Shards are padded to the same size
+    // by wrapping around to the first images, so every worker runs the same number of
+    // equally sized batches per epoch.
+    size_t shard_index = 0;
+    size_t shard_count = 1;
+};
+
+// Producer/consumer batch loader. Worker threads decode, resize and normalize
+// images (or convert records of a mapped pack file) into a fixed ring of
+// pre-allocated (batch_size, FLAT_SIZE) tensors while the trainer consumes earlier
+// batches. Workers run ahead across epoch boundaries; each epoch uses a fresh
+// shuffle drawn from the loader's own RNG.
+class DataLoader {
+public:
+    DataLoader(const ImageDataset& dataset, const DataLoaderOptions& options);
+    ~DataLoader();
+    DataLoader(const DataLoader&) = delete;
+    DataLoader& operator=(const DataLoader&) = delete;
+
+    size_t batches_per_epoch() const { return batches_per_epoch_; }
+
+    // Next batch of the current epoch, blocking until it is ready. Returns nullptr
+    // once the epoch is exhausted; the following call starts the next epoch. The
+    // returned tensor stays valid until the next call. Rethrows decode errors.
+    const Tensor* next();
+
+    // Seconds next() spent blocked waiting for data since the previous call
+    double take_wait_seconds();
+
+private:
+    void worker_loop();
+    const std::vector<size_t>& order_for_epoch(uint64_t epoch);
+
+    const ImageDataset& dataset_;
+    DataLoaderOptions options_;
+    std::vector<size_t> shard_;         // dataset indices this loader reads
+    size_t batches_per_epoch_;
+
+    std::vector<Tensor> ring_;
+    std::vector<uint64_t> ready_;       // global batch id held by each slot, or NOT_READY
+    uint64_t next_claim_ = 0;           // next global batch id for a worker to fill
+    uint64_t consumed_ = 0;             // global batches released by the consumer
+    bool holding_ = false;              // consumer currently holds batch consumed_
+    bool epoch_done_ = false;           // next() returned the last batch of an epoch
+
+    std::mt19937 rng_;
+    std::deque<std::pair<uint64_t, std::vector<size_t>>> orders_;  // epochs in flight
+
+    bool stop_ = false;
+    std::exception_ptr error_;
+    double wait_seconds_ = 0.0;
+
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable ready_cv_;
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,91 @@
+#include "io/dataset.h"
+#include "io/image_io.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+static bool is_image_file(const fs::path& p) {
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp" ||
+           ext == ".tga" || ext == ".gif" || ext == ".ppm" || ext == ".pgm";
+}
+
+ImageDataset ImageDataset::from_path(const std::string& path) {
+    ImageDataset ds;
+    ds.source_ = path;
+    fs::path p(path);
+
+    if (!fs::is_directory(p) && PackedDataset::is_packed(path)) {
+        ds.packed_ = std::make_shared<const PackedDataset>(path);
+        if (ds.packed_->size() == 0) {
+            throw std::runtime_error("No images found in dataset: " + path);
+        }
+        return ds;
+    }
+
+    if (fs::is_directory(p)) {
+        for (const auto& entry : fs::directory_iterator(p)) {
+            if (entry.is_regular_file() && is_image_file(entry.path())) {
+                ds.paths_.push_back(entry.path().string());
+            }
+        }
+        std::sort(ds.paths_.begin(), ds.paths_.end());
+    } else if (is_image_file(p)) {
+        ds.paths_.push_back(path);
+    } else {
+        // File list: one path per line, relative paths resolved against the list's directory
+        std::ifstream in(path);
+        if (!in) {
+            throw std::runtime_error("Failed to open dataset: " + path);
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            fs::path entry(line);
+            if (entry.is_relative()) {
+                entry = p.parent_path() / entry;
+            }
+            ds.paths_.push_back(entry.string());
+        }
+    }
+
+    if (ds.paths_.empty()) {
+        throw std::runtime_error("No images found in dataset: " + path);
+    }
+    return ds;
+}
+
+size_t ImageDataset::size() const {
+    return packed_ ? packed_->size() : paths_.size();
+}
+
+std::string ImageDataset::name(size_t i) const {
+    return packed_ ? source_ + "#" + std::to_string(i) : paths_[i];
+}
+
+void ImageDataset::load_into(size_t i, float* dst) const {
+    if (packed_) {
+        packed_->load_into(i, dst);
+    } else {
+        ImageIO::load_into(paths_.at(i), dst);
+    }
+}
+
+Tensor ImageDataset::load_batch(const std::vector<size_t>& indices) const {
+    Tensor batch = Tensor::uninitialized(indices.size(), ImageIO::FLAT_SIZE);
+    for (size_t r = 0; r < indices.size(); ++r) {
+        load_into(indices[r], &batch(r, 0));
+    }
+    return batch;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "io/packed_dataset.h"
+#include "math/tensor.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Ordered list of training images, backed either by image files (decoded on
+// load) or by a memory-mapped pack file (see PackedDataset)
+class ImageDataset {
+public:
+    // path may be a pack file written by `pack`, a directory (its image files,
+    // sorted by name), a text file listing one image path per line, or a single image
+    static ImageDataset from_path(const std::string& path);
+
+    size_t size() const;
+    bool is_packed() const { return packed_ != nullptr; }
+
+    // Image file path, or "<pack file>#<index>" for packed datasets
+    std::string name(size_t i) const;
+
+    // Image file paths (empty for packed datasets)
+    const std::vector<std::string>& paths() const { return paths_; }
+
+    // Image i as FLAT_SIZE floats in [0,1]
+    void load_into(size_t i, float* dst) const;
+
+    // Load the images at `indices` into the rows of a (indices.size(), FLAT_SIZE) batch
+    Tensor load_batch(const std::vector<size_t>& indices) const;
+
+private:
+    std::string source_;
+    std::vector<std::string> paths_;
+    std::shared_ptr<const PackedDataset> packed_;
+};
@@ -0,0 +1,283 @@
+#include "io/image_codec.h"
+#include "io/checksum.h"
+#include "io/image_io.h"
+#include "io/range_coder.h"
+#include "math/thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t TILE = ImageIO::TARGET_SIZE;
+constexpr size_t CHANNELS = ImageIO::CHANNELS;
+constexpr char MAGIC[4] = {'A', 'E', 'I', 'C'};
+
+// Files with at least this many tiles keep one set of models per latent dimension
+constexpr size_t PER_DIMENSION_TILES = 32;
+
+// Quantized values are kept below 2^24 in magnitude, so the exponent is at most 23
+constexpr unsigned MAX_EXPONENT = 23;
+constexpr float MAX_LEVEL = static_cast<float>((1 << 24) - 1);
+
+// Adaptive bit models for the values of one latent dimension (or of all of them)
+struct ValueModel {
+    BitModel zero;
+    BitModel sign;
+    BitModel exponent[MAX_EXPONENT];
+    BitModel mantissa[MAX_EXPONENT + 1];   // top bit below the leading one
+};
+
+void encode_value(RangeEncoder& enc, ValueModel& m, int32_t q) {
+    enc.encode_bit(m.zero, q != 0);
+    if (q == 0) {
+        return;
+    }
+    enc.encode_bit(m.sign, q < 0);
+    uint32_t mag = static_cast<uint32_t>(q < 0 ? -q : q);
+    unsigned e = 0;
+    while ((mag >> (e + 1)) != 0) {
+        ++e;
+    }
+    for (unsigned i = 0; i < e; ++i) {
+        enc.encode_bit(m.exponent[i], 1);
+    }
+    if (e < MAX_EXPONENT) {
+        enc.encode_bit(m.exponent[e], 0);
+    }
+    if (e > 0) {
+        enc.encode_bit(m.mantissa[e], (mag >> (e - 1)) & 1);
+        enc.encode_direct(mag, e - 1);
+    }
+}
+
+int32_t decode_value(RangeDecoder& dec, ValueModel& m) {
+    if (dec.decode_bit(m.zero) == 0) {
+        return 0;
+    }
+    bool negative = dec.decode_bit(m.sign) != 0;
+    unsigned e = 0;
+    while (e < MAX_EXPONENT && dec.decode_bit(m.exponent[e]) != 0) {
+        ++e;
+    }
+    uint32_t mag = 1;
+    if (e > 0) {
+        mag = (2u | dec.decode_bit(m.mantissa[e])) << (e - 1);
+        mag |= dec.decode_direct(e - 1);
+    }
+    int32_t q = static_cast<int32_t>(mag);
+    return negative ? -q : q;
+}
+
+// One set of models per dimension once there are enough tiles for each to learn
+// from; a few tiles share one set
+size_t model_count(const CodecHeader& header) {
+    return header.tiles() >= PER_DIMENSION_TILES ? header.latent_size : 1;
+}
+
+void put_u16(unsigned char* p, size_t v) {
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+}
+
+size_t get_u16(const unsigned char* p) {
+    return static_cast<size_t>(p[0]) | static_cast<size_t>(p[1]) << 8;
+}
+
+void put_u32(unsigned char* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        p[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+}
+
+uint32_t get_u32(const unsigned char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+void check_header(const CodecHeader& h) {
+    if (h.width == 0 || h.height == 0 || h.width > 0xFFFF || h.height > 0xFFFF) {
+        throw std::invalid_argument("Image codec: image size must be 1 to 65535 pixels a side");
+    }
+    if (!h.tiled && (h.width != TILE || h.height != TILE)) {
+        throw std::invalid_argument("Image codec: whole-image files decode to " +
+                                    std::to_string(TILE) + "x" + std::to_string(TILE));
+    }
+    if (h.latent_size == 0 || h.latent_size > 0xFFFF) {
+        throw std::invalid_argument("Image codec: latent size must be 1 to 65535");
+    }
+    if (!(h.step > 0.0f) || !std::isfinite(h.step)) {
+        throw std::invalid_argument("Image codec: quantization step must be positive");
+    }
+}
+
+}  // namespace
+
+size_t CodecHeader::tile_cols() const {
+    return tiled ? (width + TILE - 1) / TILE : 1;
+}
+
+size_t CodecHeader::tile_rows() const {
+    return tiled ? (height + TILE - 1) / TILE : 1;
+}
+
+uint32_t ImageCodec::model_tag(const std::string& architecture) {
+    Checksum sum;
+    sum.update(architecture.data(), architecture.size());
+    return static_cast<uint32_t>(sum.finish());
+}
+
+void ImageCodec::quantize(Tensor& latents, float step) {
+    for (size_t i = 0; i < latents.size(); ++i) {
+        float level = std::clamp(std::nearbyint(latents[i] / step), -MAX_LEVEL, MAX_LEVEL);
+        latents[i] = level * step;
+    }
+}
+
+std::vector<unsigned char> ImageCodec::compress(const CodecHeader& header, const Tensor& latents) {
+    check_header(header);
+    if (latents.rows != header.tiles() || latents.cols != header.latent_size) {
+        throw std::invalid_argument("Image codec: expected " + std::to_string(header.tiles()) +
+                                    "x" + std::to_string(header.latent_size) + " latents, got " +
+                                    std::to_string(latents.rows) + "x" +
+                                    std::to_string(latents.cols));
+    }
+
+    std::vector<unsigned char> file(HEADER_SIZE);
+    std::memcpy(file.data(), MAGIC, 4);
+    file[4] = VERSION;
+    file[5] = header.tiled ? 1 : 0;
+    put_u16(&file[6], header.width);
+    put_u16(&file[8], header.height);
+    put_u16(&file[10], header.latent_size);
+    uint32_t step_bits;
+    std::memcpy(&step_bits, &header.step, 4);
+    put_u32(&file[12], step_bits);
+    put_u32(&file[16], header.model_tag);
+
+    std::vector<ValueModel> models(model_count(header));
+    RangeEncoder enc;
+    for (size_t t = 0; t < latents.rows; ++t) {
+        for (size_t d = 0; d < latents.cols; ++d) {
+            float level = std::nearbyint(latents(t, d) / header.step);
+            int32_t q = static_cast<int32_t>(std::clamp(level, -MAX_LEVEL, MAX_LEVEL));
+            encode_value(enc, models[d % models.size()], q);
+        }
+    }
+    const std::vector<unsigned char>& payload = enc.finish();
+    file.insert(file.end(), payload.begin(), payload.end());
+    return file;
+}
+
+CodecHeader ImageCodec::read_header(const std::vector<unsigned char>& file) {
+    if (file.size() < HEADER_SIZE || std::memcmp(file.data(), MAGIC, 4) != 0) {
+        throw std::runtime_error("Image codec: not a compressed image");
+    }
+    if (file[4] != VERSION) {
+        throw std::runtime_error("Image codec: unsupported version " + std::to_string(file[4]));
+    }
+    CodecHeader header;
+    header.tiled = (file[5] & 1) != 0;
+    header.width = get_u16(&file[6]);
+    header.height = get_u16(&file[8]);
+    header.latent_size = get_u16(&file[10]);
+    uint32_t step_bits = get_u32(&file[12]);
+    std::memcpy(&header.step, &step_bits, 4);
+    header.model_tag = get_u32(&file[16]);
+    try {
+        check_header(header);
+    } catch (const std::invalid_argument& e) {
+        throw std::runtime_error(std::string("Corrupt compressed image: ") + e.what());
+    }
+    return header;
+}
+
+Tensor ImageCodec::decompress(const std::vector<unsigned char>& file, CodecHeader& header) {
+    header = read_header(file);
+    Tensor latents = Tensor::uninitialized(header.tiles(), header.latent_size);
+    std::vector<ValueModel> models(model_count(header));
+    RangeDecoder dec(file.data() + HEADER_SIZE, file.size() - HEADER_SIZE);
+    for (size_t t = 0; t < latents.rows; ++t) {
+        for (size_t d = 0; d < latents.cols; ++d) {
+            int32_t q = decode_value(dec, models[d % models.size()]);
+            latents(t, d) = static_cast<float>(q) * header.step;
+        }
+    }
+    if (dec.position() != file.size() - HEADER_SIZE) {
+        throw std::runtime_error("Corrupt compressed image: " +
+                                 std::to_string(file.size() - HEADER_SIZE - dec.position()) +
+                                 " bytes after the last latent");
+    }
+    return latents;
+}
+
+Tensor ImageCodec::split_tiles(const unsigned char* pixels, size_t width, size_t height) {
+    size_t cols = (width + TILE - 1) / TILE;
+    size_t rows = (height + TILE - 1) / TILE;
+    Tensor tiles = Tensor::uninitialized(cols * rows, ImageIO::FLAT_SIZE);
+    ThreadPool::global().parallel_for(tiles.rows, 1, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t x0 = (t % cols) * TILE, y0 = (t / cols) * TILE;
+            float* dst = tiles.data.data() + t * ImageIO::FLAT_SIZE;
+            for (size_t ty = 0; ty < TILE; ++ty) {
+                const unsigned char* src = pixels + std::min(y0 + ty, height - 1) * width * CHANNELS;
+                for (size_t tx = 0; tx < TILE; ++tx) {
+                    size_t x = std::min(x0 + tx, width - 1);
+                    for (size_t c = 0; c < CHANNELS; ++c) {
+                        *dst++ = static_cast<float>(src[x * CHANNELS + c]) / 255.0f;
+                    }
+                }
+            }
+        }
+    });
+    return tiles;
+}
+
+void ImageCodec::join_tiles(const Tensor& tiles, size_t width, size_t height,
+                            unsigned char* pixels) {
+    size_t cols = (width + TILE - 1) / TILE;
+    if (tiles.rows != cols * ((height + TILE - 1) / TILE) ||
+        tiles.cols != static_cast<size_t>(ImageIO::FLAT_SIZE)) {
+        throw std::invalid_argument("join_tiles: tile matrix does not cover a " +
+                                    std::to_string(width) + "x" + std::to_string(height) +
+                                    " image");
+    }
+    ThreadPool::global().parallel_for(tiles.rows, 1, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t x0 = (t % cols) * TILE, y0 = (t / cols) * TILE;
+            size_t w = std::min(TILE, width - x0), h = std::min(TILE, height - y0);
+            const float* src = tiles.data.data() + t * ImageIO::FLAT_SIZE;
+            for (size_t ty = 0; ty < h; ++ty) {
+                unsigned char* dst = pixels + ((y0 + ty) * width + x0) * CHANNELS;
+                const float* row = src + ty * TILE * CHANNELS;
+                for (size_t i = 0; i < w * CHANNELS; ++i) {
+                    float v = std::clamp(row[i], 0.0f, 1.0f);
+                    dst[i] = static_cast<unsigned char>(v * 255.0f + 0.5f);
+                }
+            }
+        }
+    });
+}
+
+void ImageCodec::save(const std::string& path, const std::vector<unsigned char>& file) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    if (!out) {
+        throw std::runtime_error("Failed to write compressed image: " + path);
+    }
+}
+
+std::vector<unsigned char> ImageCodec::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open compressed image: " + path);
+    }
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(in),
+                                      std::istreambuf_iterator<char>());
+}
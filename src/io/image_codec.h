@@ -0,0 +1,80 @@
+#pragma once
+
+#include "math/tensor.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What a compressed image holds besides its latents
+struct CodecHeader {
+    // Size of the decoded image: TARGET_SIZE x TARGET_SIZE for a whole-image file,
+    // the source size for a tiled one
+    size_t width = 0;
+    size_t height = 0;
+    // Tiled files code one latent per TARGET_SIZE x TARGET_SIZE tile of the image at
+    // its own resolution; whole-image files one latent of the image resized to a tile
+    bool tiled = false;
+    size_t latent_size = 0;
+    float step = 0.0f;        // quantization step of the latents
+    uint32_t model_tag = 0;   // ImageCodec::model_tag of the model that encoded them
+
+    size_t tile_cols() const;
+    size_t tile_rows() const;
+    size_t tiles() const { return tile_cols() * tile_rows(); }
+};
+
+// Lossy image codec on top of an autoencoder: an image's latents, quantized to
+// multiples of a step and entropy-coded with an adaptive range coder
+// (io/range_coder.h). The model itself stays outside the file; decoding needs the
+// model that encoded it.
+//
+// File layout (little-endian), kept small because it is a visible share of a file
+// that codes one 64-d latent in a few dozen bytes:
+//   [0, 4)    magic "AEIC"
+//   [4]       version
+//   [5]       flags: bit 0 set for tiled files
+//   [6, 12)   width, height, latent size (uint16 each)
+//   [12, 16)  quantization step (float32)
+//   [16, 20)  model tag
+//   [20, ..)  range-coded latents, tile by tile in row-major tile order
+//
+// Each latent value is coded as its quantized integer: a zero flag, a sign, an
+// Exp-Golomb exponent in unary and the mantissa bits. All but the mantissa bits
+// below the top one go through adaptive models. Files of 32 tiles or more keep
+// separate models per latent dimension; smaller ones share one set across
+// dimensions.
+class ImageCodec {
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 20;
+
+    // Tag of a model's architecture description (Autoencoder::architecture), stored
+    // so that decoding with a different layer stack fails instead of producing noise.
+    // Models with the same layers but different weights share a tag.
+    static uint32_t model_tag(const std::string& architecture);
+
+    // Round latents to multiples of step, as decompress will return them
+    static void quantize(Tensor& latents, float step);
+
+    // Code a (header.tiles(), header.latent_size) latent matrix. Throws
+    // std::invalid_argument if the header is out of range or does not match it.
+    static std::vector<unsigned char> compress(const CodecHeader& header, const Tensor& latents);
+
+    // Header of a compressed file; throws std::runtime_error if it is not one
+    static CodecHeader read_header(const std::vector<unsigned char>& file);
+
+    // Quantized latents of a compressed file. Throws std::runtime_error if the file
+    // is truncated or its payload does not decode to exactly the tiles it declares.
+    static Tensor decompress(const std::vector<unsigned char>& file, CodecHeader& header);
+
+    // Tiles of a width x height interleaved RGB image as (tiles, FLAT_SIZE) values in
+    // [0,1], in the tiled layout: tiles past the right or bottom edge repeat the
+    // image's last column or row
+    static Tensor split_tiles(const unsigned char* pixels, size_t width, size_t height);
+    // Inverse of split_tiles, dropping the padding (values are clamped and rounded)
+    static void join_tiles(const Tensor& tiles, size_t width, size_t height,
+                           unsigned char* pixels);
+
+    static void save(const std::string& path, const std::vector<unsigned char>& file);
+    static std::vector<unsigned char> load(const std::string& path);
+};
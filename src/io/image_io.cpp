@@ -8,8 +8,34 @@
 #include "io/image_io.h"
 #include <stdexcept>
 #include <algorithm>
+#include <cstring>
 
 Tensor ImageIO::load(const std::string& path) {
+    Tensor tensor = Tensor::uninitialized(1, FLAT_SIZE);
+    load_into(path, tensor.data.data());
+    return tensor;
+}
+
+void ImageIO::load_into(const std::string& path, float* dst) {
+    unsigned char resized[FLAT_SIZE];
+    load_pixels(path, resized);
+    from_pixels(resized, dst);
+}
+
+void ImageIO::from_pixels(const unsigned char* src, float* dst) {
+    for (int i = 0; i < FLAT_SIZE; ++i) {
+        dst[i] = static_cast<float>(src[i]) / 255.0f;
+    }
+}
+
+void ImageIO::to_pixels(const float* src, unsigned char* dst) {
+    for (int i = 0; i < FLAT_SIZE; ++i) {
+        float val = std::clamp(src[i], 0.0f, 1.0f);
+        dst[i] = static_cast<unsigned char>(val * 255.0f + 0.5f);
+    }
+}
+
+void ImageIO::load_pixels(const std::string& path, unsigned char* dst) {
     int w, h, c;
     unsigned char* raw = stbi_load(path.c_str(), &w, &h, &c, CHANNELS);
     if (!raw) {
@@ -17,19 +43,11 @@ Tensor ImageIO::load(const std::string& path) {
     }
 
     // Resize to 64x64
-    std::vector<unsigned char> resized(TARGET_SIZE * TARGET_SIZE * CHANNELS);
     stbir_resize_uint8_linear(
         raw, w, h, 0,
-        resized.data(), TARGET_SIZE, TARGET_SIZE, 0,
+        dst, TARGET_SIZE, TARGET_SIZE, 0,
         static_cast<stbir_pixel_layout>(CHANNELS));
     stbi_image_free(raw);
-
-    // Normalize to [0,1] and flatten
-    Tensor tensor(1, FLAT_SIZE);
-    for (int i = 0; i < FLAT_SIZE; ++i) {
-        tensor[i] = static_cast<float>(resized[i]) / 255.0f;
-    }
-    return tensor;
 }
 
 void ImageIO::save(const Tensor& tensor, const std::string& path) {
@@ -40,13 +58,44 @@ void ImageIO::save(const Tensor& tensor, const std::string& path) {
 
     // Denormalize to [0, 255]
     std::vector<unsigned char> pixels(FLAT_SIZE);
-    for (int i = 0; i < FLAT_SIZE; ++i) {
-        float val = std::clamp(tensor[i], 0.0f, 1.0f);
-        pixels[i] = static_cast<unsigned char>(val * 255.0f + 0.5f);
-    }
+    to_pixels(tensor.data.data(), pixels.data());
 
     if (!stbi_write_png(path.c_str(), TARGET_SIZE, TARGET_SIZE, CHANNELS,
                         pixels.data(), TARGET_SIZE * CHANNELS)) {
         throw std::runtime_error("Failed to write image: " + path);
     }
 }
+
+std::vector<unsigned char> ImageIO::encode_png(const unsigned char* pixels, size_t width,
+                                               size_t height) {
+    int len = 0;
+    unsigned char* png = stbi_write_png_to_mem(pixels, static_cast<int>(width * CHANNELS),
+                                               static_cast<int>(width), static_cast<int>(height),
+                                               CHANNELS, &len);
+    if (!png) {
+        throw std::runtime_error("Failed to encode PNG");
+    }
+    std::vector<unsigned char> bytes(png, png + len);
+    STBIW_FREE(png);
+    return bytes;
+}
+
+void ImageIO::decode_png(const std::vector<unsigned char>& png, size_t width, size_t height,
+                         unsigned char* pixels) {
+    int w, h, c;
+    unsigned char* raw = stbi_load_from_memory(png.data(), static_cast<int>(png.size()),
+                                               &w, &h, &c, CHANNELS);
+    if (!raw) {
+        throw std::runtime_error("Failed to decode PNG");
+    }
+    bool match = static_cast<size_t>(w) == width && static_cast<size_t>(h) == height;
+    if (match) {
+        std::memcpy(pixels, raw, width * height * CHANNELS);
+    }
+    stbi_image_free(raw);
+    if (!match) {
+        throw std::runtime_error("PNG is " + std::to_string(w) + "x" + std::to_string(h) +
+                                 ", expected " + std::to_string(width) + "x" +
+                                 std::to_string(height));
+    }
+}
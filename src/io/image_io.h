@@ -2,6 +2,7 @@
 
 #include "math/tensor.h"
 #include <string>
+#include <vector>
 
 class ImageIO {
 public:
@@ -12,6 +13,24 @@ public:
     // Load image, resize to 64x64, normalize to [0,1], flatten to (1, 12288)
     static Tensor load(const std::string& path);
 
+    // Same as load, but writes the FLAT_SIZE values to dst (e.g. a row of a batch)
+    static void load_into(const std::string& path, float* dst);
+
+    // Load and resize only: FLAT_SIZE interleaved RGB bytes in [0, 255]
+    static void load_pixels(const std::string& path, unsigned char* dst);
+
+    // Convert between FLAT_SIZE interleaved RGB bytes and normalized floats in [0,1]
+    // (to_pixels clamps and rounds)
+    static void from_pixels(const unsigned char* src, float* dst);
+    static void to_pixels(const float* src, unsigned char* dst);
+
     // Denormalize from [0,1], reshape, save as PNG
     static void save(const Tensor& tensor, const std::string& path);
+
+    // PNG file bytes of width x height interleaved RGB pixels, and the pixels of PNG
+    // bytes (throws unless they decode to a width x height image)
+    static std::vector<unsigned char> encode_png(const unsigned char* pixels, size_t width,
+                                                 size_t height);
+    static void decode_png(const std::vector<unsigned char>& png, size_t width, size_t height,
+                           unsigned char* pixels);
 };
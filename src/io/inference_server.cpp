@@ -0,0 +1,367 @@
+#include "io/inference_server.h"
+#include "io/image_io.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Buffered reader over a file descriptor for the mixed line/binary protocol
+class FdReader {
+public:
+    explicit FdReader(int fd) : fd_(fd) {}
+
+    // Next line without its terminator; false at end of input
+    bool read_line(std::string& line) {
+        line.clear();
+        for (;;) {
+            if (pos_ == len_ && !fill()) {
+                return !line.empty();
+            }
+            const char* start = buf_ + pos_;
+            const char* nl = static_cast<const char*>(std::memchr(start, '\n', len_ - pos_));
+            if (nl) {
+                line.append(start, nl);
+                pos_ += static_cast<size_t>(nl - start) + 1;
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                return true;
+            }
+            line.append(start, len_ - pos_);
+            pos_ = len_;
+        }
+    }
+
+    bool read_exact(unsigned char* dst, size_t n) {
+        while (n > 0) {
+            if (pos_ == len_ && !fill()) {
+                return false;
+            }
+            size_t take = std::min(n, len_ - pos_);
+            std::memcpy(dst, buf_ + pos_, take);
+            pos_ += take;
+            dst += take;
+            n -= take;
+        }
+        return true;
+    }
+
+private:
+    bool fill() {
+        for (;;) {
+            ssize_t got = ::read(fd_, buf_, sizeof(buf_));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            pos_ = 0;
+            len_ = got > 0 ? static_cast<size_t>(got) : 0;
+            return len_ > 0;
+        }
+    }
+
+    int fd_;
+    char buf_[1 << 16];
+    size_t pos_ = 0, len_ = 0;
+};
+
+// One response of a connection. Results carry a copy of the reconstruction, which
+// the connection's writer turns into pixels or a PNG file before sending.
+struct Reply {
+    std::string line;
+    std::vector<float> reconstruction;  // empty for ERR and STATS lines
+    bool raw = false;                   // send the reconstruction bytes after the line
+    std::string output_png;             // save the reconstruction here first
+    uint64_t id = 0;
+};
+
+// Response side of a connection. Replies are queued by the reader and by the
+// completion callbacks of its in-flight requests, and written by the connection's
+// own writer thread, so a slow client or PNG encode never holds up the batcher's
+// compute thread (and with it every other connection).
+class Connection {
+public:
+    explicit Connection(int fd) : out_fd_(fd), writer_(&Connection::write_loop, this) {}
+
+    void post(Reply reply) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(reply));
+        }
+        cv_.notify_all();
+    }
+
+    void begin_request() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++pending_;
+    }
+
+    // Queue a request's result; called on the compute thread
+    void complete(Reply reply) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(reply));
+            --pending_;
+        }
+        cv_.notify_all();
+    }
+
+    // Wait for the outstanding requests, send every queued reply and stop the writer
+    void finish() {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return pending_ == 0; });
+            done_ = true;
+        }
+        cv_.notify_all();
+        writer_.join();
+    }
+
+private:
+    void write_loop() {
+        for (;;) {
+            Reply reply;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&] { return !queue_.empty() || done_; });
+                if (queue_.empty()) {
+                    return;
+                }
+                reply = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            write_reply(reply);
+        }
+    }
+
+    void write_reply(const Reply& reply) {
+        if (reply.reconstruction.empty()) {
+            write_all(reply.line.data(), reply.line.size());
+            return;
+        }
+        try {
+            if (reply.raw) {
+                unsigned char out[ImageIO::FLAT_SIZE];
+                ImageIO::to_pixels(reply.reconstruction.data(), out);
+                if (write_all(reply.line.data(), reply.line.size())) {
+                    write_all(out, sizeof(out));
+                }
+                return;
+            }
+            if (!reply.output_png.empty()) {
+                Tensor image = Tensor::uninitialized(1, ImageIO::FLAT_SIZE);
+                std::copy(reply.reconstruction.begin(), reply.reconstruction.end(),
+                          image.data.data());
+                ImageIO::save(image, reply.output_png);
+            }
+            write_all(reply.line.data(), reply.line.size());
+        } catch (const std::exception& e) {
+            std::string err = "ERR " + std::to_string(reply.id) + " " + e.what() + "\n";
+            write_all(err.data(), err.size());
+        }
+    }
+
+    bool write_all(const void* data, size_t n) {
+        const char* p = static_cast<const char*>(data);
+        while (n > 0 && !closed_) {
+            ssize_t put = ::write(out_fd_, p, n);
+            if (put < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                closed_ = true;
+                break;
+            }
+            p += put;
+            n -= static_cast<size_t>(put);
+        }
+        return !closed_;
+    }
+
+    int out_fd_;
+    bool closed_ = false;  // a write failed: the peer is gone, drop further output
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Reply> queue_;
+    size_t pending_ = 0;   // submitted requests whose result is not queued yet
+    bool done_ = false;
+    std::thread writer_;   // declared last: starts once the members above exist
+};
+
+std::string format_ok(uint64_t seq, const InferenceResult& r) {
+    std::string line = "OK " + std::to_string(seq);
+    char num[32];
+    std::snprintf(num, sizeof(num), " mse=%.6g latent=", r.mse);
+    line += num;
+    for (size_t i = 0; i < r.latent_size; ++i) {
+        std::snprintf(num, sizeof(num), i ? ",%.6g" : "%.6g", r.latent[i]);
+        line += num;
+    }
+    line += '\n';
+    return line;
+}
+
+}  // namespace
+
+void InferenceServer::serve_connection(DynamicBatcher& batcher, int in_fd, int out_fd) {
+    auto conn = std::make_shared<Connection>(out_fd);
+    FdReader reader(in_fd);
+    std::vector<float> input(ImageIO::FLAT_SIZE);
+    std::vector<unsigned char> pixels(ImageIO::FLAT_SIZE);
+    std::string line;
+    uint64_t seq = 0;
+    auto error = [&](uint64_t id, const std::string& message) {
+        Reply reply;
+        reply.line = "ERR " + std::to_string(id) + " " + message + "\n";
+        conn->post(std::move(reply));
+    };
+
+    while (reader.read_line(line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (line == "STATS") {
+            Reply reply;
+            reply.line = format_stats(batcher.stats()) + "\n";
+            conn->post(std::move(reply));
+            continue;
+        }
+
+        uint64_t id = seq++;
+        bool raw = line == "RAW";
+        std::string output_png;
+        try {
+            if (raw) {
+                if (!reader.read_exact(pixels.data(), pixels.size())) {
+                    error(id, "truncated RAW payload");
+                    break;
+                }
+                ImageIO::from_pixels(pixels.data(), input.data());
+            } else {
+                std::istringstream fields(line);
+                std::string path;
+                fields >> path >> output_png;
+                ImageIO::load_into(path, input.data());
+            }
+        } catch (const std::exception& e) {
+            error(id, e.what());
+            continue;
+        }
+
+        // The compute thread only copies the result into the connection's queue
+        conn->begin_request();
+        batcher.submit(input.data(), [conn, id, raw, output_png](const InferenceResult& r) {
+            Reply reply;
+            reply.line = format_ok(id, r);
+            reply.reconstruction.assign(r.reconstruction, r.reconstruction + ImageIO::FLAT_SIZE);
+            reply.raw = raw;
+            reply.output_png = output_png;
+            reply.id = id;
+            conn->complete(std::move(reply));
+        });
+    }
+    conn->finish();
+}
+
+void InferenceServer::serve_unix_socket(DynamicBatcher& batcher, const std::string& path,
+                                        const std::atomic<bool>& stop) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        throw std::runtime_error("Failed to create socket: " + std::string(std::strerror(errno)));
+    }
+    ::unlink(path.c_str());
+    if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listen_fd, 64) < 0) {
+        std::string err = std::strerror(errno);
+        ::close(listen_fd);
+        throw std::runtime_error("Failed to listen on " + path + ": " + err);
+    }
+
+    // Connection threads report when they are done, and the accept loop joins them,
+    // so a long-running server only keeps the threads of live connections
+    std::mutex fds_mutex;
+    std::vector<int> open_fds;
+    std::list<std::thread> threads;
+    std::vector<std::thread::id> finished;
+    auto reap = [&] {
+        std::vector<std::thread::id> done;
+        {
+            std::lock_guard<std::mutex> lock(fds_mutex);
+            done.swap(finished);
+        }
+        for (std::thread::id id : done) {
+            auto t = std::find_if(threads.begin(), threads.end(),
+                                  [&](const std::thread& th) { return th.get_id() == id; });
+            t->join();
+            threads.erase(t);
+        }
+    };
+
+    while (!stop.load()) {
+        reap();
+        // Poll with a timeout so `stop` is noticed without a new connection
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(fds_mutex);
+            open_fds.push_back(fd);
+        }
+        threads.emplace_back([&batcher, &fds_mutex, &open_fds, &finished, fd] {
+            serve_connection(batcher, fd, fd);
+            std::lock_guard<std::mutex> lock(fds_mutex);
+            open_fds.erase(std::find(open_fds.begin(), open_fds.end(), fd));
+            ::close(fd);
+            finished.push_back(std::this_thread::get_id());
+        });
+    }
+
+    ::close(listen_fd);
+    ::unlink(path.c_str());
+    {
+        // Wake connections blocked reading from idle clients; queued work still completes
+        std::lock_guard<std::mutex> lock(fds_mutex);
+        for (int fd : open_fds) {
+            ::shutdown(fd, SHUT_RD);
+        }
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+std::string InferenceServer::format_stats(const LatencyStats& s) {
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+                  "STATS requests=%zu batches=%zu mean_batch=%.2f p50_ms=%.3f p99_ms=%.3f"
+                  " throughput=%.1f",
+                  s.requests, s.batches, s.mean_batch, s.p50_ms, s.p99_ms, s.throughput);
+    return buf;
+}
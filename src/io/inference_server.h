@@ -0,0 +1,40 @@
+#pragma once
+
+#include "io/batcher.h"
+#include <atomic>
+#include <string>
+
+// Line protocol of `reconstruct --serve`, spoken over stdin/stdout or a Unix socket.
+//
+// Requests, one per line:
+//   <image_path> [<output_png>]   decode and resize an image file; if output_png is
+//                                 given, the reconstruction is saved there
+//   RAW                           followed by exactly FLAT_SIZE bytes: a 64x64 RGB
+//                                 image, interleaved, row-major
+//   STATS                         report latency and throughput so far
+//
+// Responses carry the request's sequence number on its connection (counting from 0,
+// STATS excluded):
+//   OK <seq> mse=<f> latent=<v0>,<v1>,...
+//     for RAW requests the line is followed by the FLAT_SIZE reconstruction bytes
+//   ERR <seq> <message>
+//   STATS requests=<n> batches=<n> mean_batch=<f> p50_ms=<f> p99_ms=<f> throughput=<f>
+// OK responses arrive in request order; ERR responses are sent as soon as a request
+// fails to load, possibly ahead of earlier requests still being computed.
+class InferenceServer {
+public:
+    // Serve one connection until end of input, then wait for its outstanding requests.
+    // in_fd and out_fd may be the same descriptor. Responses are written by a writer
+    // thread of the connection, so a client that reads slowly only delays itself.
+    static void serve_connection(DynamicBatcher& batcher, int in_fd, int out_fd);
+
+    // Accept connections on a Unix socket at `path` (replacing any stale socket file)
+    // until `stop` becomes true, serving each on its own thread. Threads of finished
+    // connections are joined as the server runs. Returns once every connection has
+    // finished.
+    static void serve_unix_socket(DynamicBatcher& batcher, const std::string& path,
+                                  const std::atomic<bool>& stop);
+
+    // One-line summary in the STATS response format (without the newline)
+    static std::string format_stats(const LatencyStats& stats);
+};
@@ -0,0 +1,106 @@
+#include "io/latent_file.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+static const char LATENT_MAGIC[8] = {'A', 'E', 'L', 'A', 'T', 'E', 'N', 'T'};
+static constexpr uint64_t DATA_OFFSET = 64;
+static constexpr uint32_t DTYPE_FLOAT32 = 0;
+
+struct LatentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t data_offset;
+    unsigned char padding[24];
+};
+static_assert(sizeof(LatentHeader) == DATA_OFFSET, "latent header must be 64 bytes");
+
+LatentFile::LatentFile(const std::string& path) : file_(path) {
+    if (file_.size() < sizeof(LatentHeader)) {
+        throw std::runtime_error("Latent file too small: " + path);
+    }
+    LatentHeader h;
+    std::memcpy(&h, file_.data(), sizeof(h));
+    if (std::memcmp(h.magic, LATENT_MAGIC, sizeof(LATENT_MAGIC)) != 0) {
+        throw std::runtime_error("Not a latent file: " + path);
+    }
+    if (h.version != VERSION) {
+        throw std::runtime_error("Unsupported latent file version " + std::to_string(h.version) +
+            " in " + path);
+    }
+    if (h.dtype != DTYPE_FLOAT32) {
+        throw std::runtime_error("Unknown latent dtype in " + path);
+    }
+    if (h.cols == 0 || h.rows > (file_.size() / sizeof(float)) / h.cols ||
+        h.data_offset < sizeof(LatentHeader) || h.data_offset % sizeof(float) != 0 ||
+        file_.size() - h.data_offset < h.rows * h.cols * sizeof(float)) {
+        throw std::runtime_error("Latent file truncated: " + path);
+    }
+    rows_ = static_cast<size_t>(h.rows);
+    cols_ = static_cast<size_t>(h.cols);
+    data_ = reinterpret_cast<const float*>(file_.data() + h.data_offset);
+}
+
+Tensor LatentFile::to_tensor() const {
+    Tensor t = Tensor::uninitialized(rows_, cols_);
+    std::memcpy(t.data.data(), data_, rows_ * cols_ * sizeof(float));
+    return t;
+}
+
+static LatentHeader make_header(size_t rows, size_t cols) {
+    LatentHeader h{};
+    std::memcpy(h.magic, LATENT_MAGIC, sizeof(LATENT_MAGIC));
+    h.version = LatentFile::VERSION;
+    h.dtype = DTYPE_FLOAT32;
+    h.rows = rows;
+    h.cols = cols;
+    h.data_offset = DATA_OFFSET;
+    return h;
+}
+
+LatentWriter::LatentWriter(const std::string& path, size_t cols)
+    : path_(path), tmp_path_(path + ".tmp"), out_(tmp_path_, std::ios::binary), cols_(cols) {
+    if (!out_) {
+        throw std::runtime_error("Failed to open file for writing: " + tmp_path_);
+    }
+    // The row count is filled in by finish()
+    LatentHeader h = make_header(0, cols_);
+    out_.write(reinterpret_cast<const char*>(&h), sizeof(h));
+}
+
+LatentWriter::~LatentWriter() {
+    if (!finished_) {
+        out_.close();
+        std::remove(tmp_path_.c_str());
+    }
+}
+
+void LatentWriter::append(const Tensor& rows) {
+    if (rows.cols != cols_) {
+        throw std::invalid_argument("LatentWriter: expected " + std::to_string(cols_) +
+                                    " columns, got " + std::to_string(rows.cols));
+    }
+    out_.write(reinterpret_cast<const char*>(rows.data.data()),
+               static_cast<std::streamsize>(rows.size() * sizeof(float)));
+    if (!out_) {
+        throw std::runtime_error("Failed to write latents: " + tmp_path_);
+    }
+    rows_ += rows.rows;
+}
+
+void LatentWriter::finish() {
+    LatentHeader h = make_header(rows_, cols_);
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out_.close();
+    if (!out_) {
+        throw std::runtime_error("Failed to write latents: " + tmp_path_);
+    }
+    if (std::rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+        throw std::runtime_error("Failed to move latent file into place: " + path_);
+    }
+    finished_ = true;
+}
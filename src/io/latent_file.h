@@ -0,0 +1,64 @@
+#pragma once
+
+#include "io/mapped_file.h"
+#include "math/tensor.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Matrix of latent vectors (image embeddings), one row per image in the order of
+// the dataset they were encoded from (see the `encode` tool).
+//
+// Layout (little-endian):
+//   [0, 64)         header: magic "AELATENT", version, dtype (0 = float32), rows,
+//                   cols, data offset
+//   [data_offset..) rows x cols float32 values, row-major
+class LatentFile {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    // Map an existing latent file. Throws if the header is invalid or the file is
+    // truncated.
+    explicit LatentFile(const std::string& path);
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+
+    // Row-major values, read straight from the mapped pages
+    const float* data() const { return data_; }
+    const float* row(size_t i) const { return data_ + i * cols_; }
+
+    // Copy of the whole matrix
+    Tensor to_tensor() const;
+
+private:
+    MappedFile file_;
+    size_t rows_;
+    size_t cols_;
+    const float* data_;
+};
+
+// Streams rows into a latent file. Rows go to "<path>.tmp", which finish() moves
+// into place once the header records the final row count, so an interrupted run
+// never leaves a partial file at `path`.
+class LatentWriter {
+public:
+    LatentWriter(const std::string& path, size_t cols);
+    ~LatentWriter();
+    LatentWriter(const LatentWriter&) = delete;
+    LatentWriter& operator=(const LatentWriter&) = delete;
+
+    // Append every row of `rows` (rows.cols must equal cols)
+    void append(const Tensor& rows);
+    void finish();
+
+    size_t rows() const { return rows_; }
+
+private:
+    std::string path_;
+    std::string tmp_path_;
+    std::ofstream out_;
+    size_t cols_;
+    size_t rows_ = 0;
+    bool finished_ = false;
+};
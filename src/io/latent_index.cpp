@@ -0,0 +1,306 @@
+#include "io/latent_index.h"
+#include "math/distance.h"
+#include "math/gemm.h"
+#include "math/tensor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+static const char INDEX_MAGIC[8] = {'A', 'E', 'I', 'V', 'F', 'I', 'D', 'X'};
+static constexpr uint64_t SECTION_ALIGN = 64;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dim;
+    uint64_t rows;
+    uint64_t lists;
+    uint64_t centroids_offset;
+    uint64_t offsets_offset;
+    uint64_t ids_offset;
+    uint64_t vectors_offset;
+};
+static_assert(sizeof(IndexHeader) == SECTION_ALIGN, "index header must be 64 bytes");
+
+static uint64_t align_up(uint64_t n) {
+    return (n + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+}
+
+// Rows assigned per GEMM call while clustering
+static constexpr size_t ASSIGN_BLOCK = 1024;
+
+// Nearest centroid of each of the m rows of x. Distances are ranked as
+// |c|^2 - 2 x.c (|x|^2 is the same for every centroid), with the dot products
+// for a block of rows computed by one GEMM against all centroids.
+static void assign(const float* x, size_t m, size_t dim, const Tensor& centroids,
+                   const std::vector<float>& norms, uint32_t* labels) {
+    size_t lists = centroids.rows;
+    Tensor dots = Tensor::uninitialized(std::min(m, ASSIGN_BLOCK), lists);
+    for (size_t begin = 0; begin < m; begin += ASSIGN_BLOCK) {
+        size_t count = std::min(ASSIGN_BLOCK, m - begin);
+        GemmArgs g;
+        g.trans_b = true;
+        g.M = count;
+        g.N = lists;
+        g.K = dim;
+        g.A = x + begin * dim;
+        g.lda = dim;
+        g.B = centroids.data.data();
+        g.ldb = dim;
+        g.C = dots.data.data();
+        g.ldc = lists;
+        gemm(g);
+        for (size_t i = 0; i < count; ++i) {
+            const float* d = dots.data.data() + i * lists;
+            uint32_t best = 0;
+            float best_score = norms[0] - 2.0f * d[0];
+            for (size_t c = 1; c < lists; ++c) {
+                float score = norms[c] - 2.0f * d[c];
+                if (score < best_score) {
+                    best_score = score;
+                    best = static_cast<uint32_t>(c);
+                }
+            }
+            labels[begin + i] = best;
+        }
+    }
+}
+
+static std::vector<float> squared_norms(const Tensor& centroids) {
+    std::vector<float> norms(centroids.rows);
+    for (size_t c = 0; c < centroids.rows; ++c) {
+        const float* p = centroids.data.data() + c * centroids.cols;
+        float sum = 0.0f;
+        for (size_t d = 0; d < centroids.cols; ++d) {
+            sum += p[d] * p[d];
+        }
+        norms[c] = sum;
+    }
+    return norms;
+}
+
+// Lloyd's k-means on a random sample of the rows, seeded with distinct sample rows
+static Tensor train_centroids(const LatentFile& latents, size_t lists,
+                              const IndexBuildOptions& options) {
+    size_t rows = latents.rows();
+    size_t dim = latents.cols();
+    size_t per_list = std::max<size_t>(options.sample_per_list, 1);
+    size_t m = lists > rows / per_list ? rows : lists * per_list;
+    std::mt19937_64 rng(options.seed);
+
+    // Partial Fisher-Yates shuffle: the first m entries are a uniform sample
+    std::vector<uint64_t> order(rows);
+    std::iota(order.begin(), order.end(), uint64_t(0));
+    for (size_t i = 0; i < m; ++i) {
+        std::uniform_int_distribution<size_t> pick(i, rows - 1);
+        std::swap(order[i], order[pick(rng)]);
+    }
+    Tensor sample = Tensor::uninitialized(m, dim);
+    for (size_t i = 0; i < m; ++i) {
+        std::memcpy(sample.data.data() + i * dim, latents.row(order[i]), dim * sizeof(float));
+    }
+
+    Tensor centroids = Tensor::uninitialized(lists, dim);
+    std::memcpy(centroids.data.data(), sample.data.data(), lists * dim * sizeof(float));
+    std::vector<uint32_t> labels(m);
+    std::vector<double> sums(lists * dim);
+    std::vector<size_t> counts(lists);
+    std::uniform_int_distribution<size_t> any_row(0, m - 1);
+    for (size_t it = 0; it < options.iterations; ++it) {
+        assign(sample.data.data(), m, dim, centroids, squared_norms(centroids), labels.data());
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(counts.begin(), counts.end(), size_t(0));
+        for (size_t i = 0; i < m; ++i) {
+            const float* x = sample.data.data() + i * dim;
+            double* s = sums.data() + labels[i] * dim;
+            for (size_t d = 0; d < dim; ++d) {
+                s[d] += x[d];
+            }
+            counts[labels[i]]++;
+        }
+        for (size_t c = 0; c < lists; ++c) {
+            float* p = centroids.data.data() + c * dim;
+            if (counts[c] == 0) {
+                // Reseed an empty cell at a random sample row
+                std::memcpy(p, sample.data.data() + any_row(rng) * dim, dim * sizeof(float));
+                continue;
+            }
+            for (size_t d = 0; d < dim; ++d) {
+                p[d] = static_cast<float>(sums[c * dim + d] / static_cast<double>(counts[c]));
+            }
+        }
+    }
+    return centroids;
+}
+
+static void write_padding(std::ofstream& out, uint64_t to) {
+    static const char zeros[SECTION_ALIGN] = {};
+    uint64_t at = static_cast<uint64_t>(out.tellp());
+    out.write(zeros, static_cast<std::streamsize>(to - at));
+}
+
+void LatentIndex::build(const LatentFile& latents, const std::string& path,
+                        const IndexBuildOptions& options) {
+    size_t rows = latents.rows();
+    size_t dim = latents.cols();
+    if (rows == 0) {
+        throw std::invalid_argument("Cannot index an empty latent file");
+    }
+    size_t lists = options.lists;
+    if (lists == 0) {
+        lists = static_cast<size_t>(std::lround(std::sqrt(static_cast<double>(rows))));
+    }
+    lists = std::min(std::max<size_t>(lists, 1), rows);
+
+    Tensor centroids = train_centroids(latents, lists, options);
+
+    // Group every row by its nearest centroid, keeping row order within a cell
+    std::vector<uint32_t> labels(rows);
+    assign(latents.data(), rows, dim, centroids, squared_norms(centroids), labels.data());
+    std::vector<uint64_t> offsets(lists + 1, 0);
+    for (uint32_t label : labels) {
+        offsets[label + 1]++;
+    }
+    for (size_t c = 0; c < lists; ++c) {
+        offsets[c + 1] += offsets[c];
+    }
+    std::vector<uint64_t> ids(rows);
+    std::vector<uint64_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < rows; ++i) {
+        ids[next[labels[i]]++] = i;
+    }
+
+    IndexHeader h{};
+    std::memcpy(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    h.version = VERSION;
+    h.dim = static_cast<uint32_t>(dim);
+    h.rows = rows;
+    h.lists = lists;
+    h.centroids_offset = sizeof(IndexHeader);
+    h.offsets_offset = align_up(h.centroids_offset + lists * dim * sizeof(float));
+    h.ids_offset = align_up(h.offsets_offset + (lists + 1) * sizeof(uint64_t));
+    h.vectors_offset = align_up(h.ids_offset + rows * sizeof(uint64_t));
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Failed to open file for writing: " + tmp);
+        }
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(centroids.data.data()),
+                  static_cast<std::streamsize>(lists * dim * sizeof(float)));
+        write_padding(out, h.offsets_offset);
+        out.write(reinterpret_cast<const char*>(offsets.data()),
+                  static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+        write_padding(out, h.ids_offset);
+        out.write(reinterpret_cast<const char*>(ids.data()),
+                  static_cast<std::streamsize>(rows * sizeof(uint64_t)));
+        write_padding(out, h.vectors_offset);
+        for (uint64_t id : ids) {
+            out.write(reinterpret_cast<const char*>(latents.row(id)),
+                      static_cast<std::streamsize>(dim * sizeof(float)));
+        }
+        if (!out) {
+            out.close();
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Failed to write index: " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Failed to move index into place: " + path);
+    }
+}
+
+LatentIndex::LatentIndex(const std::string& path) : file_(path) {
+    if (file_.size() < sizeof(IndexHeader)) {
+        throw std::runtime_error("Index file too small: " + path);
+    }
+    IndexHeader h;
+    std::memcpy(&h, file_.data(), sizeof(h));
+    if (std::memcmp(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+        throw std::runtime_error("Not a latent index: " + path);
+    }
+    if (h.version != VERSION) {
+        throw std::runtime_error("Unsupported latent index version " + std::to_string(h.version) +
+            " in " + path);
+    }
+    uint64_t size = file_.size();
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t element) {
+        return offset % SECTION_ALIGN == 0 && offset <= size &&
+               count <= (size - offset) / element;
+    };
+    if (h.dim == 0 || h.lists == 0 || h.lists > h.rows ||
+        !fits(h.centroids_offset, h.lists, uint64_t(h.dim) * sizeof(float)) ||
+        !fits(h.offsets_offset, h.lists + 1, sizeof(uint64_t)) ||
+        !fits(h.ids_offset, h.rows, sizeof(uint64_t)) ||
+        !fits(h.vectors_offset, h.rows, uint64_t(h.dim) * sizeof(float))) {
+        throw std::runtime_error("Latent index truncated: " + path);
+    }
+    rows_ = static_cast<size_t>(h.rows);
+    dim_ = h.dim;
+    lists_ = static_cast<size_t>(h.lists);
+    centroids_ = reinterpret_cast<const float*>(file_.data() + h.centroids_offset);
+    offsets_ = reinterpret_cast<const uint64_t*>(file_.data() + h.offsets_offset);
+    ids_ = reinterpret_cast<const uint64_t*>(file_.data() + h.ids_offset);
+    vectors_ = reinterpret_cast<const float*>(file_.data() + h.vectors_offset);
+
+    // The cell bounds index into the mapped rows, so they are checked once here
+    if (offsets_[0] != 0 || offsets_[lists_] != rows_) {
+        throw std::runtime_error("Corrupt latent index cell offsets: " + path);
+    }
+    for (size_t c = 0; c < lists_; ++c) {
+        if (offsets_[c + 1] < offsets_[c]) {
+            throw std::runtime_error("Corrupt latent index cell offsets: " + path);
+        }
+        max_list_size_ = std::max(max_list_size_, static_cast<size_t>(offsets_[c + 1] - offsets_[c]));
+    }
+}
+
+std::vector<Neighbor> LatentIndex::search(const float* query, size_t k, size_t nprobe) const {
+    std::vector<Neighbor> best;
+    if (k == 0 || nprobe == 0) {
+        return best;
+    }
+    nprobe = std::min(nprobe, lists_);
+
+    // Cells to scan: the nprobe nearest centroids, or all of them
+    std::vector<uint32_t> probe(lists_);
+    std::iota(probe.begin(), probe.end(), uint32_t(0));
+    if (nprobe < lists_) {
+        std::vector<float> centroid_distances(lists_);
+        l2_distances(query, centroids_, lists_, dim_, centroid_distances.data());
+        std::nth_element(probe.begin(), probe.begin() + nprobe, probe.end(),
+                         [&](uint32_t a, uint32_t b) {
+                             return centroid_distances[a] < centroid_distances[b];
+                         });
+        probe.resize(nprobe);
+    }
+
+    // Max-heap on distance holding the k best rows so far
+    auto farther = [](const Neighbor& a, const Neighbor& b) { return a.distance < b.distance; };
+    best.reserve(std::min(k, rows_));
+    std::vector<float> distances(max_list_size_);
+    for (uint32_t c : probe) {
+        size_t begin = static_cast<size_t>(offsets_[c]);
+        size_t count = static_cast<size_t>(offsets_[c + 1]) - begin;
+        l2_distances(query, vectors_ + begin * dim_, count, dim_, distances.data());
+        for (size_t i = 0; i < count; ++i) {
+            if (best.size() < k) {
+                best.push_back({ids_[begin + i], distances[i]});
+                std::push_heap(best.begin(), best.end(), farther);
+            } else if (distances[i] < best.front().distance) {
+                std::pop_heap(best.begin(), best.end(), farther);
+                best.back() = {ids_[begin + i], distances[i]};
+                std::push_heap(best.begin(), best.end(), farther);
+            }
+        }
+    }
+    std::sort_heap(best.begin(), best.end(), farther);
+    return best;
+}
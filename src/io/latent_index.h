@@ -0,0 +1,67 @@
+#pragma once
+
+#include "io/latent_file.h"
+#include "io/mapped_file.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Nearest-neighbour index over a latent file (IVF: inverted file lists).
+//
+// Building clusters the rows with k-means into `lists` cells and stores every
+// row, grouped by cell, next to its original row number. A query ranks the cell
+// centroids by distance and scans only the rows of the nprobe closest cells with
+// the SIMD distance kernel (math/distance.h), keeping the k best in a heap.
+// Searching all cells is an exact brute-force search.
+//
+// Layout (little-endian, each section starting on a 64-byte boundary):
+//   [0, 64)    header: magic "AEIVFIDX", version, dim, rows, lists, section offsets
+//   centroids  lists x dim float32
+//   offsets    lists + 1 uint64: cell c holds rows [offsets[c], offsets[c + 1])
+//   ids        rows uint64: original latent row of each stored row
+//   vectors    rows x dim float32, grouped by cell
+struct IndexBuildOptions {
+    size_t lists = 0;             // k-means cells; 0 picks about sqrt(rows)
+    size_t iterations = 10;       // k-means iterations
+    size_t sample_per_list = 64;  // training sample size per cell (capped at rows)
+    uint64_t seed = 42;
+};
+
+struct Neighbor {
+    uint64_t row;    // row of the latent file the index was built from
+    float distance;  // squared Euclidean distance to the query
+};
+
+class LatentIndex {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    // Cluster the rows of `latents` and write the index to `path` (through a
+    // temporary file, like LatentWriter)
+    static void build(const LatentFile& latents, const std::string& path,
+                      const IndexBuildOptions& options = IndexBuildOptions());
+
+    // Map an existing index. Throws if the header is invalid or the file is
+    // truncated.
+    explicit LatentIndex(const std::string& path);
+
+    size_t rows() const { return rows_; }
+    size_t dim() const { return dim_; }
+    size_t lists() const { return lists_; }
+
+    // The k nearest stored rows to `query` (dim floats), closest first, scanning
+    // the nprobe cells nearest to it. nprobe >= lists() searches exhaustively.
+    // Safe to call from several threads at once.
+    std::vector<Neighbor> search(const float* query, size_t k, size_t nprobe) const;
+
+private:
+    MappedFile file_;
+    size_t rows_;
+    size_t dim_;
+    size_t lists_;
+    size_t max_list_size_ = 0;
+    const float* centroids_;
+    const uint64_t* offsets_;
+    const uint64_t* ids_;
+    const float* vectors_;
+};
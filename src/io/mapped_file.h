@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Memory mapping of a whole file. Pages are shared with the OS page cache, so
+// several processes mapping the same file share one physical copy.
+class MappedFile {
+public:
+    // ReadOnly maps the file read-only. CopyOnWrite maps it privately and writable:
+    // writes go to a process-local copy of the touched page and never reach the file,
+    // and untouched pages stay shared.
+    enum class Mode { ReadOnly, CopyOnWrite };
+
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path, Mode mode = Mode::ReadOnly);
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return data_; }
+    // Writable view; only valid for CopyOnWrite mappings
+    unsigned char* mutable_data() { return data_; }
+    size_t size() const { return size_; }
+    bool is_open() const { return data_ != nullptr; }
+
+private:
+    void close();
+
+    unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+};
@@ -1,22 +1,151 @@
 #include "io/model_io.h"
+#include "io/checksum.h"
+#include "io/mapped_file.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <memory>
 #include <stdexcept>
 
-void ModelIO::save(const std::vector<Parameter>& params, const std::string& path) {
-    std::ofstream out(path, std::ios::binary);
-    if (!out) {
-        throw std::runtime_error("Failed to open file for writing: " + path);
+namespace {
+
+constexpr char MAGIC[8] = {'A', 'E', 'M', 'O', 'D', 'E', 'L', '\0'};
+constexpr uint32_t DTYPE_FLOAT32 = 0;
+constexpr uint64_t ALIGNMENT = TensorStorage::ALIGNMENT;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t alignment;
+    uint32_t num_tensors;
+    uint64_t table_offset;
+    uint64_t arch_offset;
+    uint64_t arch_size;
+    uint64_t file_size;
+    uint64_t checksum;
+};
+static_assert(sizeof(FileHeader) == 64, "header layout is part of the file format");
+
+struct TensorEntry {
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t offset;
+    uint32_t dtype;
+    uint32_t reserved;
+};
+static_assert(sizeof(TensorEntry) == 32, "table layout is part of the file format");
+
+uint64_t align_up(uint64_t n) {
+    return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+// Writes through to the stream while hashing everything after the header
+class HashingWriter {
+public:
+    explicit HashingWriter(std::ofstream& out) : out_(out) {}
+
+    void write(const void* data, size_t n) {
+        out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+        checksum_.update(data, n);
+        pos_ += n;
+    }
+
+    void pad_to(uint64_t offset) {
+        static const char zeros[ALIGNMENT] = {};
+        while (pos_ < offset) {
+            write(zeros, static_cast<size_t>(std::min<uint64_t>(offset - pos_, ALIGNMENT)));
+        }
     }
 
-    size_t num_params = params.size();
-    out.write(reinterpret_cast<const char*>(&num_params), sizeof(num_params));
+    uint64_t checksum() { return checksum_.finish(); }
 
-    for (auto& p : params) {
-        p.value->save(out);
+private:
+    std::ofstream& out_;
+    Checksum checksum_;
+    uint64_t pos_ = sizeof(FileHeader);
+};
+
+bool is_versioned(const void* data, size_t size) {
+    return size >= sizeof(MAGIC) && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+// Validate the header of a version 3 file of `size` bytes, without the checksum
+void check_header(const FileHeader& h, uint64_t size, const std::string& path) {
+    if (h.version != ModelIO::VERSION) {
+        throw std::runtime_error("Unsupported model file version " + std::to_string(h.version) +
+                                 ": " + path);
+    }
+    if (h.dtype != DTYPE_FLOAT32 || h.alignment != ALIGNMENT) {
+        throw std::runtime_error("Unsupported model file layout: " + path);
+    }
+    if (h.file_size != size) {
+        throw std::runtime_error("Truncated model file: " + path);
+    }
+    if (h.table_offset % ALIGNMENT != 0 || h.table_offset > size ||
+        h.num_tensors > (size - h.table_offset) / sizeof(TensorEntry) ||
+        h.arch_offset > size || h.arch_size > size - h.arch_offset) {
+        throw std::runtime_error("Corrupt model file header: " + path);
     }
 }
 
-void ModelIO::load(std::vector<Parameter>& params, const std::string& path) {
+// Validate the header of a version 3 file, including the checksum of the
+// whole file
+FileHeader parse_header(const unsigned char* data, size_t size, const std::string& path) {
+    if (size < sizeof(FileHeader)) {
+        throw std::runtime_error("Truncated model file: " + path);
+    }
+    FileHeader h;
+    std::memcpy(&h, data, sizeof(h));
+    check_header(h, size, path);
+    if (ModelIO::checksum(data + sizeof(FileHeader), size - sizeof(FileHeader)) != h.checksum) {
+        throw std::runtime_error("Model file checksum mismatch: " + path);
+    }
+    return h;
+}
+
+std::string file_architecture(const unsigned char* data, const FileHeader& h) {
+    return std::string(reinterpret_cast<const char*>(data) + h.arch_offset, h.arch_size);
+}
+
+// Validate a version 3 file against the parameter list and return its tensor table
+std::vector<TensorEntry> parse(const unsigned char* data, size_t size, const std::string& path,
+                               const std::vector<Parameter>& params,
+                               const std::string& architecture) {
+    FileHeader h = parse_header(data, size, path);
+    std::string file_arch = file_architecture(data, h);
+    if (!architecture.empty() && !file_arch.empty() && architecture != file_arch) {
+        throw std::runtime_error("Architecture mismatch: file has \"" + file_arch +
+                                 "\", model is \"" + architecture + "\"");
+    }
+    if (h.num_tensors != params.size()) {
+        throw std::runtime_error("Parameter count mismatch: file has " +
+            std::to_string(h.num_tensors) + ", model has " + std::to_string(params.size()));
+    }
+
+    std::vector<TensorEntry> table(params.size());
+    for (size_t i = 0; i < params.size(); ++i) {
+        TensorEntry& e = table[i];
+        std::memcpy(&e, data + h.table_offset + i * sizeof(TensorEntry), sizeof(TensorEntry));
+        if (e.rows != params[i].value->rows || e.cols != params[i].value->cols) {
+            throw std::runtime_error("Shape mismatch for parameter " + std::to_string(i));
+        }
+        if (e.dtype != static_cast<uint32_t>(params[i].dtype)) {
+            throw std::runtime_error("Element type mismatch for parameter " + std::to_string(i) +
+                                     ": " + path);
+        }
+        uint64_t bytes = e.rows * e.cols * sizeof(float);
+        if (e.offset % ALIGNMENT != 0 || e.offset > size || bytes > size - e.offset) {
+            throw std::runtime_error("Corrupt tensor table entry " + std::to_string(i) +
+                                     ": " + path);
+        }
+    }
+    return table;
+}
+
+// Version 1: [num_params][rows, cols, float data]... through an ifstream
+void load_v1(std::vector<Parameter>& params, const std::string& path) {
     std::ifstream in(path, std::ios::binary);
     if (!in) {
         throw std::runtime_error("Failed to open file for reading: " + path);
@@ -24,17 +153,162 @@ void ModelIO::load(std::vector<Parameter>& params, const std::string& path) {
 
     size_t num_params;
     in.read(reinterpret_cast<char*>(&num_params), sizeof(num_params));
+    if (!in) {
+        throw std::runtime_error("Truncated model file: " + path);
+    }
 
     if (num_params != params.size()) {
         throw std::runtime_error("Parameter count mismatch: file has " +
             std::to_string(num_params) + ", model has " + std::to_string(params.size()));
     }
 
+    // Read each tensor straight into the parameter's storage, so loading costs one
+    // pass over the file and no temporary copies
     for (size_t i = 0; i < num_params; ++i) {
-        Tensor loaded = Tensor::load(in);
-        if (loaded.rows != params[i].value->rows || loaded.cols != params[i].value->cols) {
+        Tensor& value = *params[i].value;
+        size_t rows, cols;
+        in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+        in.read(reinterpret_cast<char*>(&cols), sizeof(cols));
+        if (!in) {
+            throw std::runtime_error("Truncated model file: " + path);
+        }
+        if (rows != value.rows || cols != value.cols) {
             throw std::runtime_error("Shape mismatch for parameter " + std::to_string(i));
         }
-        *params[i].value = loaded;
+        in.read(reinterpret_cast<char*>(value.data.data()), value.data.size() * sizeof(float));
+        if (!in) {
+            throw std::runtime_error("Truncated model file: " + path);
+        }
     }
 }
+
+}  // namespace
+
+void ModelIO::save(const std::vector<Parameter>& params, const std::string& path,
+                   const std::string& architecture) {
+    FileHeader h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.dtype = DTYPE_FLOAT32;
+    h.alignment = static_cast<uint32_t>(ALIGNMENT);
+    h.num_tensors = static_cast<uint32_t>(params.size());
+    h.table_offset = sizeof(FileHeader);
+    h.arch_offset = align_up(h.table_offset + params.size() * sizeof(TensorEntry));
+    h.arch_size = architecture.size();
+
+    std::vector<TensorEntry> table(params.size());
+    uint64_t offset = align_up(h.arch_offset + h.arch_size);
+    for (size_t i = 0; i < params.size(); ++i) {
+        const Tensor& t = *params[i].value;
+        table[i] = {t.rows, t.cols, offset, static_cast<uint32_t>(params[i].dtype), 0};
+        offset = align_up(offset + t.size() * sizeof(float));
+    }
+    h.file_size = offset;
+
+    // Written next to the destination and renamed over it, so processes that have
+    // the old file mapped keep reading the old file intact
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Failed to open file for writing: " + tmp);
+        }
+
+        // The header is written last, once the checksum is known
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        HashingWriter writer(out);
+        writer.write(table.data(), table.size() * sizeof(TensorEntry));
+        writer.pad_to(h.arch_offset);
+        writer.write(architecture.data(), architecture.size());
+        for (size_t i = 0; i < params.size(); ++i) {
+            const Tensor& t = *params[i].value;
+            writer.pad_to(table[i].offset);
+            writer.write(t.data.data(), t.size() * sizeof(float));
+        }
+        writer.pad_to(h.file_size);
+
+        h.checksum = writer.checksum();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.close();
+        if (!out) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Failed to write model file: " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Failed to move model file into place: " + path);
+    }
+}
+
+void ModelIO::load(std::vector<Parameter>& params, const std::string& path,
+                   const std::string& architecture) {
+    {
+        char magic[sizeof(MAGIC)] = {};
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Failed to open file for reading: " + path);
+        }
+        in.read(magic, sizeof(magic));
+        if (!is_versioned(magic, static_cast<size_t>(in.gcount()))) {
+            load_v1(params, path);
+            return;
+        }
+    }
+
+    MappedFile file(path);
+    std::vector<TensorEntry> table = parse(file.data(), file.size(), path, params, architecture);
+    for (size_t i = 0; i < params.size(); ++i) {
+        const float* src = reinterpret_cast<const float*>(file.data() + table[i].offset);
+        Tensor& value = *params[i].value;
+        std::memcpy(value.data.data(), src, value.size() * sizeof(float));
+    }
+}
+
+void ModelIO::map(std::vector<Parameter>& params, const std::string& path,
+                  const std::string& architecture) {
+    // Copy-on-write, so borrowing tensors may be written without touching the file
+    auto file = std::make_shared<MappedFile>(path, MappedFile::Mode::CopyOnWrite);
+    if (!is_versioned(file->data(), file->size())) {
+        load_v1(params, path);
+        return;
+    }
+    std::vector<TensorEntry> table = parse(file->data(), file->size(), path, params, architecture);
+    for (size_t i = 0; i < params.size(); ++i) {
+        Tensor& value = *params[i].value;
+        float* src = reinterpret_cast<float*>(file->mutable_data() + table[i].offset);
+        value.data = TensorBuffer::borrow(src, value.size(), file);
+    }
+}
+
+std::string ModelIO::architecture(const std::string& path) {
+    // Only the header and the description are read; load and map verify the checksum
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Failed to open file for reading: " + path);
+    }
+    uint64_t size = static_cast<uint64_t>(in.tellg());
+    FileHeader h{};
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(&h), sizeof(h));
+    if (!is_versioned(h.magic, static_cast<size_t>(in.gcount()))) {
+        return "";
+    }
+    if (!in) {
+        throw std::runtime_error("Truncated model file: " + path);
+    }
+    check_header(h, size, path);
+    std::string architecture(h.arch_size, '\0');
+    in.seekg(static_cast<std::streamoff>(h.arch_offset));
+    in.read(&architecture[0], static_cast<std::streamsize>(h.arch_size));
+    if (!in) {
+        throw std::runtime_error("Truncated model file: " + path);
+    }
+    return architecture;
+}
+
+uint64_t ModelIO::checksum(const void* data, size_t n) {
+    Checksum c;
+    c.update(data, n);
+    return c.finish();
+}
@@ -1,14 +1,54 @@
 #pragma once
 
 #include "nn/layer.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
+// Model file format, version 3 (all integers little-endian):
+//
+//   header (64 bytes)
+//     char[8]  magic "AEMODEL\0"
+//     u32      version, dtype (always 0), alignment (64), num_tensors
+//     u64      table_offset, arch_offset, arch_size, file_size
+//     u64      checksum of bytes [64, file_size) (see ModelIO::checksum)
+//   tensor table at table_offset: num_tensors x
+//     {u64 rows, u64 cols, u64 offset, u32 dtype (see DType), u32 reserved}
+//   architecture description at arch_offset: arch_size bytes of text
+//   tensor data, each tensor starting at a multiple of 64 bytes; rows x cols x 4
+//   bytes whatever the dtype (see Parameter)
+//
+// Because every tensor is aligned, a mapped file can back the weights directly
+// (see map). load and map check each tensor's dtype against the parameter's.
+// Version 1 files (a parameter count followed by rows, cols and floats per tensor,
+// with no header) are still accepted.
 class ModelIO {
 public:
-    // Save parameters to binary file: [num_params][rows,cols,float_data]...
-    static void save(const std::vector<Parameter>& params, const std::string& path);
+    static constexpr uint32_t VERSION = 3;
 
-    // Load parameters from binary file into existing parameter list
-    static void load(std::vector<Parameter>& params, const std::string& path);
+    // Save parameters with an optional architecture description (e.g.
+    // Autoencoder::architecture()), which load and map check against
+    static void save(const std::vector<Parameter>& params, const std::string& path,
+                     const std::string& architecture = "");
+
+    // Load parameters from a model file into the existing parameter storage. If both
+    // `architecture` and the file's description are non-empty they must match.
+    static void load(std::vector<Parameter>& params, const std::string& path,
+                     const std::string& architecture = "");
+
+    // Like load, but memory-maps the file and points each parameter at its weights in
+    // the mapping instead of copying them (see TensorBuffer::borrow). The mapping is
+    // private and page-cache backed, so processes mapping the same file share one
+    // physical copy until a page is written. It is released when the last borrowing
+    // tensor goes away. Version 1 files fall back to load.
+    static void map(std::vector<Parameter>& params, const std::string& path,
+                    const std::string& architecture = "");
+
+    // Architecture description stored in a model file ("" for version 1 files or
+    // files saved without one), e.g. to tell int8 models from float32 ones. Reads
+    // only the header and the description; the checksum is left to load and map.
+    static std::string architecture(const std::string& path);
+
+    // Checksum used by the format (see io/checksum.h)
+    static uint64_t checksum(const void* data, size_t n);
 };
@@ -0,0 +1,143 @@
+#include "io/packed_dataset.h"
+#include "io/image_io.h"
+#include "math/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static const char PACK_MAGIC[8] = {'A', 'E', 'P', 'A', 'C', 'K', '0', '1'};
+static constexpr uint64_t DATA_OFFSET = 64;
+static constexpr size_t WRITE_CHUNK = 256;  // images decoded per parallel chunk
+
+struct PackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t data_offset;
+    unsigned char padding[16];
+};
+static_assert(sizeof(PackHeader) == DATA_OFFSET, "pack header must be 64 bytes");
+
+static size_t dtype_size(PackedDataset::DType dtype) {
+    return dtype == PackedDataset::DType::Float32 ? sizeof(float) : 1;
+}
+
+PackedDataset::PackedDataset(const std::string& path) : file_(path) {
+    if (file_.size() < sizeof(PackHeader)) {
+        throw std::runtime_error("Pack file too small: " + path);
+    }
+    PackHeader h;
+    std::memcpy(&h, file_.data(), sizeof(h));
+    if (std::memcmp(h.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0) {
+        throw std::runtime_error("Not a pack file: " + path);
+    }
+    if (h.version != VERSION) {
+        throw std::runtime_error("Unsupported pack version " + std::to_string(h.version) +
+            " in " + path);
+    }
+    if (h.width != ImageIO::TARGET_SIZE || h.height != ImageIO::TARGET_SIZE ||
+        h.channels != ImageIO::CHANNELS) {
+        throw std::runtime_error("Pack image shape does not match model input: " + path);
+    }
+    if (h.dtype != static_cast<uint32_t>(DType::UInt8) &&
+        h.dtype != static_cast<uint32_t>(DType::Float32)) {
+        throw std::runtime_error("Unknown pack dtype in " + path);
+    }
+
+    dtype_ = static_cast<DType>(h.dtype);
+    count_ = static_cast<size_t>(h.count);
+    record_elements_ = static_cast<size_t>(h.width) * h.height * h.channels;
+    // Division form, so that a corrupt count cannot wrap the size computation
+    size_t record_bytes = record_elements_ * dtype_size(dtype_);
+    if (h.data_offset < sizeof(PackHeader) || h.data_offset > file_.size() ||
+        h.count > (file_.size() - h.data_offset) / record_bytes) {
+        throw std::runtime_error("Pack file truncated: " + path);
+    }
+    records_ = file_.data() + h.data_offset;
+}
+
+bool PackedDataset::is_packed(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(PACK_MAGIC)];
+    return in.read(magic, sizeof(magic)) &&
+           std::memcmp(magic, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0;
+}
+
+void PackedDataset::load_into(size_t i, float* dst) const {
+    if (i >= count_) {
+        throw std::out_of_range("PackedDataset: index " + std::to_string(i) + " out of range");
+    }
+    if (dtype_ == DType::Float32) {
+        std::memcpy(dst, records_ + i * record_elements_ * sizeof(float),
+                    record_elements_ * sizeof(float));
+    } else {
+        const unsigned char* src = records_ + i * record_elements_;
+        for (size_t k = 0; k < record_elements_; ++k) {
+            dst[k] = static_cast<float>(src[k]) / 255.0f;
+        }
+    }
+}
+
+void PackedDataset::write(const std::vector<std::string>& paths, const std::string& out_path,
+                          DType dtype) {
+    std::ofstream out(out_path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Failed to open file for writing: " + out_path);
+    }
+
+    PackHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    h.version = VERSION;
+    h.dtype = static_cast<uint32_t>(dtype);
+    h.width = ImageIO::TARGET_SIZE;
+    h.height = ImageIO::TARGET_SIZE;
+    h.channels = ImageIO::CHANNELS;
+    h.count = paths.size();
+    h.data_offset = DATA_OFFSET;
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+    const size_t flat = ImageIO::FLAT_SIZE;
+    std::vector<unsigned char> pixels(WRITE_CHUNK * flat);
+    std::vector<float> floats(dtype == DType::Float32 ? WRITE_CHUNK * flat : 0);
+
+    for (size_t start = 0; start < paths.size(); start += WRITE_CHUNK) {
+        size_t n = std::min(WRITE_CHUNK, paths.size() - start);
+        // Pool tasks must not throw: record a failure and report it afterwards
+        std::atomic<bool> failed{false};
+        ThreadPool::global().parallel_for(n, 1, [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) {
+                try {
+                    ImageIO::load_pixels(paths[start + i], &pixels[i * flat]);
+                } catch (const std::exception&) {
+                    failed = true;
+                }
+            }
+        });
+        if (failed) {
+            // Decode serially to report the first failing path
+            for (size_t i = 0; i < n; ++i) {
+                ImageIO::load_pixels(paths[start + i], &pixels[i * flat]);
+            }
+        }
+        if (dtype == DType::Float32) {
+            for (size_t k = 0; k < n * flat; ++k) {
+                floats[k] = static_cast<float>(pixels[k]) / 255.0f;
+            }
+            out.write(reinterpret_cast<const char*>(floats.data()), n * flat * sizeof(float));
+        } else {
+            out.write(reinterpret_cast<const char*>(pixels.data()), n * flat);
+        }
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed to write pack file: " + out_path);
+    }
+}
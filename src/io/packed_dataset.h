@@ -0,0 +1,46 @@
+#pragma once
+
+#include "io/mapped_file.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Preprocessed image set: every image already resized to 64x64x3 and stored as
+// one fixed-size record, so loading is a copy (or byte->float conversion) from
+// memory-mapped pages instead of a JPEG decode and resize.
+//
+// Layout (little-endian):
+//   [0, 64)         header: magic "AEPACK01", version, dtype, width, height,
+//                   channels, count, data offset
+//   [data_offset..) count records of width*height*channels elements of dtype
+class PackedDataset {
+public:
+    enum class DType : uint32_t { UInt8 = 0, Float32 = 1 };
+
+    static constexpr uint32_t VERSION = 1;
+
+    // Map an existing pack file. Throws if the header is invalid or the file is truncated.
+    explicit PackedDataset(const std::string& path);
+
+    // True if the file at path starts with the pack magic
+    static bool is_packed(const std::string& path);
+
+    // Decode and resize the images at `paths` and write them as a pack file.
+    // Images are processed in chunks on the thread pool, so memory stays bounded.
+    static void write(const std::vector<std::string>& paths, const std::string& out_path,
+                      DType dtype = DType::UInt8);
+
+    size_t size() const { return count_; }
+    DType dtype() const { return dtype_; }
+    size_t record_elements() const { return record_elements_; }
+
+    // Image i as FLAT_SIZE floats in [0,1], read straight from the mapped pages
+    void load_into(size_t i, float* dst) const;
+
+private:
+    MappedFile file_;
+    DType dtype_;
+    size_t count_;
+    size_t record_elements_;
+    const unsigned char* records_;
+};
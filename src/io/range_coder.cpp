@@ -0,0 +1,109 @@
+#include "io/range_coder.h"
+#include <stdexcept>
+
+namespace {
+
+// Renormalize once the range no longer has a full top byte
+constexpr uint32_t TOP = 1u << 24;
+
+}  // namespace
+
+void RangeEncoder::encode_bit(BitModel& model, unsigned bit) {
+    uint32_t bound = (range_ >> BitModel::BITS) * model.p0;
+    if (bit == 0) {
+        range_ = bound;
+    } else {
+        low_ += bound;
+        range_ -= bound;
+    }
+    model.update(bit);
+    while (range_ < TOP) {
+        range_ <<= 8;
+        shift_low();
+    }
+}
+
+void RangeEncoder::encode_direct(uint32_t value, unsigned count) {
+    while (count-- > 0) {
+        range_ >>= 1;
+        if ((value >> count) & 1) {
+            low_ += range_;
+        }
+        while (range_ < TOP) {
+            range_ <<= 8;
+            shift_low();
+        }
+    }
+}
+
+const std::vector<unsigned char>& RangeEncoder::finish() {
+    for (int i = 0; i < 5; ++i) {
+        shift_low();
+    }
+    return out_;
+}
+
+// Emit the top byte of low. A byte is held back (with any run of 0xFF after it)
+// until it is known whether a carry will still propagate into it.
+void RangeEncoder::shift_low() {
+    if (static_cast<uint32_t>(low_) < 0xFF000000u || (low_ >> 32) != 0) {
+        unsigned char carry = static_cast<unsigned char>(low_ >> 32);
+        unsigned char held = cache_;
+        do {
+            out_.push_back(static_cast<unsigned char>(held + carry));
+            held = 0xFF;
+        } while (--cache_size_ != 0);
+        cache_ = static_cast<unsigned char>(static_cast<uint32_t>(low_) >> 24);
+    }
+    ++cache_size_;
+    low_ = (low_ & 0x00FFFFFFu) << 8;
+}
+
+RangeDecoder::RangeDecoder(const unsigned char* data, size_t size) : data_(data), size_(size) {
+    if (size < 5) {
+        throw std::runtime_error("Range decoder: stream shorter than its preamble");
+    }
+    for (int i = 0; i < 5; ++i) {
+        code_ = (code_ << 8) | next_byte();
+    }
+}
+
+unsigned RangeDecoder::decode_bit(BitModel& model) {
+    uint32_t bound = (range_ >> BitModel::BITS) * model.p0;
+    unsigned bit = code_ < bound ? 0 : 1;
+    if (bit == 0) {
+        range_ = bound;
+    } else {
+        code_ -= bound;
+        range_ -= bound;
+    }
+    model.update(bit);
+    normalize();
+    return bit;
+}
+
+uint32_t RangeDecoder::decode_direct(unsigned count) {
+    uint32_t value = 0;
+    while (count-- > 0) {
+        range_ >>= 1;
+        unsigned bit = code_ >= range_ ? 1 : 0;
+        code_ -= range_ & (0u - bit);
+        value = (value << 1) | bit;
+        normalize();
+    }
+    return value;
+}
+
+unsigned char RangeDecoder::next_byte() {
+    if (pos_ >= size_) {
+        throw std::runtime_error("Range decoder: truncated stream");
+    }
+    return data_[pos_++];
+}
+
+void RangeDecoder::normalize() {
+    while (range_ < TOP) {
+        range_ <<= 8;
+        code_ = (code_ << 8) | next_byte();
+    }
+}
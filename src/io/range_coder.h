@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Adaptive binary range coder in the style of LZMA's: each coded bit carries an
+// 11-bit probability of being 0 that moves 1/16 of the way towards every bit it
+// sees, so a model spends well under a bit per decision once it has learned a skew.
+// (LZMA moves 1/32; latents give each model only tens of bits to learn from.)
+// Bits with no useful model are coded directly at one bit each.
+//
+// The encoder and decoder must make the same sequence of calls with BitModels in
+// the same states; the stream holds no framing of its own.
+
+// Probability that the next bit coded with this model is 0
+struct BitModel {
+    static constexpr uint32_t BITS = 11;
+    static constexpr uint32_t ONE = 1u << BITS;
+    static constexpr uint32_t ADAPT_SHIFT = 4;
+
+    uint16_t p0 = ONE / 2;
+
+    void update(unsigned bit) {
+        if (bit == 0) {
+            p0 = static_cast<uint16_t>(p0 + ((ONE - p0) >> ADAPT_SHIFT));
+        } else {
+            p0 = static_cast<uint16_t>(p0 - (p0 >> ADAPT_SHIFT));
+        }
+    }
+};
+
+class RangeEncoder {
+public:
+    void encode_bit(BitModel& model, unsigned bit);
+    // Low `count` bits of value, most significant first, at one bit each
+    void encode_direct(uint32_t value, unsigned count);
+
+    // Flush the remaining state; the bytes are complete after this
+    const std::vector<unsigned char>& finish();
+    const std::vector<unsigned char>& bytes() const { return out_; }
+
+private:
+    void shift_low();
+
+    uint64_t low_ = 0;
+    uint32_t range_ = 0xFFFFFFFFu;
+    unsigned char cache_ = 0;
+    uint64_t cache_size_ = 1;
+    std::vector<unsigned char> out_;
+};
+
+class RangeDecoder {
+public:
+    // Throws std::runtime_error if the stream is shorter than its 5-byte preamble
+    RangeDecoder(const unsigned char* data, size_t size);
+
+    unsigned decode_bit(BitModel& model);
+    uint32_t decode_direct(unsigned count);
+
+    // Bytes consumed so far; equal to the encoded size once every symbol is decoded.
+    // Reading past the end throws std::runtime_error.
+    size_t position() const { return pos_; }
+
+private:
+    unsigned char next_byte();
+    void normalize();
+
+    const unsigned char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    uint32_t range_ = 0xFFFFFFFFu;
+    uint32_t code_ = 0;
+};
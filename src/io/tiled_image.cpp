@@ -0,0 +1,332 @@
+#include "stb/stb_image.h"
+#include "stb/stb_image_write.h"
+
+#include "io/tiled_image.h"
+#include "io/image_io.h"
+#include "math/thread_pool.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t TILE = ImageIO::TARGET_SIZE;
+constexpr size_t CHANNELS = ImageIO::CHANNELS;
+
+// Binary PPM, read incrementally
+class PpmReader : public ImageRowReader {
+public:
+    explicit PpmReader(const std::string& path) : path_(path), file_(std::fopen(path.c_str(), "rb")) {
+        if (!file_) {
+            throw std::runtime_error("Failed to open image: " + path);
+        }
+        char magic[2];
+        if (std::fread(magic, 1, 2, file_) != 2 || magic[0] != 'P' || magic[1] != '6') {
+            fail("not a binary PPM");
+        }
+        width_ = header_number();
+        height_ = header_number();
+        if (header_number() != 255) {
+            fail("only 8-bit PPM is supported");
+        }
+        // header_number consumed the single whitespace byte before the pixels
+        if (width_ == 0 || height_ == 0) {
+            fail("empty image");
+        }
+    }
+
+    ~PpmReader() override { std::fclose(file_); }
+
+    void read_rows(unsigned char* dst, size_t rows) override {
+        if (rows_read_ + rows > height_) {
+            fail("read past the last row");
+        }
+        size_t bytes = rows * width_ * CHANNELS;
+        if (std::fread(dst, 1, bytes, file_) != bytes) {
+            fail("truncated");
+        }
+        rows_read_ += rows;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& why) {
+        throw std::runtime_error("Failed to read PPM image " + path_ + ": " + why);
+    }
+
+    // Decimal header field after whitespace and '#' comments, consuming the one
+    // whitespace byte that ends it
+    size_t header_number() {
+        int c = std::fgetc(file_);
+        while (c == '#' || std::isspace(c)) {
+            if (c == '#') {
+                while (c != '\n' && c != EOF) {
+                    c = std::fgetc(file_);
+                }
+            }
+            c = std::fgetc(file_);
+        }
+        if (!std::isdigit(c)) {
+            fail("bad header");
+        }
+        size_t n = 0;
+        while (std::isdigit(c)) {
+            n = n * 10 + static_cast<size_t>(c - '0');
+            if (n > (1u << 24)) {
+                fail("dimension too large");
+            }
+            c = std::fgetc(file_);
+        }
+        if (!std::isspace(c)) {
+            fail("bad header");
+        }
+        return n;
+    }
+
+    std::string path_;
+    std::FILE* file_;
+    size_t rows_read_ = 0;
+};
+
+// Any format stb_image decodes, decoded whole and handed out by row
+class DecodedReader : public ImageRowReader {
+public:
+    explicit DecodedReader(const std::string& path) {
+        int w, h, c;
+        pixels_ = stbi_load(path.c_str(), &w, &h, &c, CHANNELS);
+        if (!pixels_) {
+            throw std::runtime_error("Failed to load image: " + path);
+        }
+        width_ = static_cast<size_t>(w);
+        height_ = static_cast<size_t>(h);
+    }
+
+    ~DecodedReader() override { stbi_image_free(pixels_); }
+
+    void read_rows(unsigned char* dst, size_t rows) override {
+        if (rows_read_ + rows > height_) {
+            throw std::runtime_error("Image read past the last row");
+        }
+        size_t row_bytes = width_ * CHANNELS;
+        std::memcpy(dst, pixels_ + rows_read_ * row_bytes, rows * row_bytes);
+        rows_read_ += rows;
+    }
+
+private:
+    unsigned char* pixels_;
+    size_t rows_read_ = 0;
+};
+
+bool is_ppm(const std::string& path) {
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == "ppm" || ext == "pnm";
+}
+
+// First pixel of each tile along an extent: every `step` pixels, with the last tile
+// ending at the far edge (a single tile when the extent is at most one tile)
+std::vector<size_t> tile_starts(size_t extent, size_t step) {
+    std::vector<size_t> starts{0};
+    if (extent <= TILE) {
+        return starts;
+    }
+    while (starts.back() + TILE < extent) {
+        starts.push_back(std::min(starts.back() + step, extent - TILE));
+    }
+    return starts;
+}
+
+}  // namespace
+
+std::unique_ptr<ImageRowReader> ImageRowReader::open(const std::string& path) {
+    if (is_ppm(path)) {
+        return std::make_unique<PpmReader>(path);
+    }
+    return std::make_unique<DecodedReader>(path);
+}
+
+ImageRowWriter::ImageRowWriter(const std::string& path, size_t width, size_t height)
+    : path_(path), width_(width), height_(height) {
+    if (is_ppm(path)) {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_ || std::fprintf(file_, "P6\n%zu %zu\n255\n", width, height) < 0) {
+            throw std::runtime_error("Failed to write image: " + path);
+        }
+    } else {
+        image_.resize(width * height * CHANNELS);
+    }
+}
+
+ImageRowWriter::~ImageRowWriter() {
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+void ImageRowWriter::write_rows(const unsigned char* src, size_t rows) {
+    if (rows_written_ + rows > height_) {
+        throw std::runtime_error("Image write past the last row: " + path_);
+    }
+    size_t bytes = rows * width_ * CHANNELS;
+    if (file_) {
+        if (std::fwrite(src, 1, bytes, file_) != bytes) {
+            throw std::runtime_error("Failed to write image: " + path_);
+        }
+    } else {
+        std::memcpy(image_.data() + rows_written_ * width_ * CHANNELS, src, bytes);
+    }
+    rows_written_ += rows;
+}
+
+void ImageRowWriter::finish() {
+    if (rows_written_ != height_) {
+        throw std::runtime_error("Image " + path_ + " finished after " +
+                                 std::to_string(rows_written_) + " of " +
+                                 std::to_string(height_) + " rows");
+    }
+    if (file_) {
+        bool ok = std::fclose(file_) == 0;
+        file_ = nullptr;
+        if (!ok) {
+            throw std::runtime_error("Failed to write image: " + path_);
+        }
+    } else if (!stbi_write_png(path_.c_str(), static_cast<int>(width_), static_cast<int>(height_),
+                               CHANNELS, image_.data(), static_cast<int>(width_ * CHANNELS))) {
+        throw std::runtime_error("Failed to write image: " + path_);
+    }
+}
+
+TileStats reconstruct_tiled(ImageRowReader& input, ImageRowWriter& output,
+                            const std::function<void(const Tensor&, Tensor&)>& model,
+                            const TileOptions& options) {
+    if (options.overlap >= TILE || options.max_batch == 0) {
+        throw std::invalid_argument("reconstruct_tiled: overlap must be below " +
+                                    std::to_string(TILE) + " and max_batch positive");
+    }
+    const size_t W = input.width(), H = input.height();
+    const size_t row_values = W * CHANNELS;
+    std::vector<size_t> xs = tile_starts(W, TILE - options.overlap);
+    std::vector<size_t> ys = tile_starts(H, TILE - options.overlap);
+
+    // Blend weight along one tile axis: rises over the overlap, flat in the middle
+    std::vector<float> ramp(TILE);
+    for (size_t i = 0; i < TILE; ++i) {
+        float edge = static_cast<float>(std::min(i + 1, TILE - i));
+        ramp[i] = std::min(1.0f, edge / static_cast<float>(options.overlap + 1));
+    }
+
+    // Row band [y, y + TILE) of the current tile row: input pixels, weighted output
+    // sums and weights. Rows above the next tile row are final once it is reached,
+    // and the band then slides down to it.
+    std::vector<unsigned char> band(TILE * row_values);
+    std::vector<float> sums(TILE * row_values, 0.0f);
+    std::vector<float> weights(TILE * W, 0.0f);
+    std::vector<unsigned char> finished(TILE * row_values);
+    size_t batch_cap = std::min(options.max_batch, xs.size());
+    Tensor tiles = Tensor::uninitialized(batch_cap, ImageIO::FLAT_SIZE);
+    Tensor recon;
+
+    TileStats stats;
+    double squared_error = 0.0;
+    size_t band_start = 0, loaded = 0;
+    for (size_t k = 0; k < ys.size(); ++k) {
+        size_t y = ys[k];
+        size_t shift = y - band_start;
+        std::memmove(band.data(), band.data() + shift * row_values, (loaded - shift) * row_values);
+        loaded -= shift;
+        band_start = y;
+        size_t rows = std::min(TILE, H - y);
+        if (loaded < rows) {
+            input.read_rows(band.data() + loaded * row_values, rows - loaded);
+            loaded = rows;
+        }
+
+        for (size_t c0 = 0; c0 < xs.size(); c0 += batch_cap) {
+            size_t n = std::min(batch_cap, xs.size() - c0);
+            tiles.resize(n, ImageIO::FLAT_SIZE);
+            // Tiles past the image's right or bottom edge repeat its last column or row
+            ThreadPool::global().parallel_for(n, 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    float* dst = tiles.data.data() + i * ImageIO::FLAT_SIZE;
+                    for (size_t ty = 0; ty < TILE; ++ty) {
+                        const unsigned char* src = band.data() + std::min(ty, rows - 1) * row_values;
+                        for (size_t tx = 0; tx < TILE; ++tx) {
+                            size_t x = std::min(xs[c0 + i] + tx, W - 1);
+                            for (size_t c = 0; c < CHANNELS; ++c) {
+                                *dst++ = static_cast<float>(src[x * CHANNELS + c]) / 255.0f;
+                            }
+                        }
+                    }
+                }
+            });
+            model(tiles, recon);
+            if (recon.rows != n || recon.cols != static_cast<size_t>(ImageIO::FLAT_SIZE)) {
+                throw std::runtime_error("reconstruct_tiled: model returned " +
+                                         std::to_string(recon.rows) + "x" +
+                                         std::to_string(recon.cols) + " for " +
+                                         std::to_string(n) + " tiles");
+            }
+            // One band row per step, adding the tiles in order, so each sum is formed
+            // the same way on any thread count
+            ThreadPool::global().parallel_for(rows, 1, [&](size_t begin, size_t end) {
+                for (size_t ty = begin; ty < end; ++ty) {
+                    float* sum = sums.data() + ty * row_values;
+                    float* weight = weights.data() + ty * W;
+                    for (size_t i = 0; i < n; ++i) {
+                        const float* src = recon.data.data() + i * ImageIO::FLAT_SIZE +
+                                           ty * TILE * CHANNELS;
+                        size_t x0 = xs[c0 + i];
+                        size_t width = std::min(TILE, W - x0);
+                        for (size_t tx = 0; tx < width; ++tx) {
+                            float w = ramp[ty] * ramp[tx];
+                            for (size_t c = 0; c < CHANNELS; ++c) {
+                                sum[(x0 + tx) * CHANNELS + c] += w * src[tx * CHANNELS + c];
+                            }
+                            weight[x0 + tx] += w;
+                        }
+                    }
+                }
+            });
+            stats.tiles += n;
+            ++stats.batches;
+        }
+
+        // Rows no later tile covers are final
+        size_t done = (k + 1 < ys.size() ? ys[k + 1] : H) - y;
+        squared_error += ThreadPool::global().parallel_sum(done, 1, [&](size_t begin, size_t end) {
+            double error = 0.0;
+            for (size_t r = begin; r < end; ++r) {
+                for (size_t x = 0; x < W; ++x) {
+                    float inv = 1.0f / weights[r * W + x];
+                    for (size_t c = 0; c < CHANNELS; ++c) {
+                        size_t i = r * row_values + x * CHANNELS + c;
+                        float v = std::clamp(sums[i] * inv, 0.0f, 1.0f);
+                        finished[i] = static_cast<unsigned char>(v * 255.0f + 0.5f);
+                        double diff = v - static_cast<float>(band[i]) / 255.0f;
+                        error += diff * diff;
+                    }
+                }
+            }
+            return error;
+        });
+        output.write_rows(finished.data(), done);
+
+        // Slide the sums down to the next tile row
+        size_t kept = TILE - done;
+        std::memmove(sums.data(), sums.data() + done * row_values, kept * row_values * sizeof(float));
+        std::memmove(weights.data(), weights.data() + done * W, kept * W * sizeof(float));
+        std::fill(sums.begin() + static_cast<std::ptrdiff_t>(kept * row_values), sums.end(), 0.0f);
+        std::fill(weights.begin() + static_cast<std::ptrdiff_t>(kept * W), weights.end(), 0.0f);
+    }
+
+    stats.mse = squared_error / static_cast<double>(H * row_values);
+    stats.buffer_bytes = band.size() + finished.size() +
+                         (sums.size() + weights.size() + ramp.size()) * sizeof(float) +
+                         2 * batch_cap * ImageIO::FLAT_SIZE * sizeof(float);
+    return stats;
+}
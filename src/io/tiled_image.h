@@ -0,0 +1,81 @@
+#pragma once
+
+#include "math/tensor.h"
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Rows of an 8-bit RGB image of any size, read top to bottom. Binary PPM (P6,
+// maxval 255) is read from the file as rows are requested; other formats that
+// stb_image decodes are decoded up front, 3 bytes per pixel, and handed out by row.
+class ImageRowReader {
+public:
+    static std::unique_ptr<ImageRowReader> open(const std::string& path);
+    virtual ~ImageRowReader() = default;
+
+    size_t width() const { return width_; }
+    size_t height() const { return height_; }
+
+    // Next `rows` rows (width * 3 bytes each) into dst; throws past the last row
+    virtual void read_rows(unsigned char* dst, size_t rows) = 0;
+
+protected:
+    size_t width_ = 0;
+    size_t height_ = 0;
+};
+
+// Rows of an 8-bit RGB image written top to bottom. A .ppm path is written as
+// binary PPM as rows arrive; any other path is written as PNG by finish(), which
+// needs the whole 8-bit image in memory.
+class ImageRowWriter {
+public:
+    ImageRowWriter(const std::string& path, size_t width, size_t height);
+    ~ImageRowWriter();
+
+    ImageRowWriter(const ImageRowWriter&) = delete;
+    ImageRowWriter& operator=(const ImageRowWriter&) = delete;
+
+    void write_rows(const unsigned char* src, size_t rows);
+    // Throws unless every row was written
+    void finish();
+
+private:
+    std::string path_;
+    size_t width_, height_;
+    size_t rows_written_ = 0;
+    std::FILE* file_ = nullptr;         // PPM
+    std::vector<unsigned char> image_;  // PNG
+};
+
+struct TileOptions {
+    // Pixels shared by neighbouring tiles, blended with linear ramps; tiles start
+    // every TARGET_SIZE - overlap pixels
+    size_t overlap = 16;
+    // Most tiles per model call; a tile row with more is run in several calls
+    size_t max_batch = 256;
+};
+
+struct TileStats {
+    size_t tiles = 0;
+    size_t batches = 0;
+    double mse = 0.0;          // of the output against the input, per value in [0,1]
+    size_t buffer_bytes = 0;   // largest working set of row bands and tile batches
+};
+
+// Reconstruct an image of any size with a model of TARGET_SIZE x TARGET_SIZE RGB
+// images (model(inputs, outputs) on (tiles, FLAT_SIZE) tensors, e.g.
+// Autoencoder::forward_into). The image is covered by a grid of overlapping tiles,
+// the last row and column aligned to the far edges and tiles of images smaller than
+// a tile padded by repeating the edge pixels. Each output pixel is the average of
+// the tiles covering it, weighted by ramps that fall off towards tile edges, so
+// seams blend instead of showing.
+//
+// The image streams through one tile row at a time: input rows are read when the
+// first tile reaches them and output rows are written once the last tile covering
+// them is done, so working memory grows with the image width and max_batch but
+// not its height.
+TileStats reconstruct_tiled(ImageRowReader& input, ImageRowWriter& output,
+                            const std::function<void(const Tensor&, Tensor&)>& model,
+                            const TileOptions& options = TileOptions());
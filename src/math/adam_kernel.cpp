@@ -0,0 +1,9 @@
+#include "math/adam_kernel.h"
+#include "math/kernels.h"
+
+void adam_update(const AdamArgs& args, float* param, const float* grad, float* m, float* v,
+                 size_t n, uint16_t* param_bf16) {
+    if (n > 0) {
+        kernels().adam(args, param, grad, m, v, n, param_bf16);
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Fused Adam/AdamW update of one contiguous run of parameters. The per-step bias
+// corrections bc1 = 1 - beta1^t and bc2 = 1 - beta2^t are folded into the scalars,
+// so the inner loop has no per-element division by them:
+//   m = beta1 * m + (1 - beta1) * g
+//   v = beta2 * v + (1 - beta2) * g^2
+//   p = decay * p - step_size * m / (sqrt(v) * inv_sqrt_bc2 + epsilon)
+// with step_size = lr / bc1, inv_sqrt_bc2 = 1 / sqrt(bc2), and decay = 1 - lr * wd
+// for AdamW's decoupled weight decay (1 for plain Adam).
+struct AdamArgs {
+    float beta1 = 0.9f;
+    float beta2 = 0.999f;
+    float step_size = 0.0f;
+    float inv_sqrt_bc2 = 1.0f;
+    float epsilon = 1e-8f;
+    float decay = 1.0f;
+};
+
+// Dispatch to the kernel set of the active instruction set (see math/cpu.h).
+// Single-threaded; callers split large updates across the thread pool. If
+// param_bf16 is set, the updated parameters are also written to it in bfloat16
+// (see Parameter::bf16_copy).
+void adam_update(const AdamArgs& args, float* param, const float* grad, float* m, float* v,
+                 size_t n, uint16_t* param_bf16 = nullptr);
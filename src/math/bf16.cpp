@@ -0,0 +1,11 @@
+#include "math/bf16.h"
+#include "math/thread_pool.h"
+
+void convert_to_bf16(const float* src, uint16_t* dst, size_t n) {
+    ThreadPool::global().parallel_for(n, ThreadPool::ELEMENTWISE_GRAIN,
+                                      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            dst[i] = float_to_bf16(src[i]);
+        }
+    });
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// bfloat16: the upper 16 bits of an IEEE float32 (same exponent range, 8-bit
+// mantissa). Weights stored in bf16 halve the memory traffic of a GEMM; the
+// kernels widen them back to float32 as they are read (see GemmArgs::B_bf16).
+
+inline float bf16_to_float(uint16_t h) {
+    uint32_t bits = uint32_t(h) << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Round to nearest even
+inline uint16_t float_to_bf16(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) {
+        return static_cast<uint16_t>((bits >> 16) | 0x40);  // keep NaNs quiet NaNs
+    }
+    bits += 0x7fffu + ((bits >> 16) & 1u);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+// dst[i] = float_to_bf16(src[i]), split across the thread pool
+void convert_to_bf16(const float* src, uint16_t* dst, size_t n);
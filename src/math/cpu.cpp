@@ -0,0 +1,78 @@
+#include "math/cpu.h"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+static Isa detect() {
+#if defined(AE_HAVE_X86_KERNELS)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return Isa::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return Isa::AVX2;
+    }
+#endif
+    return Isa::Scalar;
+}
+
+static Isa initial_isa() {
+    Isa best = detected_isa();
+    const char* env = std::getenv("AE_ISA");
+    if (!env) {
+        return best;
+    }
+    Isa requested = best;
+    if (std::strcmp(env, "scalar") == 0) {
+        requested = Isa::Scalar;
+    } else if (std::strcmp(env, "avx2") == 0) {
+        requested = Isa::AVX2;
+    } else if (std::strcmp(env, "avx512") == 0) {
+        requested = Isa::AVX512;
+    }
+    // Never select an instruction set the CPU cannot execute
+    return requested <= best ? requested : best;
+}
+
+static Isa& current_isa() {
+    static Isa isa = initial_isa();
+    return isa;
+}
+
+Isa detected_isa() {
+    static const Isa isa = detect();
+    return isa;
+}
+
+Isa active_isa() {
+    return current_isa();
+}
+
+void set_isa(Isa isa) {
+    if (isa > detected_isa()) {
+        throw std::invalid_argument(std::string("set_isa: ") + isa_name(isa) +
+            " is not supported on this CPU");
+    }
+    current_isa() = isa;
+}
+
+bool cpu_has_avx512_vnni() {
+#if defined(AE_HAVE_X86_KERNELS)
+    __builtin_cpu_init();
+    static const bool has = __builtin_cpu_supports("avx512vnni") &&
+                            __builtin_cpu_supports("avx512bw");
+    return has;
+#else
+    return false;
+#endif
+}
+
+const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar: return "scalar";
+        case Isa::AVX2:   return "avx2";
+        case Isa::AVX512: return "avx512";
+    }
+    return "unknown";
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Instruction sets with dedicated kernel implementations, ordered by capability
+enum class Isa { Scalar, AVX2, AVX512 };
+
+// Best instruction set supported by this CPU (and compiled into this build)
+Isa detected_isa();
+
+// Instruction set currently used for kernel dispatch. Defaults to detected_isa(),
+// or to the value of the AE_ISA environment variable (scalar, avx2, avx512) if set.
+Isa active_isa();
+
+// Force kernel dispatch to a specific instruction set. Throws std::invalid_argument
+// if the CPU or build does not support it.
+void set_isa(Isa isa);
+
+const char* isa_name(Isa isa);
+
+// Whether the CPU has the AVX-512 VNNI and BW extensions (int8 dot products), which
+// the AVX-512 kernel set uses for int8_gemm when available
+bool cpu_has_avx512_vnni();
@@ -0,0 +1,8 @@
+#include "math/distance.h"
+#include "math/kernels.h"
+
+void l2_distances(const float* query, const float* rows, size_t n, size_t dim, float* out) {
+    if (n > 0) {
+        kernels().l2_distances(query, rows, n, dim, out);
+    }
+}
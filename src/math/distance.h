@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+// Squared Euclidean distance from `query` (dim floats) to each of n rows stored
+// contiguously at `rows` (row-major, stride dim):
+//   out[i] = sum_d (rows[i * dim + d] - query[d])^2
+// Dispatches to the kernel set of the active instruction set (see math/cpu.h).
+// Single-threaded; callers split large scans across the thread pool.
+void l2_distances(const float* query, const float* rows, size_t n, size_t dim, float* out);
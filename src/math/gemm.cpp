@@ -0,0 +1,24 @@
+#include "math/gemm.h"
+#include "math/kernels.h"
+
+const KernelTable& kernels() {
+    switch (active_isa()) {
+#if defined(AE_HAVE_X86_KERNELS)
+        case Isa::AVX512: return avx512_kernels();
+        case Isa::AVX2:   return avx2_kernels();
+#endif
+        default:          return scalar_kernels();
+    }
+}
+
+void gemm(const GemmArgs& args) {
+    if (args.M == 0 || args.N == 0) {
+        return;
+    }
+    if (args.K == 0) {
+        // Degenerate product: the scalar kernel handles zeroing and the epilogue
+        scalar_kernels().gemm(args);
+        return;
+    }
+    kernels().gemm(args);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Elementwise activation applied in the GEMM epilogue
+enum class Activation { None, ReLU, Sigmoid };
+
+// Row-major single-precision matrix multiply:
+//   C (M x N) = op(A) (M x K) * op(B) (K x N)      (or C += ... if accumulate)
+// where op(X) is X or X^T. With trans_a, A is stored as (K x M); with trans_b,
+// B is stored as (N x K). lda/ldb/ldc are row strides of the stored matrices.
+//
+// If bias (length N) or activation is set, the result becomes
+//   C = act(op(A) * op(B) [+ C] + bias)
+// applied to each register tile as it is written out, so no extra pass over C.
+// Sigmoid clamps its input to [-88, 88] like the Sigmoid layer.
+//
+// B may instead be given in bfloat16 (B_bf16, same layout and ldb, B left null):
+// the kernels widen it to float32 as they read it, so a weight-bound product moves
+// half the bytes while accumulating in float32 as before (see math/bf16.h).
+struct GemmArgs {
+    bool trans_a = false;
+    bool trans_b = false;
+    size_t M = 0, N = 0, K = 0;
+    const float* A = nullptr;
+    size_t lda = 0;
+    const float* B = nullptr;
+    const uint16_t* B_bf16 = nullptr;
+    size_t ldb = 0;
+    float* C = nullptr;
+    size_t ldc = 0;
+    bool accumulate = false;
+    const float* bias = nullptr;
+    Activation activation = Activation::None;
+};
+
+// Dispatch to the kernel set of the active instruction set (see math/cpu.h)
+void gemm(const GemmArgs& args);
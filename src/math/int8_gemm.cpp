@@ -0,0 +1,91 @@
+#include "math/int8_gemm.h"
+#include "math/kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+static size_t padded_k(size_t K) {
+    return (K + 1) & ~size_t(1);
+}
+
+static size_t padded_n(size_t N) {
+    return (N + INT8_BLOCK - 1) / INT8_BLOCK * INT8_BLOCK;
+}
+
+static int8_t quantize_value(float x, float inv_scale) {
+    float q = std::nearbyint(x * inv_scale);
+    return static_cast<int8_t>(std::clamp(q, -127.0f, 127.0f));
+}
+
+size_t int8_packed_bytes(size_t K, size_t N) {
+    return padded_k(K) * padded_n(N);
+}
+
+void pack_int8_weights(const int8_t* W, size_t K, size_t N, int8_t* dst) {
+    size_t kp = padded_k(K);
+    std::memset(dst, 0, int8_packed_bytes(K, N));
+    for (size_t jb = 0; jb < N; jb += INT8_BLOCK) {
+        int8_t* block = dst + jb * kp;
+        size_t width = std::min(INT8_BLOCK, N - jb);
+        for (size_t k = 0; k < K; ++k) {
+            int8_t* pair = block + (k / 2) * 2 * INT8_BLOCK + (k % 2);
+            for (size_t j = 0; j < width; ++j) {
+                pair[2 * j] = W[k * N + jb + j];
+            }
+        }
+    }
+}
+
+size_t int8_row_stride(size_t K) {
+    return padded_k(K);
+}
+
+void quantize_rows(const float* X, size_t M, size_t K, size_t ldx, int16_t* Q,
+                   float* scales) {
+    size_t ldq = padded_k(K);
+    for (size_t i = 0; i < M; ++i) {
+        const float* x = X + i * ldx;
+        float amax = 0.0f;
+        for (size_t k = 0; k < K; ++k) {
+            amax = std::max(amax, std::fabs(x[k]));
+        }
+        scales[i] = amax / 127.0f;
+        float inv = amax > 0.0f ? 127.0f / amax : 0.0f;
+        int16_t* q = Q + i * ldq;
+        for (size_t k = 0; k < K; ++k) {
+            q[k] = quantize_value(x[k], inv);
+        }
+        if (ldq > K) {
+            q[K] = 0;
+        }
+    }
+}
+
+void quantize_columns(const float* W, size_t K, size_t N, int8_t* Q, float* scales) {
+    std::vector<float> inv(N);
+    for (size_t j = 0; j < N; ++j) {
+        scales[j] = 0.0f;
+    }
+    for (size_t k = 0; k < K; ++k) {
+        for (size_t j = 0; j < N; ++j) {
+            scales[j] = std::max(scales[j], std::fabs(W[k * N + j]));
+        }
+    }
+    for (size_t j = 0; j < N; ++j) {
+        inv[j] = scales[j] > 0.0f ? 127.0f / scales[j] : 0.0f;
+        scales[j] /= 127.0f;
+    }
+    for (size_t k = 0; k < K; ++k) {
+        for (size_t j = 0; j < N; ++j) {
+            Q[k * N + j] = quantize_value(W[k * N + j], inv[j]);
+        }
+    }
+}
+
+void int8_gemm(const Int8GemmArgs& args) {
+    if (args.M == 0 || args.N == 0) {
+        return;
+    }
+    kernels().int8_gemm(args);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "math/gemm.h"
+#include <cstddef>
+#include <cstdint>
+
+// Quantized inference GEMM: int8 activations times int8 weights with int32
+// accumulation, dequantized to float in the epilogue:
+//   C[i][j] = act(a_scale[i] * b_scale[j] * sum_k A[i][k] * W[k][j] + bias[j])
+//
+// Quantization is symmetric (zero point 0) with values in [-127, 127]. Activations
+// are scaled per row and weights per output column (see quantize_rows and
+// quantize_columns). Quantized activations are stored widened to int16 with each
+// row padded to even length, so a kernel broadcasts a pair of them with one 32-bit
+// load.
+//
+// The weights are packed once, ahead of time (see pack_int8_weights): columns are
+// grouped into blocks of INT8_BLOCK, and within a block each pair of rows k, k+1 is
+// stored as INT8_BLOCK interleaved (W[k][j], W[k+1][j]) byte pairs. One load then
+// gives every column of the block its next two products, which is the operand
+// layout of pairwise multiply-add instructions (vpmaddwd, and vpdpwssd with
+// AVX-512 VNNI). K is padded to even and N to a multiple of INT8_BLOCK with zeros.
+constexpr size_t INT8_BLOCK = 16;
+
+// Size in bytes of the packed form of a (K x N) weight matrix (a multiple of 32)
+size_t int8_packed_bytes(size_t K, size_t N);
+
+// Pack a row-major (K x N) int8 matrix into dst (int8_packed_bytes(K, N) bytes)
+void pack_int8_weights(const int8_t* W, size_t K, size_t N, int8_t* dst);
+
+// Row stride of quantized activations with K columns (K rounded up to even)
+size_t int8_row_stride(size_t K);
+
+// Symmetric per-row quantization of a row-major (M x K) float matrix with row
+// stride ldx: scales[i] = max_k |X[i][k]| / 127 and Q[i][k] = round(X[i][k] / scales[i]).
+// Rows that are all zero get scale 0. Q has row stride int8_row_stride(K); a
+// padding column is set to zero.
+void quantize_rows(const float* X, size_t M, size_t K, size_t ldx, int16_t* Q,
+                   float* scales);
+
+// Symmetric per-column quantization of a row-major (K x N) float matrix:
+// scales[j] = max_k |W[k][j]| / 127
+void quantize_columns(const float* W, size_t K, size_t N, int8_t* Q, float* scales);
+
+struct Int8GemmArgs {
+    size_t M = 0, N = 0, K = 0;
+    const int16_t* A = nullptr;    // (M x K) quantized activations, see quantize_rows
+    size_t lda = 0;                // even, with a zero in column K if K is odd
+    const float* a_scale = nullptr;  // per row of A
+    const int8_t* B = nullptr;     // packed weights (see pack_int8_weights)
+    const float* b_scale = nullptr;  // per column of the weights
+    float* C = nullptr;
+    size_t ldc = 0;
+    const float* bias = nullptr;
+    Activation activation = Activation::None;
+};
+
+// Dispatch to the kernel set of the active instruction set (see math/cpu.h)
+void int8_gemm(const Int8GemmArgs& args);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "math/cpu.h"
+#include "math/gemm.h"
+#include "math/adam_kernel.h"
+#include "math/int8_gemm.h"
+
+// Per-instruction-set kernel implementations. Each table is defined in its own
+// translation unit compiled with the matching target flags; callers go through
+// kernels(), which selects the table for active_isa().
+struct KernelTable {
+    Isa isa;
+    void (*gemm)(const GemmArgs& args);
+    void (*adam)(const AdamArgs& args, float* param, const float* grad, float* m, float* v,
+                 size_t n, uint16_t* param_bf16);
+    void (*int8_gemm)(const Int8GemmArgs& args);
+    void (*l2_distances)(const float* query, const float* rows, size_t n, size_t dim,
+                         float* out);
+};
+
+const KernelTable& scalar_kernels();
+#if defined(AE_HAVE_X86_KERNELS)
+const KernelTable& avx2_kernels();
+const KernelTable& avx512_kernels();
+// AVX-512 VNNI int8 GEMM, used by avx512_kernels() when cpu_has_avx512_vnni()
+void int8_gemm_avx512_vnni(const Int8GemmArgs& args);
+#endif
+
+const KernelTable& kernels();
@@ -0,0 +1,88 @@
+// AVX2 + FMA kernels. Compiled with -mavx2 -mfma; only called after runtime detection.
+
+#include "math/kernels.h"
+#include "math/thread_pool.h"
+#include <cstring>
+#include <immintrin.h>
+#include <new>
+
+namespace {
+
+struct V {
+    using reg = __m256;
+    static constexpr int W = 8;
+    static reg zero() { return _mm256_setzero_ps(); }
+    static reg load(const float* p) { return _mm256_load_ps(p); }
+    static reg loadu(const float* p) { return _mm256_loadu_ps(p); }
+    static void storeu(float* p, reg v) { _mm256_storeu_ps(p, v); }
+    static reg set1(float x) { return _mm256_set1_ps(x); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+    static reg sqrt(reg a) { return _mm256_sqrt_ps(a); }
+    static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+    static reg round(reg a) {
+        return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+    // 2^n for integral n in [-127, 127]
+    static reg pow2n(reg n) {
+        __m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+    }
+    // bfloat16 <-> float32 (see math/bf16.h); stores round to nearest even
+    static reg load_bf16(const uint16_t* p) {
+        __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(h, 16));
+    }
+    static void store_bf16(uint16_t* p, reg v) {
+        __m256i bits = _mm256_castps_si256(v);
+        __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1));
+        bits = _mm256_add_epi32(bits, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7fff)));
+        bits = _mm256_srli_epi32(bits, 16);
+        __m128i h = _mm_packus_epi32(_mm256_castsi256_si128(bits), _mm256_extracti128_si256(bits, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), h);
+    }
+    static float hsum(reg v) {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_movehdup_ps(s));
+        return _mm_cvtss_f32(s);
+    }
+};
+
+// Int8 products: vpmaddwd multiplies int16 pairs and adds each pair into one int32
+struct I {
+    using acc = __m256i;
+    static acc zero() { return _mm256_setzero_si256(); }
+    static acc load_pairs(const int8_t* p) {
+        return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    static acc bcast_pair(const int16_t* p) {
+        int32_t pair;
+        std::memcpy(&pair, p, sizeof(pair));
+        return _mm256_set1_epi32(pair);
+    }
+    static acc dot(acc c, acc a, acc b) { return _mm256_add_epi32(c, _mm256_madd_epi16(a, b)); }
+    static V::reg to_float(acc x) { return _mm256_cvtepi32_ps(x); }
+};
+
+// 4x16 int8 tile: 8 accumulators + 2 B vectors + 1 broadcast
+constexpr int INT8_CB = 1;
+
+// 6x16 tile: 12 accumulators + 2 B vectors + 1 broadcast of the 16 ymm registers
+constexpr int MR = 6;
+constexpr int NV = 2;
+
+}  // namespace
+
+#include "math/kernels_simd.inl"
+#include "math/kernels_int8.inl"
+
+const KernelTable& avx2_kernels() {
+    static const KernelTable table = {Isa::AVX2, gemm_simd, adam_simd, int8_gemm_simd,
+                                      l2_distances_simd};
+    return table;
+}
@@ -0,0 +1,26 @@
+// AVX-512F kernels. Compiled with -mavx512f -mfma; only called after runtime detection.
+
+#include "math/kernels.h"
+#include "math/thread_pool.h"
+#include <immintrin.h>
+#include <new>
+
+#include "math/kernels_avx512_traits.inl"
+
+namespace {
+
+// 12x32 tile: 24 accumulators + 2 B vectors + 1 broadcast of the 32 zmm registers
+constexpr int MR = 12;
+constexpr int NV = 2;
+
+}  // namespace
+
+#include "math/kernels_simd.inl"
+
+const KernelTable& avx512_kernels() {
+    // vpdpwssd needs VNNI on top of AVX-512F; without it the AVX2 int8 kernel is used
+    static const KernelTable table = {Isa::AVX512, gemm_simd, adam_simd,
+        cpu_has_avx512_vnni() ? int8_gemm_avx512_vnni : avx2_kernels().int8_gemm,
+        l2_distances_simd};
+    return table;
+}
@@ -0,0 +1,45 @@
+// AVX-512F vector traits (V, see kernels_simd.inl), shared by kernels_avx512.cpp
+// and kernels_avx512_vnni.cpp. Requires <immintrin.h> and -mavx512f.
+
+namespace {
+
+struct V {
+    using reg = __m512;
+    static constexpr int W = 16;
+    static reg zero() { return _mm512_setzero_ps(); }
+    static reg load(const float* p) { return _mm512_load_ps(p); }
+    static reg loadu(const float* p) { return _mm512_loadu_ps(p); }
+    static void storeu(float* p, reg v) { _mm512_storeu_ps(p, v); }
+    static reg set1(float x) { return _mm512_set1_ps(x); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+    static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+    static reg sqrt(reg a) { return _mm512_sqrt_ps(a); }
+    static reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+    static reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+    static reg round(reg a) {
+        return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+    // 2^n for integral n in [-127, 127]
+    static reg pow2n(reg n) {
+        __m512i e = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(e, 23));
+    }
+    // bfloat16 <-> float32 (see math/bf16.h); stores round to nearest even
+    static reg load_bf16(const uint16_t* p) {
+        __m512i h = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(h, 16));
+    }
+    static void store_bf16(uint16_t* p, reg v) {
+        __m512i bits = _mm512_castps_si512(v);
+        __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+        bits = _mm512_add_epi32(bits, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7fff)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p),
+                            _mm512_cvtepi32_epi16(_mm512_srli_epi32(bits, 16)));
+    }
+    static float hsum(reg v) { return _mm512_reduce_add_ps(v); }
+};
+
+}  // namespace
@@ -0,0 +1,40 @@
+// AVX-512 VNNI int8 GEMM. Compiled with -mavx512f -mavx512bw -mavx512vnni -mfma;
+// only called after runtime detection (cpu_has_avx512_vnni).
+
+#include "math/kernels.h"
+#include "math/thread_pool.h"
+#include <cstring>
+#include <immintrin.h>
+
+#include "math/kernels_avx512_traits.inl"
+
+namespace {
+
+// Int8 products: vpdpwssd multiplies int16 pairs and accumulates each pair's sum
+// into one int32 in a single instruction
+struct I {
+    using acc = __m512i;
+    static acc zero() { return _mm512_setzero_si512(); }
+    static acc load_pairs(const int8_t* p) {
+        return _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+    static acc bcast_pair(const int16_t* p) {
+        int32_t pair;
+        std::memcpy(&pair, p, sizeof(pair));
+        return _mm512_set1_epi32(pair);
+    }
+    static acc dot(acc c, acc a, acc b) { return _mm512_dpwssd_epi32(c, a, b); }
+    static V::reg to_float(acc x) { return _mm512_cvtepi32_ps(x); }
+};
+
+// 4x64 tile: 16 accumulators + 4 B vectors + 1 broadcast of the 32 zmm registers
+constexpr int INT8_CB = 4;
+
+}  // namespace
+
+#include "math/kernels_epilogue.inl"
+#include "math/kernels_int8.inl"
+
+void int8_gemm_avx512_vnni(const Int8GemmArgs& args) {
+    int8_gemm_simd(args);
+}
@@ -0,0 +1,73 @@
+// GEMM epilogue (bias + activation) on SIMD registers, shared by kernels_simd.inl
+// and kernels_int8.inl. Requires the V vector traits described in kernels_simd.inl.
+
+namespace {
+
+// --- Epilogue (bias + activation) ---
+
+// Bias and activation applied to a tile of C when it is written out
+struct Epilogue {
+    const float* bias;  // bias of the tile's first column, or null
+    Activation activation;
+};
+
+// exp(x) for x in [-88, 88]: range reduction to x = n*ln2 + r, |r| <= ln2/2, and a
+// degree-6 polynomial for exp(r) (Cephes expf coefficients, ~1 ulp)
+inline typename V::reg exp_ps(typename V::reg x) {
+    typename V::reg n = V::round(V::mul(x, V::set1(1.44269504088896341f)));
+    x = V::sub(x, V::mul(n, V::set1(0.693359375f)));
+    x = V::sub(x, V::mul(n, V::set1(-2.12194440e-4f)));
+    typename V::reg y = V::set1(1.9875691500e-4f);
+    y = V::fmadd(y, x, V::set1(1.3981999507e-3f));
+    y = V::fmadd(y, x, V::set1(8.3334519073e-3f));
+    y = V::fmadd(y, x, V::set1(4.1665795894e-2f));
+    y = V::fmadd(y, x, V::set1(1.6666665459e-1f));
+    y = V::fmadd(y, x, V::set1(5.0000001201e-1f));
+    y = V::fmadd(y, V::mul(x, x), V::add(x, V::set1(1.0f)));
+    return V::mul(y, V::pow2n(n));
+}
+
+inline typename V::reg activate(typename V::reg x, Activation activation) {
+    if (activation == Activation::ReLU) {
+        return V::max(x, V::zero());
+    }
+    if (activation == Activation::Sigmoid) {
+        // Clamp to [-88, 88] like the Sigmoid layer
+        x = V::min(V::max(x, V::set1(-88.0f)), V::set1(88.0f));
+        typename V::reg e = exp_ps(V::sub(V::zero(), x));
+        return V::div(V::set1(1.0f), V::add(V::set1(1.0f), e));
+    }
+    return x;
+}
+
+// Epilogue over n contiguous values of one row of C (edge tiles and small-M path)
+void epilogue_span(float* c, const Epilogue& ep, size_t n) {
+    size_t j = 0;
+    for (; j + V::W <= n; j += V::W) {
+        typename V::reg x = V::loadu(c + j);
+        if (ep.bias) {
+            x = V::add(x, V::loadu(ep.bias + j));
+        }
+        V::storeu(c + j, activate(x, ep.activation));
+    }
+    if (j < n) {
+        // Tail through a padded scratch vector
+        alignas(64) float tmp[V::W] = {};
+        alignas(64) float bias[V::W] = {};
+        for (size_t t = 0; t < n - j; ++t) {
+            tmp[t] = c[j + t];
+            bias[t] = ep.bias ? ep.bias[j + t] : 0.0f;
+        }
+        typename V::reg x = V::add(V::load(tmp), V::load(bias));
+        V::storeu(tmp, activate(x, ep.activation));
+        for (size_t t = 0; t < n - j; ++t) {
+            c[j + t] = tmp[t];
+        }
+    }
+}
+
+inline bool has_epilogue(const GemmArgs& g) {
+    return g.bias || g.activation != Activation::None;
+}
+
+}  // namespace
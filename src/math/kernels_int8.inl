@@ -0,0 +1,106 @@
+// Shared int8 GEMM implementation (see math/int8_gemm.h), included after
+// kernels_epilogue.inl by each translation unit with int8 kernels. Besides V, the
+// unit defines in an anonymous namespace:
+//   I         integer vector traits: acc (V::W int32 lanes), zero, load_pairs (V::W
+//             packed column pairs, sign-extended to int16), bcast_pair (the int16
+//             activation pair at p in every lane), dot (acc plus the sum of each
+//             lane's two products), to_float
+//   INT8_CB   column blocks per register tile; a tile is up to 4 rows x INT8_CB blocks
+
+namespace {
+
+constexpr int INT8_NV = static_cast<int>(INT8_BLOCK) / V::W;  // vectors per column block
+
+// Rows [i0, i0 + R) of CB column blocks starting at jb: int32 dot products over K,
+// dequantized into C. Bias and activation are applied afterwards by the caller.
+template <int R, int CB>
+void int8_tile(const Int8GemmArgs& g, size_t kp, size_t i0, size_t jb) {
+    typename I::acc acc[R][CB * INT8_NV];
+    for (int r = 0; r < R; ++r) {
+        for (int v = 0; v < CB * INT8_NV; ++v) {
+            acc[r][v] = I::zero();
+        }
+    }
+    const int8_t* b = g.B + jb * kp;
+    const int16_t* a = g.A + i0 * g.lda;
+    for (size_t k = 0; k < kp; k += 2, b += 2 * INT8_BLOCK) {
+        typename I::acc bv[CB * INT8_NV];
+        for (int c = 0; c < CB; ++c) {
+            for (int v = 0; v < INT8_NV; ++v) {
+                bv[c * INT8_NV + v] = I::load_pairs(b + c * INT8_BLOCK * kp + 2 * v * V::W);
+            }
+        }
+        for (int r = 0; r < R; ++r) {
+            typename I::acc av = I::bcast_pair(a + r * g.lda + k);
+            for (int v = 0; v < CB * INT8_NV; ++v) {
+                acc[r][v] = I::dot(acc[r][v], av, bv[v]);
+            }
+        }
+    }
+
+    size_t width = g.N - jb < CB * INT8_BLOCK ? g.N - jb : CB * INT8_BLOCK;
+    for (int r = 0; r < R; ++r) {
+        float a_scale = g.a_scale[i0 + r];
+        float* c = g.C + (i0 + r) * g.ldc + jb;
+        if (width == CB * INT8_BLOCK) {
+            typename V::reg as = V::set1(a_scale);
+            for (int v = 0; v < CB * INT8_NV; ++v) {
+                typename V::reg scale = V::mul(as, V::loadu(g.b_scale + jb + v * V::W));
+                V::storeu(c + v * V::W, V::mul(I::to_float(acc[r][v]), scale));
+            }
+        } else {
+            // Edge tile: only `width` columns (and scales) exist
+            alignas(64) float tmp[CB * INT8_BLOCK];
+            for (int v = 0; v < CB * INT8_NV; ++v) {
+                V::storeu(tmp + v * V::W, I::to_float(acc[r][v]));
+            }
+            for (size_t j = 0; j < width; ++j) {
+                c[j] = tmp[j] * (a_scale * g.b_scale[jb + j]);
+            }
+        }
+    }
+}
+
+template <int CB>
+void int8_rows(const Int8GemmArgs& g, size_t kp, size_t i, size_t rows, size_t jb) {
+    switch (rows) {
+        case 1: int8_tile<1, CB>(g, kp, i, jb); break;
+        case 2: int8_tile<2, CB>(g, kp, i, jb); break;
+        case 3: int8_tile<3, CB>(g, kp, i, jb); break;
+        default: int8_tile<4, CB>(g, kp, i, jb); break;
+    }
+}
+
+// Each chunk covers whole tiles of columns and runs every row over them, so its
+// slice of the packed weights is reused from cache across rows. The chunk's output
+// rows are still in L1 when the epilogue runs over them.
+void int8_gemm_simd(const Int8GemmArgs& g) {
+    constexpr size_t TILE = INT8_CB * INT8_BLOCK;
+    size_t kp = (g.K + 1) & ~size_t(1);
+    size_t tiles = (g.N + TILE - 1) / TILE;
+    size_t tile_work = kp * TILE * g.M;
+    size_t grain = tile_work >= (size_t(1) << 16) ? 1 : (size_t(1) << 16) / (tile_work + 1);
+    ThreadPool::global().parallel_for(tiles, grain, [&](size_t t0, size_t t1) {
+        size_t j0 = t0 * TILE;
+        size_t j1 = t1 * TILE < g.N ? t1 * TILE : g.N;
+        Epilogue ep{g.bias ? g.bias + j0 : nullptr, g.activation};
+        for (size_t i = 0; i < g.M; i += 4) {
+            size_t rows = g.M - i < 4 ? g.M - i : 4;
+            size_t jb = j0;
+            for (; jb + TILE <= j1; jb += TILE) {
+                int8_rows<INT8_CB>(g, kp, i, rows, jb);
+            }
+            // Last partial tile: whole blocks, then the edge block
+            for (; jb < j1; jb += INT8_BLOCK) {
+                int8_rows<1>(g, kp, i, rows, jb);
+            }
+            if (g.bias || g.activation != Activation::None) {
+                for (size_t r = 0; r < rows; ++r) {
+                    epilogue_span(g.C + (i + r) * g.ldc + j0, ep, j1 - j0);
+                }
+            }
+        }
+    });
+}
+
+}  // namespace
@@ -0,0 +1,117 @@
+// Portable reference kernels. These are the fallback on CPUs without AVX2 and
+// the baseline the SIMD kernels are checked against in the tests.
+
+#include "math/kernels.h"
+#include "math/bf16.h"
+#include <algorithm>
+#include <cmath>
+
+// Bias and activation for one finished row of C
+static void epilogue_row(const GemmArgs& g, float* c) {
+    if (g.bias) {
+        for (size_t j = 0; j < g.N; ++j) {
+            c[j] += g.bias[j];
+        }
+    }
+    if (g.activation == Activation::ReLU) {
+        for (size_t j = 0; j < g.N; ++j) {
+            c[j] = c[j] > 0.0f ? c[j] : 0.0f;
+        }
+    } else if (g.activation == Activation::Sigmoid) {
+        for (size_t j = 0; j < g.N; ++j) {
+            float x = std::clamp(c[j], -88.0f, 88.0f);
+            c[j] = 1.0f / (1.0f + std::exp(-x));
+        }
+    }
+}
+
+// Element `index` of stored B, in whichever format it is given
+static float b_at(const GemmArgs& g, size_t index) {
+    return g.B_bf16 ? bf16_to_float(g.B_bf16[index]) : g.B[index];
+}
+
+static void gemm_scalar(const GemmArgs& g) {
+    for (size_t i = 0; i < g.M; ++i) {
+        float* c = g.C + i * g.ldc;
+        if (!g.accumulate) {
+            for (size_t j = 0; j < g.N; ++j) {
+                c[j] = 0.0f;
+            }
+        }
+        if (!g.trans_b) {
+            // i,k,j loop order for cache locality
+            for (size_t k = 0; k < g.K; ++k) {
+                float a_ik = g.trans_a ? g.A[k * g.lda + i] : g.A[i * g.lda + k];
+                for (size_t j = 0; j < g.N; ++j) {
+                    c[j] += a_ik * b_at(g, k * g.ldb + j);
+                }
+            }
+        } else {
+            // B stored as (N x K): each output is a dot product of contiguous rows
+            for (size_t j = 0; j < g.N; ++j) {
+                float sum = 0.0f;
+                for (size_t k = 0; k < g.K; ++k) {
+                    float a_ik = g.trans_a ? g.A[k * g.lda + i] : g.A[i * g.lda + k];
+                    sum += a_ik * b_at(g, j * g.ldb + k);
+                }
+                c[j] += sum;
+            }
+        }
+        epilogue_row(g, c);
+    }
+}
+
+static void adam_scalar(const AdamArgs& a, float* param, const float* grad, float* m,
+                        float* v, size_t n, uint16_t* param_bf16) {
+    for (size_t i = 0; i < n; ++i) {
+        float g = grad[i];
+        m[i] = a.beta1 * m[i] + (1.0f - a.beta1) * g;
+        v[i] = a.beta2 * v[i] + (1.0f - a.beta2) * g * g;
+        float denom = std::sqrt(v[i]) * a.inv_sqrt_bc2 + a.epsilon;
+        param[i] = a.decay * param[i] - a.step_size * m[i] / denom;
+        if (param_bf16) {
+            param_bf16[i] = float_to_bf16(param[i]);
+        }
+    }
+}
+
+static void int8_gemm_scalar(const Int8GemmArgs& g) {
+    size_t kp = (g.K + 1) & ~size_t(1);
+    GemmArgs epilogue;
+    epilogue.N = g.N;
+    epilogue.bias = g.bias;
+    epilogue.activation = g.activation;
+    for (size_t i = 0; i < g.M; ++i) {
+        const int16_t* a = g.A + i * g.lda;
+        float* c = g.C + i * g.ldc;
+        for (size_t j = 0; j < g.N; ++j) {
+            // Column j of the packed block holding it (see pack_int8_weights)
+            const int8_t* b = g.B + (j / INT8_BLOCK) * INT8_BLOCK * kp + 2 * (j % INT8_BLOCK);
+            int32_t sum = 0;
+            for (size_t k = 0; k < g.K; ++k) {
+                sum += int32_t(a[k]) * b[(k / 2) * 2 * INT8_BLOCK + (k % 2)];
+            }
+            c[j] = static_cast<float>(sum) * (g.a_scale[i] * g.b_scale[j]);
+        }
+        epilogue_row(epilogue, c);
+    }
+}
+
+static void l2_distances_scalar(const float* query, const float* rows, size_t n, size_t dim,
+                                float* out) {
+    for (size_t i = 0; i < n; ++i) {
+        const float* r = rows + i * dim;
+        float sum = 0.0f;
+        for (size_t d = 0; d < dim; ++d) {
+            float diff = r[d] - query[d];
+            sum += diff * diff;
+        }
+        out[i] = sum;
+    }
+}
+
+const KernelTable& scalar_kernels() {
+    static const KernelTable table = {Isa::Scalar, gemm_scalar, adam_scalar, int8_gemm_scalar,
+                                      l2_distances_scalar};
+    return table;
+}
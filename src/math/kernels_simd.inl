@@ -0,0 +1,518 @@
+// Shared SIMD kernel implementations, included once by each of
+// kernels_avx2.cpp and kernels_avx512.cpp. Before including, the translation
+// unit defines in an anonymous namespace:
+//   V       vector traits: reg, W (floats per register), zero, load (aligned),
+//           loadu, storeu, set1, fmadd, add, sub, mul, div, sqrt, max, min,
+//           round (to nearest), pow2n (2^n for integral n), hsum,
+//           load_bf16 / store_bf16 (V::W bfloat16 values, widened / rounded)
+//   MR, NV  GEMM register tile of MR rows x NV vectors
+//
+// Everything here has internal linkage and avoids inline library templates, so
+// code compiled with wider target flags cannot leak into other translation units.
+
+#include "math/kernels_epilogue.inl"
+
+namespace {
+
+constexpr size_t NR = static_cast<size_t>(NV) * V::W;
+
+// Cache blocking: a packed KC x NR sliver of B stays in L1, a packed MC x KC
+// block of A in L2, and a packed KC x NC panel of B in L3.
+constexpr size_t KC = 256;
+constexpr size_t MC = MR * 16;
+constexpr size_t NC = NR * 64;
+
+// Row counts at or below this skip packing and stream B directly (GEMV-like shapes)
+constexpr size_t SMALL_M = 4;
+
+inline size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+// 64-byte aligned scratch buffer that only grows, so steady-state calls do not allocate
+struct PackBuffer {
+    float* ptr = nullptr;
+    size_t capacity = 0;
+
+    ~PackBuffer() {
+        if (ptr) {
+            ::operator delete(ptr, std::align_val_t(64));
+        }
+    }
+
+    float* get(size_t n) {
+        if (n > capacity) {
+            if (ptr) {
+                ::operator delete(ptr, std::align_val_t(64));
+            }
+            ptr = static_cast<float*>(::operator new(n * sizeof(float), std::align_val_t(64)));
+            capacity = n;
+        }
+        return ptr;
+    }
+};
+
+// Stored B is float32 or bfloat16 (GemmArgs::B_bf16). Code that reads B is
+// templated on its element type and widens it through these.
+inline typename V::reg load_b(const float* p) {
+    return V::loadu(p);
+}
+
+inline typename V::reg load_b(const uint16_t* p) {
+    return V::load_bf16(p);
+}
+
+inline float b_value(float x) {
+    return x;
+}
+
+inline float b_value(uint16_t h) {
+    uint32_t bits = uint32_t(h) << 16;
+    float f;
+    __builtin_memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// --- Packed (cache-blocked) path ---
+
+// Pack op(A)[ic:ic+mc, pc:pc+kc] into MR-row panels, each stored k-major so the
+// micro-kernel reads MR consecutive values per k. Short panels are zero-padded.
+void pack_a(const GemmArgs& g, size_t ic, size_t pc, size_t mc, size_t kc, float* dst) {
+    for (size_t ir = 0; ir < mc; ir += MR) {
+        size_t mr = min_size(MR, mc - ir);
+        for (size_t p = 0; p < kc; ++p) {
+            size_t k = pc + p;
+            for (size_t i = 0; i < mr; ++i) {
+                size_t row = ic + ir + i;
+                dst[i] = g.trans_a ? g.A[k * g.lda + row] : g.A[row * g.lda + k];
+            }
+            for (size_t i = mr; i < MR; ++i) {
+                dst[i] = 0.0f;
+            }
+            dst += MR;
+        }
+    }
+}
+
+// Pack op(B)[pc:pc+kc, jc:jc+nc] into NR-column panels, each stored k-major.
+// bf16 B is widened here, so the micro-kernel always runs on float32 panels.
+template <class T>
+void pack_b(const GemmArgs& g, const T* B, size_t pc, size_t jc, size_t nc, size_t kc,
+            float* dst) {
+    for (size_t jr = 0; jr < nc; jr += NR) {
+        size_t nr = min_size(NR, nc - jr);
+        if (!g.trans_b) {
+            for (size_t p = 0; p < kc; ++p) {
+                const T* src = B + (pc + p) * g.ldb + jc + jr;
+                size_t j = 0;
+                if (nr == NR) {
+                    for (; j < NR; j += V::W) {
+                        V::storeu(dst + j, load_b(src + j));
+                    }
+                }
+                for (; j < nr; ++j) {
+                    dst[j] = b_value(src[j]);
+                }
+                for (; j < NR; ++j) {
+                    dst[j] = 0.0f;
+                }
+                dst += NR;
+            }
+        } else {
+            // B stored as (N x K): read each source row contiguously
+            for (size_t j = 0; j < NR; ++j) {
+                if (j < nr) {
+                    const T* src = B + (jc + jr + j) * g.ldb + pc;
+                    for (size_t p = 0; p < kc; ++p) {
+                        dst[p * NR + j] = b_value(src[p]);
+                    }
+                } else {
+                    for (size_t p = 0; p < kc; ++p) {
+                        dst[p * NR + j] = 0.0f;
+                    }
+                }
+            }
+            dst += kc * NR;
+        }
+    }
+}
+
+// MR x NR register tile: c = a_panel * b_panel (+ c if accumulate), followed by
+// the epilogue (if any) while the tile is still in registers
+void micro_kernel(size_t kc, const float* a, const float* b, float* c, size_t ldc,
+                  bool accumulate, const Epilogue* ep) {
+    typename V::reg acc[MR][NV];
+#pragma GCC unroll 16
+    for (int i = 0; i < MR; ++i) {
+#pragma GCC unroll 4
+        for (int v = 0; v < NV; ++v) {
+            acc[i][v] = V::zero();
+        }
+    }
+
+    for (size_t p = 0; p < kc; ++p) {
+        typename V::reg bv[NV];
+#pragma GCC unroll 4
+        for (int v = 0; v < NV; ++v) {
+            bv[v] = V::load(b + v * V::W);
+        }
+#pragma GCC unroll 16
+        for (int i = 0; i < MR; ++i) {
+            typename V::reg av = V::set1(a[i]);
+#pragma GCC unroll 4
+            for (int v = 0; v < NV; ++v) {
+                acc[i][v] = V::fmadd(av, bv[v], acc[i][v]);
+            }
+        }
+        a += MR;
+        b += NR;
+    }
+
+    typename V::reg bias[NV];
+#pragma GCC unroll 4
+    for (int v = 0; v < NV; ++v) {
+        bias[v] = ep && ep->bias ? V::loadu(ep->bias + v * V::W) : V::zero();
+    }
+
+#pragma GCC unroll 16
+    for (int i = 0; i < MR; ++i) {
+#pragma GCC unroll 4
+        for (int v = 0; v < NV; ++v) {
+            float* dst = c + i * ldc + v * V::W;
+            if (accumulate) {
+                acc[i][v] = V::add(acc[i][v], V::loadu(dst));
+            }
+            if (ep) {
+                acc[i][v] = activate(V::add(acc[i][v], bias[v]), ep->activation);
+            }
+            V::storeu(dst, acc[i][v]);
+        }
+    }
+}
+
+// Partial tile at the right/bottom edge: run the full kernel into a scratch tile
+void edge_kernel(size_t kc, const float* a, const float* b, float* c, size_t ldc,
+                 size_t mr, size_t nr, bool accumulate, const Epilogue* ep) {
+    alignas(64) float tile[MR * NR];
+    micro_kernel(kc, a, b, tile, NR, false, nullptr);
+    for (size_t i = 0; i < mr; ++i) {
+        for (size_t j = 0; j < nr; ++j) {
+            float v = tile[i * NR + j];
+            c[i * ldc + j] = accumulate ? c[i * ldc + j] + v : v;
+        }
+        if (ep) {
+            epilogue_span(c + i * ldc, *ep, nr);
+        }
+    }
+}
+
+// One macro-tile of C: rows [ic, ic+mc) x cols [jc, jc+nc), full K loop.
+// Each tile packs its own A block and B panel into per-thread buffers.
+void gemm_tile(const GemmArgs& g, size_t ic, size_t jc, size_t mc, size_t nc) {
+    static thread_local PackBuffer a_buf, b_buf;
+    float* ap = a_buf.get(MC * KC);
+    float* bp = b_buf.get(KC * NC);
+
+    for (size_t pc = 0; pc < g.K; pc += KC) {
+        size_t kc = min_size(KC, g.K - pc);
+        if (g.B_bf16) {
+            pack_b(g, g.B_bf16, pc, jc, nc, kc, bp);
+        } else {
+            pack_b(g, g.B, pc, jc, nc, kc, bp);
+        }
+        pack_a(g, ic, pc, mc, kc, ap);
+        bool accumulate = g.accumulate || pc > 0;
+        // The epilogue runs on the final K block, once each tile is complete
+        bool last = pc + kc == g.K;
+
+        for (size_t jr = 0; jr < nc; jr += NR) {
+            size_t nr = min_size(NR, nc - jr);
+            const float* b = bp + jr * kc;
+            Epilogue ep{g.bias ? g.bias + jc + jr : nullptr, g.activation};
+            const Epilogue* epp = last && has_epilogue(g) ? &ep : nullptr;
+            for (size_t ir = 0; ir < mc; ir += MR) {
+                size_t mr = min_size(MR, mc - ir);
+                const float* a = ap + ir * kc;
+                float* c = g.C + (ic + ir) * g.ldc + jc + jr;
+                if (mr == MR && nr == NR) {
+                    micro_kernel(kc, a, b, c, g.ldc, accumulate, epp);
+                } else {
+                    edge_kernel(kc, a, b, c, g.ldc, mr, nr, accumulate, epp);
+                }
+            }
+        }
+    }
+}
+
+// Split C into MC-row x nct-column macro-tiles and run them across the thread pool.
+// Narrower column tiles are used when there would be too few tiles to keep every
+// thread busy. Every element accumulates over K in the same order whatever the
+// tiling, so results do not depend on the thread count.
+void gemm_packed(const GemmArgs& g) {
+    ThreadPool& pool = ThreadPool::global();
+    size_t row_tiles = (g.M + MC - 1) / MC;
+    size_t nct = NC;
+    while (nct > 4 * NR && row_tiles * ((g.N + nct - 1) / nct) < 2 * pool.num_threads()) {
+        nct /= 2;
+    }
+    size_t col_tiles = (g.N + nct - 1) / nct;
+
+    pool.parallel_for(row_tiles * col_tiles, 1, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t ic = (t / col_tiles) * MC;
+            size_t jc = (t % col_tiles) * nct;
+            gemm_tile(g, ic, jc, min_size(MC, g.M - ic), min_size(nct, g.N - jc));
+        }
+    });
+}
+
+// --- Small-M path (no packing) ---
+
+// C[rows, j:j+NB*W] for M_ rows of A against row-major B, streaming each B row slice once
+template <int M_, int NB, class T>
+void small_nn_block(const GemmArgs& g, const T* B, size_t i0, size_t j) {
+    typename V::reg acc[M_][NB];
+    for (int i = 0; i < M_; ++i) {
+        for (int v = 0; v < NB; ++v) {
+            acc[i][v] = V::zero();
+        }
+    }
+    const float* a = g.A + i0 * g.lda;
+    const T* b = B + j;
+    for (size_t k = 0; k < g.K; ++k) {
+        typename V::reg bv[NB];
+        for (int v = 0; v < NB; ++v) {
+            bv[v] = load_b(b + v * V::W);
+        }
+        for (int i = 0; i < M_; ++i) {
+            typename V::reg av = V::set1(a[i * g.lda + k]);
+            for (int v = 0; v < NB; ++v) {
+                acc[i][v] = V::fmadd(av, bv[v], acc[i][v]);
+            }
+        }
+        b += g.ldb;
+    }
+    for (int i = 0; i < M_; ++i) {
+        for (int v = 0; v < NB; ++v) {
+            float* dst = g.C + (i0 + i) * g.ldc + j + v * V::W;
+            if (g.accumulate) {
+                acc[i][v] = V::add(acc[i][v], V::loadu(dst));
+            }
+            V::storeu(dst, acc[i][v]);
+        }
+    }
+}
+
+constexpr size_t SMALL_NN_BLOCK = 4 * V::W;
+
+// Columns [j0, j1) of the small-M NN product
+template <int M_, class T>
+void small_nn_rows(const GemmArgs& g, const T* B, size_t i0, size_t j0, size_t j1) {
+    size_t j = j0;
+    for (; j + SMALL_NN_BLOCK <= j1; j += SMALL_NN_BLOCK) {
+        small_nn_block<M_, 4>(g, B, i0, j);
+    }
+    for (; j + V::W <= j1; j += V::W) {
+        small_nn_block<M_, 1>(g, B, i0, j);
+    }
+    for (; j < j1; ++j) {
+        for (int i = 0; i < M_; ++i) {
+            const float* a = g.A + (i0 + i) * g.lda;
+            float sum = 0.0f;
+            for (size_t k = 0; k < g.K; ++k) {
+                sum += a[k] * b_value(B[k * g.ldb + j]);
+            }
+            float* dst = g.C + (i0 + i) * g.ldc + j;
+            *dst = g.accumulate ? *dst + sum : sum;
+        }
+    }
+}
+
+// C[rows, j:j+JB] = A[rows] . B[j:j+JB] with B stored (N x K): dot products of contiguous rows
+template <int M_, int JB, class T>
+void small_nt_block(const GemmArgs& g, const T* B, size_t i0, size_t j) {
+    typename V::reg acc[M_][JB];
+    for (int i = 0; i < M_; ++i) {
+        for (int jj = 0; jj < JB; ++jj) {
+            acc[i][jj] = V::zero();
+        }
+    }
+    const float* a = g.A + i0 * g.lda;
+    const T* b = B + j * g.ldb;
+    size_t k = 0;
+    for (; k + V::W <= g.K; k += V::W) {
+        typename V::reg bv[JB];
+        for (int jj = 0; jj < JB; ++jj) {
+            bv[jj] = load_b(b + jj * g.ldb + k);
+        }
+        for (int i = 0; i < M_; ++i) {
+            typename V::reg av = V::loadu(a + i * g.lda + k);
+            for (int jj = 0; jj < JB; ++jj) {
+                acc[i][jj] = V::fmadd(av, bv[jj], acc[i][jj]);
+            }
+        }
+    }
+    for (int i = 0; i < M_; ++i) {
+        for (int jj = 0; jj < JB; ++jj) {
+            float sum = V::hsum(acc[i][jj]);
+            for (size_t kk = k; kk < g.K; ++kk) {
+                sum += a[i * g.lda + kk] * b_value(b[jj * g.ldb + kk]);
+            }
+            float* dst = g.C + (i0 + i) * g.ldc + j + jj;
+            *dst = g.accumulate ? *dst + sum : sum;
+        }
+    }
+}
+
+// Columns [j0, j1) of the small-M NT product
+template <int M_, class T>
+void small_nt_rows(const GemmArgs& g, const T* B, size_t i0, size_t j0, size_t j1) {
+    size_t j = j0;
+    for (; j + 4 <= j1; j += 4) {
+        small_nt_block<M_, 4>(g, B, i0, j);
+    }
+    for (; j < j1; ++j) {
+        small_nt_block<M_, 1>(g, B, i0, j);
+    }
+}
+
+template <int M_, class T>
+void small_m_columns(const GemmArgs& g, const T* B, size_t j0, size_t j1) {
+    if (g.trans_b) {
+        small_nt_rows<M_>(g, B, 0, j0, j1);
+    } else {
+        small_nn_rows<M_>(g, B, 0, j0, j1);
+    }
+}
+
+template <int M_>
+void small_m_columns(const GemmArgs& g, size_t j0, size_t j1) {
+    if (g.B_bf16) {
+        small_m_columns<M_>(g, g.B_bf16, j0, j1);
+    } else {
+        small_m_columns<M_>(g, g.B, j0, j1);
+    }
+}
+
+// Column chunks are multiples of the widest block, so the split never changes
+// which block kernel computes a given column
+void gemm_small_m(const GemmArgs& g) {
+    size_t grain = g.trans_b ? 64 : SMALL_NN_BLOCK * 4;
+    ThreadPool::global().parallel_for(g.N, grain, [&](size_t j0, size_t j1) {
+        switch (g.M) {
+            case 1: small_m_columns<1>(g, j0, j1); break;
+            case 2: small_m_columns<2>(g, j0, j1); break;
+            case 3: small_m_columns<3>(g, j0, j1); break;
+            default: small_m_columns<4>(g, j0, j1); break;
+        }
+        if (has_epilogue(g)) {
+            // The chunk was just written and is still in L1
+            Epilogue ep{g.bias ? g.bias + j0 : nullptr, g.activation};
+            for (size_t i = 0; i < g.M; ++i) {
+                epilogue_span(g.C + i * g.ldc + j0, ep, j1 - j0);
+            }
+        }
+    });
+}
+
+// --- Adam ---
+
+// One vector of the fused Adam/AdamW update (see math/adam_kernel.h)
+inline void adam_vector(const AdamArgs& a, float* param, const float* grad, float* m,
+                        float* v, uint16_t* param_bf16) {
+    typename V::reg g = V::loadu(grad);
+    typename V::reg mv = V::fmadd(V::set1(a.beta1), V::loadu(m),
+                                  V::mul(V::set1(1.0f - a.beta1), g));
+    typename V::reg vv = V::fmadd(V::set1(a.beta2), V::loadu(v),
+                                  V::mul(V::set1(1.0f - a.beta2), V::mul(g, g)));
+    typename V::reg denom = V::fmadd(V::sqrt(vv), V::set1(a.inv_sqrt_bc2), V::set1(a.epsilon));
+    typename V::reg p = V::mul(V::set1(a.decay), V::loadu(param));
+    p = V::sub(p, V::div(V::mul(V::set1(a.step_size), mv), denom));
+    V::storeu(m, mv);
+    V::storeu(v, vv);
+    V::storeu(param, p);
+    if (param_bf16) {
+        V::store_bf16(param_bf16, p);
+    }
+}
+
+void adam_simd(const AdamArgs& a, float* param, const float* grad, float* m, float* v,
+               size_t n, uint16_t* param_bf16) {
+    size_t i = 0;
+    for (; i + V::W <= n; i += V::W) {
+        adam_vector(a, param + i, grad + i, m + i, v + i, param_bf16 ? param_bf16 + i : nullptr);
+    }
+    if (i < n) {
+        // Tail through padded scratch vectors
+        alignas(64) float tp[V::W] = {}, tg[V::W] = {}, tm[V::W] = {}, tv[V::W] = {};
+        alignas(64) uint16_t th[V::W] = {};
+        size_t r = n - i;
+        for (size_t t = 0; t < r; ++t) {
+            tp[t] = param[i + t]; tg[t] = grad[i + t]; tm[t] = m[i + t]; tv[t] = v[i + t];
+        }
+        adam_vector(a, tp, tg, tm, tv, param_bf16 ? th : nullptr);
+        for (size_t t = 0; t < r; ++t) {
+            param[i + t] = tp[t]; m[i + t] = tm[t]; v[i + t] = tv[t];
+            if (param_bf16) {
+                param_bf16[i + t] = th[t];
+            }
+        }
+    }
+}
+
+// Four rows at a time, so four independent accumulator chains hide the FMA
+// latency; dimensions past the last full vector are summed in scalar
+void l2_distances_simd(const float* query, const float* rows, size_t n, size_t dim,
+                       float* out) {
+    size_t dv = dim - dim % V::W;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const float* r = rows + i * dim;
+        typename V::reg acc0 = V::zero(), acc1 = V::zero(), acc2 = V::zero(), acc3 = V::zero();
+        for (size_t d = 0; d < dv; d += V::W) {
+            typename V::reg q = V::loadu(query + d);
+            typename V::reg d0 = V::sub(V::loadu(r + d), q);
+            typename V::reg d1 = V::sub(V::loadu(r + dim + d), q);
+            typename V::reg d2 = V::sub(V::loadu(r + 2 * dim + d), q);
+            typename V::reg d3 = V::sub(V::loadu(r + 3 * dim + d), q);
+            acc0 = V::fmadd(d0, d0, acc0);
+            acc1 = V::fmadd(d1, d1, acc1);
+            acc2 = V::fmadd(d2, d2, acc2);
+            acc3 = V::fmadd(d3, d3, acc3);
+        }
+        float sum[4] = {V::hsum(acc0), V::hsum(acc1), V::hsum(acc2), V::hsum(acc3)};
+        for (size_t d = dv; d < dim; ++d) {
+            for (size_t t = 0; t < 4; ++t) {
+                float diff = r[t * dim + d] - query[d];
+                sum[t] += diff * diff;
+            }
+        }
+        for (size_t t = 0; t < 4; ++t) {
+            out[i + t] = sum[t];
+        }
+    }
+    for (; i < n; ++i) {
+        const float* r = rows + i * dim;
+        typename V::reg acc = V::zero();
+        for (size_t d = 0; d < dv; d += V::W) {
+            typename V::reg diff = V::sub(V::loadu(r + d), V::loadu(query + d));
+            acc = V::fmadd(diff, diff, acc);
+        }
+        float sum = V::hsum(acc);
+        for (size_t d = dv; d < dim; ++d) {
+            float diff = r[d] - query[d];
+            sum += diff * diff;
+        }
+        out[i] = sum;
+    }
+}
+
+void gemm_simd(const GemmArgs& g) {
+    if (g.M <= SMALL_M && !g.trans_a) {
+        gemm_small_m(g);
+    } else {
+        gemm_packed(g);
+    }
+}
+
+}  // namespace
@@ -0,0 +1,186 @@
+#include "math/profiler.h"
+#include "math/storage.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+
+std::atomic<bool> Profiler::enabled_{false};
+
+static thread_local ProfileScope* current_scope = nullptr;
+
+// Small per-thread ids for the trace, in order of first use
+static uint32_t thread_index() {
+    static std::atomic<uint32_t> next{0};
+    static thread_local uint32_t index = next.fetch_add(1);
+    return index;
+}
+
+Profiler::Profiler() : origin_ns_(now_ns()) {}
+
+Profiler& Profiler::global() {
+    static Profiler profiler;
+    return profiler;
+}
+
+int64_t Profiler::now_ns() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::enable(bool trace) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trace_ = trace;
+    if (events_.empty()) {
+        origin_ns_ = now_ns();  // trace timestamps count from the first enable
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::disable() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+std::vector<ProfileStat> Profiler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<ProfileStat> used;
+    for (const ProfileStat& s : stats_) {
+        if (s.calls > 0) {
+            used.push_back(s);
+        }
+    }
+    return used;
+}
+
+void Profiler::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (ProfileStat& s : stats_) {
+        s = ProfileStat{s.label};
+    }
+}
+
+void Profiler::record(const std::string& label, int64_t start_ns, int64_t end_ns, double flops,
+                      double bytes, uint64_t allocations) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(label);
+    if (it == index_.end()) {
+        it = index_.emplace(label, static_cast<uint32_t>(stats_.size())).first;
+        stats_.push_back(ProfileStat{label});
+    }
+    ProfileStat& s = stats_[it->second];
+    s.calls++;
+    s.seconds += static_cast<double>(end_ns - start_ns) * 1e-9;
+    s.flops += flops;
+    s.bytes += bytes;
+    s.allocations += allocations;
+    if (trace_) {
+        if (events_.size() < MAX_TRACE_EVENTS) {
+            events_.push_back({it->second, thread_index(), start_ns - origin_ns_,
+                               end_ns - start_ns, flops, bytes, allocations});
+        } else {
+            dropped_events_++;
+        }
+    }
+}
+
+void Profiler::write_summary(std::ostream& out, double wall_seconds) const {
+    std::vector<ProfileStat> used = stats();
+    size_t width = 5;
+    for (const ProfileStat& s : used) {
+        width = std::max(width, s.label.size());
+    }
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::left << "  " << std::setw(static_cast<int>(width)) << "label"
+        << std::right << std::setw(8) << "calls" << std::setw(11) << "total ms" << std::setw(7)
+        << "%" << std::setw(11) << "avg us" << std::setw(9) << "GFLOP/s" << std::setw(8)
+        << "GB/s" << std::setw(8) << "allocs" << '\n';
+    for (const ProfileStat& s : used) {
+        out << "  " << std::left << std::setw(static_cast<int>(width)) << s.label << std::right
+            << std::setw(8) << s.calls << std::setprecision(2) << std::setw(11)
+            << s.seconds * 1e3 << std::setprecision(1) << std::setw(7)
+            << (wall_seconds > 0.0 ? 100.0 * s.seconds / wall_seconds : 0.0) << std::setw(11)
+            << s.seconds * 1e6 / static_cast<double>(s.calls);
+        double seconds = s.seconds > 0.0 ? s.seconds : 1e-12;
+        if (s.flops > 0.0) {
+            out << std::setw(9) << s.flops / seconds * 1e-9;
+        } else {
+            out << std::setw(9) << "-";
+        }
+        if (s.bytes > 0.0) {
+            out << std::setw(8) << s.bytes / seconds * 1e-9;
+        } else {
+            out << std::setw(8) << "-";
+        }
+        out << std::setw(8) << s.allocations << '\n';
+    }
+    out.flags(flags);
+}
+
+static void write_json_string(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void Profiler::write_trace(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", "
+        << "\"otherData\": {\"dropped_events\": " << dropped_events_ << "},\n\"traceEvents\": [";
+    for (size_t i = 0; i < events_.size(); ++i) {
+        const TraceEvent& e = events_[i];
+        out << (i ? ",\n" : "\n") << "{\"name\": ";
+        write_json_string(out, stats_[e.label].label);
+        out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+            << ", \"ts\": " << static_cast<double>(e.start_ns) * 1e-3
+            << ", \"dur\": " << static_cast<double>(e.duration_ns) * 1e-3
+            << ", \"args\": {\"flops\": " << e.flops << ", \"bytes\": " << e.bytes
+            << ", \"allocations\": " << e.allocations << "}}";
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+}
+
+void Profiler::write_trace(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Failed to open file for writing: " + path);
+    }
+    write_trace(out);
+    if (!out) {
+        throw std::runtime_error("Failed to write trace: " + path);
+    }
+}
+
+void ProfileScope::begin(const std::string& label) {
+    label_ = &label;
+    parent_ = current_scope;
+    current_scope = this;
+    allocations_ = TensorStorage::heap_allocations();
+    start_ns_ = Profiler::global().now_ns();
+}
+
+void ProfileScope::end() {
+    Profiler& profiler = Profiler::global();
+    int64_t end_ns = profiler.now_ns();
+    current_scope = parent_;
+    profiler.record(*label_, start_ns_, end_ns, flops_, bytes_,
+                    TensorStorage::heap_allocations() - allocations_);
+}
+
+void ProfileScope::add_work(double flops, double bytes) {
+    if (ProfileScope* scope = current_scope) {
+        scope->flops_ += flops;
+        scope->bytes_ += bytes;
+    }
+}
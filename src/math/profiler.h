@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Opt-in hot-path instrumentation.
+//
+// Code marks a region with AE_PROFILE_SCOPE(label) and reports the work done inside
+// it with AE_PROFILE_WORK(flops, bytes), which is credited to the innermost open
+// scope of the calling thread. While the profiler is enabled, each label
+// accumulates calls, wall time, FLOPs, bytes and tensor storage heap allocations
+// (see TensorStorage::heap_allocations). With tracing on, every call is also kept
+// as an event for Chrome's trace viewer (chrome://tracing or ui.perfetto.dev).
+//
+// While the profiler is disabled a scope costs a relaxed load and a branch. The
+// macros compile to nothing unless AE_PROFILE is defined (CMake option AE_PROFILE).
+//
+// Labels are taken by reference and must outlive the scope, so callers keep them in
+// long-lived strings rather than building them per call.
+
+struct ProfileStat {
+    std::string label;
+    uint64_t calls = 0;
+    double seconds = 0.0;  // inclusive of nested scopes
+    double flops = 0.0;
+    double bytes = 0.0;
+    uint64_t allocations = 0;
+};
+
+class Profiler {
+public:
+    static Profiler& global();
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Start collecting; with trace, also record every call (up to MAX_TRACE_EVENTS)
+    void enable(bool trace = false);
+    void disable();
+
+    // Totals per label since the last reset, for labels used since then
+    std::vector<ProfileStat> stats() const;
+    // Clear the totals; recorded trace events are kept
+    void reset();
+
+    // Totals as a table, with each label's share of `wall_seconds`
+    void write_summary(std::ostream& out, double wall_seconds) const;
+    // Recorded calls as Chrome trace-event JSON
+    void write_trace(std::ostream& out) const;
+    void write_trace(const std::string& path) const;
+
+    static constexpr size_t MAX_TRACE_EVENTS = size_t(1) << 20;
+
+    // Called by ProfileScope
+    void record(const std::string& label, int64_t start_ns, int64_t end_ns, double flops,
+                double bytes, uint64_t allocations);
+    int64_t now_ns() const;
+
+private:
+    Profiler();
+
+    struct TraceEvent {
+        uint32_t label;
+        uint32_t thread;
+        int64_t start_ns;
+        int64_t duration_ns;
+        double flops;
+        double bytes;
+        uint64_t allocations;
+    };
+
+    static std::atomic<bool> enabled_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, uint32_t> index_;  // label -> position in stats_
+    std::vector<ProfileStat> stats_;
+    bool trace_ = false;
+    std::vector<TraceEvent> events_;
+    size_t dropped_events_ = 0;
+    int64_t origin_ns_ = 0;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const std::string& label) {
+        if (Profiler::enabled()) {
+            begin(label);
+        }
+    }
+    ~ProfileScope() {
+        if (label_) {
+            end();
+        }
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    // Credit work to the innermost open scope of the calling thread, if any
+    static void add_work(double flops, double bytes);
+
+private:
+    void begin(const std::string& label);
+    void end();
+
+    const std::string* label_ = nullptr;
+    ProfileScope* parent_ = nullptr;
+    int64_t start_ns_ = 0;
+    uint64_t allocations_ = 0;
+    double flops_ = 0.0;
+    double bytes_ = 0.0;
+};
+
+#ifdef AE_PROFILE
+#define AE_PROFILE_CONCAT_(a, b) a##b
+#define AE_PROFILE_CONCAT(a, b) AE_PROFILE_CONCAT_(a, b)
+#define AE_PROFILE_SCOPE(label) ProfileScope AE_PROFILE_CONCAT(profile_scope_, __LINE__)(label)
+#define AE_PROFILE_WORK(flops, bytes) ProfileScope::add_work(flops, bytes)
+#else
+#define AE_PROFILE_SCOPE(label) ((void)0)
+#define AE_PROFILE_WORK(flops, bytes) ((void)0)
+#endif
@@ -0,0 +1,242 @@
+#include "math/storage.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+static size_t round_up(size_t bytes) {
+    return (bytes + TensorStorage::ALIGNMENT - 1) & ~(TensorStorage::ALIGNMENT - 1);
+}
+
+static std::atomic<uint64_t> heap_blocks{0};
+
+static void* aligned_new(size_t bytes) {
+    heap_blocks.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(bytes, std::align_val_t(TensorStorage::ALIGNMENT));
+}
+
+static void aligned_delete(void* p) {
+    ::operator delete(p, std::align_val_t(TensorStorage::ALIGNMENT));
+}
+
+// ---- TensorStorage ----
+
+static thread_local TensorStorage* scoped_storage = nullptr;
+
+static TensorStorage& default_storage() {
+    static TensorStorage* storage = [] () -> TensorStorage* {
+        const char* env = std::getenv("AE_TENSOR_STORAGE");
+        if (env && std::strcmp(env, "heap") == 0) {
+            return &HeapStorage::global();
+        }
+        return &PoolStorage::global();
+    }();
+    return *storage;
+}
+
+TensorStorage& TensorStorage::current() {
+    return scoped_storage ? *scoped_storage : default_storage();
+}
+
+TensorStorage::Scope::Scope(TensorStorage& storage) : previous_(scoped_storage) {
+    scoped_storage = &storage;
+}
+
+TensorStorage::Scope::~Scope() {
+    scoped_storage = previous_;
+}
+
+// Block layout: [owner pointer, padded to ALIGNMENT][elements...]
+void* TensorStorage::allocate_block(size_t bytes) {
+    TensorStorage& owner = current();
+    char* base = static_cast<char*>(owner.allocate(ALIGNMENT + round_up(bytes)));
+    *reinterpret_cast<TensorStorage**>(base) = &owner;
+    return base + ALIGNMENT;
+}
+
+void TensorStorage::deallocate_block(void* p, size_t bytes) {
+    char* base = static_cast<char*>(p) - ALIGNMENT;
+    TensorStorage* owner = *reinterpret_cast<TensorStorage**>(base);
+    owner->deallocate(base, ALIGNMENT + round_up(bytes));
+}
+
+uint64_t TensorStorage::heap_allocations() {
+    return heap_blocks.load(std::memory_order_relaxed);
+}
+
+// ---- HeapStorage ----
+
+void* HeapStorage::allocate(size_t bytes) {
+    return aligned_new(bytes);
+}
+
+void HeapStorage::deallocate(void* p, size_t) {
+    aligned_delete(p);
+}
+
+HeapStorage& HeapStorage::global() {
+    static HeapStorage storage;
+    return storage;
+}
+
+// ---- PoolStorage ----
+
+// Map a request to its size class: 64-byte steps up to 256 bytes, then four classes
+// per power of two. Returns the class index and stores the class size in `size`.
+static size_t size_class(size_t bytes, size_t& size) {
+    size_t n = bytes - 1;
+    if (n < 256) {
+        size = (n / 64 + 1) * 64;
+        return n / 64;
+    }
+    size_t k = 0;
+    while ((n >> k) > 1) {
+        ++k;
+    }
+    size_t step_shift = k - 2;
+    size_t sub = n >> step_shift;  // 4..7
+    size = (sub + 1) << step_shift;
+    return 4 + (k - 8) * 4 + (sub - 4);
+}
+
+PoolStorage::~PoolStorage() {
+    trim();
+}
+
+void* PoolStorage::allocate(size_t bytes) {
+    size_t size;
+    size_t cls = size_class(bytes, size);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (FreeBlock* block = free_[cls]) {
+            free_[cls] = block->next;
+            cached_bytes_ -= size;
+            return block;
+        }
+    }
+    return aligned_new(size);
+}
+
+void PoolStorage::deallocate(void* p, size_t bytes) {
+    size_t size;
+    size_t cls = size_class(bytes, size);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* block = static_cast<FreeBlock*>(p);
+    block->next = free_[cls];
+    free_[cls] = block;
+    cached_bytes_ += size;
+}
+
+void PoolStorage::trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& head : free_) {
+        while (FreeBlock* block = head) {
+            head = block->next;
+            aligned_delete(block);
+        }
+    }
+    cached_bytes_ = 0;
+}
+
+size_t PoolStorage::cached_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cached_bytes_;
+}
+
+PoolStorage& PoolStorage::global() {
+    // Leaked so tensors in other static objects can still be freed at exit
+    static PoolStorage* storage = new PoolStorage();
+    return *storage;
+}
+
+// ---- TensorBuffer ----
+
+TensorBuffer::TensorBuffer(size_t n) {
+    resize(n);
+}
+
+TensorBuffer::TensorBuffer(size_t n, float value) {
+    resize(n);
+    std::fill(data_, data_ + n, value);
+}
+
+TensorBuffer::TensorBuffer(const TensorBuffer& other) {
+    assign(other.begin(), other.end());
+}
+
+TensorBuffer::TensorBuffer(TensorBuffer&& other) noexcept
+    : data_(other.data_), size_(other.size_), capacity_(other.capacity_),
+      owner_(std::move(other.owner_)) {
+    other.data_ = nullptr;
+    other.size_ = other.capacity_ = 0;
+}
+
+TensorBuffer& TensorBuffer::operator=(const TensorBuffer& other) {
+    if (this != &other) {
+        assign(other.begin(), other.end());
+    }
+    return *this;
+}
+
+TensorBuffer& TensorBuffer::operator=(TensorBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        data_ = other.data_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        owner_ = std::move(other.owner_);
+        other.data_ = nullptr;
+        other.size_ = other.capacity_ = 0;
+    }
+    return *this;
+}
+
+TensorBuffer::~TensorBuffer() {
+    release();
+}
+
+TensorBuffer TensorBuffer::borrow(float* p, size_t n, std::shared_ptr<const void> owner) {
+    assert(owner && reinterpret_cast<uintptr_t>(p) % TensorStorage::ALIGNMENT == 0);
+    TensorBuffer buf;
+    buf.data_ = p;
+    buf.size_ = n;
+    buf.owner_ = std::move(owner);
+    return buf;
+}
+
+void TensorBuffer::release() {
+    if (capacity_) {
+        TensorStorage::deallocate_block(data_, capacity_ * sizeof(float));
+    }
+    data_ = nullptr;
+    size_ = capacity_ = 0;
+    owner_.reset();
+}
+
+void TensorBuffer::resize(size_t n) {
+    if (borrowed() ? n == size_ : n <= capacity_) {
+        size_ = n;
+        return;
+    }
+    float* p = static_cast<float*>(TensorStorage::allocate_block(n * sizeof(float)));
+    std::copy(data_, data_ + std::min(size_, n), p);
+    release();
+    data_ = p;
+    size_ = capacity_ = n;
+}
+
+void TensorBuffer::assign(const float* first, const float* last) {
+    size_t n = static_cast<size_t>(last - first);
+    if (borrowed() || n > capacity_) {
+        // Drop the old contents first so growing does not copy them
+        release();
+    }
+    resize(n);
+    std::copy(first, last, data_);
+}
+
+bool TensorBuffer::operator==(const TensorBuffer& other) const {
+    return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+// Pluggable backends for Tensor storage.
+//
+// Every block handed to a Tensor is 64-byte aligned (one cache line, one AVX-512
+// register) and preceded by a 64-byte header recording the backend that owns it, so
+// a block is always returned to its owner no matter which backend is current when
+// the tensor is destroyed. The current backend is selected per thread with
+// TensorStorage::Scope; by default it is the process-wide PoolStorage.
+class TensorStorage {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    virtual ~TensorStorage() = default;
+
+    // Raw allocation of `bytes` (a multiple of ALIGNMENT), returning an
+    // ALIGNMENT-aligned block. deallocate receives the same size back.
+    virtual void* allocate(size_t bytes) = 0;
+    virtual void deallocate(void* p, size_t bytes) = 0;
+
+    // Backend used for new tensors on the calling thread. Defaults to
+    // PoolStorage::global(), or to HeapStorage::global() if the AE_TENSOR_STORAGE
+    // environment variable is set to "heap" (e.g. for sanitizer runs).
+    static TensorStorage& current();
+
+    // Makes `storage` the current backend of the calling thread for the lifetime of
+    // the scope. Scopes nest.
+    class Scope {
+    public:
+        explicit Scope(TensorStorage& storage);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        TensorStorage* previous_;
+    };
+
+    // Element storage for a tensor of `bytes` bytes, from the current backend
+    static void* allocate_block(size_t bytes);
+    static void deallocate_block(void* p, size_t bytes);
+
+    // Blocks any backend has taken from the heap so far, process-wide (cache hits of
+    // PoolStorage are not counted). Used by the profiler.
+    static uint64_t heap_allocations();
+};
+
+// Plain aligned operator new/delete, no caching
+class HeapStorage : public TensorStorage {
+public:
+    void* allocate(size_t bytes) override;
+    void deallocate(void* p, size_t bytes) override;
+
+    static HeapStorage& global();
+};
+
+// Size-class pool for long-lived tensors and value-API temporaries. Freed blocks are
+// kept on a per-class free list and handed out again to the next request of the same
+// class, so a loop that creates and drops same-shaped tensors stops allocating after
+// its first iteration. Classes are 64-byte steps up to 256 bytes, then four per power
+// of two, so at most 25% of a block is wasted. Thread-safe.
+class PoolStorage : public TensorStorage {
+public:
+    PoolStorage() = default;
+    ~PoolStorage() override;
+    PoolStorage(const PoolStorage&) = delete;
+    PoolStorage& operator=(const PoolStorage&) = delete;
+
+    void* allocate(size_t bytes) override;
+    void deallocate(void* p, size_t bytes) override;
+
+    // Release all cached free blocks back to the heap
+    void trim();
+    // Bytes currently held on free lists
+    size_t cached_bytes() const;
+
+    static PoolStorage& global();
+
+private:
+    static constexpr size_t NUM_CLASSES = 4 + 4 * 56;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    mutable std::mutex mutex_;
+    FreeBlock* free_[NUM_CLASSES] = {};
+    size_t cached_bytes_ = 0;
+};
+
+// Element storage of a Tensor: a float array with std::vector-like value semantics,
+// allocated through TensorStorage. Growing leaves the new elements unset rather than
+// zero-filling memory that is about to be overwritten, and shrinking keeps the
+// allocation so a later resize back up is free.
+//
+// A buffer can instead borrow memory it does not own (see borrow), e.g. weights
+// memory-mapped from a model file. Borrowed buffers read and write the borrowed
+// memory in place and keep its owner alive; copying one yields an owning copy, and
+// resizing one to a different size detaches it into owned storage.
+class TensorBuffer {
+public:
+    TensorBuffer() = default;
+    explicit TensorBuffer(size_t n);  // elements left unset
+    TensorBuffer(size_t n, float value);
+    TensorBuffer(const TensorBuffer& other);
+    TensorBuffer(TensorBuffer&& other) noexcept;
+    TensorBuffer& operator=(const TensorBuffer& other);
+    TensorBuffer& operator=(TensorBuffer&& other) noexcept;
+    ~TensorBuffer();
+
+    // View of n floats at p (ALIGNMENT-aligned), kept valid by holding `owner`
+    static TensorBuffer borrow(float* p, size_t n, std::shared_ptr<const void> owner);
+
+    float* data() { return data_; }
+    const float* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool borrowed() const { return owner_ != nullptr; }
+
+    float& operator[](size_t i) { return data_[i]; }
+    const float& operator[](size_t i) const { return data_[i]; }
+    float* begin() { return data_; }
+    float* end() { return data_ + size_; }
+    const float* begin() const { return data_; }
+    const float* end() const { return data_ + size_; }
+
+    // Keeps the first min(size, n) elements; any new elements are unset
+    void resize(size_t n);
+    void assign(const float* first, const float* last);
+
+    bool operator==(const TensorBuffer& other) const;
+    bool operator!=(const TensorBuffer& other) const { return !(*this == other); }
+
+private:
+    void release();
+
+    float* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;                 // owned elements; 0 when borrowed
+    std::shared_ptr<const void> owner_;  // set when borrowed
+};
@@ -1,9 +1,25 @@
 #include "math/tensor.h"
+#include "math/gemm.h"
+#include "math/thread_pool.h"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <random>
 #include <stdexcept>
 
+// Run fn(begin, end) over chunks of [0, n) on the global thread pool
+template <class F>
+static void parallel_elementwise(size_t n, F&& fn) {
+    ThreadPool::global().parallel_for(n, ThreadPool::ELEMENTWISE_GRAIN, fn);
+}
+
+// Run fn(row_begin, row_end) over chunks of whole rows, sized like elementwise chunks
+template <class F>
+static void parallel_rows(size_t rows, size_t cols, F&& fn) {
+    size_t grain = cols == 0 ? rows : std::max<size_t>(1, ThreadPool::ELEMENTWISE_GRAIN / cols);
+    ThreadPool::global().parallel_for(rows, grain, fn);
+}
+
 Tensor::Tensor() : rows(0), cols(0) {}
 
 Tensor::Tensor(size_t rows, size_t cols)
@@ -13,8 +29,16 @@ Tensor::Tensor(size_t rows, size_t cols, float val)
     : data(rows * cols, val), rows(rows), cols(cols) {}
 
 Tensor Tensor::from_vector(const std::vector<float>& vec) {
-    Tensor t(1, vec.size());
-    t.data = vec;
+    Tensor t;
+    t.data.assign(vec.data(), vec.data() + vec.size());
+    t.rows = 1;
+    t.cols = vec.size();
+    return t;
+}
+
+Tensor Tensor::uninitialized(size_t rows, size_t cols) {
+    Tensor t;
+    t.resize(rows, cols);
     return t;
 }
 
@@ -38,60 +62,139 @@ size_t Tensor::size() const {
     return data.size();
 }
 
+void Tensor::resize(size_t new_rows, size_t new_cols) {
+    data.resize(new_rows * new_cols);
+    rows = new_rows;
+    cols = new_cols;
+}
+
 Tensor Tensor::matmul(const Tensor& A, const Tensor& B) {
+    Tensor C;
+    matmul_into(A, B, C);
+    return C;
+}
+
+Tensor Tensor::matmul_tn(const Tensor& A, const Tensor& B) {
+    Tensor C;
+    matmul_tn_into(A, B, C);
+    return C;
+}
+
+Tensor Tensor::matmul_nt(const Tensor& A, const Tensor& B) {
+    Tensor C;
+    matmul_nt_into(A, B, C);
+    return C;
+}
+
+void Tensor::matmul_into(const Tensor& A, const Tensor& B, Tensor& C) {
     if (A.cols != B.rows) {
         throw std::invalid_argument("matmul: incompatible shapes (" +
             std::to_string(A.rows) + "x" + std::to_string(A.cols) + ") * (" +
             std::to_string(B.rows) + "x" + std::to_string(B.cols) + ")");
     }
-    Tensor C(A.rows, B.cols);
-    // i,k,j loop order for cache locality
-    for (size_t i = 0; i < A.rows; ++i) {
-        for (size_t k = 0; k < A.cols; ++k) {
-            float a_ik = A.data[i * A.cols + k];
-            for (size_t j = 0; j < B.cols; ++j) {
-                C.data[i * B.cols + j] += a_ik * B.data[k * B.cols + j];
-            }
-        }
+    C.resize(A.rows, B.cols);
+    GemmArgs g;
+    g.M = A.rows; g.N = B.cols; g.K = A.cols;
+    g.A = A.data.data(); g.lda = A.cols;
+    g.B = B.data.data(); g.ldb = B.cols;
+    g.C = C.data.data(); g.ldc = C.cols;
+    gemm(g);
+}
+
+void Tensor::matmul_tn_into(const Tensor& A, const Tensor& B, Tensor& C) {
+    if (A.rows != B.rows) {
+        throw std::invalid_argument("matmul_tn: incompatible shapes (" +
+            std::to_string(A.rows) + "x" + std::to_string(A.cols) + ")^T * (" +
+            std::to_string(B.rows) + "x" + std::to_string(B.cols) + ")");
     }
-    return C;
+    C.resize(A.cols, B.cols);
+    GemmArgs g;
+    g.trans_a = true;
+    g.M = A.cols; g.N = B.cols; g.K = A.rows;
+    g.A = A.data.data(); g.lda = A.cols;
+    g.B = B.data.data(); g.ldb = B.cols;
+    g.C = C.data.data(); g.ldc = C.cols;
+    gemm(g);
+}
+
+void Tensor::matmul_nt_into(const Tensor& A, const Tensor& B, Tensor& C) {
+    if (A.cols != B.cols) {
+        throw std::invalid_argument("matmul_nt: incompatible shapes (" +
+            std::to_string(A.rows) + "x" + std::to_string(A.cols) + ") * (" +
+            std::to_string(B.rows) + "x" + std::to_string(B.cols) + ")^T");
+    }
+    C.resize(A.rows, B.rows);
+    GemmArgs g;
+    g.trans_b = true;
+    g.M = A.rows; g.N = B.rows; g.K = A.cols;
+    g.A = A.data.data(); g.lda = A.cols;
+    g.B = B.data.data(); g.ldb = B.cols;
+    g.C = C.data.data(); g.ldc = C.cols;
+    gemm(g);
+}
+
+void Tensor::linear_into(const Tensor& X, const Tensor& W, const Tensor& b,
+                         Activation activation, Tensor& Y) {
+    if (X.cols != W.rows || b.rows != 1 || b.cols != W.cols) {
+        throw std::invalid_argument("linear: incompatible shapes (" +
+            std::to_string(X.rows) + "x" + std::to_string(X.cols) + ") * (" +
+            std::to_string(W.rows) + "x" + std::to_string(W.cols) + ") + (" +
+            std::to_string(b.rows) + "x" + std::to_string(b.cols) + ")");
+    }
+    Y.resize(X.rows, W.cols);
+    GemmArgs g;
+    g.M = X.rows; g.N = W.cols; g.K = X.cols;
+    g.A = X.data.data(); g.lda = X.cols;
+    g.B = W.data.data(); g.ldb = W.cols;
+    g.C = Y.data.data(); g.ldc = Y.cols;
+    g.bias = b.data.data();
+    g.activation = activation;
+    gemm(g);
 }
 
 Tensor Tensor::transpose(const Tensor& A) {
-    Tensor T(A.cols, A.rows);
-    for (size_t i = 0; i < A.rows; ++i) {
-        for (size_t j = 0; j < A.cols; ++j) {
-            T.data[j * A.rows + i] = A.data[i * A.cols + j];
+    Tensor T = uninitialized(A.cols, A.rows);
+    parallel_rows(A.rows, A.cols, [&](size_t r0, size_t r1) {
+        for (size_t i = r0; i < r1; ++i) {
+            for (size_t j = 0; j < A.cols; ++j) {
+                T.data[j * A.rows + i] = A.data[i * A.cols + j];
+            }
         }
-    }
+    });
     return T;
 }
 
 Tensor Tensor::add(const Tensor& A, const Tensor& B) {
     // Support broadcast: if B is (1, cols) and A is (rows, cols)
     if (A.rows == B.rows && A.cols == B.cols) {
-        Tensor C(A.rows, A.cols);
-        for (size_t i = 0; i < A.size(); ++i) {
-            C.data[i] = A.data[i] + B.data[i];
-        }
+        Tensor C = uninitialized(A.rows, A.cols);
+        parallel_elementwise(A.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                C.data[i] = A.data[i] + B.data[i];
+            }
+        });
         return C;
     }
     if (B.rows == 1 && A.cols == B.cols) {
-        Tensor C(A.rows, A.cols);
-        for (size_t i = 0; i < A.rows; ++i) {
-            for (size_t j = 0; j < A.cols; ++j) {
-                C.data[i * A.cols + j] = A.data[i * A.cols + j] + B.data[j];
+        Tensor C = uninitialized(A.rows, A.cols);
+        parallel_rows(A.rows, A.cols, [&](size_t r0, size_t r1) {
+            for (size_t i = r0; i < r1; ++i) {
+                for (size_t j = 0; j < A.cols; ++j) {
+                    C.data[i * A.cols + j] = A.data[i * A.cols + j] + B.data[j];
+                }
             }
-        }
+        });
         return C;
     }
     if (A.rows == 1 && A.cols == B.cols) {
-        Tensor C(B.rows, B.cols);
-        for (size_t i = 0; i < B.rows; ++i) {
-            for (size_t j = 0; j < B.cols; ++j) {
-                C.data[i * B.cols + j] = A.data[j] + B.data[i * B.cols + j];
+        Tensor C = uninitialized(B.rows, B.cols);
+        parallel_rows(B.rows, B.cols, [&](size_t r0, size_t r1) {
+            for (size_t i = r0; i < r1; ++i) {
+                for (size_t j = 0; j < B.cols; ++j) {
+                    C.data[i * B.cols + j] = A.data[j] + B.data[i * B.cols + j];
+                }
             }
-        }
+        });
         return C;
     }
     throw std::invalid_argument("add: incompatible shapes");
@@ -101,10 +204,12 @@ Tensor Tensor::subtract(const Tensor& A, const Tensor& B) {
     if (A.rows != B.rows || A.cols != B.cols) {
         throw std::invalid_argument("subtract: shapes must match");
     }
-    Tensor C(A.rows, A.cols);
-    for (size_t i = 0; i < A.size(); ++i) {
-        C.data[i] = A.data[i] - B.data[i];
-    }
+    Tensor C = uninitialized(A.rows, A.cols);
+    parallel_elementwise(A.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            C.data[i] = A.data[i] - B.data[i];
+        }
+    });
     return C;
 }
 
@@ -112,26 +217,32 @@ Tensor Tensor::multiply(const Tensor& A, const Tensor& B) {
     if (A.rows != B.rows || A.cols != B.cols) {
         throw std::invalid_argument("multiply: shapes must match");
     }
-    Tensor C(A.rows, A.cols);
-    for (size_t i = 0; i < A.size(); ++i) {
-        C.data[i] = A.data[i] * B.data[i];
-    }
+    Tensor C = uninitialized(A.rows, A.cols);
+    parallel_elementwise(A.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            C.data[i] = A.data[i] * B.data[i];
+        }
+    });
     return C;
 }
 
 Tensor Tensor::scale(const Tensor& A, float scalar) {
-    Tensor C(A.rows, A.cols);
-    for (size_t i = 0; i < A.size(); ++i) {
-        C.data[i] = A.data[i] * scalar;
-    }
+    Tensor C = uninitialized(A.rows, A.cols);
+    parallel_elementwise(A.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            C.data[i] = A.data[i] * scalar;
+        }
+    });
     return C;
 }
 
 Tensor Tensor::sqrt_elem(const Tensor& A) {
-    Tensor C(A.rows, A.cols);
-    for (size_t i = 0; i < A.size(); ++i) {
-        C.data[i] = std::sqrt(A.data[i]);
-    }
+    Tensor C = uninitialized(A.rows, A.cols);
+    parallel_elementwise(A.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            C.data[i] = std::sqrt(A.data[i]);
+        }
+    });
     return C;
 }
 
@@ -139,43 +250,53 @@ Tensor Tensor::divide_elem(const Tensor& A, const Tensor& B) {
     if (A.rows != B.rows || A.cols != B.cols) {
         throw std::invalid_argument("divide_elem: shapes must match");
     }
-    Tensor C(A.rows, A.cols);
-    for (size_t i = 0; i < A.size(); ++i) {
-        C.data[i] = A.data[i] / B.data[i];
-    }
+    Tensor C = uninitialized(A.rows, A.cols);
+    parallel_elementwise(A.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            C.data[i] = A.data[i] / B.data[i];
+        }
+    });
     return C;
 }
 
 void Tensor::add_inplace(const Tensor& other) {
     if (rows == other.rows && cols == other.cols) {
-        for (size_t i = 0; i < size(); ++i) {
-            data[i] += other.data[i];
-        }
+        parallel_elementwise(size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                data[i] += other.data[i];
+            }
+        });
     } else if (other.rows == 1 && cols == other.cols) {
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                data[i * cols + j] += other.data[j];
+        parallel_rows(rows, cols, [&](size_t r0, size_t r1) {
+            for (size_t i = r0; i < r1; ++i) {
+                for (size_t j = 0; j < cols; ++j) {
+                    data[i * cols + j] += other.data[j];
+                }
             }
-        }
+        });
     } else {
         throw std::invalid_argument("add_inplace: incompatible shapes");
     }
 }
 
 void Tensor::scale_inplace(float scalar) {
-    for (size_t i = 0; i < size(); ++i) {
-        data[i] *= scalar;
-    }
+    parallel_elementwise(size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            data[i] *= scalar;
+        }
+    });
 }
 
 void Tensor::zero() {
-    std::fill(data.begin(), data.end(), 0.0f);
+    parallel_elementwise(size(), [&](size_t begin, size_t end) {
+        std::fill(data.begin() + begin, data.begin() + end, 0.0f);
+    });
 }
 
 Tensor Tensor::randn(size_t rows, size_t cols, float mean, float stddev) {
     static std::mt19937 gen(42);
     std::normal_distribution<float> dist(mean, stddev);
-    Tensor t(rows, cols);
+    Tensor t = uninitialized(rows, cols);
     for (size_t i = 0; i < t.size(); ++i) {
         t.data[i] = dist(gen);
     }
@@ -196,7 +317,7 @@ Tensor Tensor::load(std::ifstream& in) {
     size_t r, c;
     in.read(reinterpret_cast<char*>(&r), sizeof(r));
     in.read(reinterpret_cast<char*>(&c), sizeof(c));
-    Tensor t(r, c);
+    Tensor t = uninitialized(r, c);
     in.read(reinterpret_cast<char*>(t.data.data()), t.data.size() * sizeof(float));
     return t;
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "math/gemm.h"
+#include "math/storage.h"
 #include <vector>
 #include <cstddef>
 #include <fstream>
@@ -7,7 +9,7 @@
 
 class Tensor {
 public:
-    std::vector<float> data;
+    TensorBuffer data;  // 64-byte aligned, owned or borrowed (see TensorBuffer)
     size_t rows, cols;
 
     // Construction
@@ -15,6 +17,8 @@ public:
     Tensor(size_t rows, size_t cols);
     Tensor(size_t rows, size_t cols, float val);
     static Tensor from_vector(const std::vector<float>& data);
+    // Tensor whose elements are left unset, for results that are fully overwritten
+    static Tensor uninitialized(size_t rows, size_t cols);
 
     // Element access
     float& operator()(size_t r, size_t c);
@@ -23,8 +27,15 @@ public:
     const float& operator[](size_t i) const;
     size_t size() const;
 
+    // Reshape to (rows, cols), reusing the existing storage when it is large enough
+    // (so no allocation once a buffer has reached its steady-state size). Element
+    // values are unspecified afterwards.
+    void resize(size_t rows, size_t cols);
+
     // Math operations (return new Tensors)
     static Tensor matmul(const Tensor& A, const Tensor& B);
+    static Tensor matmul_tn(const Tensor& A, const Tensor& B);  // A^T * B, no copy of A^T
+    static Tensor matmul_nt(const Tensor& A, const Tensor& B);  // A * B^T, no copy of B^T
     static Tensor transpose(const Tensor& A);
     static Tensor add(const Tensor& A, const Tensor& B);
     static Tensor subtract(const Tensor& A, const Tensor& B);
@@ -33,6 +44,16 @@ public:
     static Tensor sqrt_elem(const Tensor& A);
     static Tensor divide_elem(const Tensor& A, const Tensor& B);
 
+    // Matrix products into an existing tensor (resized as needed, see resize).
+    // C must not alias A or B.
+    static void matmul_into(const Tensor& A, const Tensor& B, Tensor& C);
+    static void matmul_tn_into(const Tensor& A, const Tensor& B, Tensor& C);
+    static void matmul_nt_into(const Tensor& A, const Tensor& B, Tensor& C);
+    // Y = act(X * W + b) in a single GEMM, with b (1 x W.cols) and the activation
+    // applied in the kernel epilogue instead of separate passes over Y
+    static void linear_into(const Tensor& X, const Tensor& W, const Tensor& b,
+                            Activation activation, Tensor& Y);
+
     // In-place operations
     void add_inplace(const Tensor& other);
     void scale_inplace(float scalar);
@@ -0,0 +1,168 @@
+#include "math/thread_pool.h"
+#include <cstdlib>
+
+// Set on pool workers and on a caller while it executes chunks, so nested
+// parallel_for calls run inline instead of deadlocking on the pool
+static thread_local bool in_parallel_region = false;
+
+static uint64_t pack_range(uint64_t begin, uint64_t end) {
+    return (begin << 32) | end;
+}
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : num_participants_(num_threads == 0 ? 1 : num_threads) {
+    queues_.reset(new ChunkQueue[num_participants_]);
+    for (size_t i = 1; i < num_participants_; ++i) {
+        workers_.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& w : workers_) {
+        w.join();
+    }
+}
+
+size_t ThreadPool::num_threads() const {
+    return num_participants_;
+}
+
+static size_t default_thread_count() {
+    if (const char* env = std::getenv("AE_NUM_THREADS")) {
+        int n = std::atoi(env);
+        if (n > 0) {
+            return static_cast<size_t>(n);
+        }
+    }
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw == 0 ? 1 : hw;
+}
+
+static std::unique_ptr<ThreadPool>& global_pool() {
+    static std::unique_ptr<ThreadPool> pool(new ThreadPool(default_thread_count()));
+    return pool;
+}
+
+ThreadPool& ThreadPool::global() {
+    return *global_pool();
+}
+
+void ThreadPool::set_global_threads(size_t num_threads) {
+    auto& pool = global_pool();
+    if (pool->num_threads() != num_threads) {
+        pool.reset();
+        pool.reset(new ThreadPool(num_threads));
+    }
+}
+
+double* ThreadPool::reduction_buffer(size_t n) {
+    static thread_local std::vector<double> buffer;
+    if (buffer.size() < n) {
+        buffer.resize(n);
+    }
+    return buffer.data();
+}
+
+void ThreadPool::run(size_t num_chunks, void (*invoke)(void*, size_t), void* ctx) {
+    std::unique_lock<std::mutex> submit(submit_mutex_, std::try_to_lock);
+    if (num_chunks == 1 || workers_.empty() || in_parallel_region || !submit.owns_lock()) {
+        for (size_t c = 0; c < num_chunks; ++c) {
+            invoke(ctx, c);
+        }
+        return;
+    }
+
+    // Give each participant an equal contiguous run of chunks to start from
+    for (size_t p = 0; p < num_participants_; ++p) {
+        uint64_t begin = num_chunks * p / num_participants_;
+        uint64_t end = num_chunks * (p + 1) / num_participants_;
+        queues_[p].range.store(pack_range(begin, end), std::memory_order_relaxed);
+    }
+    busy_.store(workers_.size(), std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        invoke_ = invoke;
+        ctx_ = ctx;
+        ++generation_;
+    }
+    wake_cv_.notify_all();
+
+    in_parallel_region = true;
+    work(0);
+    in_parallel_region = false;
+
+    // Every chunk has been claimed; wait until the workers have finished theirs
+    // and stopped touching the queues before the next job can reuse them
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return busy_.load(std::memory_order_acquire) == 0; });
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    in_parallel_region = true;
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) {
+                return;
+            }
+            seen = generation_;
+        }
+        work(index);
+        if (busy_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_cv_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::work(size_t self) {
+    size_t chunk;
+    while (pop_front(self, chunk)) {
+        invoke_(ctx_, chunk);
+    }
+    for (size_t i = 1; i < num_participants_; ++i) {
+        size_t victim = (self + i) % num_participants_;
+        while (steal_back(victim, chunk)) {
+            invoke_(ctx_, chunk);
+        }
+    }
+}
+
+bool ThreadPool::pop_front(size_t queue, size_t& chunk) {
+    auto& range = queues_[queue].range;
+    uint64_t r = range.load(std::memory_order_acquire);
+    while (true) {
+        uint64_t begin = r >> 32, end = r & 0xffffffffu;
+        if (begin >= end) {
+            return false;
+        }
+        if (range.compare_exchange_weak(r, pack_range(begin + 1, end),
+                                        std::memory_order_acq_rel)) {
+            chunk = static_cast<size_t>(begin);
+            return true;
+        }
+    }
+}
+
+bool ThreadPool::steal_back(size_t queue, size_t& chunk) {
+    auto& range = queues_[queue].range;
+    uint64_t r = range.load(std::memory_order_acquire);
+    while (true) {
+        uint64_t begin = r >> 32, end = r & 0xffffffffu;
+        if (begin >= end) {
+            return false;
+        }
+        if (range.compare_exchange_weak(r, pack_range(begin, end - 1),
+                                        std::memory_order_acq_rel)) {
+            chunk = static_cast<size_t>(end - 1);
+            return true;
+        }
+    }
+}
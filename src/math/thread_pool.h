@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent work-stealing thread pool used by the tensor, layer and optimizer kernels.
+//
+// parallel_for splits [0, n) into fixed chunks of `grain` elements. Each participant
+// (the calling thread plus the workers) starts with a contiguous run of chunks and
+// steals from the back of other participants' runs once its own is exhausted. Chunk
+// boundaries depend only on n and grain, never on the thread count, so any kernel
+// that writes per-chunk results is deterministic. Dispatch does not allocate.
+class ThreadPool {
+public:
+    // Elements per chunk for simple elementwise loops; smaller tensors run inline
+    static constexpr size_t ELEMENTWISE_GRAIN = size_t(1) << 15;
+
+    // num_threads includes the calling thread, so 1 means no worker threads
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t num_threads() const;
+
+    // Process-wide pool. Sized by the AE_NUM_THREADS environment variable if set,
+    // otherwise by std::thread::hardware_concurrency().
+    static ThreadPool& global();
+    // Resize the global pool. Must not be called while kernels are running.
+    static void set_global_threads(size_t num_threads);
+
+    // Call fn(begin, end) for each chunk of [0, n) and wait for all of them.
+    // fn must not throw. Nested calls from inside a chunk run serially.
+    template <class F>
+    void parallel_for(size_t n, size_t grain, F&& fn) {
+        if (n == 0) {
+            return;
+        }
+        if (grain == 0) {
+            grain = 1;
+        }
+        struct Context {
+            std::remove_reference_t<F>* fn;
+            size_t n, grain;
+        } ctx{&fn, n, grain};
+        run((n + grain - 1) / grain, [](void* p, size_t chunk) {
+            auto* c = static_cast<Context*>(p);
+            size_t begin = chunk * c->grain;
+            size_t end = begin + c->grain < c->n ? begin + c->grain : c->n;
+            (*c->fn)(begin, end);
+        }, &ctx);
+    }
+
+    // Sum of fn(begin, end) over the chunks of [0, n), added in chunk order so the
+    // result is independent of scheduling.
+    template <class F>
+    double parallel_sum(size_t n, size_t grain, F&& fn) {
+        if (grain == 0) {
+            grain = 1;
+        }
+        size_t chunks = (n + grain - 1) / grain;
+        double* partials = reduction_buffer(chunks);
+        parallel_for(n, grain, [&](size_t begin, size_t end) {
+            partials[begin / grain] = fn(begin, end);
+        });
+        double total = 0.0;
+        for (size_t i = 0; i < chunks; ++i) {
+            total += partials[i];
+        }
+        return total;
+    }
+
+    // Type-erased entry point behind parallel_for
+    void run(size_t num_chunks, void (*invoke)(void*, size_t), void* ctx);
+
+private:
+    struct alignas(64) ChunkQueue {
+        // Remaining chunk range packed as (begin << 32) | end
+        std::atomic<uint64_t> range{0};
+    };
+
+    void worker_loop(size_t index);
+    void work(size_t self);
+    bool pop_front(size_t queue, size_t& chunk);
+    bool steal_back(size_t queue, size_t& chunk);
+    // Per-calling-thread scratch for parallel_sum partials (grows, never shrinks)
+    static double* reduction_buffer(size_t n);
+
+    std::vector<std::thread> workers_;
+    std::unique_ptr<ChunkQueue[]> queues_;
+    size_t num_participants_;
+
+    // Current job, published to workers under mutex_ by bumping generation_
+    void (*invoke_)(void*, size_t) = nullptr;
+    void* ctx_ = nullptr;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+    std::atomic<size_t> busy_{0};
+
+    std::mutex mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable done_cv_;
+    std::mutex submit_mutex_;
+};
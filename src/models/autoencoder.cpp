@@ -1,24 +1,87 @@
 #include "models/autoencoder.h"
 
-// Architecture:
-// Encoder: Input(12288) -> Dense(512) -> ReLU -> Dense(128) -> ReLU -> Dense(64) [latent]
-// Decoder: Latent(64) -> Dense(128) -> ReLU -> Dense(512) -> ReLU -> Dense(12288) -> Sigmoid
-
-Autoencoder::Autoencoder() {
-    // Encoder layers (He init for ReLU layers)
-    encoder_.add_layer(std::make_shared<DenseLayer>(12288, 512, InitMethod::He));
-    encoder_.add_layer(std::make_shared<ReLU>());
-    encoder_.add_layer(std::make_shared<DenseLayer>(512, 128, InitMethod::He));
-    encoder_.add_layer(std::make_shared<ReLU>());
-    encoder_.add_layer(std::make_shared<DenseLayer>(128, 64, InitMethod::He));
-
-    // Decoder layers (He init for ReLU layers, Xavier for Sigmoid output)
-    decoder_.add_layer(std::make_shared<DenseLayer>(64, 128, InitMethod::He));
-    decoder_.add_layer(std::make_shared<ReLU>());
-    decoder_.add_layer(std::make_shared<DenseLayer>(128, 512, InitMethod::He));
-    decoder_.add_layer(std::make_shared<ReLU>());
-    decoder_.add_layer(std::make_shared<DenseLayer>(512, 12288, InitMethod::Xavier));
-    decoder_.add_layer(std::make_shared<Sigmoid>());
+#include "nn/conv2d.h"
+#include "nn/pooling.h"
+#include "nn/relu.h"
+#include "nn/sigmoid.h"
+
+const char* precision_name(Precision precision) {
+    switch (precision) {
+        case Precision::BF16: return "bf16";
+        case Precision::Int8: return "int8";
+        default:              return "float32";
+    }
+}
+
+Precision precision_of(const std::string& architecture) {
+    if (architecture.find("QuantizedDense") != std::string::npos) {
+        return Precision::Int8;
+    }
+    if (architecture.find(",bf16)") != std::string::npos) {
+        return Precision::BF16;
+    }
+    return Precision::Float32;
+}
+
+Autoencoder::Autoencoder(const ModelSpec& spec) : Autoencoder(true, Precision::Float32, spec) {}
+
+Autoencoder Autoencoder::for_inference(Precision precision, const ModelSpec& spec) {
+    return Autoencoder(false, precision, spec);
+}
+
+// The layer a spec describes, followed by its activation as a separate layer
+static void add_layer(Network& network, const LayerSpec& spec, bool random_init) {
+    InitMethod init = random_init ? spec.init : InitMethod::Skip;
+    switch (spec.kind) {
+        case LayerSpec::Kind::Dense:
+            network.add_layer(std::make_shared<DenseLayer>(spec.in_features, spec.out_features, init));
+            break;
+        case LayerSpec::Kind::Conv2D:
+            network.add_layer(std::make_shared<Conv2DLayer>(spec.geometry, spec.filters, init));
+            break;
+        case LayerSpec::Kind::ConvTranspose2D:
+            network.add_layer(std::make_shared<ConvTranspose2DLayer>(spec.geometry, spec.filters, init));
+            break;
+        case LayerSpec::Kind::MaxPool2D:
+            network.add_layer(std::make_shared<MaxPool2D>(spec.geometry.channels, spec.geometry.height,
+                                                          spec.geometry.width, spec.factor,
+                                                          spec.geometry.layout));
+            break;
+        case LayerSpec::Kind::Upsample2D:
+            network.add_layer(std::make_shared<Upsample2D>(spec.geometry.channels, spec.geometry.height,
+                                                           spec.geometry.width, spec.factor,
+                                                           spec.geometry.layout));
+            break;
+    }
+    if (spec.activation == Activation::ReLU) {
+        network.add_layer(std::make_shared<ReLU>());
+    } else if (spec.activation == Activation::Sigmoid) {
+        network.add_layer(std::make_shared<Sigmoid>());
+    }
+}
+
+Autoencoder::Autoencoder(bool random_init, Precision precision, const ModelSpec& spec)
+    : input_size_(spec.input_size()), latent_size_(spec.latent_size()) {
+    encoder_.set_name("encoder");
+    decoder_.set_name("decoder");
+    for (const LayerSpec& layer : spec.encoder) {
+        add_layer(encoder_, layer, random_init);
+    }
+    for (const LayerSpec& layer : spec.decoder) {
+        add_layer(decoder_, layer, random_init);
+    }
+
+    // Run each activation in the epilogue of the preceding Dense or conv layer
+    encoder_.fuse_activations();
+    decoder_.fuse_activations();
+
+    if (precision == Precision::Int8) {
+        encoder_.quantize(false);
+        decoder_.quantize(false);
+    } else if (precision == Precision::BF16) {
+        encoder_.use_bf16_weights(false, false);
+        decoder_.use_bf16_weights(false, false);
+    }
 }
 
 Tensor Autoencoder::forward(const Tensor& input) {
@@ -30,6 +93,10 @@ Tensor Autoencoder::encode(const Tensor& input) {
     return encoder_.forward(input);
 }
 
+void Autoencoder::encode_into(const Tensor& input, Tensor& latent) {
+    encoder_.forward_into(input, latent);
+}
+
 Tensor Autoencoder::decode(const Tensor& latent) {
     return decoder_.forward(latent);
 }
@@ -39,6 +106,22 @@ Tensor Autoencoder::backward(const Tensor& grad_output) {
     return encoder_.backward(grad);
 }
 
+void Autoencoder::forward_into(const Tensor& input, Tensor& output) {
+    encoder_.forward_into(input, latent_);
+    decoder_.forward_into(latent_, output);
+}
+
+void Autoencoder::backward_into(const Tensor& grad_output, Tensor* grad_input) {
+    decoder_.backward_into(grad_output, &grad_latent_);
+    encoder_.backward_into(grad_latent_, grad_input);
+}
+
+void Autoencoder::set_gradient_hook(Network::GradientHook hook) {
+    size_t encoder_params = encoder_.parameters().size();
+    encoder_.set_gradient_hook(hook, 0);
+    decoder_.set_gradient_hook(std::move(hook), encoder_params);
+}
+
 std::vector<Parameter> Autoencoder::parameters() {
     auto enc_params = encoder_.parameters();
     auto dec_params = decoder_.parameters();
@@ -50,3 +133,17 @@ void Autoencoder::zero_gradients() {
     encoder_.zero_gradients();
     decoder_.zero_gradients();
 }
+
+void Autoencoder::quantize() {
+    encoder_.quantize();
+    decoder_.quantize();
+}
+
+void Autoencoder::use_bf16_weights(bool keep_master) {
+    encoder_.use_bf16_weights(keep_master);
+    decoder_.use_bf16_weights(keep_master);
+}
+
+std::string Autoencoder::architecture() const {
+    return "encoder: " + encoder_.describe() + "; decoder: " + decoder_.describe();
+}
@@ -1,14 +1,43 @@
 #pragma once
 
+#include "models/model_spec.h"
 #include "nn/network.h"
-#include "nn/dense.h"
-#include "nn/relu.h"
-#include "nn/sigmoid.h"
+#include <string>
 #include <vector>
 
+// Weight storage of an inference model (see Autoencoder::for_inference)
+enum class Precision { Float32, BF16, Int8 };
+
+const char* precision_name(Precision precision);
+
+// Weight storage of a model saved with the given architecture description
+// (see Autoencoder::architecture and ModelIO::architecture)
+Precision precision_of(const std::string& architecture);
+
 class Autoencoder {
 public:
-    Autoencoder();
+    // Latent size of the built-in models (ModelSpec::dense and ModelSpec::conv)
+    static constexpr size_t LATENT_SIZE = 64;
+
+    // Training model with randomly initialized weights
+    explicit Autoencoder(const ModelSpec& spec = ModelSpec::dense());
+
+    // Inference model: weights are allocated but not initialized and no gradient
+    // buffers are allocated, so construction costs nothing beyond the allocation.
+    // Load the weights (ModelIO::load) before use. BF16 and Int8 build the layers a
+    // model saved after use_bf16_weights(false) or quantize() loads into (only
+    // Dense layers change precision; convolutions stay float32).
+    static Autoencoder for_inference(Precision precision = Precision::Float32,
+                                     const ModelSpec& spec = ModelSpec::dense());
+
+    // Post-training int8 quantization of the current weights (see Network::quantize).
+    // The model becomes inference-only.
+    void quantize();
+
+    // bf16 weights in every Dense layer (see DenseLayer::use_bf16_weights). Call
+    // with keep_master before taking parameters() for the optimizer to train in
+    // mixed precision, or without it to convert an inference model.
+    void use_bf16_weights(bool keep_master);
 
     // Forward pass through full autoencoder (encode then decode)
     Tensor forward(const Tensor& input);
@@ -16,19 +45,48 @@ public:
     // Encode input to latent space
     Tensor encode(const Tensor& input);
 
+    // Encoder only, into a caller-owned (batch, latent_size()) tensor; the latent
+    // width comes from the model spec
+    void encode_into(const Tensor& input, Tensor& latent);
+
     // Decode latent vector to reconstruction
     Tensor decode(const Tensor& latent);
 
     // Backward pass through full autoencoder
     Tensor backward(const Tensor& grad_output);
 
+    // Allocation-free forward/backward for the training loop (see Network::forward_into).
+    // grad_input may be null, which skips the input gradient of the first layer.
+    void forward_into(const Tensor& input, Tensor& output);
+    void backward_into(const Tensor& grad_output, Tensor* grad_input);
+
+    // Report parameter gradients as backward passes finish them, as indices into
+    // parameters() (see Network::set_gradient_hook)
+    void set_gradient_hook(Network::GradientHook hook);
+
+    // Latent of the most recent forward_into batch
+    const Tensor& latent() const { return latent_; }
+
     // Get all trainable parameters (encoder + decoder)
     std::vector<Parameter> parameters();
 
     // Zero all gradients
     void zero_gradients();
 
+    // Layer-by-layer description, stored in model files (see ModelIO::save). It is
+    // a spec of the same layer stack (see ModelSpec::of_architecture).
+    std::string architecture() const;
+
+    size_t input_size() const { return input_size_; }
+    size_t latent_size() const { return latent_size_; }
+
 private:
+    Autoencoder(bool random_init, Precision precision, const ModelSpec& spec);
+
     Network encoder_;
     Network decoder_;
+    Tensor latent_;
+    Tensor grad_latent_;
+    size_t input_size_ = 0;
+    size_t latent_size_ = 0;
 };
@@ -0,0 +1,357 @@
+#include "models/model_spec.h"
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// Dense: 12288 -> 512 -> 128 -> 64 [latent] and the mirror back, He init for the
+// ReLU layers and Xavier for the Sigmoid output
+static const char* DENSE_SPEC =
+    "encoder: Dense(12288,512) ReLU Dense(512,128) ReLU Dense(128,64)\n"
+    "decoder: Dense(64,128) ReLU Dense(128,512) ReLU Dense(512,12288) Sigmoid\n";
+
+// Conv (NHWC, 3x3 stride-2 convolutions, 4x4 stride-2 transposed):
+// 64x64x3 -> 32x32x16 -> 16x16x32 -> 8x8x64 -> Dense(4096, 64) [latent], then
+// Dense(64, 4096) -> 16x16x32 -> 32x32x16 -> 64x64x3
+static const char* CONV_SPEC =
+    "encoder: Conv2D(3,16,64x64,k3s2p1,NHWC) ReLU Conv2D(16,32,32x32,k3s2p1,NHWC) ReLU"
+    " Conv2D(32,64,16x16,k3s2p1,NHWC) ReLU Dense(4096,64)\n"
+    "decoder: Dense(64,4096) ReLU ConvTranspose2D(64,32,8x8,k4s2p1,NHWC) ReLU"
+    " ConvTranspose2D(32,16,16x16,k4s2p1,NHWC) ReLU ConvTranspose2D(16,3,32x32,k4s2p1,NHWC)"
+    " Sigmoid\n";
+
+// Output image of a transposed convolution with input side g
+static size_t transposed_extent(size_t in, const ConvGeometry& g) {
+    return (in - 1) * g.stride + g.kernel - 2 * g.padding;
+}
+
+size_t LayerSpec::input_size() const {
+    return kind == Kind::Dense ? in_features : geometry.image_size();
+}
+
+size_t LayerSpec::output_size() const {
+    const ConvGeometry& g = geometry;
+    switch (kind) {
+        case Kind::Dense:           return out_features;
+        case Kind::Conv2D:          return filters * g.out_height() * g.out_width();
+        case Kind::ConvTranspose2D:
+            return filters * transposed_extent(g.height, g) * transposed_extent(g.width, g);
+        case Kind::MaxPool2D:       return g.image_size() / (factor * factor);
+        case Kind::Upsample2D:      return g.image_size() * factor * factor;
+    }
+    return 0;
+}
+
+size_t LayerSpec::multiply_adds() const {
+    const ConvGeometry& g = geometry;
+    switch (kind) {
+        case Kind::Dense:           return in_features * out_features;
+        case Kind::Conv2D:          return g.out_height() * g.out_width() * g.patch_size() * filters;
+        case Kind::ConvTranspose2D:
+            return g.height * g.width * g.channels * g.kernel * g.kernel * filters;
+        default:                    return 0;
+    }
+}
+
+std::string LayerSpec::describe() const {
+    const ConvGeometry& g = geometry;
+    std::string s;
+    switch (kind) {
+        case Kind::Dense:
+            s = "Dense(" + std::to_string(in_features) + "," + std::to_string(out_features) + ")";
+            break;
+        case Kind::Conv2D:
+        case Kind::ConvTranspose2D:
+            s = std::string(kind == Kind::Conv2D ? "Conv2D(" : "ConvTranspose2D(") +
+                std::to_string(g.channels) + "," + std::to_string(filters) + "," +
+                std::to_string(g.height) + "x" + std::to_string(g.width) + ",k" +
+                std::to_string(g.kernel) + "s" + std::to_string(g.stride) + "p" +
+                std::to_string(g.padding) + "," + layout_name(g.layout) + ")";
+            break;
+        case Kind::MaxPool2D:
+        case Kind::Upsample2D:
+            s = std::string(kind == Kind::MaxPool2D ? "MaxPool2D(" : "Upsample2D(") +
+                std::to_string(g.channels) + "," + std::to_string(g.height) + "x" +
+                std::to_string(g.width) + "," + std::to_string(factor) + "," +
+                layout_name(g.layout) + ")";
+            break;
+    }
+    if (activation == Activation::ReLU) {
+        s += " ReLU";
+    } else if (activation == Activation::Sigmoid) {
+        s += " Sigmoid";
+    }
+    return s;
+}
+
+namespace {
+
+[[noreturn]] void fail(const std::string& token, const std::string& why) {
+    throw std::runtime_error("Model spec: " + why + " in \"" + token + "\"");
+}
+
+// Whitespace- or ';'-separated tokens, keeping parenthesized arguments together
+// and dropping '#' comments
+std::vector<std::string> tokenize(const std::string& text) {
+    std::vector<std::string> tokens;
+    std::string token;
+    int depth = 0;
+    bool comment = false;
+    for (char c : text) {
+        if (comment) {
+            comment = c != '\n';
+            continue;
+        }
+        if (c == '#') {
+            comment = true;
+        } else if (c == '(') {
+            ++depth;
+        } else if (c == ')') {
+            --depth;
+        }
+        bool separator = c == '#' || ((std::isspace(static_cast<unsigned char>(c)) || c == ';') &&
+                                      depth == 0);
+        if (separator) {
+            if (!token.empty()) {
+                tokens.push_back(token);
+                token.clear();
+            }
+        } else if (!std::isspace(static_cast<unsigned char>(c))) {
+            token += c;
+        }
+    }
+    if (depth != 0) {
+        fail(token, "unbalanced parentheses");
+    }
+    if (!token.empty()) {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+std::vector<std::string> split(const std::string& s, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream ss(s);
+    std::string part;
+    while (std::getline(ss, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+size_t parse_size(const std::string& s, const std::string& token) {
+    if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos) {
+        fail(token, "expected a number, got \"" + s + "\"");
+    }
+    size_t n = std::stoul(s);
+    if (n == 0) {
+        fail(token, "sizes must be positive");
+    }
+    return n;
+}
+
+// "HxW"
+void parse_extent(const std::string& s, const std::string& token, ConvGeometry& g) {
+    size_t x = s.find('x');
+    if (x == std::string::npos) {
+        fail(token, "expected HxW, got \"" + s + "\"");
+    }
+    g.height = parse_size(s.substr(0, x), token);
+    g.width = parse_size(s.substr(x + 1), token);
+}
+
+// "kKsSpP"
+void parse_window(const std::string& s, const std::string& token, ConvGeometry& g) {
+    size_t sp = s.find('s'), pp = s.find('p');
+    if (s.empty() || s[0] != 'k' || sp == std::string::npos || pp == std::string::npos ||
+        pp < sp) {
+        fail(token, "expected kKsSpP, got \"" + s + "\"");
+    }
+    g.kernel = parse_size(s.substr(1, sp - 1), token);
+    g.stride = parse_size(s.substr(sp + 1, pp - sp - 1), token);
+    std::string padding = s.substr(pp + 1);
+    g.padding = padding == "0" ? 0 : parse_size(padding, token);
+}
+
+void parse_layout(const std::vector<std::string>& args, size_t i, const std::string& token,
+                  ConvGeometry& g) {
+    if (args.size() == i) {
+        return;
+    }
+    if (args.size() != i + 1 || (args[i] != "NHWC" && args[i] != "NCHW")) {
+        fail(token, "expected NHWC or NCHW as the last argument");
+    }
+    g.layout = args[i] == "NCHW" ? ImageLayout::NCHW : ImageLayout::NHWC;
+}
+
+LayerSpec parse_layer(const std::string& token) {
+    size_t open = token.find('(');
+    if (open == std::string::npos || token.back() != ')') {
+        fail(token, "unknown layer");
+    }
+    std::string name = token.substr(0, open);
+    std::vector<std::string> args = split(token.substr(open + 1, token.size() - open - 2), ',');
+    LayerSpec layer;
+    if (name == "Dense" || name == "QuantizedDense") {
+        bool bf16 = name == "Dense" && args.size() == 3 && args[2] == "bf16";
+        if (args.size() != (bf16 ? 3u : 2u)) {
+            fail(token, "expected Dense(in,out)");
+        }
+        layer.kind = LayerSpec::Kind::Dense;
+        layer.in_features = parse_size(args[0], token);
+        layer.out_features = parse_size(args[1], token);
+    } else if (name == "Conv2D" || name == "ConvTranspose2D") {
+        if (args.size() < 4) {
+            fail(token, "expected " + name + "(in,out,HxW,kKsSpP[,layout])");
+        }
+        layer.kind = name == "Conv2D" ? LayerSpec::Kind::Conv2D : LayerSpec::Kind::ConvTranspose2D;
+        layer.geometry.channels = parse_size(args[0], token);
+        layer.filters = parse_size(args[1], token);
+        parse_extent(args[2], token, layer.geometry);
+        parse_window(args[3], token, layer.geometry);
+        parse_layout(args, 4, token, layer.geometry);
+    } else if (name == "MaxPool2D" || name == "Upsample2D") {
+        if (args.size() < 3) {
+            fail(token, "expected " + name + "(channels,HxW,size[,layout])");
+        }
+        layer.kind = name == "MaxPool2D" ? LayerSpec::Kind::MaxPool2D : LayerSpec::Kind::Upsample2D;
+        layer.geometry.channels = parse_size(args[0], token);
+        parse_extent(args[1], token, layer.geometry);
+        layer.factor = parse_size(args[2], token);
+        layer.geometry.kernel = layer.factor;
+        layer.geometry.stride = layer.factor;
+        parse_layout(args, 3, token, layer.geometry);
+    } else {
+        fail(token, "unknown layer");
+    }
+    return layer;
+}
+
+// Geometry the built layer would reject, reported before anything is allocated
+void check_layer(const LayerSpec& layer, const std::string& token) {
+    if (layer.kind == LayerSpec::Kind::Dense) {
+        return;
+    }
+    const ConvGeometry& g = layer.geometry;
+    if (g.height + 2 * g.padding < g.kernel || g.width + 2 * g.padding < g.kernel) {
+        fail(token, "kernel larger than the padded image");
+    }
+    if (layer.kind == LayerSpec::Kind::ConvTranspose2D &&
+        ((g.height - 1) * g.stride + g.kernel <= 2 * g.padding ||
+         (g.width - 1) * g.stride + g.kernel <= 2 * g.padding)) {
+        fail(token, "padding leaves an empty output");
+    }
+    if (layer.kind == LayerSpec::Kind::MaxPool2D &&
+        (g.height % layer.factor != 0 || g.width % layer.factor != 0)) {
+        fail(token, "image size is not a multiple of the pool size");
+    }
+}
+
+}  // namespace
+
+ModelSpec ModelSpec::parse(const std::string& text) {
+    ModelSpec spec;
+    std::vector<LayerSpec>* section = nullptr;
+    std::vector<std::string> names;  // token of each layer, for messages
+    bool init_set = false;
+    for (const std::string& token : tokenize(text)) {
+        if (token == "encoder:" || token == "decoder:") {
+            section = token == "encoder:" ? &spec.encoder : &spec.decoder;
+            if (!section->empty()) {
+                fail(token, "section given twice");
+            }
+            continue;
+        }
+        if (!section) {
+            fail(token, "expected \"encoder:\" or \"decoder:\" first");
+        }
+        if (token == "ReLU" || token == "Sigmoid") {
+            if (section->empty() || section->back().activation != Activation::None) {
+                fail(token, "activation without a layer before it");
+            }
+            section->back().activation = token == "ReLU" ? Activation::ReLU : Activation::Sigmoid;
+            if (token == "Sigmoid" && !init_set) {
+                section->back().init = InitMethod::Xavier;
+            }
+        } else if (token == "init=he" || token == "init=xavier") {
+            if (section->empty()) {
+                fail(token, "init without a layer before it");
+            }
+            section->back().init = token == "init=he" ? InitMethod::He : InitMethod::Xavier;
+            init_set = true;
+        } else {
+            LayerSpec layer = parse_layer(token);
+            check_layer(layer, token);
+            section->push_back(layer);
+            names.push_back(token);
+            init_set = false;
+        }
+    }
+    if (spec.encoder.empty() || spec.decoder.empty()) {
+        throw std::runtime_error("Model spec: needs both an encoder: and a decoder: section");
+    }
+
+    // Every layer must accept the previous one's output, and the decoder must map the
+    // latent back to an input
+    std::vector<LayerSpec> stack = spec.encoder;
+    stack.insert(stack.end(), spec.decoder.begin(), spec.decoder.end());
+    for (size_t i = 1; i < stack.size(); ++i) {
+        if (stack[i].input_size() != stack[i - 1].output_size()) {
+            fail(names[i], "expects " + std::to_string(stack[i].input_size()) +
+                           " inputs but the previous layer gives " +
+                           std::to_string(stack[i - 1].output_size()));
+        }
+    }
+    if (stack.back().output_size() != spec.input_size()) {
+        fail(names.back(), "decoder outputs " + std::to_string(stack.back().output_size()) +
+                           " values for " + std::to_string(spec.input_size()) + " inputs");
+    }
+    return spec;
+}
+
+ModelSpec ModelSpec::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Failed to open model spec: " + path);
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+    return parse(text.str());
+}
+
+ModelSpec ModelSpec::dense() {
+    return parse(DENSE_SPEC);
+}
+
+ModelSpec ModelSpec::conv() {
+    return parse(CONV_SPEC);
+}
+
+ModelSpec ModelSpec::of_architecture(const std::string& architecture) {
+    return architecture.empty() ? dense() : parse(architecture);
+}
+
+size_t ModelSpec::multiply_adds() const {
+    size_t n = 0;
+    for (const LayerSpec& layer : encoder) {
+        n += layer.multiply_adds();
+    }
+    for (const LayerSpec& layer : decoder) {
+        n += layer.multiply_adds();
+    }
+    return n;
+}
+
+std::string ModelSpec::to_string() const {
+    auto join = [](const std::vector<LayerSpec>& layers) {
+        std::string s;
+        for (const LayerSpec& layer : layers) {
+            if (!s.empty()) {
+                s += ' ';
+            }
+            s += layer.describe();
+        }
+        return s;
+    };
+    return "encoder: " + join(encoder) + "; decoder: " + join(decoder);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "nn/dense.h"
+#include "nn/im2col.h"
+#include <string>
+#include <vector>
+
+// One layer of an autoencoder spec, plus the activation that follows it
+struct LayerSpec {
+    enum class Kind { Dense, Conv2D, ConvTranspose2D, MaxPool2D, Upsample2D };
+
+    Kind kind = Kind::Dense;
+    size_t in_features = 0;   // Dense
+    size_t out_features = 0;  // Dense
+    // Input side of Conv2D and ConvTranspose2D; the image of MaxPool2D and
+    // Upsample2D, with kernel and stride set to the pool size or factor
+    ConvGeometry geometry;
+    size_t filters = 0;       // Conv2D, ConvTranspose2D
+    size_t factor = 0;        // MaxPool2D size, Upsample2D factor
+    Activation activation = Activation::None;
+    // He unless the layer is followed by Sigmoid or the spec says otherwise
+    InitMethod init = InitMethod::He;
+
+    size_t input_size() const;
+    size_t output_size() const;
+    // Per image, for FLOP counts
+    size_t multiply_adds() const;
+    // Same text as the built layer's describe() (plus its activation)
+    std::string describe() const;
+};
+
+// Layer stack of an Autoencoder, written as text in the notation of the layer
+// descriptions that model files store (see Autoencoder::architecture):
+//
+//   # 12288 -> 256 -> 32 variant
+//   encoder: Dense(12288,256) ReLU Dense(256,32)
+//   decoder: Dense(32,256) ReLU Dense(256,12288) Sigmoid
+//
+// Layers are Dense(in,out), Conv2D(in,out,HxW,kKsSpP[,NHWC|NCHW]),
+// ConvTranspose2D(in,out,HxW,kKsSpP[,layout]), MaxPool2D(channels,HxW,size[,layout])
+// and Upsample2D(channels,HxW,factor[,layout]), where HxW is the input image and the
+// layout defaults to NHWC. ReLU or Sigmoid after a layer is its activation, and
+// init=he or init=xavier overrides its weight init. Tokens are separated by
+// whitespace (or the ';' that stored descriptions use) and '#' starts a comment.
+// QuantizedDense(in,out) and Dense(in,out,bf16), as saved by int8 and bf16 models,
+// read as Dense(in,out); precision_of tells those models apart.
+//
+// Parsing checks that each layer's output size is the next one's input size and
+// that the decoder maps the latent back to the encoder's input size; any problem
+// throws std::runtime_error.
+struct ModelSpec {
+    std::vector<LayerSpec> encoder;
+    std::vector<LayerSpec> decoder;
+
+    static ModelSpec parse(const std::string& text);
+    static ModelSpec load(const std::string& path);
+
+    // Built-in models: the fully connected 12288-512-128-64 autoencoder and the
+    // strided-convolution one (see model_spec.cpp)
+    static ModelSpec dense();
+    static ModelSpec conv();
+
+    // Layer stack of a model file's stored description; dense() for files saved
+    // without one
+    static ModelSpec of_architecture(const std::string& architecture);
+
+    size_t input_size() const { return encoder.front().input_size(); }
+    size_t latent_size() const { return encoder.back().output_size(); }
+    size_t multiply_adds() const;
+
+    // Canonical text, equal to Autoencoder::architecture() of a float32 model built
+    // from this spec. Init overrides are not part of it.
+    std::string to_string() const;
+};
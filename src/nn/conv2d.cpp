@@ -0,0 +1,309 @@
+#include "nn/conv2d.h"
+#include "math/profiler.h"
+#include <cmath>
+#include <stdexcept>
+
+// He or Xavier weights for `fan_in` inputs per output and `fan_out` outputs per input
+static void init_weights(Tensor& W, Tensor& b, Tensor& dW, Tensor& db, size_t rows, size_t cols,
+                         size_t biases, InitMethod init, float fan_in, float fan_out) {
+    if (init == InitMethod::Skip) {
+        W = Tensor::uninitialized(rows, cols);
+        b = Tensor::uninitialized(1, biases);
+        return;
+    }
+    float stddev = init == InitMethod::He ? std::sqrt(2.0f / fan_in)
+                                          : std::sqrt(2.0f / (fan_in + fan_out));
+    W = Tensor::randn(rows, cols, 0.0f, stddev);
+    b = Tensor::zeros(1, biases);
+    dW = Tensor::zeros(rows, cols);
+    db = Tensor::zeros(1, biases);
+}
+
+static void check_input(const Tensor& input, size_t expected, const char* layer) {
+    if (input.cols != expected) {
+        throw std::invalid_argument(std::string(layer) + ": expected " + std::to_string(expected) +
+                                    " input values per image, got " + std::to_string(input.cols));
+    }
+}
+
+// "(in,out,HxW,kKsSpP,LAYOUT)" plus a fused activation, like DenseLayer::describe
+static std::string describe_conv(const char* name, const ConvGeometry& g, size_t filters,
+                                 Activation activation) {
+    std::string s = std::string(name) + "(" + std::to_string(g.channels) + "," +
+                    std::to_string(filters) + "," + std::to_string(g.height) + "x" +
+                    std::to_string(g.width) + ",k" + std::to_string(g.kernel) + "s" +
+                    std::to_string(g.stride) + "p" + std::to_string(g.padding) + "," +
+                    layout_name(g.layout) + ")";
+    if (activation == Activation::ReLU) {
+        s += " ReLU";
+    } else if (activation == Activation::Sigmoid) {
+        s += " Sigmoid";
+    }
+    return s;
+}
+
+Conv2DLayer::Conv2DLayer(const ConvGeometry& geometry, size_t filters, InitMethod init,
+                         Activation activation)
+    : g_(geometry), filters_(filters), activation_(activation) {
+    g_.validate("Conv2D");
+    if (filters == 0) {
+        throw std::invalid_argument("Conv2D: filters must be positive");
+    }
+    direct_ = g_.kernel == 1 && g_.stride == 1 && g_.padding == 0 &&
+              g_.layout == ImageLayout::NHWC;
+    init_weights(W_, b_, dW_, db_, g_.patch_size(), filters, filters, init,
+                 static_cast<float>(g_.patch_size()),
+                 static_cast<float>(g_.kernel * g_.kernel * filters));
+}
+
+Tensor Conv2DLayer::forward(const Tensor& input) {
+    if (activation_ == Activation::None) {
+        return Layer::forward(input);
+    }
+    // The activation derivative needs the output, so keep a copy of it as well
+    input_copy_ = input;
+    forward_into(input_copy_, output_cache_);
+    return output_cache_;
+}
+
+void Conv2DLayer::forward_into(const Tensor& input, Tensor& output) {
+    check_input(input, g_.image_size(), "Conv2D");
+    input_ = &input;
+    output_ = &output;
+    size_t batch = input.rows;
+    size_t pixels = g_.out_height() * g_.out_width();
+    size_t rows = batch * pixels;
+    AE_PROFILE_WORK(2.0 * static_cast<double>(rows * g_.patch_size() * filters_),
+                    4.0 * static_cast<double>(input.size() + g_.patch_size() * filters_ +
+                                              rows * (filters_ + (direct_ ? 0 : 2 * g_.patch_size()))));
+
+    const float* patches = input.data.data();
+    if (!direct_) {
+        cols_.resize(rows, g_.patch_size());
+        im2col(g_, input.data.data(), batch, cols_.data.data());
+        patches = cols_.data.data();
+    }
+    output.resize(batch, output_size());
+    float* out = output.data.data();
+    if (g_.layout == ImageLayout::NCHW) {
+        rows_.resize(rows, filters_);
+        out = rows_.data.data();
+    }
+
+    // (pixels x patch) * (patch x filters), then bias and activation per tile
+    GemmArgs g;
+    g.M = rows; g.N = filters_; g.K = g_.patch_size();
+    g.A = patches; g.lda = g_.patch_size();
+    g.B = W_.data.data(); g.ldb = filters_;
+    g.C = out; g.ldc = filters_;
+    g.bias = b_.data.data();
+    g.activation = activation_;
+    gemm(g);
+
+    if (g_.layout == ImageLayout::NCHW) {
+        rows_to_nchw(rows_.data.data(), batch, filters_, pixels, output.data.data());
+    }
+}
+
+void Conv2DLayer::backward_into(const Tensor& grad_output, Tensor* grad_input) {
+    size_t batch = grad_output.rows;
+    size_t pixels = g_.out_height() * g_.out_width();
+    size_t rows = batch * pixels;
+    AE_PROFILE_WORK(
+        (grad_input ? 4.0 : 2.0) * static_cast<double>(rows * g_.patch_size() * filters_),
+        4.0 * static_cast<double>(2 * rows * filters_ + 2 * g_.patch_size() * filters_ +
+                                  rows * g_.patch_size() * (grad_input ? 3 : 1)));
+
+    // delta = grad_output * act'(y), as (pixels x filters) rows
+    const float* delta = grad_output.data.data();
+    const float* y = output_->data.data();
+    if (g_.layout == ImageLayout::NCHW) {
+        delta_.resize(rows, filters_);
+        nchw_to_rows(grad_output.data.data(), batch, filters_, pixels, delta_.data.data());
+        delta = delta_.data.data();
+        y = rows_.data.data();
+    }
+    if (activation_ != Activation::None) {
+        delta_.resize(rows, filters_);
+        activation_gradient(delta, y, rows * filters_, activation_, delta_.data.data());
+        delta = delta_.data.data();
+    }
+    db_.resize(1, filters_);
+    channel_sums(delta, rows, filters_, 1, ImageLayout::NHWC, db_.data.data());
+
+    // dW = patches^T * delta
+    dW_.resize(g_.patch_size(), filters_);
+    GemmArgs g;
+    g.trans_a = true;
+    g.M = g_.patch_size(); g.N = filters_; g.K = rows;
+    g.A = direct_ ? input_->data.data() : cols_.data.data(); g.lda = g_.patch_size();
+    g.B = delta; g.ldb = filters_;
+    g.C = dW_.data.data(); g.ldc = filters_;
+    gemm(g);
+
+    if (!grad_input) {
+        return;
+    }
+    // d(patches) = delta * W^T, summed back onto the input pixels
+    grad_input->resize(batch, g_.image_size());
+    GemmArgs d;
+    d.trans_b = true;
+    d.M = rows; d.N = g_.patch_size(); d.K = filters_;
+    d.A = delta; d.lda = filters_;
+    d.B = W_.data.data(); d.ldb = filters_;
+    d.C = direct_ ? grad_input->data.data() : cols_.data.data(); d.ldc = g_.patch_size();
+    gemm(d);
+    if (!direct_) {
+        col2im(g_, cols_.data.data(), batch, grad_input->data.data());
+    }
+}
+
+std::string Conv2DLayer::describe() const {
+    return describe_conv("Conv2D", g_, filters_, activation_);
+}
+
+std::vector<Parameter> Conv2DLayer::parameters() {
+    return {{&W_, &dW_}, {&b_, &db_}};
+}
+
+void Conv2DLayer::zero_gradients() {
+    dW_.zero();
+    db_.zero();
+}
+
+// The output side is the convolution whose input gradient this layer computes:
+// `filters` channels at the upsampled size, read through the same window
+static ConvGeometry transposed_output(const ConvGeometry& g, size_t filters) {
+    g.validate("ConvTranspose2D");
+    if ((g.height - 1) * g.stride + g.kernel <= 2 * g.padding ||
+        (g.width - 1) * g.stride + g.kernel <= 2 * g.padding) {
+        throw std::invalid_argument("ConvTranspose2D: padding leaves an empty output");
+    }
+    ConvGeometry out = g;
+    out.channels = filters;
+    out.height = (g.height - 1) * g.stride + g.kernel - 2 * g.padding;
+    out.width = (g.width - 1) * g.stride + g.kernel - 2 * g.padding;
+    return out;
+}
+
+ConvTranspose2DLayer::ConvTranspose2DLayer(const ConvGeometry& geometry, size_t filters,
+                                           InitMethod init, Activation activation)
+    : g_(geometry), out_(transposed_output(geometry, filters)), filters_(filters),
+      activation_(activation) {
+    if (filters == 0) {
+        throw std::invalid_argument("ConvTranspose2D: filters must be positive");
+    }
+    // Each output value sums about channels * kernel^2 / stride^2 products
+    float taps = static_cast<float>(g_.kernel * g_.kernel) / static_cast<float>(g_.stride * g_.stride);
+    init_weights(W_, b_, dW_, db_, g_.channels, out_.patch_size(), filters, init,
+                 static_cast<float>(g_.channels) * taps, static_cast<float>(filters) * taps);
+}
+
+Tensor ConvTranspose2DLayer::forward(const Tensor& input) {
+    if (activation_ == Activation::None) {
+        return Layer::forward(input);
+    }
+    input_copy_ = input;
+    forward_into(input_copy_, output_cache_);
+    return output_cache_;
+}
+
+void ConvTranspose2DLayer::forward_into(const Tensor& input, Tensor& output) {
+    check_input(input, g_.image_size(), "ConvTranspose2D");
+    input_ = &input;
+    output_ = &output;
+    size_t batch = input.rows;
+    size_t rows = batch * g_.height * g_.width;
+    AE_PROFILE_WORK(2.0 * static_cast<double>(rows * g_.channels * out_.patch_size()),
+                    4.0 * static_cast<double>(input.size() + g_.channels * out_.patch_size() +
+                                              2 * rows * out_.patch_size() +
+                                              batch * output_size()));
+
+    const float* pixels = input.data.data();
+    if (g_.layout == ImageLayout::NCHW) {
+        rows_.resize(rows, g_.channels);
+        nchw_to_rows(input.data.data(), batch, g_.channels, g_.height * g_.width,
+                     rows_.data.data());
+        pixels = rows_.data.data();
+    }
+
+    // Each input pixel's contribution to its output window
+    cols_.resize(rows, out_.patch_size());
+    GemmArgs g;
+    g.M = rows; g.N = out_.patch_size(); g.K = g_.channels;
+    g.A = pixels; g.lda = g_.channels;
+    g.B = W_.data.data(); g.ldb = out_.patch_size();
+    g.C = cols_.data.data(); g.ldc = out_.patch_size();
+    gemm(g);
+
+    output.resize(batch, output_size());
+    col2im(out_, cols_.data.data(), batch, output.data.data(), b_.data.data(), activation_);
+}
+
+void ConvTranspose2DLayer::backward_into(const Tensor& grad_output, Tensor* grad_input) {
+    size_t batch = grad_output.rows;
+    size_t rows = batch * g_.height * g_.width;
+    AE_PROFILE_WORK(
+        (grad_input ? 4.0 : 2.0) * static_cast<double>(rows * g_.channels * out_.patch_size()),
+        4.0 * static_cast<double>(3 * grad_output.size() + 2 * g_.channels * out_.patch_size() +
+                                  rows * (g_.channels + out_.patch_size() * (grad_input ? 3 : 2))));
+
+    const float* delta = grad_output.data.data();
+    if (activation_ != Activation::None) {
+        delta_.resize(grad_output.rows, grad_output.cols);
+        activation_gradient(delta, output_->data.data(), grad_output.size(), activation_,
+                            delta_.data.data());
+        delta = delta_.data.data();
+    }
+    db_.resize(1, filters_);
+    channel_sums(delta, batch, filters_, out_.height * out_.width, out_.layout, db_.data.data());
+
+    // Gradient of every input pixel's output window
+    cols_.resize(rows, out_.patch_size());
+    im2col(out_, delta, batch, cols_.data.data());
+
+    // dW = pixels^T * d(windows)
+    const float* pixels = g_.layout == ImageLayout::NCHW ? rows_.data.data() : input_->data.data();
+    dW_.resize(g_.channels, out_.patch_size());
+    GemmArgs g;
+    g.trans_a = true;
+    g.M = g_.channels; g.N = out_.patch_size(); g.K = rows;
+    g.A = pixels; g.lda = g_.channels;
+    g.B = cols_.data.data(); g.ldb = out_.patch_size();
+    g.C = dW_.data.data(); g.ldc = out_.patch_size();
+    gemm(g);
+
+    if (!grad_input) {
+        return;
+    }
+    // d(pixels) = d(windows) * W^T
+    grad_input->resize(batch, g_.image_size());
+    float* dx = grad_input->data.data();
+    if (g_.layout == ImageLayout::NCHW) {
+        dx = rows_.data.data();  // the input rows are no longer needed
+    }
+    GemmArgs d;
+    d.trans_b = true;
+    d.M = rows; d.N = g_.channels; d.K = out_.patch_size();
+    d.A = cols_.data.data(); d.lda = out_.patch_size();
+    d.B = W_.data.data(); d.ldb = out_.patch_size();
+    d.C = dx; d.ldc = g_.channels;
+    gemm(d);
+    if (g_.layout == ImageLayout::NCHW) {
+        rows_to_nchw(rows_.data.data(), batch, g_.channels, g_.height * g_.width,
+                     grad_input->data.data());
+    }
+}
+
+std::string ConvTranspose2DLayer::describe() const {
+    return describe_conv("ConvTranspose2D", g_, filters_, activation_);
+}
+
+std::vector<Parameter> ConvTranspose2DLayer::parameters() {
+    return {{&W_, &dW_}, {&b_, &db_}};
+}
+
+void ConvTranspose2DLayer::zero_gradients() {
+    dW_.zero();
+    db_.zero();
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "nn/dense.h"
+#include "nn/im2col.h"
+
+// 2-D convolution over a batch of images, one image per row of the input
+// (geometry.image_size() values in geometry.layout). The output rows hold
+// filters x out_height x out_width images in the same layout.
+//
+// The batch's patch matrix (see im2col) is multiplied with the
+// (patch_size x filters) weight matrix in one GEMM, whose rows are output pixels,
+// so bias and activation run in the GEMM epilogue as in DenseLayer. NHWC output
+// comes straight out of the GEMM; NCHW output is transposed from it. Backward
+// reuses the patch matrix for dW = patches^T * delta, then overwrites it with
+// delta * W^T and folds that back into the input gradient with col2im. A 1x1,
+// stride-1, unpadded NHWC convolution skips im2col: the input is its own patch
+// matrix.
+class Conv2DLayer : public Layer {
+public:
+    Conv2DLayer(const ConvGeometry& geometry, size_t filters, InitMethod init = InitMethod::He,
+                Activation activation = Activation::None);
+
+    Tensor forward(const Tensor& input) override;
+    void forward_into(const Tensor& input, Tensor& output) override;
+    void backward_into(const Tensor& grad_output, Tensor* grad_input) override;
+    std::vector<Parameter> parameters() override;
+    void zero_gradients() override;
+    std::string name() const override { return "Conv2D"; }
+    std::string describe() const override;
+
+    Activation activation() const { return activation_; }
+    void set_activation(Activation activation) { activation_ = activation; }
+
+    const ConvGeometry& geometry() const { return g_; }
+    size_t filters() const { return filters_; }
+    size_t output_size() const { return filters_ * g_.out_height() * g_.out_width(); }
+    // (patch_size x filters), rows ordered (kh, kw, c) like the patch matrix
+    const Tensor& weights() const { return W_; }
+    const Tensor& bias() const { return b_; }  // (1 x filters)
+
+private:
+    ConvGeometry g_;
+    size_t filters_;
+    bool direct_;  // the input is its own patch matrix
+    Tensor W_, b_;
+    Tensor dW_, db_;
+    Activation activation_;
+    const Tensor* input_ = nullptr;
+    const Tensor* output_ = nullptr;
+    Tensor output_cache_;  // output kept by the value API
+    Tensor cols_;          // patch matrix, then its gradient during backward
+    Tensor rows_;          // NCHW: output as pixel rows, before the layout change
+    Tensor delta_;         // gradient w.r.t. the pre-activation, as pixel rows
+};
+
+// Transposed 2-D convolution (the adjoint of Conv2DLayer's input gradient), which
+// upsamples: channels x height x width input images become filters x
+// out_height() x out_width() images with out_height = (height - 1) * stride -
+// 2 * padding + kernel.
+//
+// One GEMM of the input pixel rows with the (channels x patch_size) weights gives
+// every input pixel's contribution to its output window; col2im sums the
+// overlapping windows, adding bias and activation in the same pass. Backward
+// is a Conv2DLayer forward in reverse: im2col of the output gradient, then one GEMM
+// each for dW and the input gradient.
+class ConvTranspose2DLayer : public Layer {
+public:
+    // `geometry` describes the input images and the window; the kernel is applied
+    // to the output
+    ConvTranspose2DLayer(const ConvGeometry& geometry, size_t filters,
+                         InitMethod init = InitMethod::He,
+                         Activation activation = Activation::None);
+
+    Tensor forward(const Tensor& input) override;
+    void forward_into(const Tensor& input, Tensor& output) override;
+    void backward_into(const Tensor& grad_output, Tensor* grad_input) override;
+    std::vector<Parameter> parameters() override;
+    void zero_gradients() override;
+    std::string name() const override { return "ConvTranspose2D"; }
+    std::string describe() const override;
+
+    Activation activation() const { return activation_; }
+    void set_activation(Activation activation) { activation_ = activation; }
+
+    const ConvGeometry& geometry() const { return g_; }
+    size_t filters() const { return filters_; }
+    size_t out_height() const { return out_.height; }
+    size_t out_width() const { return out_.width; }
+    size_t output_size() const { return out_.image_size(); }
+    // (channels x patch_size), columns ordered (kh, kw, filter)
+    const Tensor& weights() const { return W_; }
+    const Tensor& bias() const { return b_; }  // (1 x filters)
+
+private:
+    ConvGeometry g_;    // input side
+    ConvGeometry out_;  // output side: the convolution this layer is the adjoint of
+    size_t filters_;
+    Tensor W_, b_;
+    Tensor dW_, db_;
+    Activation activation_;
+    const Tensor* input_ = nullptr;
+    const Tensor* output_ = nullptr;
+    Tensor output_cache_;  // output kept by the value API
+    Tensor rows_;          // NCHW: input as pixel rows; its gradient during backward
+    Tensor cols_;          // per-pixel output windows, then their gradient
+    Tensor delta_;         // gradient w.r.t. the pre-activation
+};
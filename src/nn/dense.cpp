@@ -1,11 +1,20 @@
 #include "nn/dense.h"
+#include "math/bf16.h"
+#include "math/profiler.h"
+#include "math/thread_pool.h"
 #include <cmath>
+#include <stdexcept>
 
-DenseLayer::DenseLayer(size_t in_features, size_t out_features, InitMethod init)
+DenseLayer::DenseLayer(size_t in_features, size_t out_features, InitMethod init,
+                       Activation activation)
     : in_features_(in_features), out_features_(out_features),
-      b_(1, out_features, 0.0f),
-      dW_(in_features, out_features, 0.0f),
-      db_(1, out_features, 0.0f) {
+      activation_(activation) {
+
+    if (init == InitMethod::Skip) {
+        W_ = Tensor::uninitialized(in_features, out_features);
+        b_ = Tensor::uninitialized(1, out_features);
+        return;
+    }
 
     float stddev;
     if (init == InitMethod::He) {
@@ -16,35 +25,161 @@ DenseLayer::DenseLayer(size_t in_features, size_t out_features, InitMethod init)
         stddev = std::sqrt(2.0f / static_cast<float>(in_features + out_features));
     }
     W_ = Tensor::randn(in_features, out_features, 0.0f, stddev);
+    b_ = Tensor::zeros(1, out_features);
+    dW_ = Tensor::zeros(in_features, out_features);
+    db_ = Tensor::zeros(1, out_features);
 }
 
 Tensor DenseLayer::forward(const Tensor& input) {
-    input_cache_ = input;
-    // y = x * W + b
-    auto out = Tensor::matmul(input, W_);
-    return Tensor::add(out, b_);
+    if (activation_ == Activation::None) {
+        return Layer::forward(input);
+    }
+    // The activation derivative needs the output, so keep a copy of it as well
+    input_copy_ = input;
+    forward_into(input_copy_, output_cache_);
+    return output_cache_;
+}
+
+void DenseLayer::use_bf16_weights(bool keep_master, bool convert_weights) {
+    if (keep_master && !master_) {
+        throw std::logic_error("DenseLayer: float32 weights were already dropped");
+    }
+    if (!bf16_) {
+        size_t n = in_features_ * out_features_;
+        W16_ = Tensor::uninitialized(1, (n + 1) / 2);
+        if (convert_weights) {
+            convert_to_bf16(W_.data.data(), reinterpret_cast<uint16_t*>(W16_.data.data()), n);
+        }
+        bf16_ = true;
+    }
+    if (!keep_master) {
+        W_ = Tensor();
+        dW_ = Tensor();
+        master_ = false;
+    }
 }
 
-Tensor DenseLayer::backward(const Tensor& grad_output) {
-    // dW = x^T * grad_output
-    dW_ = Tensor::matmul(Tensor::transpose(input_cache_), grad_output);
+// Bytes of the weights the GEMMs read
+static double weight_bytes(size_t in, size_t out, bool bf16) {
+    return static_cast<double>(in * out) * (bf16 ? 2.0 : 4.0);
+}
 
-    // db = sum of grad_output over batch (for single sample, just grad_output)
-    if (grad_output.rows == 1) {
-        db_ = grad_output;
-    } else {
-        db_ = Tensor::zeros(1, out_features_);
+void DenseLayer::forward_into(const Tensor& input, Tensor& output) {
+    input_ = &input;
+    output_ = &output;
+    AE_PROFILE_WORK(2.0 * static_cast<double>(input.rows * in_features_ * out_features_),
+                    weight_bytes(in_features_, out_features_, bf16_) +
+                        4.0 * static_cast<double>(input.rows * (in_features_ + out_features_)));
+    if (!bf16_) {
+        // y = act(x * W + b)
+        Tensor::linear_into(input, W_, b_, activation_, output);
+        return;
+    }
+    if (input.cols != in_features_) {
+        throw std::invalid_argument("Dense: expected " + std::to_string(in_features_) +
+                                    " input features, got " + std::to_string(input.cols));
+    }
+    output.resize(input.rows, out_features_);
+    GemmArgs g;
+    g.M = input.rows; g.N = out_features_; g.K = in_features_;
+    g.A = input.data.data(); g.lda = input.cols;
+    g.B_bf16 = reinterpret_cast<const uint16_t*>(W16_.data.data()); g.ldb = out_features_;
+    g.C = output.data.data(); g.ldc = output.cols;
+    g.bias = b_.data.data();
+    g.activation = activation_;
+    gemm(g);
+}
+
+// delta = grad_output * act'(y) and db = column sums of delta, in one pass. Split
+// over columns so each thread sums whole columns in row order.
+template <class Deriv>
+static void activation_backward(const Tensor& grad_output, const Tensor& y, Tensor& delta,
+                                Tensor& db, Deriv deriv) {
+    delta.resize(grad_output.rows, grad_output.cols);
+    ThreadPool::global().parallel_for(grad_output.cols, 1024, [&](size_t j0, size_t j1) {
         for (size_t i = 0; i < grad_output.rows; ++i) {
-            for (size_t j = 0; j < grad_output.cols; ++j) {
-                db_(0, j) += grad_output(i, j);
+            for (size_t j = j0; j < j1; ++j) {
+                float d = grad_output(i, j) * deriv(y(i, j));
+                delta(i, j) = d;
+                db[j] = i == 0 ? d : db[j] + d;
             }
         }
+    });
+}
+
+void DenseLayer::backward_into(const Tensor& grad_output, Tensor* grad_input) {
+    // dW reads the input and delta and writes dW; dx reads the weights and writes dx
+    AE_PROFILE_WORK(
+        (grad_input ? 4.0 : 2.0) * static_cast<double>(grad_output.rows * in_features_ * out_features_),
+        4.0 * static_cast<double>(in_features_ * out_features_ +
+                                  grad_output.rows * (in_features_ + out_features_)) +
+            (grad_input ? weight_bytes(in_features_, out_features_, bf16_) +
+                              4.0 * static_cast<double>(grad_output.rows * in_features_)
+                        : 0.0));
+    db_.resize(1, out_features_);
+    const Tensor* delta = &grad_output;
+    if (activation_ == Activation::ReLU) {
+        activation_backward(grad_output, *output_, delta_, db_,
+                            [](float y) { return y > 0.0f ? 1.0f : 0.0f; });
+        delta = &delta_;
+    } else if (activation_ == Activation::Sigmoid) {
+        activation_backward(grad_output, *output_, delta_, db_,
+                            [](float y) { return y * (1.0f - y); });
+        delta = &delta_;
+    } else {
+        // db = sum of grad_output over the batch
+        ThreadPool::global().parallel_for(grad_output.cols, 1024, [&](size_t j0, size_t j1) {
+            for (size_t j = j0; j < j1; ++j) {
+                db_[j] = grad_output(0, j);
+            }
+            for (size_t i = 1; i < grad_output.rows; ++i) {
+                for (size_t j = j0; j < j1; ++j) {
+                    db_[j] += grad_output(i, j);
+                }
+            }
+        });
+    }
+
+    // dW = x^T * delta
+    Tensor::matmul_tn_into(*input_, *delta, dW_);
+
+    // dx = delta * W^T
+    if (grad_input && !bf16_) {
+        Tensor::matmul_nt_into(*delta, W_, *grad_input);
+    } else if (grad_input) {
+        grad_input->resize(delta->rows, in_features_);
+        GemmArgs g;
+        g.trans_b = true;
+        g.M = delta->rows; g.N = in_features_; g.K = out_features_;
+        g.A = delta->data.data(); g.lda = delta->cols;
+        g.B_bf16 = reinterpret_cast<const uint16_t*>(W16_.data.data()); g.ldb = out_features_;
+        g.C = grad_input->data.data(); g.ldc = grad_input->cols;
+        gemm(g);
     }
+}
 
-    // dx = grad_output * W^T
-    return Tensor::matmul(grad_output, Tensor::transpose(W_));
+// A fused activation is described as the separate layer it replaced, so the
+// description does not depend on whether fuse_activations ran. Only stored bf16
+// weights are part of it: with a float32 master the saved model is float32.
+std::string DenseLayer::describe() const {
+    std::string s = "Dense(" + std::to_string(in_features_) + "," +
+                    std::to_string(out_features_) + (master_ ? ")" : ",bf16)");
+    if (activation_ == Activation::ReLU) {
+        s += " ReLU";
+    } else if (activation_ == Activation::Sigmoid) {
+        s += " Sigmoid";
+    }
+    return s;
 }
 
 std::vector<Parameter> DenseLayer::parameters() {
-    return {{&W_, &dW_}, {&b_, &db_}};
+    if (!master_) {
+        return {{&W16_, nullptr, DType::BF16}, {&b_, &db_}};
+    }
+    return {{&W_, &dW_, DType::Float32, bf16_ ? &W16_ : nullptr}, {&b_, &db_}};
+}
+
+void DenseLayer::zero_gradients() {
+    dW_.zero();
+    db_.zero();
 }
@@ -2,20 +2,56 @@
 
 #include "nn/layer.h"
 
-enum class InitMethod { He, Xavier };
+// Skip allocates W and b without filling them (no RNG draw, no zero fill) and leaves
+// the gradient buffers empty until the first backward pass. Use it for inference
+// layers whose parameters are loaded right after construction.
+enum class InitMethod { He, Xavier, Skip };
 
 class DenseLayer : public Layer {
 public:
-    DenseLayer(size_t in_features, size_t out_features, InitMethod init = InitMethod::He);
+    // With an activation, the layer computes act(x * W + b): bias and activation run
+    // in the GEMM epilogue, and backward applies the activation derivative in the
+    // same pass that sums the bias gradient
+    DenseLayer(size_t in_features, size_t out_features, InitMethod init = InitMethod::He,
+               Activation activation = Activation::None);
 
     Tensor forward(const Tensor& input) override;
-    Tensor backward(const Tensor& grad_output) override;
+    void forward_into(const Tensor& input, Tensor& output) override;
+    void backward_into(const Tensor& grad_output, Tensor* grad_input) override;
     std::vector<Parameter> parameters() override;
+    void zero_gradients() override;
     std::string name() const override { return "Dense"; }
+    std::string describe() const override;
+
+    Activation activation() const { return activation_; }
+    void set_activation(Activation activation) { activation_ = activation; }
+
+    // Multiply with bf16 weights, widened to float32 inside the GEMM kernels, so
+    // every product that reads W moves half the bytes. With keep_master (mixed
+    // precision training) W stays the float32 parameter and the optimizer keeps the
+    // bf16 copy in sync (see Parameter::bf16_copy). Without it (inference) the
+    // float32 weights are dropped and the bf16 weights become the parameter, so they
+    // are saved and loaded as bf16. Without convert_weights the bf16 weights are
+    // left unset, for loading a bf16 model.
+    void use_bf16_weights(bool keep_master, bool convert_weights = true);
+    bool bf16_weights() const { return bf16_; }
+
+    size_t in_features() const { return in_features_; }
+    size_t out_features() const { return out_features_; }
+    // (in_features x out_features); empty once use_bf16_weights(false) dropped it
+    const Tensor& weights() const { return W_; }
+    const Tensor& bias() const { return b_; }  // (1 x out_features)
 
 private:
     size_t in_features_, out_features_;
     Tensor W_, b_;
     Tensor dW_, db_;
-    Tensor input_cache_;
+    Tensor W16_;           // bf16 weights as raw bytes (see use_bf16_weights)
+    bool bf16_ = false;    // the GEMMs read W16_ instead of W_
+    bool master_ = true;   // W_ holds the float32 weights
+    Activation activation_;
+    const Tensor* input_ = nullptr;
+    const Tensor* output_ = nullptr;  // needed for the activation derivative
+    Tensor output_cache_;             // output kept by the value API
+    Tensor delta_;                    // gradient w.r.t. the pre-activation
 };
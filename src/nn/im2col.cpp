@@ -0,0 +1,206 @@
+#include "nn/im2col.h"
+#include "math/thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+// Patch rows or image pixels per thread pool chunk
+static constexpr size_t ROW_GRAIN = 64;
+
+const char* layout_name(ImageLayout layout) {
+    return layout == ImageLayout::NCHW ? "NCHW" : "NHWC";
+}
+
+void ConvGeometry::validate(const std::string& layer) const {
+    if (channels == 0 || height == 0 || width == 0 || kernel == 0 || stride == 0 ||
+        height + 2 * padding < kernel || width + 2 * padding < kernel) {
+        throw std::invalid_argument(layer + ": invalid geometry (" + std::to_string(channels) +
+            " channels, " + std::to_string(height) + "x" + std::to_string(width) + ", kernel " +
+            std::to_string(kernel) + ", stride " + std::to_string(stride) + ", padding " +
+            std::to_string(padding) + ")");
+    }
+}
+
+void im2col(const ConvGeometry& g, const float* images, size_t batch, float* cols) {
+    size_t oh_n = g.out_height(), ow_n = g.out_width();
+    size_t C = g.channels, K = g.kernel, P = g.patch_size();
+    ThreadPool::global().parallel_for(batch * oh_n * ow_n, ROW_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            size_t n = r / (oh_n * ow_n);
+            size_t oh = r / ow_n % oh_n;
+            size_t ow = r % ow_n;
+            const float* image = images + n * g.image_size();
+            float* row = cols + r * P;
+            for (size_t kh = 0; kh < K; ++kh) {
+                // Unsigned wrap-around puts rows above the image out of range too
+                size_t ih = oh * g.stride + kh - g.padding;
+                size_t iw0 = ow * g.stride - g.padding;
+                float* dst = row + kh * K * C;
+                if (g.layout == ImageLayout::NHWC && ih < g.height && iw0 < g.width &&
+                    iw0 + K <= g.width) {
+                    // The window's row is K adjacent pixels, contiguous in NHWC
+                    std::memcpy(dst, image + (ih * g.width + iw0) * C, K * C * sizeof(float));
+                    continue;
+                }
+                for (size_t kw = 0; kw < K; ++kw, dst += C) {
+                    size_t iw = iw0 + kw;
+                    if (ih >= g.height || iw >= g.width) {
+                        std::memset(dst, 0, C * sizeof(float));
+                    } else if (g.layout == ImageLayout::NHWC) {
+                        std::memcpy(dst, image + (ih * g.width + iw) * C, C * sizeof(float));
+                    } else {
+                        const float* src = image + ih * g.width + iw;
+                        for (size_t c = 0; c < C; ++c) {
+                            dst[c] = src[c * g.height * g.width];
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+static float activate(float x, Activation activation) {
+    if (activation == Activation::ReLU) {
+        return x > 0.0f ? x : 0.0f;
+    }
+    if (activation == Activation::Sigmoid) {
+        return 1.0f / (1.0f + std::exp(-std::clamp(x, -88.0f, 88.0f)));
+    }
+    return x;
+}
+
+void col2im(const ConvGeometry& g, const float* cols, size_t batch, float* images,
+            const float* bias, Activation activation) {
+    size_t oh_n = g.out_height(), ow_n = g.out_width();
+    size_t C = g.channels, K = g.kernel, P = g.patch_size(), S = g.stride;
+    size_t pixels = g.height * g.width;
+    // NHWC keeps a pixel's channels adjacent; NCHW spaces them a plane apart
+    size_t channel_step = g.layout == ImageLayout::NHWC ? 1 : pixels;
+    size_t pixel_step = g.layout == ImageLayout::NHWC ? C : 1;
+    size_t grain = std::max<size_t>(1, ROW_GRAIN / g.width);
+    // Each chunk owns whole image rows, so the sums need no synchronisation and add
+    // up in the same order on any thread count. The windows reaching row ih are the
+    // output rows oh with oh * stride + kh = ih + padding; each one's kernel row kh
+    // is read across its patch rows at a constant stride, which prefetches well.
+    ThreadPool::global().parallel_for(batch * g.height, grain, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            size_t n = r / g.height;
+            size_t ih = r % g.height;
+            float* row = images + n * g.image_size() + ih * g.width * pixel_step;
+            for (size_t iw = 0; iw < g.width; ++iw) {
+                for (size_t c = 0; c < C; ++c) {
+                    row[iw * pixel_step + c * channel_step] = bias ? bias[c] : 0.0f;
+                }
+            }
+            size_t qh = (ih + g.padding) / S;
+            for (size_t kh = (ih + g.padding) % S, i = 0; kh < K && i <= qh; kh += S, ++i) {
+                size_t oh = qh - i;
+                if (oh >= oh_n) {
+                    continue;
+                }
+                const float* src = cols + (n * oh_n + oh) * ow_n * P + kh * K * C;
+                for (size_t ow = 0; ow < ow_n; ++ow, src += P) {
+                    // Unsigned wrap-around puts columns left of the image out of range too
+                    size_t iw0 = ow * S - g.padding;
+                    for (size_t kw = 0; kw < K; ++kw) {
+                        size_t iw = iw0 + kw;
+                        if (iw >= g.width) {
+                            continue;
+                        }
+                        float* dst = row + iw * pixel_step;
+                        const float* values = src + kw * C;
+                        if (channel_step == 1) {
+                            for (size_t c = 0; c < C; ++c) {
+                                dst[c] += values[c];
+                            }
+                        } else {
+                            for (size_t c = 0; c < C; ++c) {
+                                dst[c * channel_step] += values[c];
+                            }
+                        }
+                    }
+                }
+            }
+            if (activation != Activation::None) {
+                for (size_t iw = 0; iw < g.width; ++iw) {
+                    for (size_t c = 0; c < C; ++c) {
+                        float& v = row[iw * pixel_step + c * channel_step];
+                        v = activate(v, activation);
+                    }
+                }
+            }
+        }
+    });
+}
+
+void nchw_to_rows(const float* images, size_t batch, size_t channels, size_t pixels, float* rows) {
+    ThreadPool::global().parallel_for(batch * pixels, ROW_GRAIN * 16, [&](size_t begin, size_t end) {
+        for (size_t q = begin; q < end; ++q) {
+            const float* src = images + (q / pixels) * channels * pixels + q % pixels;
+            for (size_t c = 0; c < channels; ++c) {
+                rows[q * channels + c] = src[c * pixels];
+            }
+        }
+    });
+}
+
+void rows_to_nchw(const float* rows, size_t batch, size_t channels, size_t pixels, float* images) {
+    ThreadPool::global().parallel_for(batch * pixels, ROW_GRAIN * 16, [&](size_t begin, size_t end) {
+        for (size_t q = begin; q < end; ++q) {
+            float* dst = images + (q / pixels) * channels * pixels + q % pixels;
+            for (size_t c = 0; c < channels; ++c) {
+                dst[c * pixels] = rows[q * channels + c];
+            }
+        }
+    });
+}
+
+void channel_sums(const float* images, size_t batch, size_t channels, size_t pixels,
+                  ImageLayout layout, float* sums) {
+    // Blocks of 16 channels (one cache line of an NHWC pixel) per chunk, so each
+    // chunk reads its lines once and sums in a fixed order
+    ThreadPool::global().parallel_for(channels, 16, [&](size_t c0, size_t c1) {
+        for (size_t c = c0; c < c1; ++c) {
+            sums[c] = 0.0f;
+        }
+        for (size_t n = 0; n < batch; ++n) {
+            const float* image = images + n * channels * pixels;
+            if (layout == ImageLayout::NHWC) {
+                for (size_t q = 0; q < pixels; ++q) {
+                    for (size_t c = c0; c < c1; ++c) {
+                        sums[c] += image[q * channels + c];
+                    }
+                }
+            } else {
+                for (size_t c = c0; c < c1; ++c) {
+                    float sum = 0.0f;
+                    for (size_t q = 0; q < pixels; ++q) {
+                        sum += image[c * pixels + q];
+                    }
+                    sums[c] += sum;
+                }
+            }
+        }
+    });
+}
+
+void activation_gradient(const float* grad_output, const float* y, size_t n,
+                         Activation activation, float* delta) {
+    ThreadPool::global().parallel_for(n, ThreadPool::ELEMENTWISE_GRAIN, [&](size_t begin, size_t end) {
+        if (activation == Activation::ReLU) {
+            for (size_t i = begin; i < end; ++i) {
+                delta[i] = y[i] > 0.0f ? grad_output[i] : 0.0f;
+            }
+        } else if (activation == Activation::Sigmoid) {
+            for (size_t i = begin; i < end; ++i) {
+                delta[i] = grad_output[i] * y[i] * (1.0f - y[i]);
+            }
+        } else {
+            for (size_t i = begin; i < end; ++i) {
+                delta[i] = grad_output[i];
+            }
+        }
+    });
+}
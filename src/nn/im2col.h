@@ -0,0 +1,65 @@
+#pragma once
+
+// Image geometry and patch-matrix helpers shared by the convolution layers
+
+#include "math/gemm.h"
+#include <cstddef>
+#include <string>
+
+// Order of the values of one image within a row of a (batch, C*H*W) tensor.
+// NHWC stores each pixel's channels together, which is the order ImageIO
+// produces; NCHW stores each channel as a separate plane.
+enum class ImageLayout { NHWC, NCHW };
+
+const char* layout_name(ImageLayout layout);
+
+// Shape of a convolution, seen from its image side: channels x height x width
+// images read through a kernel x kernel window moved `stride` pixels at a time,
+// with `padding` zero pixels around each edge
+struct ConvGeometry {
+    size_t channels = 1;
+    size_t height = 1;
+    size_t width = 1;
+    size_t kernel = 1;
+    size_t stride = 1;
+    size_t padding = 0;
+    ImageLayout layout = ImageLayout::NHWC;
+
+    size_t out_height() const { return (height + 2 * padding - kernel) / stride + 1; }
+    size_t out_width() const { return (width + 2 * padding - kernel) / stride + 1; }
+    size_t image_size() const { return channels * height * width; }
+    // Values in one window, i.e. columns of the patch matrix
+    size_t patch_size() const { return kernel * kernel * channels; }
+
+    // Throws std::invalid_argument unless every size is positive and the padded
+    // image holds at least one window; `layer` names the caller in the message
+    void validate(const std::string& layer) const;
+};
+
+// Patch matrix of a batch of images: row (n, oh, ow) holds the window feeding
+// output pixel (oh, ow) of image n, ordered (kh, kw, c), with zeros where the
+// window covers padding. `cols` is (batch * out_height * out_width) x patch_size.
+// A convolution is then one GEMM of the patch matrix with a (patch_size x filters)
+// weight matrix.
+void im2col(const ConvGeometry& g, const float* images, size_t batch, float* cols);
+
+// Adjoint of im2col: each image value becomes the sum of every patch entry that
+// im2col would copy from it, then bias[c] is added and the activation applied.
+// Each image row is summed by a single thread, in an order that does not
+// depend on the thread count.
+void col2im(const ConvGeometry& g, const float* cols, size_t batch, float* images,
+            const float* bias = nullptr, Activation activation = Activation::None);
+
+// Convert a batch of NCHW images to pixel rows ((batch * pixels) x channels,
+// the NHWC order) and back
+void nchw_to_rows(const float* images, size_t batch, size_t channels, size_t pixels, float* rows);
+void rows_to_nchw(const float* rows, size_t batch, size_t channels, size_t pixels, float* images);
+
+// Per-channel sums over a batch of images (bias gradients)
+void channel_sums(const float* images, size_t batch, size_t channels, size_t pixels,
+                  ImageLayout layout, float* sums);
+
+// delta = grad_output * act'(y) over n values, given the activation's output y
+// (ReLU: y > 0, Sigmoid: y * (1 - y)). delta may alias grad_output.
+void activation_gradient(const float* grad_output, const float* y, size_t n,
+                         Activation activation, float* delta);
@@ -1,19 +1,60 @@
 #pragma once
 
 #include "math/tensor.h"
+#include <cstdint>
 #include <vector>
 #include <string>
 
+// Element type of a parameter's contents. Parameters of other types than Float32
+// keep their raw bytes in a float tensor (e.g. QuantizedDenseLayer's packed int8
+// weights, or bf16 DenseLayer weights); model files record the type so such bytes
+// are never read as floats.
+enum class DType : uint32_t { Float32 = 0, Int8 = 1, BF16 = 2 };
+
 struct Parameter {
     Tensor* value;
-    Tensor* gradient;
+    Tensor* gradient;  // null for parameters that are not trained
+    DType dtype = DType::Float32;
+    // bf16 copy of a Float32 value used by the forward and backward GEMMs (mixed
+    // precision, see DenseLayer::use_bf16_weights). Whoever writes the value must
+    // refresh it: the optimizer does so in the same pass as the update.
+    Tensor* bf16_copy = nullptr;
 };
 
 class Layer {
 public:
     virtual ~Layer() = default;
-    virtual Tensor forward(const Tensor& input) = 0;
-    virtual Tensor backward(const Tensor& grad_output) = 0;
+
+    // Value API: returns new tensors and caches a private copy of the input, so the
+    // caller may reuse or modify `input` before calling backward
+    virtual Tensor forward(const Tensor& input) {
+        input_copy_ = input;
+        Tensor output;
+        forward_into(input_copy_, output);
+        return output;
+    }
+
+    virtual Tensor backward(const Tensor& grad_output) {
+        Tensor grad_input;
+        backward_into(grad_output, &grad_input);
+        return grad_input;
+    }
+
+    // Allocation-free API: writes into caller-owned tensors, which are only
+    // reallocated when too small (see Tensor::resize). The layer keeps references
+    // to `input` and `output`, so both must stay alive and unchanged until the
+    // matching backward_into. grad_input may be null when the caller does not need
+    // the input gradient (e.g. for the first layer), which skips computing it.
+    virtual void forward_into(const Tensor& input, Tensor& output) = 0;
+    virtual void backward_into(const Tensor& grad_output, Tensor* grad_input) = 0;
+
     virtual std::vector<Parameter> parameters() { return {}; }
+    virtual void zero_gradients() {}
     virtual std::string name() const = 0;
+    // Name plus shape and options, e.g. "Dense(12288,512) ReLU"; stored as model
+    // file metadata to catch loading weights into the wrong architecture
+    virtual std::string describe() const { return name(); }
+
+protected:
+    Tensor input_copy_;  // input cached by the value API
 };
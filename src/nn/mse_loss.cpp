@@ -1,23 +1,56 @@
 #include "nn/mse_loss.h"
+#include "math/profiler.h"
+#include "math/thread_pool.h"
+
+static const std::string PROFILE_LABEL = "MSELoss";
 
 float MSELoss::forward(const Tensor& prediction, const Tensor& target) {
     prediction_cache_ = prediction;
     target_cache_ = target;
     n_ = prediction.size();
 
-    float sum = 0.0f;
-    for (size_t i = 0; i < n_; ++i) {
-        float diff = prediction[i] - target[i];
-        sum += diff * diff;
-    }
-    return sum / static_cast<float>(n_);
+    // Per-chunk partial sums are combined in chunk order, so the loss is
+    // identical for any thread count
+    double sum = ThreadPool::global().parallel_sum(n_, ThreadPool::ELEMENTWISE_GRAIN,
+                                                   [&](size_t begin, size_t end) {
+        float partial = 0.0f;
+        for (size_t i = begin; i < end; ++i) {
+            float diff = prediction[i] - target[i];
+            partial += diff * diff;
+        }
+        return static_cast<double>(partial);
+    });
+    return static_cast<float>(sum / static_cast<double>(n_));
 }
 
 Tensor MSELoss::backward() {
-    Tensor grad(prediction_cache_.rows, prediction_cache_.cols);
+    Tensor grad = Tensor::uninitialized(prediction_cache_.rows, prediction_cache_.cols);
     float scale = 2.0f / static_cast<float>(n_);
-    for (size_t i = 0; i < n_; ++i) {
-        grad[i] = scale * (prediction_cache_[i] - target_cache_[i]);
-    }
+    ThreadPool::global().parallel_for(n_, ThreadPool::ELEMENTWISE_GRAIN,
+                                      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            grad[i] = scale * (prediction_cache_[i] - target_cache_[i]);
+        }
+    });
     return grad;
 }
+
+float MSELoss::forward_backward(const Tensor& prediction, const Tensor& target, Tensor& grad) {
+    AE_PROFILE_SCOPE(PROFILE_LABEL);
+    size_t n = prediction.size();
+    float scale = 2.0f / static_cast<float>(n);
+    grad.resize(prediction.rows, prediction.cols);
+    AE_PROFILE_WORK(3.0 * static_cast<double>(n), 12.0 * static_cast<double>(n));
+
+    double sum = ThreadPool::global().parallel_sum(n, ThreadPool::ELEMENTWISE_GRAIN,
+                                                   [&](size_t begin, size_t end) {
+        float partial = 0.0f;
+        for (size_t i = begin; i < end; ++i) {
+            float diff = prediction[i] - target[i];
+            partial += diff * diff;
+            grad[i] = scale * diff;
+        }
+        return static_cast<double>(partial);
+    });
+    return static_cast<float>(sum / static_cast<double>(n));
+}
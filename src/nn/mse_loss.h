@@ -7,6 +7,10 @@ public:
     float forward(const Tensor& prediction, const Tensor& target);
     Tensor backward();
 
+    // Loss and gradient in a single pass, without caching the inputs. grad is
+    // resized as needed (see Tensor::resize), so this does not allocate at steady state.
+    float forward_backward(const Tensor& prediction, const Tensor& target, Tensor& grad);
+
 private:
     Tensor prediction_cache_;
     Tensor target_cache_;
@@ -1,13 +1,42 @@
 #include "nn/network.h"
+#include "nn/conv2d.h"
+#include "nn/dense.h"
+#include "nn/quantized_dense.h"
+#include "nn/relu.h"
+#include "nn/sigmoid.h"
+#include "math/profiler.h"
 
 void Network::add_layer(std::shared_ptr<Layer> layer) {
     layers_.push_back(std::move(layer));
+    activations_.resize(layers_.size() - 1);
+    gradients_.resize(layers_.size() - 1);
+    update_labels();
+}
+
+void Network::set_name(std::string name) {
+    name_ = std::move(name);
+    update_labels();
+}
+
+void Network::update_labels() {
+    forward_labels_.clear();
+    backward_labels_.clear();
+    for (size_t i = 0; i < layers_.size(); ++i) {
+        std::string label = name_ + "[" + std::to_string(i) + "] " + layers_[i]->describe();
+        forward_labels_.push_back(label + " forward");
+        backward_labels_.push_back(label + " backward");
+    }
+    param_starts_.assign(1, hook_offset_);
+    for (const auto& layer : layers_) {
+        param_starts_.push_back(param_starts_.back() + layer->parameters().size());
+    }
 }
 
 Tensor Network::forward(const Tensor& input) {
     Tensor x = input;
-    for (auto& layer : layers_) {
-        x = layer->forward(x);
+    for (size_t i = 0; i < layers_.size(); ++i) {
+        AE_PROFILE_SCOPE(forward_labels_[i]);
+        x = layers_[i]->forward(x);
     }
     return x;
 }
@@ -15,11 +44,114 @@ Tensor Network::forward(const Tensor& input) {
 Tensor Network::backward(const Tensor& grad_output) {
     Tensor grad = grad_output;
     for (int i = static_cast<int>(layers_.size()) - 1; i >= 0; --i) {
+        AE_PROFILE_SCOPE(backward_labels_[i]);
         grad = layers_[i]->backward(grad);
     }
     return grad;
 }
 
+void Network::forward_into(const Tensor& input, Tensor& output) {
+    if (layers_.empty()) {
+        output = input;
+        return;
+    }
+    size_t last = layers_.size() - 1;
+    for (size_t i = 0; i <= last; ++i) {
+        const Tensor& x = i == 0 ? input : activations_[i - 1];
+        Tensor& y = i == last ? output : activations_[i];
+        AE_PROFILE_SCOPE(forward_labels_[i]);
+        layers_[i]->forward_into(x, y);
+    }
+}
+
+void Network::backward_into(const Tensor& grad_output, Tensor* grad_input) {
+    if (layers_.empty()) {
+        if (grad_input) {
+            *grad_input = grad_output;
+        }
+        return;
+    }
+    size_t last = layers_.size() - 1;
+    for (size_t i = last + 1; i-- > 0;) {
+        const Tensor& dy = i == last ? grad_output : gradients_[i];
+        Tensor* dx = i == 0 ? grad_input : &gradients_[i - 1];
+        {
+            AE_PROFILE_SCOPE(backward_labels_[i]);
+            layers_[i]->backward_into(dy, dx);
+        }
+        if (gradient_hook_ && param_starts_[i + 1] > param_starts_[i]) {
+            gradient_hook_(param_starts_[i], param_starts_[i + 1]);
+        }
+    }
+}
+
+void Network::set_gradient_hook(GradientHook hook, size_t offset) {
+    gradient_hook_ = std::move(hook);
+    hook_offset_ = offset;
+    update_labels();
+}
+
+// Give `layer` the activation if it is a GEMM layer without one yet
+template <class L>
+static bool set_fused_activation(Layer* layer, Activation activation) {
+    auto* gemm_layer = dynamic_cast<L*>(layer);
+    if (!gemm_layer || gemm_layer->activation() != Activation::None) {
+        return false;
+    }
+    gemm_layer->set_activation(activation);
+    return true;
+}
+
+void Network::fuse_activations() {
+    std::vector<std::shared_ptr<Layer>> fused;
+    for (size_t i = 0; i < layers_.size(); ++i) {
+        fused.push_back(layers_[i]);
+        if (i + 1 == layers_.size()) {
+            continue;
+        }
+        const Layer* next = layers_[i + 1].get();
+        Activation activation = dynamic_cast<const ReLU*>(next)      ? Activation::ReLU
+                                : dynamic_cast<const Sigmoid*>(next) ? Activation::Sigmoid
+                                                                     : Activation::None;
+        Layer* layer = layers_[i].get();
+        if (activation != Activation::None &&
+            (set_fused_activation<DenseLayer>(layer, activation) ||
+             set_fused_activation<Conv2DLayer>(layer, activation) ||
+             set_fused_activation<ConvTranspose2DLayer>(layer, activation))) {
+            ++i;
+        }
+    }
+    layers_ = std::move(fused);
+    activations_.resize(layers_.empty() ? 0 : layers_.size() - 1);
+    gradients_.resize(layers_.empty() ? 0 : layers_.size() - 1);
+    update_labels();
+}
+
+void Network::quantize(bool convert_weights) {
+    for (auto& layer : layers_) {
+        const auto* dense = dynamic_cast<const DenseLayer*>(layer.get());
+        if (!dense) {
+            continue;
+        }
+        if (convert_weights) {
+            layer = QuantizedDenseLayer::quantize(*dense);
+        } else {
+            layer = std::make_shared<QuantizedDenseLayer>(
+                dense->in_features(), dense->out_features(), dense->activation());
+        }
+    }
+    update_labels();
+}
+
+void Network::use_bf16_weights(bool keep_master, bool convert_weights) {
+    for (auto& layer : layers_) {
+        if (auto* dense = dynamic_cast<DenseLayer*>(layer.get())) {
+            dense->use_bf16_weights(keep_master, convert_weights);
+        }
+    }
+    update_labels();
+}
+
 std::vector<Parameter> Network::parameters() {
     std::vector<Parameter> params;
     for (auto& layer : layers_) {
@@ -30,7 +162,18 @@ std::vector<Parameter> Network::parameters() {
 }
 
 void Network::zero_gradients() {
-    for (auto& param : parameters()) {
-        param.gradient->zero();
+    for (auto& layer : layers_) {
+        layer->zero_gradients();
+    }
+}
+
+std::string Network::describe() const {
+    std::string s;
+    for (auto& layer : layers_) {
+        if (!s.empty()) {
+            s += ' ';
+        }
+        s += layer->describe();
     }
+    return s;
 }
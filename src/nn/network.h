@@ -1,17 +1,67 @@
 #pragma once
 
 #include "nn/layer.h"
+#include <functional>
 #include <vector>
 #include <memory>
 
 class Network {
 public:
     void add_layer(std::shared_ptr<Layer> layer);
+
+    // Prefix of the profiling labels (see math/profiler.h): each layer call is timed
+    // as "<name>[i] <description> forward" or "... backward". Defaults to "network".
+    void set_name(std::string name);
     Tensor forward(const Tensor& input);
     Tensor backward(const Tensor& grad_output);
+
+    // Allocation-free execution: intermediate activations and gradients live in
+    // buffers owned by the network, sized by the first batch and reused by later
+    // ones (see Layer::forward_into). `input` must stay alive and unchanged until
+    // backward_into; grad_input may be null to skip the first layer's input gradient.
+    void forward_into(const Tensor& input, Tensor& output);
+    void backward_into(const Tensor& grad_output, Tensor* grad_input);
+
+    // Called by backward_into as soon as a layer's parameter gradients are final,
+    // with the range [begin, end) of those parameters in parameters(), shifted by
+    // `offset`. Layers run last to first, so the ranges arrive in decreasing order;
+    // gradient communication can start on them while earlier layers still compute
+    // (see GradientAllReduce). An empty hook removes it.
+    using GradientHook = std::function<void(size_t begin, size_t end)>;
+    void set_gradient_hook(GradientHook hook, size_t offset = 0);
+
+    // Fold every ReLU or Sigmoid that directly follows an activation-free Dense,
+    // Conv2D or ConvTranspose2D layer into that layer (see DenseLayer), removing a
+    // full pass over the activation in each direction. The parameter list is unchanged, so saved models still load.
+    void fuse_activations();
+
+    // Replace every Dense layer with a QuantizedDenseLayer of the same shape and
+    // activation, for int8 inference. With convert_weights the current weights are
+    // quantized (see QuantizedDenseLayer::quantize); without it the new layers are
+    // left unset for loading an already quantized model. Changes the parameter list
+    // and the description, so quantized models are saved and loaded as such.
+    void quantize(bool convert_weights = true);
+
+    // Switch every Dense layer to bf16 weights (see DenseLayer::use_bf16_weights)
+    void use_bf16_weights(bool keep_master, bool convert_weights = true);
+
     std::vector<Parameter> parameters();
     void zero_gradients();
 
+    // Layer descriptions separated by spaces (see Layer::describe)
+    std::string describe() const;
+
 private:
+    // Profiling labels and parameter ranges of the current layers
+    void update_labels();
+
+    std::string name_ = "network";
     std::vector<std::shared_ptr<Layer>> layers_;
+    std::vector<std::string> forward_labels_;   // profiling label of each layer
+    std::vector<std::string> backward_labels_;
+    std::vector<Tensor> activations_;  // output of layer i, for all but the last layer
+    std::vector<Tensor> gradients_;    // gradient w.r.t. the output of layer i
+    GradientHook gradient_hook_;
+    size_t hook_offset_ = 0;
+    std::vector<size_t> param_starts_;  // first parameter of layer i (+ offset), plus the end
 };
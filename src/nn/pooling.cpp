@@ -0,0 +1,178 @@
+#include "nn/pooling.h"
+#include "math/profiler.h"
+#include "math/thread_pool.h"
+#include <stdexcept>
+
+// Image pixels per thread pool chunk
+static constexpr size_t PIXEL_GRAIN = 256;
+
+// Offset of value (c, h, w) within a channels x height x width image
+static size_t offset(const ConvGeometry& g, size_t c, size_t h, size_t w) {
+    return g.layout == ImageLayout::NHWC ? (h * g.width + w) * g.channels + c
+                                         : (c * g.height + h) * g.width + w;
+}
+
+static ConvGeometry image_geometry(size_t channels, size_t height, size_t width,
+                                   ImageLayout layout) {
+    ConvGeometry g;
+    g.channels = channels;
+    g.height = height;
+    g.width = width;
+    g.layout = layout;
+    return g;
+}
+
+static void check_input(const Tensor& input, size_t expected, const char* layer) {
+    if (input.cols != expected) {
+        throw std::invalid_argument(std::string(layer) + ": expected " + std::to_string(expected) +
+                                    " input values per image, got " + std::to_string(input.cols));
+    }
+}
+
+static std::string describe_resize(const char* name, const ConvGeometry& g, size_t factor) {
+    return std::string(name) + "(" + std::to_string(g.channels) + "," + std::to_string(g.height) +
+           "x" + std::to_string(g.width) + "," + std::to_string(factor) + "," +
+           layout_name(g.layout) + ")";
+}
+
+MaxPool2D::MaxPool2D(size_t channels, size_t height, size_t width, size_t size,
+                     ImageLayout layout)
+    : g_(image_geometry(channels, height, width, layout)), size_(size) {
+    g_.kernel = size;
+    g_.stride = size;
+    g_.validate("MaxPool2D");
+    if (height % size != 0 || width % size != 0) {
+        throw std::invalid_argument("MaxPool2D: " + std::to_string(height) + "x" +
+                                    std::to_string(width) + " is not a multiple of " +
+                                    std::to_string(size));
+    }
+}
+
+void MaxPool2D::forward_into(const Tensor& input, Tensor& output) {
+    check_input(input, g_.image_size(), "MaxPool2D");
+    size_t batch = input.rows;
+    size_t oh_n = g_.out_height(), ow_n = g_.out_width();
+    output.resize(batch, output_size());
+    argmax_.resize(batch * output_size());
+    AE_PROFILE_WORK(0.0, 4.0 * static_cast<double>(input.size() + 2 * output.size()));
+    ConvGeometry out = image_geometry(g_.channels, oh_n, ow_n, g_.layout);
+    ThreadPool::global().parallel_for(batch * oh_n * ow_n, PIXEL_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t q = begin; q < end; ++q) {
+            size_t n = q / (oh_n * ow_n);
+            size_t oh = q / ow_n % oh_n;
+            size_t ow = q % ow_n;
+            const float* x = input.data.data() + n * g_.image_size();
+            for (size_t c = 0; c < g_.channels; ++c) {
+                size_t best = offset(g_, c, oh * size_, ow * size_);
+                for (size_t kh = 0; kh < size_; ++kh) {
+                    for (size_t kw = 0; kw < size_; ++kw) {
+                        size_t o = offset(g_, c, oh * size_ + kh, ow * size_ + kw);
+                        if (x[o] > x[best]) {
+                            best = o;
+                        }
+                    }
+                }
+                size_t i = n * output_size() + offset(out, c, oh, ow);
+                output[i] = x[best];
+                argmax_[i] = static_cast<uint32_t>(best);
+            }
+        }
+    });
+}
+
+void MaxPool2D::backward_into(const Tensor& grad_output, Tensor* grad_input) {
+    if (!grad_input) {
+        return;
+    }
+    size_t batch = grad_output.rows;
+    size_t oh_n = g_.out_height(), ow_n = g_.out_width();
+    grad_input->resize(batch, g_.image_size());
+    AE_PROFILE_WORK(0.0, 4.0 * static_cast<double>(2 * grad_output.size() + grad_input->size()));
+    ConvGeometry out = image_geometry(g_.channels, oh_n, ow_n, g_.layout);
+    // Windows tile the input, so writing every window covers every input value once
+    ThreadPool::global().parallel_for(batch * oh_n * ow_n, PIXEL_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t q = begin; q < end; ++q) {
+            size_t n = q / (oh_n * ow_n);
+            size_t oh = q / ow_n % oh_n;
+            size_t ow = q % ow_n;
+            float* dx = grad_input->data.data() + n * g_.image_size();
+            for (size_t c = 0; c < g_.channels; ++c) {
+                size_t i = n * output_size() + offset(out, c, oh, ow);
+                for (size_t kh = 0; kh < size_; ++kh) {
+                    for (size_t kw = 0; kw < size_; ++kw) {
+                        size_t o = offset(g_, c, oh * size_ + kh, ow * size_ + kw);
+                        dx[o] = o == argmax_[i] ? grad_output[i] : 0.0f;
+                    }
+                }
+            }
+        }
+    });
+}
+
+std::string MaxPool2D::describe() const {
+    return describe_resize("MaxPool2D", g_, size_);
+}
+
+Upsample2D::Upsample2D(size_t channels, size_t height, size_t width, size_t factor,
+                       ImageLayout layout)
+    : g_(image_geometry(channels, height, width, layout)), factor_(factor) {
+    g_.validate("Upsample2D");
+    if (factor == 0) {
+        throw std::invalid_argument("Upsample2D: factor must be positive");
+    }
+}
+
+void Upsample2D::forward_into(const Tensor& input, Tensor& output) {
+    check_input(input, g_.image_size(), "Upsample2D");
+    size_t batch = input.rows;
+    size_t oh_n = g_.height * factor_, ow_n = g_.width * factor_;
+    output.resize(batch, output_size());
+    AE_PROFILE_WORK(0.0, 4.0 * static_cast<double>(input.size() + output.size()));
+    ConvGeometry out = image_geometry(g_.channels, oh_n, ow_n, g_.layout);
+    ThreadPool::global().parallel_for(batch * oh_n * ow_n, PIXEL_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t q = begin; q < end; ++q) {
+            size_t n = q / (oh_n * ow_n);
+            size_t oh = q / ow_n % oh_n;
+            size_t ow = q % ow_n;
+            const float* x = input.data.data() + n * g_.image_size();
+            float* y = output.data.data() + n * output_size();
+            for (size_t c = 0; c < g_.channels; ++c) {
+                y[offset(out, c, oh, ow)] = x[offset(g_, c, oh / factor_, ow / factor_)];
+            }
+        }
+    });
+}
+
+void Upsample2D::backward_into(const Tensor& grad_output, Tensor* grad_input) {
+    if (!grad_input) {
+        return;
+    }
+    size_t batch = grad_output.rows;
+    size_t pixels = g_.height * g_.width;
+    grad_input->resize(batch, g_.image_size());
+    AE_PROFILE_WORK(0.0, 4.0 * static_cast<double>(grad_output.size() + grad_input->size()));
+    ConvGeometry out = image_geometry(g_.channels, g_.height * factor_, g_.width * factor_,
+                                      g_.layout);
+    ThreadPool::global().parallel_for(batch * pixels, PIXEL_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t q = begin; q < end; ++q) {
+            size_t n = q / pixels;
+            size_t h = q % pixels / g_.width;
+            size_t w = q % g_.width;
+            const float* dy = grad_output.data.data() + n * output_size();
+            float* dx = grad_input->data.data() + n * g_.image_size();
+            for (size_t c = 0; c < g_.channels; ++c) {
+                float sum = 0.0f;
+                for (size_t kh = 0; kh < factor_; ++kh) {
+                    for (size_t kw = 0; kw < factor_; ++kw) {
+                        sum += dy[offset(out, c, h * factor_ + kh, w * factor_ + kw)];
+                    }
+                }
+                dx[offset(g_, c, h, w)] = sum;
+            }
+        }
+    });
+}
+
+std::string Upsample2D::describe() const {
+    return describe_resize("Upsample2D", g_, factor_);
+}
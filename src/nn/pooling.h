@@ -0,0 +1,45 @@
+#pragma once
+
+#include "nn/layer.h"
+#include "nn/im2col.h"
+#include <cstdint>
+
+// Max over non-overlapping size x size windows of channels x height x width images
+// (height and width must be multiples of size). Forward records which input won
+// each window, so backward routes each gradient straight to it.
+class MaxPool2D : public Layer {
+public:
+    MaxPool2D(size_t channels, size_t height, size_t width, size_t size = 2,
+              ImageLayout layout = ImageLayout::NHWC);
+
+    void forward_into(const Tensor& input, Tensor& output) override;
+    void backward_into(const Tensor& grad_output, Tensor* grad_input) override;
+    std::string name() const override { return "MaxPool2D"; }
+    std::string describe() const override;
+
+    size_t output_size() const { return g_.image_size() / (size_ * size_); }
+
+private:
+    ConvGeometry g_;
+    size_t size_;
+    std::vector<uint32_t> argmax_;  // input offset within its image, per output value
+};
+
+// Nearest-neighbour upsampling: every pixel of channels x height x width images
+// becomes a factor x factor block. Backward sums each block's gradients.
+class Upsample2D : public Layer {
+public:
+    Upsample2D(size_t channels, size_t height, size_t width, size_t factor = 2,
+               ImageLayout layout = ImageLayout::NHWC);
+
+    void forward_into(const Tensor& input, Tensor& output) override;
+    void backward_into(const Tensor& grad_output, Tensor* grad_input) override;
+    std::string name() const override { return "Upsample2D"; }
+    std::string describe() const override;
+
+    size_t output_size() const { return g_.image_size() * factor_ * factor_; }
+
+private:
+    ConvGeometry g_;
+    size_t factor_;
+};
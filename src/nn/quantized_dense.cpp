@@ -0,0 +1,72 @@
+#include "nn/quantized_dense.h"
+#include "math/profiler.h"
+#include <stdexcept>
+
+QuantizedDenseLayer::QuantizedDenseLayer(size_t in_features, size_t out_features,
+                                         Activation activation)
+    : in_features_(in_features), out_features_(out_features), activation_(activation),
+      packed_(Tensor::uninitialized(1, int8_packed_bytes(in_features, out_features) /
+                                           sizeof(float))),
+      scales_(Tensor::uninitialized(1, out_features)),
+      b_(Tensor::uninitialized(1, out_features)) {}
+
+std::shared_ptr<QuantizedDenseLayer> QuantizedDenseLayer::quantize(const DenseLayer& layer) {
+    if (layer.weights().size() == 0) {
+        throw std::invalid_argument("QuantizedDense: the layer has no float32 weights");
+    }
+    size_t in = layer.in_features(), out = layer.out_features();
+    auto q = std::make_shared<QuantizedDenseLayer>(in, out, layer.activation());
+    std::vector<int8_t> w(in * out);
+    quantize_columns(layer.weights().data.data(), in, out, w.data(), q->scales_.data.data());
+    pack_int8_weights(w.data(), in, out, reinterpret_cast<int8_t*>(q->packed_.data.data()));
+    q->b_.data.assign(layer.bias().data.begin(), layer.bias().data.end());
+    return q;
+}
+
+void QuantizedDenseLayer::forward_into(const Tensor& input, Tensor& output) {
+    if (input.cols != in_features_) {
+        throw std::invalid_argument("QuantizedDense: expected " + std::to_string(in_features_) +
+                                    " input features, got " + std::to_string(input.cols));
+    }
+    // Integer multiply-adds; int8 weights plus float activations in and out
+    AE_PROFILE_WORK(2.0 * static_cast<double>(input.rows * in_features_ * out_features_),
+                    static_cast<double>(in_features_ * out_features_) +
+                        4.0 * static_cast<double>(input.rows * (in_features_ + out_features_)));
+    size_t lda = int8_row_stride(in_features_);
+    input_q_.resize(input.rows * lda);
+    input_scales_.resize(input.rows);
+    quantize_rows(input.data.data(), input.rows, in_features_, input.cols, input_q_.data(),
+                  input_scales_.data());
+
+    output.resize(input.rows, out_features_);
+    Int8GemmArgs g;
+    g.M = input.rows; g.N = out_features_; g.K = in_features_;
+    g.A = input_q_.data(); g.lda = lda;
+    g.a_scale = input_scales_.data();
+    g.B = reinterpret_cast<const int8_t*>(packed_.data.data());
+    g.b_scale = scales_.data.data();
+    g.C = output.data.data(); g.ldc = output.cols;
+    g.bias = b_.data.data();
+    g.activation = activation_;
+    int8_gemm(g);
+}
+
+void QuantizedDenseLayer::backward_into(const Tensor&, Tensor*) {
+    throw std::logic_error("QuantizedDense layers are inference-only");
+}
+
+std::vector<Parameter> QuantizedDenseLayer::parameters() {
+    return {{&packed_, nullptr, DType::Int8}, {&scales_, nullptr}, {&b_, nullptr}};
+}
+
+// Same shape and activation notation as DenseLayer::describe
+std::string QuantizedDenseLayer::describe() const {
+    std::string s = "QuantizedDense(" + std::to_string(in_features_) + "," +
+                    std::to_string(out_features_) + ")";
+    if (activation_ == Activation::ReLU) {
+        s += " ReLU";
+    } else if (activation_ == Activation::Sigmoid) {
+        s += " Sigmoid";
+    }
+    return s;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "nn/dense.h"
+#include "math/int8_gemm.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Inference-only int8 version of DenseLayer (see math/int8_gemm.h). Weights are
+// quantized per output column and stored packed; each batch is quantized per row on
+// the way in, multiplied with int32 accumulation, and dequantized in the GEMM
+// epilogue together with the float bias and activation.
+class QuantizedDenseLayer : public Layer {
+public:
+    // Parameter storage for an (in x out) layer, left unset for ModelIO::load or map
+    QuantizedDenseLayer(size_t in_features, size_t out_features,
+                        Activation activation = Activation::None);
+
+    // Post-training quantization of a trained layer (which must still have its
+    // float32 weights, see DenseLayer::use_bf16_weights)
+    static std::shared_ptr<QuantizedDenseLayer> quantize(const DenseLayer& layer);
+
+    void forward_into(const Tensor& input, Tensor& output) override;
+    // Throws std::logic_error: quantized layers cannot be trained
+    void backward_into(const Tensor& grad_output, Tensor* grad_input) override;
+    std::vector<Parameter> parameters() override;
+    std::string name() const override { return "QuantizedDense"; }
+    std::string describe() const override;
+
+private:
+    size_t in_features_, out_features_;
+    Activation activation_;
+    Tensor packed_;  // weights in pack_int8_weights layout, as raw bytes
+    Tensor scales_;  // (1 x out_features) weight scale of each output column
+    Tensor b_;       // (1 x out_features)
+    std::vector<int16_t> input_q_;  // quantized batch, reused across calls
+    std::vector<float> input_scales_;
+};
@@ -1,18 +1,31 @@
 #include "nn/relu.h"
+#include "math/profiler.h"
+#include "math/thread_pool.h"
 
-Tensor ReLU::forward(const Tensor& input) {
-    input_cache_ = input;
-    Tensor out(input.rows, input.cols);
-    for (size_t i = 0; i < input.size(); ++i) {
-        out[i] = input[i] > 0.0f ? input[i] : 0.0f;
-    }
-    return out;
+void ReLU::forward_into(const Tensor& input, Tensor& output) {
+    input_ = &input;
+    output.resize(input.rows, input.cols);
+    AE_PROFILE_WORK(0.0, 8.0 * static_cast<double>(input.size()));
+    ThreadPool::global().parallel_for(input.size(), ThreadPool::ELEMENTWISE_GRAIN,
+                                      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            output[i] = input[i] > 0.0f ? input[i] : 0.0f;
+        }
+    });
 }
 
-Tensor ReLU::backward(const Tensor& grad_output) {
-    Tensor grad_input(grad_output.rows, grad_output.cols);
-    for (size_t i = 0; i < grad_output.size(); ++i) {
-        grad_input[i] = input_cache_[i] > 0.0f ? grad_output[i] : 0.0f;
+void ReLU::backward_into(const Tensor& grad_output, Tensor* grad_input) {
+    if (!grad_input) {
+        return;
     }
-    return grad_input;
+    const Tensor& input = *input_;
+    Tensor& dx = *grad_input;
+    dx.resize(grad_output.rows, grad_output.cols);
+    AE_PROFILE_WORK(0.0, 12.0 * static_cast<double>(grad_output.size()));
+    ThreadPool::global().parallel_for(grad_output.size(), ThreadPool::ELEMENTWISE_GRAIN,
+                                      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            dx[i] = input[i] > 0.0f ? grad_output[i] : 0.0f;
+        }
+    });
 }
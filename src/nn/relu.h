@@ -4,10 +4,10 @@
 
 class ReLU : public Layer {
 public:
-    Tensor forward(const Tensor& input) override;
-    Tensor backward(const Tensor& grad_output) override;
+    void forward_into(const Tensor& input, Tensor& output) override;
+    void backward_into(const Tensor& grad_output, Tensor* grad_input) override;
     std::string name() const override { return "ReLU"; }
 
 private:
-    Tensor input_cache_;
+    const Tensor* input_ = nullptr;
 };
@@ -1,22 +1,41 @@
 #include "nn/sigmoid.h"
+#include "math/profiler.h"
+#include "math/thread_pool.h"
 #include <cmath>
 #include <algorithm>
 
 Tensor Sigmoid::forward(const Tensor& input) {
-    output_cache_ = Tensor(input.rows, input.cols);
-    for (size_t i = 0; i < input.size(); ++i) {
-        // Clamp to [-88, 88] for numerical stability
-        float x = std::clamp(input[i], -88.0f, 88.0f);
-        output_cache_[i] = 1.0f / (1.0f + std::exp(-x));
-    }
+    forward_into(input, output_cache_);
     return output_cache_;
 }
 
-Tensor Sigmoid::backward(const Tensor& grad_output) {
-    Tensor grad_input(grad_output.rows, grad_output.cols);
-    for (size_t i = 0; i < grad_output.size(); ++i) {
-        float s = output_cache_[i];
-        grad_input[i] = grad_output[i] * s * (1.0f - s);
+void Sigmoid::forward_into(const Tensor& input, Tensor& output) {
+    output_ = &output;
+    output.resize(input.rows, input.cols);
+    AE_PROFILE_WORK(0.0, 8.0 * static_cast<double>(input.size()));
+    ThreadPool::global().parallel_for(input.size(), ThreadPool::ELEMENTWISE_GRAIN,
+                                      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            // Clamp to [-88, 88] for numerical stability
+            float x = std::clamp(input[i], -88.0f, 88.0f);
+            output[i] = 1.0f / (1.0f + std::exp(-x));
+        }
+    });
+}
+
+void Sigmoid::backward_into(const Tensor& grad_output, Tensor* grad_input) {
+    if (!grad_input) {
+        return;
     }
-    return grad_input;
+    const Tensor& output = *output_;
+    Tensor& dx = *grad_input;
+    dx.resize(grad_output.rows, grad_output.cols);
+    AE_PROFILE_WORK(0.0, 12.0 * static_cast<double>(grad_output.size()));
+    ThreadPool::global().parallel_for(grad_output.size(), ThreadPool::ELEMENTWISE_GRAIN,
+                                      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            float s = output[i];
+            dx[i] = grad_output[i] * s * (1.0f - s);
+        }
+    });
 }
@@ -4,10 +4,14 @@
 
 class Sigmoid : public Layer {
 public:
+    // The backward pass only needs the output, so the value API caches that
+    // instead of a copy of the input
     Tensor forward(const Tensor& input) override;
-    Tensor backward(const Tensor& grad_output) override;
+    void forward_into(const Tensor& input, Tensor& output) override;
+    void backward_into(const Tensor& grad_output, Tensor* grad_input) override;
     std::string name() const override { return "Sigmoid"; }
 
 private:
+    const Tensor* output_ = nullptr;
     Tensor output_cache_;
 };
@@ -1,37 +1,65 @@
 #include "optim/adam.h"
+#include "math/adam_kernel.h"
+#include "math/profiler.h"
+#include "math/thread_pool.h"
+#include <algorithm>
 #include <cmath>
+#include <stdexcept>
 
-Adam::Adam(std::vector<Parameter> params, float lr, float beta1, float beta2, float epsilon)
+static const std::string PROFILE_LABEL = "Adam step";
+
+Adam::Adam(std::vector<Parameter> params, float lr, float beta1, float beta2, float epsilon,
+           float weight_decay)
     : params_(std::move(params)), lr_(lr), beta1_(beta1), beta2_(beta2),
-      epsilon_(epsilon), t_(0) {
+      epsilon_(epsilon), weight_decay_(weight_decay), t_(0) {
 
+    offsets_.push_back(0);
     for (auto& p : params_) {
-        m_.push_back(Tensor::zeros(p.value->rows, p.value->cols));
-        v_.push_back(Tensor::zeros(p.value->rows, p.value->cols));
+        offsets_.push_back(offsets_.back() + p.value->size());
     }
+    m_ = Tensor::zeros(1, offsets_.back());
+    v_ = Tensor::zeros(1, offsets_.back());
+}
+
+void Adam::restore_state(const Tensor& m, const Tensor& v, int t) {
+    if (m.size() != m_.size() || v.size() != v_.size() || t < 0) {
+        throw std::invalid_argument("Adam: saved state does not match the parameters");
+    }
+    m_.data.assign(m.data.begin(), m.data.end());
+    v_.data.assign(v.data.begin(), v.data.end());
+    t_ = t;
 }
 
 void Adam::step() {
+    AE_PROFILE_SCOPE(PROFILE_LABEL);
+    // Reads parameter, gradient and both moments; writes parameter and moments
+    AE_PROFILE_WORK(0.0, 28.0 * static_cast<double>(offsets_.back()));
     t_++;
     float bc1 = 1.0f - std::pow(beta1_, static_cast<float>(t_));
     float bc2 = 1.0f - std::pow(beta2_, static_cast<float>(t_));
 
-    for (size_t i = 0; i < params_.size(); ++i) {
-        Tensor& param = *params_[i].value;
-        Tensor& grad = *params_[i].gradient;
-        Tensor& m = m_[i];
-        Tensor& v = v_[i];
+    AdamArgs args;
+    args.beta1 = beta1_;
+    args.beta2 = beta2_;
+    args.step_size = lr_ / bc1;
+    args.inv_sqrt_bc2 = 1.0f / std::sqrt(bc2);
+    args.epsilon = epsilon_;
+    args.decay = 1.0f - lr_ * weight_decay_;
 
-        for (size_t j = 0; j < param.size(); ++j) {
-            // Update biased first moment: m = beta1 * m + (1 - beta1) * g
-            m[j] = beta1_ * m[j] + (1.0f - beta1_) * grad[j];
-            // Update biased second moment: v = beta2 * v + (1 - beta2) * g^2
-            v[j] = beta2_ * v[j] + (1.0f - beta2_) * grad[j] * grad[j];
-            // Bias-corrected estimates
-            float m_hat = m[j] / bc1;
-            float v_hat = v[j] / bc2;
-            // Update parameter
-            param[j] -= lr_ * m_hat / (std::sqrt(v_hat) + epsilon_);
+    ThreadPool::global().parallel_for(offsets_.back(), ThreadPool::ELEMENTWISE_GRAIN,
+                                      [&](size_t begin, size_t end) {
+        // First parameter overlapping [begin, end), then every segment up to end
+        size_t i = std::upper_bound(offsets_.begin(), offsets_.end(), begin) - offsets_.begin() - 1;
+        for (; i < params_.size() && offsets_[i] < end; ++i) {
+            size_t lo = std::max(begin, offsets_[i]);
+            size_t hi = std::min(end, offsets_[i + 1]);
+            size_t local = lo - offsets_[i];
+            Tensor* half = params_[i].bf16_copy;
+            adam_update(args,
+                        params_[i].value->data.data() + local,
+                        params_[i].gradient->data.data() + local,
+                        m_.data.data() + lo, v_.data.data() + lo, hi - lo,
+                        half ? reinterpret_cast<uint16_t*>(half->data.data()) + local : nullptr);
         }
-    }
+    });
 }
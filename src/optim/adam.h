@@ -3,17 +3,36 @@
 #include "nn/layer.h"
 #include <vector>
 
+// Adam optimizer. With weight_decay > 0 it becomes AdamW: parameters decay by
+// lr * weight_decay each step, decoupled from the gradient moments.
+//
+// step() updates every parameter in one sweep over the concatenated parameter list:
+// the sweep is split into fixed chunks on the thread pool and each chunk runs the
+// fused SIMD kernel (math/adam_kernel.h) over the tensor segments it covers. The
+// kernel also refreshes each parameter's bf16 copy, if it has one (mixed precision).
 class Adam {
 public:
     Adam(std::vector<Parameter> params, float lr = 0.001f,
-         float beta1 = 0.9f, float beta2 = 0.999f, float epsilon = 1e-8f);
+         float beta1 = 0.9f, float beta2 = 0.999f, float epsilon = 1e-8f,
+         float weight_decay = 0.0f);
 
     void step();
 
+    // Optimizer state, for checkpoints: the moments of all parameters concatenated
+    // in parameter order, and the number of steps taken
+    const Tensor& first_moment() const { return m_; }
+    const Tensor& second_moment() const { return v_; }
+    int timestep() const { return t_; }
+
+    // Continue from a saved state; m and v must match first_moment()/second_moment()
+    // in shape
+    void restore_state(const Tensor& m, const Tensor& v, int t);
+
 private:
     std::vector<Parameter> params_;
-    std::vector<Tensor> m_;  // First moment estimates
-    std::vector<Tensor> v_;  // Second moment estimates
-    float lr_, beta1_, beta2_, epsilon_;
+    std::vector<size_t> offsets_;  // start of each parameter in the flattened sweep, plus the total
+    Tensor m_;  // First moment estimates, all parameters concatenated
+    Tensor v_;  // Second moment estimates, all parameters concatenated
+    float lr_, beta1_, beta2_, epsilon_, weight_decay_;
     int t_;  // Timestep
 };
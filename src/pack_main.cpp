@@ -0,0 +1,58 @@
+#include "io/dataset.h"
+#include "io/packed_dataset.h"
+#include "math/thread_pool.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog
+              << " <images> <output_pack> [--float] [--threads N]" << std::endl
+              << "  <images> is a directory of images or a text file"
+              << " listing one image path per line" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::string data_path = argv[1];
+    std::string out_path = argv[2];
+    auto dtype = PackedDataset::DType::UInt8;
+
+    for (int i = 3; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--float") == 0) {
+            dtype = PackedDataset::DType::Float32;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            int threads = std::atoi(argv[++i]);
+            if (threads > 0) {
+                ThreadPool::set_global_threads(static_cast<size_t>(threads));
+            }
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    ImageDataset dataset = ImageDataset::from_path(data_path);
+    if (dataset.is_packed()) {
+        std::cerr << data_path << " is already a pack file" << std::endl;
+        return 1;
+    }
+    std::cout << "Packing " << dataset.size() << " images from " << data_path
+              << " as " << (dtype == PackedDataset::DType::Float32 ? "float32" : "uint8")
+              << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    PackedDataset::write(dataset.paths(), out_path, dtype);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Wrote " << out_path << " in " << ms << "ms" << std::endl;
+    return 0;
+}
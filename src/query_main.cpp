@@ -0,0 +1,106 @@
+#include "models/autoencoder.h"
+#include "io/image_io.h"
+#include "io/latent_index.h"
+#include "io/model_io.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog
+              << " <model_path> <index_path> <image>... [--k K] [--nprobe N] [--names PATH]"
+              << std::endl
+              << "  Encodes each image and prints its K (default 10) nearest neighbours in the"
+              << " index, closest first, with squared latent distances" << std::endl
+              << "  --nprobe sets how many index cells are scanned (default 8; at least the"
+              << " cell count searches exactly)" << std::endl
+              << "  --names is the names file written by encode --names, to print image names"
+              << " instead of row numbers" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    size_t k = 10;
+    size_t nprobe = 8;
+    std::string names_path;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--k") == 0 && i + 1 < argc) {
+            k = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (std::strcmp(argv[i], "--nprobe") == 0 && i + 1 < argc) {
+            nprobe = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (std::strcmp(argv[i], "--names") == 0 && i + 1 < argc) {
+            names_path = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    if (positional.size() < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const std::string& model_path = positional[0];
+    const std::string& index_path = positional[1];
+
+    // Inference model mapped from the model file, run as saved. Query with the
+    // model (and precision) the indexed latents were encoded with.
+    std::string architecture = ModelIO::architecture(model_path);
+    Autoencoder model = Autoencoder::for_inference(precision_of(architecture),
+                                                   ModelSpec::of_architecture(architecture));
+    auto params = model.parameters();
+    ModelIO::map(params, model_path, model.architecture());
+
+    LatentIndex index(index_path);
+    if (index.dim() != model.latent_size()) {
+        std::cerr << index_path << " indexes " << index.dim() << "-d vectors, but the model's"
+                  << " latents are " << model.latent_size() << "-d" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> names;
+    if (!names_path.empty()) {
+        std::ifstream in(names_path);
+        if (!in) {
+            std::cerr << "Failed to open " << names_path << std::endl;
+            return 1;
+        }
+        for (std::string line; std::getline(in, line);) {
+            names.push_back(line);
+        }
+        if (names.size() != index.rows()) {
+            std::cerr << names_path << " has " << names.size() << " names for "
+                      << index.rows() << " indexed rows" << std::endl;
+            return 1;
+        }
+    }
+
+    size_t count = positional.size() - 2;
+    Tensor images = Tensor::uninitialized(count, ImageIO::FLAT_SIZE);
+    for (size_t i = 0; i < count; ++i) {
+        ImageIO::load_into(positional[i + 2], images.data.data() + i * ImageIO::FLAT_SIZE);
+    }
+    Tensor latents = model.encode(images);
+
+    for (size_t i = 0; i < count; ++i) {
+        std::vector<Neighbor> found =
+            index.search(latents.data.data() + i * model.latent_size(), k, nprobe);
+        std::cout << positional[i + 2] << ":" << std::endl;
+        for (size_t r = 0; r < found.size(); ++r) {
+            std::cout << "  " << r + 1 << ". ";
+            if (names.empty()) {
+                std::cout << "row " << found[r].row;
+            } else {
+                std::cout << names[found[r].row];
+            }
+            std::cout << "  " << found[r].distance << std::endl;
+        }
+    }
+    return 0;
+}
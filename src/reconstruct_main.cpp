@@ -1,32 +1,250 @@
 #include "models/autoencoder.h"
 #include "nn/mse_loss.h"
 #include "io/image_io.h"
+#include "io/dataset.h"
 #include "io/model_io.h"
+#include "io/batcher.h"
+#include "io/inference_server.h"
+#include "io/tiled_image.h"
+#include "math/thread_pool.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include <cmath>
 #include <string>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog
+              << " <model_path> <input> <output_image> [--index N] [--threads N]" << std::endl
+              << "       " << prog
+              << " <model_path> <image> <output_image> --tiled [--overlap N] [--tile-batch N]"
+              << " [--threads N]" << std::endl
+              << "       " << prog
+              << " <model_path> --serve [--socket PATH] [--max-batch N] [--max-delay-ms F]"
+              << " [--threads N]" << std::endl
+              << "       " << prog << " <model_path> --export-quantized|--export-bf16 PATH"
+              << std::endl
+              << "  --quantized (int8) and --bf16 convert a float32 model after loading and"
+              << " report the MSE change against float32; --export-quantized and"
+              << " --export-bf16 save the converted model" << std::endl
+              << "  <input> is an image, or a pack file / directory / list with --index"
+              << " selecting the image (default 0)" << std::endl
+              << "  --tiled reconstructs the image at its own size from overlapping 64x64"
+              << " tiles (default overlap 16, up to 256 tiles per batch), streaming it by row"
+              << " band; .ppm input and output stream from and to disk" << std::endl
+              << "  --serve reads requests from stdin (or the Unix socket) and batches them;"
+              << " see io/inference_server.h for the protocol" << std::endl;
+}
+
+// Inference model (no init, no gradients) of the layer stack a model file was saved
+// with, with its weights pointing at the memory-mapped file
+static Autoencoder load_model(const std::string& path, const std::string& architecture,
+                              Precision precision) {
+    Autoencoder model =
+        Autoencoder::for_inference(precision, ModelSpec::of_architecture(architecture));
+    auto params = model.parameters();
+    ModelIO::map(params, path, model.architecture());
+    return model;
+}
+
+// Float32 inference model whose weights borrow `reference`'s, so a model that is
+// about to be converted does not map and verify the file a second time
+static Autoencoder share_weights(const std::shared_ptr<Autoencoder>& reference,
+                                 const std::string& architecture) {
+    Autoencoder model = Autoencoder::for_inference(Precision::Float32,
+                                                   ModelSpec::of_architecture(architecture));
+    auto params = model.parameters();
+    auto source = reference->parameters();
+    for (size_t i = 0; i < params.size(); ++i) {
+        Tensor& value = *params[i].value;
+        value.data = TensorBuffer::borrow(source[i].value->data.data(), value.size(), reference);
+    }
+    return model;
+}
+
+static std::atomic<bool> stop_serving{false};
+
+static void handle_stop_signal(int) {
+    stop_serving.store(true);
+}
+
+// Long-running mode: load the model once and answer requests through a dynamic batcher
+static int serve(Autoencoder& model, const std::string& socket_path, const BatcherOptions& opts) {
+    // A client that disconnects early must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    DynamicBatcher batcher([&](const Tensor& inputs, Tensor& outputs, Tensor& latents) {
+        model.forward_into(inputs, outputs);
+        latents = model.latent();
+    }, ImageIO::FLAT_SIZE, opts);
+
+    std::cerr << "Serving with max batch " << opts.max_batch << ", max delay "
+              << opts.max_delay_ms << " ms on " << ThreadPool::global().num_threads()
+              << " threads" << std::endl;
+    if (socket_path.empty()) {
+        InferenceServer::serve_connection(batcher, STDIN_FILENO, STDOUT_FILENO);
+    } else {
+        struct sigaction sa {};
+        sa.sa_handler = handle_stop_signal;
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+        std::cerr << "Listening on " << socket_path << std::endl;
+        InferenceServer::serve_unix_socket(batcher, socket_path, stop_serving);
+    }
+    batcher.close();
+    std::cerr << InferenceServer::format_stats(batcher.stats()) << std::endl;
+    return 0;
+}
+
+// --tiled: the whole image at its own resolution, a tile row at a time
+static int run_tiled(Autoencoder& model, const std::string& input_path,
+                     const std::string& output_path, const TileOptions& opts) {
+    if (opts.overlap >= static_cast<size_t>(ImageIO::TARGET_SIZE)) {
+        std::cerr << "--overlap must be below " << ImageIO::TARGET_SIZE << std::endl;
+        return 1;
+    }
+    std::unique_ptr<ImageRowReader> input = ImageRowReader::open(input_path);
+    ImageRowWriter output(output_path, input->width(), input->height());
+    std::cout << "Loaded image: " << input_path << " (" << input->width() << "x"
+              << input->height() << ")" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    TileStats stats = reconstruct_tiled(*input, output, [&](const Tensor& tiles, Tensor& out) {
+        model.forward_into(tiles, out);
+    }, opts);
+    output.finish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Reconstructed " << stats.tiles << " tiles in " << stats.batches
+              << " batches in " << seconds << " s (" << stats.tiles / seconds << " tiles/s, "
+              << stats.buffer_bytes / (1024.0 * 1024.0) << " MiB working buffers)" << std::endl;
+    std::cout << "Reconstruction loss (MSE): " << stats.mse << std::endl;
+    std::cout << "Saved reconstruction to " << output_path << std::endl;
+    return 0;
+}
 
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cerr << "Usage: " << argv[0]
-                  << " <model_path> <input_image> <output_image>" << std::endl;
+    std::vector<std::string> positional;
+    size_t index = 0;
+    bool serve_mode = false;
+    Precision precision = Precision::Float32;
+    std::string export_path;
+    std::string socket_path;
+    BatcherOptions batcher_opts;
+    bool tiled = false;
+    TileOptions tile_opts;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            index = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            int threads = std::atoi(argv[++i]);
+            if (threads > 0) {
+                ThreadPool::set_global_threads(static_cast<size_t>(threads));
+            }
+        } else if (std::strcmp(argv[i], "--tiled") == 0) {
+            tiled = true;
+        } else if (std::strcmp(argv[i], "--overlap") == 0 && i + 1 < argc) {
+            tile_opts.overlap = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--tile-batch") == 0 && i + 1 < argc) {
+            tile_opts.max_batch = std::max<size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+        } else if (std::strcmp(argv[i], "--serve") == 0) {
+            serve_mode = true;
+        } else if (std::strcmp(argv[i], "--quantized") == 0) {
+            precision = Precision::Int8;
+        } else if (std::strcmp(argv[i], "--bf16") == 0) {
+            precision = Precision::BF16;
+        } else if (std::strcmp(argv[i], "--export-quantized") == 0 && i + 1 < argc) {
+            export_path = argv[++i];
+            precision = Precision::Int8;
+        } else if (std::strcmp(argv[i], "--export-bf16") == 0 && i + 1 < argc) {
+            export_path = argv[++i];
+            precision = Precision::BF16;
+        } else if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--max-batch") == 0 && i + 1 < argc) {
+            batcher_opts.max_batch = std::max(std::atoi(argv[++i]), 1);
+        } else if (std::strcmp(argv[i], "--max-delay-ms") == 0 && i + 1 < argc) {
+            batcher_opts.max_delay_ms = std::max(std::atof(argv[++i]), 0.0);
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    bool export_only = !export_path.empty() && positional.size() == 1;
+    if (positional.size() != (serve_mode || export_only ? 1u : 3u)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    std::string model_path = positional[0];
+
+    // An exported int8 or bf16 model runs as saved; a float32 model is converted
+    // after loading and kept as the reference for the MSE comparison
+    std::string architecture = ModelIO::architecture(model_path);
+    Precision stored = precision_of(architecture);
+    if (stored != Precision::Float32 && precision != Precision::Float32 && precision != stored) {
+        std::cerr << model_path << " is a " << precision_name(stored)
+                  << " model and cannot be converted to " << precision_name(precision)
+                  << std::endl;
         return 1;
     }
+    std::shared_ptr<Autoencoder> reference;
+    if (stored == Precision::Float32 && precision != Precision::Float32) {
+        reference = std::make_shared<Autoencoder>(
+            load_model(model_path, architecture, Precision::Float32));
+    }
+    Autoencoder model = reference ? share_weights(reference, architecture)
+                                  : load_model(model_path, architecture, stored);
+    if (reference) {
+        if (precision == Precision::Int8) {
+            model.quantize();
+        } else {
+            model.use_bf16_weights(false);
+        }
+    } else {
+        precision = stored;
+    }
+    // In serve mode stdout carries the protocol, so progress goes to stderr
+    (serve_mode ? std::cerr : std::cout) << "Loaded " << precision_name(precision)
+        << " model from " << model_path << std::endl;
 
-    std::string model_path = argv[1];
-    std::string input_path = argv[2];
-    std::string output_path = argv[3];
+    if (!export_path.empty()) {
+        ModelIO::save(model.parameters(), export_path, model.architecture());
+        std::cout << "Saved " << precision_name(precision) << " model to " << export_path
+                  << std::endl;
+        if (export_only) {
+            return 0;
+        }
+    }
+    if (serve_mode) {
+        return serve(model, socket_path, batcher_opts);
+    }
+    std::string input_path = positional[1];
+    std::string output_path = positional[2];
 
-    // Build model and load weights
-    Autoencoder model;
-    auto params = model.parameters();
-    ModelIO::load(params, model_path);
-    std::cout << "Loaded model from " << model_path << std::endl;
+    if (tiled) {
+        return run_tiled(model, input_path, output_path, tile_opts);
+    }
 
     // Load input image
-    Tensor input = ImageIO::load(input_path);
-    std::cout << "Loaded image: " << input_path << std::endl;
+    ImageDataset source = ImageDataset::from_path(input_path);
+    if (index >= source.size()) {
+        std::cerr << "--index " << index << " out of range (" << source.size()
+                  << " images)" << std::endl;
+        return 1;
+    }
+    Tensor input = source.load_batch({index});
+    std::cout << "Loaded image: " << source.name(index) << std::endl;
 
     // Encode to latent space
     Tensor latent = model.encode(input);
@@ -62,6 +280,13 @@ int main(int argc, char* argv[]) {
     // Print results
     std::cout << std::endl;
     std::cout << "Reconstruction loss (MSE): " << loss << std::endl;
+    if (reference) {
+        float reference_loss = loss_fn.forward(reference->forward(input), input);
+        std::cout << "  float32 MSE: " << reference_loss << ", " << precision_name(precision)
+                  << " MSE: " << loss
+                  << " (delta " << std::showpos << loss - reference_loss << std::noshowpos
+                  << ")" << std::endl;
+    }
     std::cout << std::endl;
     std::cout << "Latent vector (" << latent.size() << " dims):" << std::endl;
     std::cout << "  min:  " << lat_min << std::endl;
@@ -1,30 +1,85 @@
 #include "models/autoencoder.h"
 #include "nn/mse_loss.h"
 #include "optim/adam.h"
-#include "io/image_io.h"
+#include "io/dataset.h"
+#include "io/data_loader.h"
 #include "io/model_io.h"
+#include "io/checkpoint.h"
+#include "io/image_io.h"
+#include "io/allreduce.h"
+#include "math/bf16.h"
+#include "math/profiler.h"
+#include "math/thread_pool.h"
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <chrono>
 #include <cstring>
+#include <memory>
+#include <signal.h>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 static void print_usage(const char* prog) {
     std::cerr << "Usage: " << prog
-              << " <input_image> <output_model_path> [--epochs N] [--lr F]"
-              << std::endl;
+              << " <images> <output_model_path> [--epochs N] [--lr F] [--batch-size B]"
+              << " [--weight-decay F] [--seed N] [--threads N] [--loader-threads N]"
+              << " [--checkpoint-every N] [--checkpoint PATH] [--resume PATH] [--arch PATH|--conv]"
+              << " [--bf16] [--profile] [--trace PATH]"
+              << " [--workers N | --rank R --world-size N --rendezvous HOST:PORT]" << std::endl
+              << "  <images> is an image file, a directory of images, or a text file"
+              << " listing one image path per line" << std::endl
+              << "  --checkpoint-every N writes a checkpoint (parameters, optimizer state and"
+              << " data position) every N steps, to <output_model_path>.ckpt by default;"
+              << " --resume continues training from one" << std::endl
+              << "  --arch builds the layer stack from a model spec file (see"
+              << " models/model_spec.h); --conv trains the built-in convolutional autoencoder"
+              << " instead of the fully connected one" << std::endl
+              << "  --bf16 trains in mixed precision: the GEMMs read bf16 weights while Adam"
+              << " updates float32 master weights, which are what gets saved" << std::endl
+              << "  --profile prints per-layer time, FLOP/s, bandwidth and allocations after"
+              << " each epoch; --trace also writes every timed call as Chrome trace JSON"
+              << std::endl
+              << "  --workers N trains data-parallel in N local processes, each on a shard of"
+              << " the images with its own batch of B, averaging gradients over TCP after"
+              << " every step; --rank, --world-size and --rendezvous start one process of a"
+              << " job spread over several machines (rank 0 listens on PORT). Rank 0 saves"
+              << " the model and checkpoints; to resume, every process needs the checkpoint and"
+              << " the same number of processes" << std::endl;
 }
 
-int main(int argc, char* argv[]) {
+// Rank 0 of a --workers job fills `children` with the pids it forked; main reaps them
+static int train(int argc, char* argv[], std::vector<pid_t>& children) {
     if (argc < 3) {
         print_usage(argv[0]);
         return 1;
     }
 
-    std::string image_path = argv[1];
+    std::string data_path = argv[1];
     std::string model_path = argv[2];
     int epochs = 500;
     float lr = 0.001f;
+    float weight_decay = 0.0f;  // > 0 switches Adam to AdamW
+    int batch_size = 16;
+    unsigned seed = 42;
+    int threads = 0;  // 0 = keep the default (AE_NUM_THREADS or all cores)
+    int loader_threads = 2;
+    long checkpoint_every = 0;  // steps between checkpoints (0 = off)
+    std::string checkpoint_path;
+    std::string resume_path;
+    std::string arch_path;
+    bool conv = false;
+    bool bf16 = false;
+    bool profile = false;
+    std::string trace_path;
+    int workers = 1;
+    long rank_arg = -1;
+    int world_size = 1;
+    std::string rendezvous;
 
     // Parse optional arguments
     for (int i = 3; i < argc; ++i) {
@@ -32,6 +87,41 @@ int main(int argc, char* argv[]) {
             epochs = std::atoi(argv[++i]);
         } else if (std::strcmp(argv[i], "--lr") == 0 && i + 1 < argc) {
             lr = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--weight-decay") == 0 && i + 1 < argc) {
+            weight_decay = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--batch-size") == 0 && i + 1 < argc) {
+            batch_size = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--loader-threads") == 0 && i + 1 < argc) {
+            loader_threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            checkpoint_every = std::atol(argv[++i]);
+        } else if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            resume_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--arch") == 0 && i + 1 < argc) {
+            arch_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--conv") == 0) {
+            conv = true;
+        } else if (std::strcmp(argv[i], "--bf16") == 0) {
+            bf16 = true;
+        } else if (std::strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+            profile = true;
+        } else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--rank") == 0 && i + 1 < argc) {
+            rank_arg = std::atol(argv[++i]);
+        } else if (std::strcmp(argv[i], "--world-size") == 0 && i + 1 < argc) {
+            world_size = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--rendezvous") == 0 && i + 1 < argc) {
+            rendezvous = argv[++i];
         } else {
             std::cerr << "Unknown argument: " << argv[i] << std::endl;
             print_usage(argv[0]);
@@ -39,20 +129,179 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    // Load image
-    std::cout << "Loading image: " << image_path << std::endl;
-    Tensor input = ImageIO::load(image_path);
+    if (batch_size < 1) {
+        std::cerr << "--batch-size must be at least 1" << std::endl;
+        return 1;
+    }
 
-    std::cout << "Training for " << epochs << " epochs with lr=" << lr << std::endl;
-    std::cout << std::endl;
+    // Data-parallel processes: --workers forks local ones (this process is rank 0),
+    // --rank joins a job whose rank 0 listens at --rendezvous. Forking happens before
+    // any thread is started.
+    size_t world = 1, rank = 0;
+    std::string root_host = "127.0.0.1";
+    uint16_t root_port = 0;
+    std::unique_ptr<Ring::Listener> listener;
+    if (workers > 1 && rank_arg < 0) {
+        world = static_cast<size_t>(workers);
+        listener.reset(new Ring::Listener());
+        root_port = listener->port();
+        std::cout.flush();
+        for (size_t r = 1; r < world; ++r) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                std::cerr << "Failed to start worker " << r << std::endl;
+                return 1;
+            }
+            if (pid == 0) {
+                rank = r;
+                listener->close();
+                children.clear();
+                break;
+            }
+            children.push_back(pid);
+        }
+        // The workers share this machine's cores
+        if (threads <= 0) {
+            threads = static_cast<int>(std::max<size_t>(
+                1, std::thread::hardware_concurrency() / world));
+        }
+    } else if (rank_arg >= 0) {
+        size_t colon = rendezvous.rfind(':');
+        if (world_size < 1 || rank_arg >= world_size || colon == std::string::npos || workers > 1) {
+            std::cerr << "--rank needs --world-size above it and --rendezvous HOST:PORT"
+                      << " (and no --workers)" << std::endl;
+            return 1;
+        }
+        world = static_cast<size_t>(world_size);
+        rank = static_cast<size_t>(rank_arg);
+        root_host = rendezvous.substr(0, colon);
+        root_port = static_cast<uint16_t>(std::atoi(rendezvous.c_str() + colon + 1));
+        if (rank == 0) {
+            listener.reset(new Ring::Listener(root_port));
+        }
+    }
+    // Only rank 0 reports and saves
+    if (rank != 0) {
+        std::cout.setstate(std::ios_base::badbit);
+    }
+
+    if (threads > 0) {
+        ThreadPool::set_global_threads(static_cast<size_t>(threads));
+    }
 
-    // Build model and optimizer
-    Autoencoder model;
+    if (profile) {
+#ifndef AE_PROFILE
+        std::cerr << "Warning: built with AE_PROFILE=OFF, so --profile has nothing to report"
+                  << std::endl;
+#endif
+        Profiler::global().enable(!trace_path.empty());
+    }
+
+    ModelSpec spec = conv ? ModelSpec::conv() : ModelSpec::dense();
+    if (!arch_path.empty()) {
+        try {
+            spec = ModelSpec::load(arch_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (spec.input_size() != static_cast<size_t>(ImageIO::FLAT_SIZE)) {
+        std::cerr << arch_path << " takes " << spec.input_size() << " input values, but images"
+                  << " have " << ImageIO::FLAT_SIZE << std::endl;
+        return 1;
+    }
+
+    // Build model and optimizer. In mixed precision the parameters carry bf16 copies
+    // of the weights, which the optimizer refreshes on every step.
+    Autoencoder model(spec);
+    if (bf16) {
+        model.use_bf16_weights(true);
+    }
     auto params = model.parameters();
-    Adam optimizer(params, lr);
+    Adam optimizer(params, lr, 0.9f, 0.999f, 1e-8f, weight_decay);
     MSELoss loss_fn;
 
-    std::cout << "Model parameters: " << params.size() << " tensors" << std::endl;
+    // Resuming restores the weights, optimizer state and data position, and takes the
+    // seed from the checkpoint so the shuffles continue where they left off
+    uint64_t start_batch = 0;
+    if (!resume_path.empty()) {
+        Checkpoint checkpoint = CheckpointIO::load(resume_path);
+        if (checkpoint.architecture != model.architecture()) {
+            std::cerr << "Checkpoint " << resume_path << " was saved for a different architecture"
+                      << std::endl;
+            return 1;
+        }
+        if (checkpoint.batch_size != static_cast<uint64_t>(batch_size)) {
+            std::cerr << "Checkpoint " << resume_path << " was saved with --batch-size "
+                      << checkpoint.batch_size << "; resume with the same batch size" << std::endl;
+            return 1;
+        }
+        checkpoint.restore(params, optimizer);
+        seed = checkpoint.seed;
+        start_batch = checkpoint.batches_done;
+        std::cout << "Resumed from " << resume_path << " at step " << start_batch << std::endl;
+    }
+
+    // Every rank starts from rank 0's weights. During training, backward hands each
+    // layer's gradients to the all-reduce thread as soon as they are final, and the
+    // optimizer steps on the mean over all ranks, so the replicas stay identical.
+    std::unique_ptr<Ring> ring;
+    std::unique_ptr<GradientAllReduce> grad_sync;
+    if (world > 1) {
+        // A local worker that exits before joining would leave rank 0 waiting for it
+        auto check_children = [&children] {
+            for (size_t i = 0; i < children.size(); ++i) {
+                int status = 0;
+                if (waitpid(children[i], &status, WNOHANG) == children[i]) {
+                    children.erase(children.begin() + static_cast<std::ptrdiff_t>(i));
+                    throw std::runtime_error("A worker process exited before joining the ring");
+                }
+            }
+        };
+        ring.reset(rank == 0 ? new Ring(*listener, world, check_children)
+                             : new Ring(root_host, root_port, rank, world));
+        for (const auto& p : params) {
+            ring->broadcast(p.value->data.data(), p.value->size());
+            if (Tensor* half = p.bf16_copy) {
+                convert_to_bf16(p.value->data.data(), reinterpret_cast<uint16_t*>(half->data.data()),
+                                p.value->size());
+            }
+        }
+        grad_sync.reset(new GradientAllReduce(*ring, params));
+        model.set_gradient_hook([&](size_t begin, size_t end) { grad_sync->mark_ready(begin, end); });
+    }
+
+    // Index the dataset; background threads decode batches ahead of the trainer
+    ImageDataset dataset = ImageDataset::from_path(data_path);
+    DataLoaderOptions loader_opts;
+    loader_opts.batch_size = static_cast<size_t>(batch_size);
+    loader_opts.num_workers = static_cast<size_t>(std::max(loader_threads, 1));
+    loader_opts.seed = seed;
+    loader_opts.epochs = static_cast<size_t>(epochs);
+    loader_opts.start_batch = start_batch;
+    loader_opts.shard_index = rank;
+    loader_opts.shard_count = world;
+    DataLoader loader(dataset, loader_opts);
+    size_t shard_images = (dataset.size() + world - 1) / world;
+    size_t batch = std::min(static_cast<size_t>(batch_size), shard_images);
+    size_t steps_per_epoch = loader.batches_per_epoch();
+    std::cout << "Dataset: " << dataset.size() << " images from " << data_path << std::endl;
+
+    std::cout << "Training for " << epochs << " epochs with lr=" << lr
+              << ", batch size " << batch << " (" << steps_per_epoch << " steps/epoch)"
+              << " on " << ThreadPool::global().num_threads() << " threads" << std::endl;
+    if (world > 1) {
+        std::cout << "Data-parallel over " << world << " processes: " << world << " shards of "
+                  << shard_images << " images, global batch "
+                  << batch * world << ", gradients all-reduced in " << grad_sync->buckets()
+                  << " buckets" << std::endl;
+    }
+    std::cout << std::endl;
+
+    std::cout << "Model: " << model.architecture() << std::endl;
+    std::cout << params.size() << " parameter tensors, latent size " << model.latent_size()
+              << std::endl;
     size_t total_params = 0;
     for (const auto& p : params) {
         total_params += p.value->size();
@@ -63,29 +312,95 @@ int main(int argc, char* argv[]) {
     // Training loop
     auto total_start = std::chrono::steady_clock::now();
 
-    for (int epoch = 0; epoch < epochs; ++epoch) {
+    // Activation and gradient buffers reach their steady-state size on the first
+    // step; after that a training step performs no heap allocations
+    Tensor output, grad;
+
+    // Checkpoints are written from a snapshot on a background thread; the loop only
+    // waits for the copy into the snapshot
+    std::unique_ptr<CheckpointWriter> checkpoints;
+    if (checkpoint_every > 0 && rank == 0) {
+        checkpoints.reset(new CheckpointWriter(
+            checkpoint_path.empty() ? model_path + ".ckpt" : checkpoint_path));
+    }
+    const std::string data_label = "data wait";
+    const std::string checkpoint_label = "checkpoint snapshot";
+    auto next_batch = [&]() {
+        AE_PROFILE_SCOPE(data_label);
+        return loader.next();
+    };
+    auto write_checkpoint = [&](uint64_t batches_done) {
+        AE_PROFILE_SCOPE(checkpoint_label);
+        checkpoints->submit([&](Checkpoint& c) {
+            c.capture(params, optimizer);
+            c.architecture = model.architecture();
+            c.batches_done = batches_done;
+            c.batch_size = static_cast<uint64_t>(batch_size);
+            c.seed = seed;
+        });
+    };
+
+    uint64_t step = start_batch;
+    int start_epoch = static_cast<int>(start_batch / steps_per_epoch);
+    for (int epoch = start_epoch; epoch < epochs; ++epoch) {
         auto epoch_start = std::chrono::steady_clock::now();
 
-        // Forward pass
-        model.zero_gradients();
-        Tensor output = model.forward(input);
-        float loss = loss_fn.forward(output, input);
+        double epoch_loss = 0.0;
+        size_t epoch_samples = 0;  // less than the dataset when resuming mid-epoch
+        while (const Tensor* batch_ptr = next_batch()) {
+            const Tensor& input = *batch_ptr;
+
+            // Forward pass and loss gradient into reused buffers. Dense layers
+            // overwrite their gradients, so no zeroing is needed between steps.
+            model.forward_into(input, output);
+            float loss = loss_fn.forward_backward(output, input, grad);
+
+            // Backward pass (the input gradient is never used, so skip it)
+            model.backward_into(grad, nullptr);
+
+            // Update weights, once the other ranks' gradients are averaged in
+            if (grad_sync) {
+                grad_sync->wait();
+            }
+            optimizer.step();
 
-        // Backward pass
-        Tensor grad = loss_fn.backward();
-        model.backward(grad);
+            epoch_loss += static_cast<double>(loss) * static_cast<double>(input.rows);
+            epoch_samples += input.rows;
 
-        // Update weights
-        optimizer.step();
+            if (checkpoints && ++step % static_cast<uint64_t>(checkpoint_every) == 0) {
+                write_checkpoint(step);
+            }
+        }
 
         auto epoch_end = std::chrono::steady_clock::now();
         auto epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
             epoch_end - epoch_start).count();
+        double wait_ms = loader.take_wait_seconds() * 1000.0;
+        double comm_wait_ms = 0.0;
+        if (ring) {
+            // Loss and samples over all ranks
+            float totals[2] = {static_cast<float>(epoch_loss), static_cast<float>(epoch_samples)};
+            ring->allreduce_sum(totals, 2);
+            epoch_loss = totals[0];
+            epoch_samples = static_cast<size_t>(totals[1]);
+            comm_wait_ms = grad_sync->take_wait_seconds() * 1000.0;
+        }
+        double ms_per_sample = static_cast<double>(epoch_ms) / static_cast<double>(epoch_samples);
 
         std::cout << "Epoch " << (epoch + 1) << "/" << epochs
-                  << "  loss=" << loss
+                  << "  loss=" << epoch_loss / static_cast<double>(epoch_samples)
                   << "  time=" << epoch_ms << "ms"
-                  << std::endl;
+                  << "  (" << ms_per_sample << " ms/sample)"
+                  << "  data_wait=" << wait_ms << "ms";
+        if (ring) {
+            std::cout << "  comm_wait=" << comm_wait_ms << "ms";
+        }
+        std::cout << std::endl;
+        if (profile) {
+            double epoch_seconds = std::chrono::duration<double>(epoch_end - epoch_start).count();
+            Profiler::global().write_summary(std::cout, epoch_seconds);
+            Profiler::global().reset();
+        }
     }
 
     auto total_end = std::chrono::steady_clock::now();
@@ -94,9 +409,52 @@ int main(int argc, char* argv[]) {
     std::cout << std::endl;
     std::cout << "Training complete in " << total_sec << "s" << std::endl;
 
+    if (!trace_path.empty()) {
+        Profiler::global().write_trace(trace_path);
+        std::cout << "Trace written to " << trace_path << std::endl;
+    }
+
+    if (rank != 0) {
+        return 0;
+    }
+
     // Save model
-    ModelIO::save(model.parameters(), model_path);
+    ModelIO::save(model.parameters(), model_path, model.architecture());
     std::cout << "Model saved to " << model_path << std::endl;
 
+    if (checkpoints) {
+        if (step % static_cast<uint64_t>(checkpoint_every) != 0) {
+            write_checkpoint(step);
+        }
+        checkpoints->wait();
+        std::cout << "Checkpoint saved to " << checkpoints->path() << std::endl;
+    }
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    std::vector<pid_t> children;
+    int result = 1;
+    try {
+        result = train(argc, argv, children);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+
+    // If rank 0 failed, its workers would only wait on it: stop them before reaping
+    if (result != 0) {
+        for (pid_t child : children) {
+            kill(child, SIGTERM);
+        }
+    }
+    for (pid_t child : children) {
+        int status = 0;
+        if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            if (result == 0) {
+                std::cerr << "A worker process failed" << std::endl;
+                result = 1;
+            }
+        }
+    }
+    return result;
+}
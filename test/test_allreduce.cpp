@@ -0,0 +1,118 @@
+#include "io/allreduce.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+static bool approx(float a, float b, float eps = 1e-4f) {
+    return std::fabs(a - b) < eps;
+}
+
+void test_ring_allreduce() {
+    const size_t ranks = 3;
+    Ring::Listener listener;
+    // Rank r holds value r + i / 8 at i (exact in float, so is every sum)
+    auto fill = [](std::vector<float>& v, size_t r) {
+        for (size_t i = 0; i < v.size(); ++i) v[i] = static_cast<float>(r) + (i % 64) / 8.0f;
+    };
+
+    // Gradients of 4 fake parameters with rank-dependent values, one untrained
+    struct Replica {
+        std::vector<Tensor> values, grads;
+        std::vector<Parameter> params;
+    };
+    std::vector<Replica> replicas(ranks);
+    for (size_t r = 0; r < ranks; ++r) {
+        const size_t sizes[4] = {50, 3, 200, 7};
+        for (size_t p = 0; p < 4; ++p) {
+            replicas[r].values.emplace_back(1, sizes[p]);
+            replicas[r].grads.emplace_back(1, sizes[p], static_cast<float>(r * 3 + p));
+        }
+        for (size_t p = 0; p < 4; ++p) {
+            replicas[r].params.push_back({&replicas[r].values[p],
+                                          p == 1 ? nullptr : &replicas[r].grads[p]});
+        }
+    }
+
+    std::vector<std::vector<float>> results(ranks);
+    std::vector<std::thread> threads;
+    for (size_t r = 0; r < ranks; ++r) {
+        threads.emplace_back([&, r] {
+            std::unique_ptr<Ring> ring(r == 0 ? new Ring(listener, ranks)
+                                              : new Ring("127.0.0.1", listener.port(), r, ranks));
+            assert(ring->rank() == r && ring->size() == ranks);
+
+            // Sizes that do not split evenly, including fewer values than ranks
+            for (size_t n : {size_t(1000), size_t(2), size_t(0)}) {
+                std::vector<float> v(n);
+                fill(v, r);
+                ring->allreduce_sum(v.data(), n);
+                for (size_t i = 0; i < n; ++i) assert(v[i] == 3.0f + 3.0f * (i % 64) / 8.0f);
+                if (n == 1000) results[r] = v;
+            }
+            std::vector<float> b(10, static_cast<float>(r + 1));
+            ring->broadcast(b.data(), b.size());
+            for (float x : b) assert(x == 1.0f);
+
+            // Two steps with parameters marked in backward order, in small buckets
+            Replica& rep = replicas[r];
+            GradientAllReduce sync(*ring, rep.params, 5 * sizeof(float));
+            assert(sync.buckets() == 3);
+            for (int step = 0; step < 2; ++step) {
+                for (size_t p = 0; p < 4; ++p) {
+                    std::fill(rep.grads[p].data.begin(), rep.grads[p].data.end(),
+                              static_cast<float>(r * 3 + p + step));
+                }
+                sync.mark_ready(3, 4);
+                sync.mark_ready(2, 3);
+                sync.mark_ready(0, 2);
+                sync.wait();
+                for (size_t p : {size_t(0), size_t(2), size_t(3)}) {
+                    for (size_t i = 0; i < rep.grads[p].size(); ++i) {
+                        assert(approx(rep.grads[p][i], static_cast<float>(3 + p + step)));
+                    }
+                }
+                // Untrained parameter untouched
+                assert(rep.grads[1][0] == static_cast<float>(r * 3 + 1 + step));
+            }
+            assert(sync.take_wait_seconds() >= 0.0);
+        });
+    }
+    for (auto& t : threads) t.join();
+    // Every rank holds bitwise identical sums
+    assert(results[0] == results[1] && results[1] == results[2]);
+
+    printf("  PASS: ring all-reduce\n");
+}
+
+// Rank 0's waiting callback can give up on ranks that never connect
+void test_ring_abandoned() {
+    Ring::Listener listener;
+    int calls = 0;
+    bool threw = false;
+    try {
+        Ring ring(listener, 3, [&calls] {
+            if (++calls == 2) {
+                throw std::runtime_error("rank gone");
+            }
+        });
+    } catch (const std::runtime_error& e) {
+        threw = std::string(e.what()) == "rank gone";
+    }
+    assert(threw && calls == 2);
+
+    printf("  PASS: abandoned ring\n");
+}
+
+int main() {
+    printf("Running all-reduce tests...\n");
+    test_ring_allreduce();
+    test_ring_abandoned();
+    printf("All all-reduce tests passed!\n");
+    return 0;
+}
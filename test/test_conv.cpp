@@ -0,0 +1,306 @@
+#include "nn/conv2d.h"
+#include "nn/pooling.h"
+#include "nn/network.h"
+#include "nn/relu.h"
+#include "nn/sigmoid.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+static bool approx(float a, float b, float eps = 1e-4f) {
+    return std::fabs(a - b) < eps;
+}
+
+static ConvGeometry geometry(size_t channels, size_t height, size_t width, size_t kernel,
+                             size_t stride, size_t padding,
+                             ImageLayout layout = ImageLayout::NHWC) {
+    ConvGeometry g;
+    g.channels = channels; g.height = height; g.width = width;
+    g.kernel = kernel; g.stride = stride; g.padding = padding;
+    g.layout = layout;
+    return g;
+}
+
+// Reorder a batch of images between NHWC and NCHW
+static Tensor to_nchw(const Tensor& t, size_t C, size_t pixels) {
+    Tensor r(t.rows, t.cols);
+    for (size_t n = 0; n < t.rows; ++n)
+        for (size_t q = 0; q < pixels; ++q)
+            for (size_t c = 0; c < C; ++c) r(n, c * pixels + q) = t(n, q * C + c);
+    return r;
+}
+
+// Direct convolution of NHWC images, straight from the definition
+static Tensor reference_conv(const Tensor& x, const ConvGeometry& g, const Tensor& W,
+                             const Tensor& b, size_t F) {
+    size_t OH = g.out_height(), OW = g.out_width();
+    Tensor y(x.rows, OH * OW * F);
+    for (size_t n = 0; n < x.rows; ++n)
+        for (size_t oh = 0; oh < OH; ++oh)
+            for (size_t ow = 0; ow < OW; ++ow)
+                for (size_t f = 0; f < F; ++f) {
+                    float sum = b[f];
+                    for (size_t kh = 0; kh < g.kernel; ++kh)
+                        for (size_t kw = 0; kw < g.kernel; ++kw) {
+                            long ih = long(oh * g.stride + kh) - long(g.padding);
+                            long iw = long(ow * g.stride + kw) - long(g.padding);
+                            if (ih < 0 || iw < 0 || ih >= long(g.height) || iw >= long(g.width)) continue;
+                            for (size_t c = 0; c < g.channels; ++c)
+                                sum += W((kh * g.kernel + kw) * g.channels + c, f) *
+                                       x(n, (size_t(ih) * g.width + size_t(iw)) * g.channels + c);
+                        }
+                    y(n, (oh * OW + ow) * F + f) = sum;
+                }
+    return y;
+}
+
+// Transposed convolution: every input pixel scatters its weighted window into the output
+static Tensor reference_conv_transpose(const Tensor& x, const ConvGeometry& g, const Tensor& W,
+                                       const Tensor& b, size_t F, size_t OH, size_t OW) {
+    Tensor y(x.rows, OH * OW * F);
+    for (size_t n = 0; n < x.rows; ++n) {
+        for (size_t q = 0; q < OH * OW; ++q)
+            for (size_t f = 0; f < F; ++f) y(n, q * F + f) = b[f];
+        for (size_t ih = 0; ih < g.height; ++ih)
+            for (size_t iw = 0; iw < g.width; ++iw)
+                for (size_t kh = 0; kh < g.kernel; ++kh)
+                    for (size_t kw = 0; kw < g.kernel; ++kw) {
+                        long oh = long(ih * g.stride + kh) - long(g.padding);
+                        long ow = long(iw * g.stride + kw) - long(g.padding);
+                        if (oh < 0 || ow < 0 || oh >= long(OH) || ow >= long(OW)) continue;
+                        for (size_t c = 0; c < g.channels; ++c)
+                            for (size_t f = 0; f < F; ++f)
+                                y(n, (size_t(oh) * OW + size_t(ow)) * F + f) +=
+                                    x(n, (ih * g.width + iw) * g.channels + c) *
+                                    W(c, (kh * g.kernel + kw) * F + f);
+                    }
+    }
+    return y;
+}
+
+// Finite-difference check of the input and parameter gradients of loss = sum(y * R)
+static void check_gradients(Layer& layer, Tensor x) {
+    Tensor y = layer.forward(x);
+    Tensor R = Tensor::randn(y.rows, y.cols, 0.0f, 1.0f);
+    Tensor dx = layer.backward(R);
+    auto loss = [&]() {
+        Tensor out = layer.forward(x);
+        double sum = 0.0;
+        for (size_t i = 0; i < out.size(); ++i) sum += double(out[i]) * R[i];
+        return sum;
+    };
+    auto numerical = [&](float& v) {
+        float orig = v, eps = 1e-2f;
+        v = orig + eps;
+        double plus = loss();
+        v = orig - eps;
+        double minus = loss();
+        v = orig;
+        return float((plus - minus) / (2.0 * eps));
+    };
+    assert(dx.rows == x.rows && dx.cols == x.cols);
+    for (size_t i = 0; i < x.size(); ++i) assert(approx(dx[i], numerical(x[i]), 5e-3f));
+    for (auto& p : layer.parameters()) {
+        const Tensor& grad = *p.gradient;
+        for (size_t i = 0; i < p.value->size(); ++i) {
+            assert(approx(grad[i], numerical((*p.value)[i]), 5e-3f));
+        }
+    }
+}
+
+void test_conv2d_forward() {
+    // Odd sizes, stride 2 and padding 1; and the 1x1 path that skips im2col
+    for (ConvGeometry g : {geometry(3, 5, 7, 3, 2, 1), geometry(2, 6, 6, 2, 1, 0),
+                           geometry(4, 3, 5, 1, 1, 0)}) {
+        Conv2DLayer conv(g, 5);
+        auto params = conv.parameters();
+        Tensor& W = *params[0].value;
+        Tensor& b = *params[1].value;
+        assert(W.rows == g.patch_size() && W.cols == 5);
+        b = Tensor::randn(1, 5, 0.0f, 1.0f);
+        Tensor x = Tensor::randn(2, g.image_size(), 0.0f, 1.0f);
+        Tensor y = conv.forward(x);
+        Tensor expected = reference_conv(x, g, W, b, 5);
+        assert(y.rows == 2 && y.cols == conv.output_size() && y.cols == expected.cols);
+        for (size_t i = 0; i < y.size(); ++i) assert(approx(y[i], expected[i]));
+
+        // A fused ReLU clamps the same values
+        conv.set_activation(Activation::ReLU);
+        Tensor r = conv.forward(x);
+        for (size_t i = 0; i < r.size(); ++i) assert(approx(r[i], std::max(expected[i], 0.0f)));
+    }
+    bool threw = false;
+    try {
+        Conv2DLayer(geometry(3, 2, 2, 5, 1, 0), 4);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    printf("  PASS: conv2d forward matches direct convolution\n");
+}
+
+void test_conv2d_gradient_check() {
+    for (ConvGeometry g : {geometry(2, 5, 4, 3, 2, 1), geometry(3, 3, 3, 1, 1, 0),
+                           geometry(2, 4, 5, 3, 1, 1, ImageLayout::NCHW)}) {
+        Conv2DLayer conv(g, 3);
+        (*conv.parameters()[1].value) = Tensor::randn(1, 3, 0.0f, 1.0f);
+        check_gradients(conv, Tensor::randn(2, g.image_size(), 0.0f, 1.0f));
+    }
+    printf("  PASS: conv2d gradient check\n");
+}
+
+void test_conv_transpose() {
+    // 4x3 -> 8x6 with the usual k4 s2 p1 upsampling, and an unpadded k3 s1 case
+    for (ConvGeometry g : {geometry(3, 4, 3, 4, 2, 1), geometry(2, 3, 3, 3, 1, 0)}) {
+        ConvTranspose2DLayer up(g, 2);
+        size_t OH = (g.height - 1) * g.stride + g.kernel - 2 * g.padding;
+        size_t OW = (g.width - 1) * g.stride + g.kernel - 2 * g.padding;
+        assert(up.out_height() == OH && up.out_width() == OW && up.output_size() == OH * OW * 2);
+        auto params = up.parameters();
+        *params[1].value = Tensor::randn(1, 2, 0.0f, 1.0f);
+        Tensor x = Tensor::randn(2, g.image_size(), 0.0f, 1.0f);
+        Tensor y = up.forward(x);
+        Tensor expected = reference_conv_transpose(x, g, *params[0].value, *params[1].value,
+                                                   2, OH, OW);
+        for (size_t i = 0; i < y.size(); ++i) assert(approx(y[i], expected[i]));
+
+        check_gradients(up, x);
+        ConvGeometry planar = g;
+        planar.layout = ImageLayout::NCHW;
+        ConvTranspose2DLayer up_nchw(planar, 2);
+        check_gradients(up_nchw, x);
+    }
+    printf("  PASS: conv transpose forward and gradients\n");
+}
+
+// The same weights give the same results in either layout, through a fused
+// activation, forward and backward
+void test_conv_layouts() {
+    ConvGeometry g = geometry(3, 6, 5, 3, 2, 1);
+    ConvGeometry planar = g;
+    planar.layout = ImageLayout::NCHW;
+    Conv2DLayer a(g, 4, InitMethod::He, Activation::ReLU);
+    Conv2DLayer b(planar, 4, InitMethod::He, Activation::ReLU);
+    ConvGeometry ug = geometry(4, a.geometry().out_height(), a.geometry().out_width(), 4, 2, 1);
+    ConvGeometry uplanar = ug;
+    uplanar.layout = ImageLayout::NCHW;
+    ConvTranspose2DLayer ua(ug, 3, InitMethod::Xavier, Activation::Sigmoid);
+    ConvTranspose2DLayer ub(uplanar, 3, InitMethod::Xavier, Activation::Sigmoid);
+    for (auto pair : {std::make_pair<Layer*, Layer*>(&a, &b), std::make_pair<Layer*, Layer*>(&ua, &ub)}) {
+        auto pa = pair.first->parameters(), pb = pair.second->parameters();
+        for (size_t i = 0; i < pa.size(); ++i) *pb[i].value = *pa[i].value;
+        (*pa[1].value) = Tensor::randn(1, pa[1].value->cols, 0.0f, 0.5f);
+        *pb[1].value = *pa[1].value;
+    }
+
+    Tensor x = Tensor::randn(2, g.image_size(), 0.0f, 1.0f);
+    Network na, nb;
+    na.add_layer(std::shared_ptr<Layer>(&a, [](Layer*) {}));
+    na.add_layer(std::shared_ptr<Layer>(&ua, [](Layer*) {}));
+    nb.add_layer(std::shared_ptr<Layer>(&b, [](Layer*) {}));
+    nb.add_layer(std::shared_ptr<Layer>(&ub, [](Layer*) {}));
+    Tensor ya, yb;
+    na.forward_into(x, ya);
+    Tensor xb = to_nchw(x, 3, 30);
+    nb.forward_into(xb, yb);
+    Tensor ya_planar = to_nchw(ya, 3, 36);
+    for (size_t i = 0; i < yb.size(); ++i) assert(approx(yb[i], ya_planar[i], 1e-5f));
+
+    Tensor R = Tensor::randn(ya.rows, ya.cols, 0.0f, 1.0f);
+    Tensor dxa, dxb;
+    na.backward_into(R, &dxa);
+    nb.backward_into(to_nchw(R, 3, 36), &dxb);
+    Tensor dxa_planar = to_nchw(dxa, 3, 30);
+    for (size_t i = 0; i < dxb.size(); ++i) assert(approx(dxb[i], dxa_planar[i], 1e-5f));
+    auto pa = na.parameters(), pb = nb.parameters();
+    for (size_t p = 0; p < pa.size(); ++p)
+        for (size_t i = 0; i < pa[p].gradient->size(); ++i)
+            assert(approx((*pa[p].gradient)[i], (*pb[p].gradient)[i], 1e-4f));
+    printf("  PASS: NHWC and NCHW layouts agree\n");
+}
+
+void test_pooling() {
+    for (ImageLayout layout : {ImageLayout::NHWC, ImageLayout::NCHW}) {
+        // 2 channels, 4x4, values chosen so channel 1 peaks at a different corner
+        Tensor x(1, 32);
+        auto index = [&](size_t c, size_t h, size_t w) {
+            return layout == ImageLayout::NHWC ? (h * 4 + w) * 2 + c : (c * 4 + h) * 4 + w;
+        };
+        for (size_t h = 0; h < 4; ++h)
+            for (size_t w = 0; w < 4; ++w) {
+                x[index(0, h, w)] = float(h * 4 + w);
+                x[index(1, h, w)] = -float(h * 4 + w);
+            }
+        MaxPool2D pool(2, 4, 4, 2, layout);
+        Tensor y = pool.forward(x);
+        assert(y.cols == pool.output_size() && y.cols == 8);
+        auto out_index = [&](size_t c, size_t h, size_t w) {
+            return layout == ImageLayout::NHWC ? (h * 2 + w) * 2 + c : (c * 2 + h) * 2 + w;
+        };
+        assert(y[out_index(0, 0, 0)] == 5.0f && y[out_index(0, 1, 1)] == 15.0f);
+        assert(y[out_index(1, 0, 1)] == -2.0f && y[out_index(1, 1, 0)] == -8.0f);
+        Tensor dy(1, 8, 1.0f);
+        dy[out_index(1, 1, 1)] = 3.0f;
+        Tensor dx = pool.backward(dy);
+        float total = 0.0f;
+        for (size_t i = 0; i < dx.size(); ++i) total += dx[i];
+        assert(total == 10.0f);
+        assert(dx[index(0, 1, 1)] == 1.0f && dx[index(0, 0, 0)] == 0.0f);
+        assert(dx[index(1, 2, 2)] == 3.0f && dx[index(1, 3, 3)] == 0.0f);
+
+        Upsample2D up(2, 2, 3, 2, layout);
+        Tensor u = Tensor::randn(1, 12, 0.0f, 1.0f);
+        Tensor v = up.forward(u);
+        assert(v.cols == up.output_size() && v.cols == 48);
+        auto small = [&](size_t c, size_t h, size_t w) {
+            return layout == ImageLayout::NHWC ? (h * 3 + w) * 2 + c : (c * 2 + h) * 3 + w;
+        };
+        auto big = [&](size_t c, size_t h, size_t w) {
+            return layout == ImageLayout::NHWC ? (h * 6 + w) * 2 + c : (c * 4 + h) * 6 + w;
+        };
+        for (size_t c = 0; c < 2; ++c)
+            for (size_t h = 0; h < 4; ++h)
+                for (size_t w = 0; w < 6; ++w) assert(v[big(c, h, w)] == u[small(c, h / 2, w / 2)]);
+        Tensor dv = Tensor::randn(1, 48, 0.0f, 1.0f);
+        Tensor du = up.backward(dv);
+        float expected = dv[big(1, 2, 4)] + dv[big(1, 2, 5)] + dv[big(1, 3, 4)] + dv[big(1, 3, 5)];
+        assert(approx(du[small(1, 1, 2)], expected, 1e-5f));
+    }
+    printf("  PASS: max pooling and upsampling\n");
+}
+
+void test_conv_network_fusion() {
+    Network net;
+    ConvGeometry g = geometry(3, 8, 8, 3, 2, 1);
+    net.add_layer(std::make_shared<Conv2DLayer>(g, 4));
+    net.add_layer(std::make_shared<ReLU>());
+    net.add_layer(std::make_shared<MaxPool2D>(4, 4, 4));
+    net.add_layer(std::make_shared<Upsample2D>(4, 2, 2));
+    net.add_layer(std::make_shared<ConvTranspose2DLayer>(geometry(4, 4, 4, 4, 2, 1), 3));
+    net.add_layer(std::make_shared<Sigmoid>());
+    Tensor x = Tensor::randn(2, g.image_size(), 0.5f, 0.3f);
+    Tensor before = net.forward(x);
+    assert(before.cols == g.image_size());
+
+    net.fuse_activations();
+    assert(net.describe() == "Conv2D(3,4,8x8,k3s2p1,NHWC) ReLU MaxPool2D(4,4x4,2,NHWC) "
+                             "Upsample2D(4,2x2,2,NHWC) ConvTranspose2D(4,3,4x4,k4s2p1,NHWC) Sigmoid");
+    Tensor after;
+    net.forward_into(x, after);
+    for (size_t i = 0; i < after.size(); ++i) assert(approx(after[i], before[i], 1e-5f));
+    printf("  PASS: conv network activation fusion\n");
+}
+
+int main() {
+    printf("Running convolution layer tests...\n");
+    test_conv2d_forward();
+    test_conv2d_gradient_check();
+    test_conv_transpose();
+    test_conv_layouts();
+    test_pooling();
+    test_conv_network_fusion();
+    printf("All convolution tests passed!\n");
+    return 0;
+}
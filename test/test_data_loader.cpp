@@ -0,0 +1,376 @@
+#include "io/data_loader.h"
+#include "io/dataset.h"
+#include "io/image_io.h"
+#include "io/tiled_image.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+static bool approx(float a, float b, float eps = 1e-6f) {
+    return std::fabs(a - b) < eps;
+}
+
+// Write n solid-colour 64x64 images whose first channel encodes the image index
+static std::string make_image_dir(size_t n) {
+    std::string dir = "/tmp/test_data_loader_images";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    for (size_t i = 0; i < n; ++i) {
+        Tensor img(1, ImageIO::FLAT_SIZE, 0.5f);
+        for (size_t p = 0; p < img.size(); p += ImageIO::CHANNELS) {
+            img[p] = static_cast<float>(i * 20) / 255.0f;
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), "/img_%02zu.png", i);
+        ImageIO::save(img, dir + name);
+    }
+    return dir;
+}
+
+static size_t image_id(const Tensor& batch, size_t row) {
+    return static_cast<size_t>(std::lround(batch(row, 0) * 255.0f / 20.0f));
+}
+
+void test_dataset_from_directory() {
+    auto ds = ImageDataset::from_path(make_image_dir(5));
+    assert(ds.size() == 5);
+    // Sorted by name
+    auto batch = ds.load_batch({4, 0});
+    assert(batch.rows == 2 && batch.cols == static_cast<size_t>(ImageIO::FLAT_SIZE));
+    assert(image_id(batch, 0) == 4 && image_id(batch, 1) == 0);
+
+    printf("  PASS: dataset from directory\n");
+}
+
+void test_loader_epochs() {
+    auto ds = ImageDataset::from_path(make_image_dir(7));
+    DataLoaderOptions opts;
+    opts.batch_size = 3;
+    opts.num_workers = 3;
+    opts.prefetch = 2;
+    opts.epochs = 3;
+    DataLoader loader(ds, opts);
+    assert(loader.batches_per_epoch() == 3);
+
+    for (int epoch = 0; epoch < 3; ++epoch) {
+        std::multiset<size_t> seen;
+        size_t batches = 0;
+        while (const Tensor* b = loader.next()) {
+            assert(b->rows == (batches < 2 ? 3u : 1u));
+            assert(b->size() == b->rows * ImageIO::FLAT_SIZE);
+            for (size_t r = 0; r < b->rows; ++r) {
+                seen.insert(image_id(*b, r));
+                // Decoded pixels match a direct load
+                assert(approx((*b)(r, 1), 0.5f, 2.0f / 255.0f));
+            }
+            ++batches;
+        }
+        // Every image exactly once per epoch
+        assert(batches == 3 && seen.size() == 7);
+        for (size_t i = 0; i < 7; ++i) assert(seen.count(i) == 1);
+    }
+    // Past the configured epochs
+    assert(loader.next() == nullptr);
+    assert(loader.take_wait_seconds() >= 0.0);
+
+    printf("  PASS: data loader epochs\n");
+}
+
+void test_loader_deterministic_shuffle() {
+    auto ds = ImageDataset::from_path(make_image_dir(6));
+    auto first_epoch = [&](size_t workers) {
+        DataLoaderOptions opts;
+        opts.batch_size = 2;
+        opts.num_workers = workers;
+        opts.seed = 7;
+        opts.epochs = 1;
+        DataLoader loader(ds, opts);
+        std::vector<size_t> ids;
+        while (const Tensor* b = loader.next()) {
+            for (size_t r = 0; r < b->rows; ++r) ids.push_back(image_id(*b, r));
+        }
+        return ids;
+    };
+    assert(first_epoch(1) == first_epoch(4));
+
+    printf("  PASS: data loader shuffle is deterministic\n");
+}
+
+void test_loader_resume() {
+    auto ds = ImageDataset::from_path(make_image_dir(7));
+    // All image ids from start_batch to the end of 3 epochs of batch size 2
+    auto ids_from = [&](uint64_t start_batch) {
+        DataLoaderOptions opts;
+        opts.batch_size = 2;
+        opts.seed = 11;
+        opts.epochs = 3;
+        opts.start_batch = start_batch;
+        DataLoader loader(ds, opts);
+        std::vector<size_t> ids;
+        for (int epoch = 0; epoch < 3; ++epoch) {
+            while (const Tensor* b = loader.next()) {
+                for (size_t r = 0; r < b->rows; ++r) ids.push_back(image_id(*b, r));
+            }
+        }
+        return ids;
+    };
+    std::vector<size_t> full = ids_from(0);
+    assert(full.size() == 21);
+    // Resume mid-epoch (batch 6 is the third of epoch 1) and at an epoch boundary
+    std::vector<size_t> mid = ids_from(6);
+    assert(std::equal(mid.begin(), mid.end(), full.begin() + 11));
+    std::vector<size_t> boundary = ids_from(8);
+    assert(std::equal(boundary.begin(), boundary.end(), full.begin() + 14));
+
+    printf("  PASS: data loader resumes at a batch position\n");
+}
+
+void test_loader_shards() {
+    auto ds = ImageDataset::from_path(make_image_dir(7));
+    std::multiset<size_t> seen;
+    for (size_t shard = 0; shard < 3; ++shard) {
+        DataLoaderOptions opts;
+        opts.batch_size = 2;
+        opts.seed = 5;
+        opts.epochs = 2;
+        opts.shard_index = shard;
+        opts.shard_count = 3;
+        DataLoader loader(ds, opts);
+        // 7 images in 3 shards of 3, the last two padded with images 0 and 1
+        assert(loader.batches_per_epoch() == 2);
+        for (int epoch = 0; epoch < 2; ++epoch) {
+            std::multiset<size_t> epoch_ids;
+            while (const Tensor* b = loader.next()) {
+                for (size_t r = 0; r < b->rows; ++r) {
+                    size_t id = image_id(*b, r);
+                    assert(id % 3 == shard || id < 2);
+                    epoch_ids.insert(id);
+                }
+            }
+            assert(epoch_ids.size() == 3);
+            if (epoch == 0) seen.insert(epoch_ids.begin(), epoch_ids.end());
+        }
+    }
+    // Together the shards cover every image
+    for (size_t i = 0; i < 7; ++i) assert(seen.count(i) >= 1);
+    assert(seen.size() == 9);
+
+    bool threw = false;
+    try {
+        DataLoaderOptions opts;
+        opts.shard_index = 2;
+        opts.shard_count = 2;
+        DataLoader loader(ds, opts);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    printf("  PASS: data loader shards\n");
+}
+
+void test_loader_reports_errors() {
+    std::string dir = make_image_dir(2);
+    std::string list = dir + "/list.txt";
+    {
+        FILE* f = std::fopen(list.c_str(), "w");
+        std::fprintf(f, "img_00.png\nmissing.png\n");
+        std::fclose(f);
+    }
+    auto ds = ImageDataset::from_path(list);
+    DataLoaderOptions opts;
+    opts.batch_size = 2;
+    opts.shuffle = false;
+    DataLoader loader(ds, opts);
+    bool threw = false;
+    try {
+        loader.next();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    printf("  PASS: data loader propagates decode errors\n");
+}
+
+void test_packed_dataset() {
+    std::string dir = make_image_dir(5);
+    auto files = ImageDataset::from_path(dir);
+
+    for (auto dtype : {PackedDataset::DType::UInt8, PackedDataset::DType::Float32}) {
+        std::string pack_path = "/tmp/test_data_loader.aepack";
+        PackedDataset::write(files.paths(), pack_path, dtype);
+
+        auto packed = ImageDataset::from_path(pack_path);
+        assert(packed.is_packed() && packed.size() == 5);
+        assert(packed.name(3) == pack_path + "#3");
+
+        // Records read from the mapping match decoding the original files
+        Tensor expected = files.load_batch({0, 1, 2, 3, 4});
+        Tensor actual = packed.load_batch({0, 1, 2, 3, 4});
+        assert(actual.data == expected.data);
+
+        // The loader builds batches straight from the mapped records
+        DataLoaderOptions opts;
+        opts.batch_size = 2;
+        opts.shuffle = false;
+        opts.epochs = 1;
+        DataLoader loader(packed, opts);
+        const Tensor* b = loader.next();
+        assert(b && b->rows == 2 && image_id(*b, 0) == 0 && image_id(*b, 1) == 1);
+    }
+
+    // Non-pack files are rejected
+    bool threw = false;
+    try {
+        PackedDataset bad(dir + "/img_00.png");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // So are headers whose count or data offset does not fit the file, including a
+    // count whose byte size wraps around (2^52 x 12288 bytes)
+    std::string pack_path = "/tmp/test_data_loader.aepack";
+    PackedDataset::write(files.paths(), pack_path, PackedDataset::DType::UInt8);
+    std::string bytes;
+    {
+        std::ifstream in(pack_path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    const size_t count_at = 32, offset_at = 40;
+    for (auto field : {std::make_pair(count_at, uint64_t(1) << 52),
+                       std::make_pair(count_at, uint64_t(6)),
+                       std::make_pair(offset_at, ~uint64_t(0) - 63)}) {
+        std::string corrupt = bytes;
+        std::memcpy(&corrupt[field.first], &field.second, sizeof(uint64_t));
+        std::ofstream("/tmp/test_data_loader_bad.aepack", std::ios::binary)
+            .write(corrupt.data(), static_cast<std::streamsize>(corrupt.size()));
+        threw = false;
+        try {
+            PackedDataset bad("/tmp/test_data_loader_bad.aepack");
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    printf("  PASS: packed dataset round-trip\n");
+}
+
+// Write a width x height binary PPM whose pixels are a function of their position
+static void write_ppm(const std::string& path, size_t width, size_t height) {
+    ImageRowWriter writer(path, width, height);
+    std::vector<unsigned char> row(width * 3);
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            row[x * 3] = static_cast<unsigned char>(x * 7 + y);
+            row[x * 3 + 1] = static_cast<unsigned char>(y * 5);
+            row[x * 3 + 2] = static_cast<unsigned char>((x ^ y) & 0xff);
+        }
+        writer.write_rows(row.data(), 1);
+    }
+    writer.finish();
+}
+
+void test_tiled_reconstruction() {
+    auto identity = [](const Tensor& in, Tensor& out) { out = in; };
+
+    // Sizes below, at and between tile multiples, PPM and PNG output
+    const size_t sizes[][2] = {{200, 150}, {64, 64}, {30, 20}, {131, 64}};
+    for (const auto& size : sizes) {
+        size_t w = size[0], h = size[1];
+        write_ppm("/tmp/test_tiled_in.ppm", w, h);
+        for (const char* out_path : {"/tmp/test_tiled_out.ppm", "/tmp/test_tiled_out.png"}) {
+            auto input = ImageRowReader::open("/tmp/test_tiled_in.ppm");
+            assert(input->width() == w && input->height() == h);
+            ImageRowWriter output(out_path, w, h);
+            TileOptions opts;
+            opts.max_batch = 3;
+            TileStats stats = reconstruct_tiled(*input, output, identity, opts);
+            output.finish();
+            assert(stats.mse < 1e-10);
+            assert(stats.batches >= (stats.tiles + 2) / 3);
+
+            // Blending identical tiles gives back the image exactly
+            auto expected = ImageRowReader::open("/tmp/test_tiled_in.ppm");
+            auto actual = ImageRowReader::open(out_path);
+            assert(actual->width() == w && actual->height() == h);
+            std::vector<unsigned char> a(w * h * 3), b(w * h * 3);
+            expected->read_rows(a.data(), h);
+            actual->read_rows(b.data(), h);
+            assert(a == b);
+        }
+    }
+
+    // A model that brightens every tile by a different amount: overlaps blend
+    // between neighbours instead of jumping, and working memory does not grow with
+    // the image height
+    size_t calls = 0;
+    auto shift = [&calls](const Tensor& in, Tensor& out) {
+        out = in;
+        for (size_t i = 0; i < out.size(); ++i) {
+            out[i] = 0.25f + 0.05f * static_cast<float>((calls + i / ImageIO::FLAT_SIZE) % 4);
+        }
+        ++calls;
+    };
+    size_t short_bytes = 0;
+    for (size_t h : {100, 1000}) {
+        write_ppm("/tmp/test_tiled_in.ppm", 300, h);
+        auto input = ImageRowReader::open("/tmp/test_tiled_in.ppm");
+        ImageRowWriter output("/tmp/test_tiled_out.ppm", 300, h);
+        TileStats stats = reconstruct_tiled(*input, output, shift);
+        output.finish();
+        if (h == 100) {
+            short_bytes = stats.buffer_bytes;
+        } else {
+            assert(stats.buffer_bytes == short_bytes);
+        }
+        auto result = ImageRowReader::open("/tmp/test_tiled_out.ppm");
+        std::vector<unsigned char> row(300 * 3);
+        for (size_t y = 0; y < h; ++y) {
+            result->read_rows(row.data(), 1);
+            for (size_t x = 1; x < 300; ++x) {
+                int step = std::abs(row[x * 3] - row[(x - 1) * 3]);
+                assert(row[x * 3] >= 63 && row[x * 3] <= 102 && step <= 3);
+            }
+        }
+    }
+
+    bool threw = false;
+    try {
+        auto input = ImageRowReader::open("/tmp/test_tiled_in.ppm");
+        ImageRowWriter output("/tmp/test_tiled_out.ppm", input->width(), input->height());
+        TileOptions opts;
+        opts.overlap = 64;
+        reconstruct_tiled(*input, output, identity, opts);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    printf("  PASS: tiled reconstruction\n");
+}
+
+int main() {
+    printf("Running data loader tests...\n");
+    test_dataset_from_directory();
+    test_loader_epochs();
+    test_loader_deterministic_shuffle();
+    test_loader_resume();
+    test_loader_shards();
+    test_loader_reports_errors();
+    test_packed_dataset();
+    test_tiled_reconstruction();
+    printf("All data loader tests passed!\n");
+    return 0;
+}
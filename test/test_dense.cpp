@@ -1,7 +1,11 @@
 #include "nn/dense.h"
+#include "nn/network.h"
+#include "nn/relu.h"
+#include "nn/sigmoid.h"
 #include <cassert>
 #include <cmath>
 #include <cstdio>
+#include <memory>
 
 static bool approx(float a, float b, float eps = 1e-4f) {
     return std::fabs(a - b) < eps;
@@ -114,11 +118,115 @@ void test_dense_gradient_check() {
     printf("  PASS: dense gradient check\n");
 }
 
+void test_dense_batch_backward() {
+    DenseLayer dense(3, 2, InitMethod::He);
+    auto params = dense.parameters();
+    Tensor& W = *params[0].value;
+    W(0,0)=1; W(0,1)=2; W(1,0)=3; W(1,1)=4; W(2,0)=5; W(2,1)=6;
+
+    // Two samples in one batch
+    Tensor x(2, 3);
+    x(0,0)=1; x(0,1)=2; x(0,2)=3;
+    x(1,0)=-1; x(1,1)=0; x(1,2)=2;
+    dense.forward(x);
+
+    Tensor grad(2, 2);
+    grad(0,0)=1; grad(0,1)=0.5f;
+    grad(1,0)=-2; grad(1,1)=1;
+    auto dx = dense.backward(grad);
+
+    // dx = grad * W^T, row by row
+    assert(dx.rows == 2 && dx.cols == 3);
+    assert(approx(dx(0,0), 2.0f) && approx(dx(0,1), 5.0f) && approx(dx(0,2), 8.0f));
+    assert(approx(dx(1,0), 0.0f) && approx(dx(1,1), -2.0f) && approx(dx(1,2), -4.0f));
+
+    // dW = x^T * grad sums over the batch
+    Tensor& dW = *params[0].gradient;
+    assert(approx(dW(0,0), 3.0f) && approx(dW(0,1), -0.5f));
+    assert(approx(dW(1,0), 2.0f) && approx(dW(1,1), 1.0f));
+    assert(approx(dW(2,0), -1.0f) && approx(dW(2,1), 3.5f));
+
+    // db = column sums of grad
+    Tensor& db = *params[1].gradient;
+    assert(approx(db(0,0), -1.0f) && approx(db(0,1), 1.5f));
+
+    printf("  PASS: dense batch backward\n");
+}
+
+// A Dense layer with a fused activation matches Dense followed by the activation
+// layer, forward and backward, on shapes that exercise full and partial GEMM tiles
+void test_dense_fused_activation() {
+    for (Activation act : {Activation::ReLU, Activation::Sigmoid}) {
+        for (size_t batch : {1, 3, 29}) {
+            DenseLayer fused(45, 70, InitMethod::He, act);
+            DenseLayer plain(45, 70, InitMethod::He);
+            auto fp = fused.parameters();
+            auto pp = plain.parameters();
+            *pp[0].value = *fp[0].value;
+            *fp[1].value = Tensor::randn(1, 70, 0.0f, 0.5f);
+            *pp[1].value = *fp[1].value;
+
+            Network reference;
+            reference.add_layer(std::make_shared<DenseLayer>(plain));
+            if (act == Activation::ReLU) {
+                reference.add_layer(std::make_shared<ReLU>());
+            } else {
+                reference.add_layer(std::make_shared<Sigmoid>());
+            }
+
+            Tensor x = Tensor::randn(batch, 45, 0.0f, 1.0f);
+            Tensor dy = Tensor::randn(batch, 70, 0.0f, 1.0f);
+            Tensor y = fused.forward(x);
+            Tensor y_ref = reference.forward(x);
+            Tensor dx = fused.backward(dy);
+            Tensor dx_ref = reference.backward(dy);
+
+            for (size_t i = 0; i < y.size(); ++i) assert(approx(y[i], y_ref[i], 1e-5f));
+            for (size_t i = 0; i < dx.size(); ++i) assert(approx(dx[i], dx_ref[i], 1e-4f));
+            auto rp = reference.parameters();
+            for (size_t p = 0; p < fp.size(); ++p) {
+                for (size_t i = 0; i < fp[p].gradient->size(); ++i) {
+                    assert(approx((*fp[p].gradient)[i], (*rp[p].gradient)[i], 1e-4f));
+                }
+            }
+        }
+    }
+    printf("  PASS: fused dense activation\n");
+}
+
+void test_network_fuse_activations() {
+    Network net;
+    net.add_layer(std::make_shared<DenseLayer>(8, 6));
+    net.add_layer(std::make_shared<ReLU>());
+    net.add_layer(std::make_shared<DenseLayer>(6, 4));
+    net.add_layer(std::make_shared<DenseLayer>(4, 8));
+    net.add_layer(std::make_shared<Sigmoid>());
+
+    Tensor x = Tensor::randn(5, 8, 0.0f, 1.0f);
+    Tensor before = net.forward(x);
+    size_t num_params = net.parameters().size();
+
+    net.fuse_activations();
+    Tensor after = net.forward(x);
+    assert(net.parameters().size() == num_params);
+    for (size_t i = 0; i < after.size(); ++i) assert(approx(after[i], before[i], 1e-5f));
+
+    // Same result through the into-API with the network's own buffers
+    Tensor out;
+    net.forward_into(x, out);
+    for (size_t i = 0; i < out.size(); ++i) assert(approx(out[i], before[i], 1e-5f));
+
+    printf("  PASS: network activation fusion\n");
+}
+
 int main() {
     printf("Running dense layer tests...\n");
     test_dense_forward();
     test_dense_backward();
     test_dense_gradient_check();
+    test_dense_batch_backward();
+    test_dense_fused_activation();
+    test_network_fuse_activations();
     printf("All dense tests passed!\n");
     return 0;
 }
@@ -0,0 +1,167 @@
+#include "io/image_codec.h"
+#include "io/image_io.h"
+#include "io/range_coder.h"
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+static bool throws(const std::function<void()>& fn) {
+    try {
+        fn();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void test_range_coder() {
+    // Skewed and uniform bits through adaptive models, interleaved with direct bits
+    std::vector<unsigned> bits;
+    std::vector<uint32_t> direct;
+    uint32_t state = 12345;
+    for (size_t i = 0; i < 20000; ++i) {
+        state = state * 1664525u + 1013904223u;
+        bits.push_back((state >> 24) < 20 ? 1 : 0);
+        direct.push_back(state >> 20);
+    }
+    RangeEncoder enc;
+    BitModel skewed, uniform;
+    for (size_t i = 0; i < bits.size(); ++i) {
+        enc.encode_bit(skewed, bits[i]);
+        enc.encode_bit(uniform, direct[i] & 1);
+        enc.encode_direct(direct[i], 12);
+    }
+    std::vector<unsigned char> bytes = enc.finish();
+    // 1 bit for the uniform model, 12 direct bits and well under 1 bit for the
+    // skewed one per step
+    assert(bytes.size() * 8 < bits.size() * 13.5);
+
+    RangeDecoder dec(bytes.data(), bytes.size());
+    BitModel skewed_in, uniform_in;
+    for (size_t i = 0; i < bits.size(); ++i) {
+        assert(dec.decode_bit(skewed_in) == bits[i]);
+        assert(dec.decode_bit(uniform_in) == (direct[i] & 1));
+        assert(dec.decode_direct(12) == (direct[i] & 0xFFF));
+    }
+    assert(dec.position() == bytes.size());
+
+    // Decoding a truncated stream runs out of bytes
+    assert(throws([&] {
+        RangeDecoder cut(bytes.data(), bytes.size() / 2);
+        BitModel a, b;
+        for (size_t i = 0; i < bits.size(); ++i) {
+            cut.decode_bit(a);
+            cut.decode_bit(b);
+            cut.decode_direct(12);
+        }
+    }));
+    printf("  PASS: range coder\n");
+}
+
+void test_image_codec() {
+    auto invalid = [](const std::function<void()>& fn) {
+        try {
+            fn();
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+
+    CodecHeader header;
+    header.width = 150;
+    header.height = 70;
+    header.tiled = true;
+    header.latent_size = 16;
+    header.step = 0.25f;
+    header.model_tag = ImageCodec::model_tag("encoder: Dense(12288,16)");
+    assert(header.tiles() == 3 * 2);
+
+    // Latents come back rounded to the step, including zeros and outliers
+    Tensor latents = Tensor::randn(header.tiles(), header.latent_size, 0.0f, 3.0f);
+    latents(0, 0) = 0.0f;
+    latents(1, 3) = -1000.3f;
+    latents(5, 15) = 0.1f;
+    std::vector<unsigned char> file = ImageCodec::compress(header, latents);
+    CodecHeader read;
+    Tensor decoded = ImageCodec::decompress(file, read);
+    assert(read.width == 150 && read.height == 70 && read.tiled && read.latent_size == 16);
+    assert(read.step == 0.25f && read.model_tag == header.model_tag);
+    Tensor expected = latents;
+    ImageCodec::quantize(expected, header.step);
+    assert(decoded.rows == latents.rows && decoded.cols == latents.cols);
+    for (size_t i = 0; i < latents.size(); ++i) {
+        assert(decoded[i] == expected[i]);
+        assert(std::fabs(decoded[i] - latents[i]) <= 0.125f + 1e-3f);
+    }
+    assert(decoded(0, 0) == 0.0f && decoded(5, 15) == 0.0f && decoded(1, 3) == -1000.25f);
+
+    // Many tiles of latents with a spread of 0 to 3 (0 to 12 steps) per dimension
+    // code in under 5 bits per value, each dimension learning its own spread
+    CodecHeader big = header;
+    big.width = 64 * 16;
+    big.height = 64 * 8;
+    Tensor many = Tensor::randn(big.tiles(), big.latent_size, 0.0f, 1.0f);
+    for (size_t t = 0; t < many.rows; ++t) {
+        for (size_t d = 0; d < many.cols; ++d) {
+            many(t, d) *= static_cast<float>(d % 4);
+        }
+    }
+    std::vector<unsigned char> packed = ImageCodec::compress(big, many);
+    assert(packed.size() * 8 < many.size() * 5);
+    Tensor unpacked = ImageCodec::decompress(packed, read);
+    ImageCodec::quantize(many, big.step);
+    for (size_t i = 0; i < many.size(); ++i) {
+        assert(unpacked[i] == many[i]);
+    }
+
+    // Whole-image files hold one latent of a 64x64 image
+    CodecHeader whole = header;
+    whole.tiled = false;
+    assert(invalid([&] { ImageCodec::compress(whole, latents); }));
+    whole.width = whole.height = ImageIO::TARGET_SIZE;
+    std::vector<unsigned char> one = ImageCodec::compress(whole, Tensor::randn(1, 16, 0.0f, 1.0f));
+    assert(ImageCodec::read_header(one).tiles() == 1);
+
+    // Corrupted files are rejected rather than decoded to noise of another shape
+    std::vector<unsigned char> cut(file.begin(), file.end() - 3);
+    assert(throws([&] { ImageCodec::decompress(cut, read); }));
+    std::vector<unsigned char> extra = file;
+    extra.push_back(0);
+    assert(throws([&] { ImageCodec::decompress(extra, read); }));
+    std::vector<unsigned char> bad_magic = file;
+    bad_magic[0] = 'X';
+    assert(throws([&] { ImageCodec::decompress(bad_magic, read); }));
+    CodecHeader zero_step = header;
+    zero_step.step = 0.0f;
+    assert(invalid([&] { ImageCodec::compress(zero_step, latents); }));
+
+    // Tiles split from an image join back into it, padding dropped
+    const size_t w = 150, h = 70;
+    std::vector<unsigned char> pixels(w * h * ImageIO::CHANNELS);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = static_cast<unsigned char>(i * 7 % 251);
+    }
+    Tensor tiles = ImageCodec::split_tiles(pixels.data(), w, h);
+    assert(tiles.rows == 6 && tiles.cols == static_cast<size_t>(ImageIO::FLAT_SIZE));
+    // The right-most tile repeats the last column past the edge
+    size_t last = (63 * ImageIO::TARGET_SIZE + 63) * ImageIO::CHANNELS;
+    assert(tiles(2, last) == static_cast<float>(pixels[(63 * w + w - 1) * 3]) / 255.0f);
+    std::vector<unsigned char> joined(pixels.size());
+    ImageCodec::join_tiles(tiles, w, h, joined.data());
+    assert(joined == pixels);
+
+    printf("  PASS: image codec\n");
+}
+
+int main() {
+    printf("Running image codec tests...\n");
+    test_range_coder();
+    test_image_codec();
+    printf("All image codec tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,333 @@
+#include "io/batcher.h"
+#include "io/image_io.h"
+#include "io/inference_server.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static bool approx(float a, float b, float eps = 1e-6f) {
+    return std::fabs(a - b) < eps;
+}
+
+// Stand-in model: reconstruction = input * 0.5, latent = (row sum, row max)
+static void half_model(const Tensor& inputs, Tensor& outputs, Tensor& latents,
+                       std::vector<size_t>* batch_sizes = nullptr) {
+    outputs = Tensor::scale(inputs, 0.5f);
+    latents.resize(inputs.rows, 2);
+    for (size_t r = 0; r < inputs.rows; ++r) {
+        float sum = 0.0f, mx = inputs(r, 0);
+        for (size_t j = 0; j < inputs.cols; ++j) {
+            sum += inputs(r, j);
+            mx = std::max(mx, inputs(r, j));
+        }
+        latents(r, 0) = sum;
+        latents(r, 1) = mx;
+    }
+    if (batch_sizes) {
+        batch_sizes->push_back(inputs.rows);
+    }
+}
+
+void test_batches_fill_and_complete_in_order() {
+    std::vector<size_t> batch_sizes;
+    BatcherOptions opts;
+    opts.max_batch = 4;
+    opts.max_delay_ms = 10000.0;  // only full batches (or close) trigger a run
+    DynamicBatcher batcher([&](const Tensor& in, Tensor& out, Tensor& lat) {
+        half_model(in, out, lat, &batch_sizes);
+    }, 3, opts);
+
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<float> mses;
+    for (int i = 0; i < 10; ++i) {
+        float v = static_cast<float>(i);
+        float input[3] = {v, v, 2.0f * v};
+        batcher.submit(input, [&, i, v](const InferenceResult& r) {
+            assert(r.latent_size == 2);
+            assert(approx(r.latent[0], 4.0f * v) && approx(r.latent[1], 2.0f * v));
+            assert(approx(r.reconstruction[2], v));
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(i);
+            mses.push_back(r.mse);
+        });
+    }
+    batcher.close();
+
+    // Two full batches, then the remainder flushed by close
+    assert((batch_sizes == std::vector<size_t>{4, 4, 2}));
+    for (int i = 0; i < 10; ++i) {
+        assert(order[i] == i);
+        float v = static_cast<float>(i);
+        // Errors (-v/2, -v/2, -v): mean square 0.5 * v^2
+        assert(approx(mses[i], 0.5f * v * v, 1e-4f));
+    }
+    LatencyStats s = batcher.stats();
+    assert(s.requests == 10 && s.batches == 3);
+    assert(approx(static_cast<float>(s.mean_batch), 10.0f / 3.0f, 1e-5f));
+    assert(s.p50_ms <= s.p99_ms);
+
+    printf("  PASS: batches fill and complete in order\n");
+}
+
+void test_deadline_flushes_partial_batch() {
+    BatcherOptions opts;
+    opts.max_batch = 64;
+    opts.max_delay_ms = 20.0;
+    DynamicBatcher batcher([](const Tensor& in, Tensor& out, Tensor& lat) {
+        half_model(in, out, lat);
+    }, 3, opts);
+
+    std::atomic<bool> done{false};
+    float input[3] = {1.0f, 2.0f, 3.0f};
+    auto start = std::chrono::steady_clock::now();
+    batcher.submit(input, [&](const InferenceResult&) { done.store(true); });
+    while (!done.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        assert(waited < 5.0);
+    }
+    // The lone request ran on its deadline, without waiting for close
+    LatencyStats s = batcher.stats();
+    assert(s.requests == 1 && s.batches == 1);
+    assert(s.p99_ms >= 15.0);
+
+    printf("  PASS: deadline flushes a partial batch\n");
+}
+
+void test_latency_window() {
+    BatcherOptions opts;
+    opts.max_batch = 1;
+    opts.latency_window = 3;
+    int calls = 0;
+    DynamicBatcher batcher([&](const Tensor& in, Tensor& out, Tensor& lat) {
+        // Only the first request is slow
+        if (calls++ == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        half_model(in, out, lat);
+    }, 3, opts);
+
+    float input[3] = {1.0f, 2.0f, 3.0f};
+    for (int i = 0; i < 10; ++i) {
+        std::atomic<bool> done{false};
+        batcher.submit(input, [&](const InferenceResult&) { done.store(true); });
+        while (!done.load()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        if (i == 0) {
+            assert(batcher.stats().p99_ms >= 45.0);
+        }
+    }
+    // Counters cover every request, the percentiles only the last three
+    LatencyStats s = batcher.stats();
+    assert(s.requests == 10 && s.batches == 10);
+    assert(s.p99_ms < 45.0);
+    assert(s.throughput > 0.0);
+
+    printf("  PASS: latency percentiles over a bounded window\n");
+}
+
+// Drive the line protocol over a pair of pipes with a RAW request, an image path
+// with an output PNG, a missing file and STATS
+void test_serve_connection_protocol() {
+    BatcherOptions opts;
+    opts.max_batch = 8;
+    opts.max_delay_ms = 1.0;
+    DynamicBatcher batcher([](const Tensor& in, Tensor& out, Tensor& lat) {
+        half_model(in, out, lat);
+    }, ImageIO::FLAT_SIZE, opts);
+
+    std::string image = "/tmp/test_inference_server_in.png";
+    std::string recon = "/tmp/test_inference_server_out.png";
+    std::remove(recon.c_str());
+    ImageIO::save(Tensor(1, ImageIO::FLAT_SIZE, 0.8f), image);
+
+    int req[2], resp[2];
+    int piped = pipe(req) + pipe(resp);
+    assert(piped == 0);
+    std::thread server([&] {
+        InferenceServer::serve_connection(batcher, req[0], resp[1]);
+        close(resp[1]);
+    });
+
+    std::vector<unsigned char> pixels(ImageIO::FLAT_SIZE, 200);
+    std::string requests = "RAW\n";
+    requests.append(pixels.begin(), pixels.end());
+    requests += image + " " + recon + "\n/tmp/does_not_exist.png\n";
+    ssize_t put = write(req[1], requests.data(), requests.size());
+    assert(put == static_cast<ssize_t>(requests.size()));
+
+    // Read until all three responses are in (RAW line + payload, OK, ERR)
+    std::string out;
+    char buf[4096];
+    auto complete = [&] {
+        return out.find("ERR 2 ") != std::string::npos && out.find("OK 1 ") != std::string::npos &&
+               out.find("OK 0 ") != std::string::npos &&
+               out.size() > ImageIO::FLAT_SIZE + out.find('\n', out.find("OK 0 "));
+    };
+    while (!complete()) {
+        ssize_t got = read(resp[0], buf, sizeof(buf));
+        assert(got > 0);
+        out.append(buf, static_cast<size_t>(got));
+    }
+    std::string stats_req = "STATS\n";
+    put = write(req[1], stats_req.data(), stats_req.size());
+    assert(put == 6);
+    close(req[1]);
+    server.join();
+    ssize_t got;
+    while ((got = read(resp[0], buf, sizeof(buf))) > 0) {
+        out.append(buf, static_cast<size_t>(got));
+    }
+    close(resp[0]);
+
+    // RAW: 200/255 in, half of that back as bytes after the OK line
+    size_t ok0 = out.find("OK 0 mse=");
+    assert(ok0 != std::string::npos);
+    size_t payload = out.find('\n', ok0) + 1;
+    assert(static_cast<unsigned char>(out[payload]) == 100);
+    assert(static_cast<unsigned char>(out[payload + ImageIO::FLAT_SIZE - 1]) == 100);
+    std::string tail = out.substr(payload + ImageIO::FLAT_SIZE);
+
+    assert(tail.find("OK 1 mse=") != std::string::npos);
+    // The failed load is reported immediately, possibly ahead of the OKs
+    assert(out.find("ERR 2 ") != std::string::npos);
+    assert(tail.find("STATS requests=2 ") != std::string::npos);
+    Tensor saved = ImageIO::load(recon);
+    assert(approx(saved[0], 102.0f / 255.0f, 1e-6f));
+
+    printf("  PASS: serve connection protocol\n");
+}
+
+// A client that stops reading its responses must not hold up other connections
+void test_stalled_client_does_not_block_others() {
+    BatcherOptions opts;
+    opts.max_batch = 4;
+    opts.max_delay_ms = 1.0;
+    DynamicBatcher batcher([](const Tensor& in, Tensor& out, Tensor& lat) {
+        half_model(in, out, lat);
+    }, ImageIO::FLAT_SIZE, opts);
+
+    std::vector<unsigned char> pixels(ImageIO::FLAT_SIZE, 200);
+    std::string raw = "RAW\n";
+    raw.append(pixels.begin(), pixels.end());
+
+    // Client A sends 32 RAW requests and reads nothing until the end: its replies
+    // overflow the pipe, so its writer blocks
+    int a_req[2], a_resp[2], b_req[2], b_resp[2];
+    int piped = pipe(a_req) + pipe(a_resp) + pipe(b_req) + pipe(b_resp);
+    assert(piped == 0);
+    std::thread a_server([&] {
+        InferenceServer::serve_connection(batcher, a_req[0], a_resp[1]);
+        close(a_resp[1]);
+    });
+    std::thread a_client([&] {
+        for (int i = 0; i < 32; ++i) {
+            ssize_t put = write(a_req[1], raw.data(), raw.size());
+            assert(put == static_cast<ssize_t>(raw.size()));
+        }
+        close(a_req[1]);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Client B is still answered
+    std::thread b_server([&] {
+        InferenceServer::serve_connection(batcher, b_req[0], b_resp[1]);
+        close(b_resp[1]);
+    });
+    ssize_t put = write(b_req[1], raw.data(), raw.size());
+    assert(put == static_cast<ssize_t>(raw.size()));
+    close(b_req[1]);
+    std::string out;
+    char buf[4096];
+    while (out.size() < ImageIO::FLAT_SIZE) {
+        pollfd pfd{b_resp[0], POLLIN, 0};
+        assert(poll(&pfd, 1, 5000) == 1);
+        ssize_t got = read(b_resp[0], buf, sizeof(buf));
+        assert(got > 0);
+        out.append(buf, static_cast<size_t>(got));
+    }
+    assert(out.compare(0, 5, "OK 0 ") == 0);
+    b_server.join();
+    close(b_resp[0]);
+
+    // Once A reads again, all of its replies arrive
+    size_t a_bytes = 0;
+    ssize_t got;
+    while ((got = read(a_resp[0], buf, sizeof(buf))) > 0) {
+        a_bytes += static_cast<size_t>(got);
+    }
+    a_client.join();
+    a_server.join();
+    close(a_resp[0]);
+    assert(a_bytes > 32 * ImageIO::FLAT_SIZE);
+
+    printf("  PASS: stalled client does not block others\n");
+}
+
+// Sequential clients of the socket server, whose finished connection threads are
+// joined while it keeps running
+void test_unix_socket_connections() {
+    BatcherOptions opts;
+    DynamicBatcher batcher([](const Tensor& in, Tensor& out, Tensor& lat) {
+        half_model(in, out, lat);
+    }, ImageIO::FLAT_SIZE, opts);
+    std::string path = "/tmp/test_inference_server.sock";
+    std::atomic<bool> stop{false};
+    std::thread server([&] { InferenceServer::serve_unix_socket(batcher, path, stop); });
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    for (int client = 0; client < 5; ++client) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        assert(fd >= 0);
+        auto start = std::chrono::steady_clock::now();
+        while (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        std::string request = "STATS\n";
+        ssize_t put = write(fd, request.data(), request.size());
+        assert(put == static_cast<ssize_t>(request.size()));
+        shutdown(fd, SHUT_WR);
+        std::string out;
+        char buf[256];
+        ssize_t got;
+        while ((got = read(fd, buf, sizeof(buf))) > 0) {
+            out.append(buf, static_cast<size_t>(got));
+        }
+        close(fd);
+        assert(out.compare(0, 15, "STATS requests=") == 0);
+        // Let the accept loop wake up and reap the finished connection
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    }
+    stop.store(true);
+    server.join();
+
+    printf("  PASS: unix socket connections\n");
+}
+
+int main() {
+    printf("Running inference server tests...\n");
+    test_batches_fill_and_complete_in_order();
+    test_deadline_flushes_partial_batch();
+    test_latency_window();
+    test_serve_connection_protocol();
+    test_stalled_client_does_not_block_others();
+    test_unix_socket_connections();
+    printf("All inference server tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "io/latent_file.h"
+#include "io/latent_index.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static bool approx(float a, float b, float eps = 1e-4f) {
+    return std::fabs(a - b) < eps;
+}
+
+static bool throws(const std::function<void()>& fn) {
+    try {
+        fn();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void test_latent_index() {
+    const size_t dim = 19, clusters = 8, per_cluster = 50;
+    Tensor centers = Tensor::randn(clusters, dim, 0.0f, 4.0f);
+    Tensor points = Tensor::randn(clusters * per_cluster, dim, 0.0f, 0.5f);
+    for (size_t i = 0; i < points.rows; ++i) {
+        for (size_t d = 0; d < dim; ++d) {
+            points(i, d) += centers(i % clusters, d);
+        }
+    }
+    {
+        LatentWriter writer("/tmp/test_index_latents.bin", dim);
+        writer.append(points);
+        writer.finish();
+    }
+    LatentFile latents("/tmp/test_index_latents.bin");
+    IndexBuildOptions opts;
+    opts.lists = 8;
+    opts.iterations = 5;
+    LatentIndex::build(latents, "/tmp/test_index.bin", opts);
+    LatentIndex index("/tmp/test_index.bin");
+    assert(index.rows() == points.rows && index.dim() == dim && index.lists() == 8);
+
+    auto brute_force = [&](const float* q) {
+        std::vector<Neighbor> all;
+        for (size_t i = 0; i < points.rows; ++i) {
+            float sum = 0.0f;
+            for (size_t d = 0; d < dim; ++d) {
+                float diff = points(i, d) - q[d];
+                sum += diff * diff;
+            }
+            all.push_back({i, sum});
+        }
+        std::sort(all.begin(), all.end(),
+                  [](const Neighbor& a, const Neighbor& b) { return a.distance < b.distance; });
+        return all;
+    };
+
+    // Exhaustive search returns every row exactly once, in distance order
+    const float* q0 = latents.row(17);
+    std::vector<Neighbor> everything = index.search(q0, points.rows + 5, index.lists());
+    assert(everything.size() == points.rows);
+    std::vector<bool> seen(points.rows, false);
+    for (size_t i = 0; i < everything.size(); ++i) {
+        assert(!seen[everything[i].row]);
+        seen[everything[i].row] = true;
+        assert(i == 0 || everything[i - 1].distance <= everything[i].distance);
+    }
+    assert(everything[0].row == 17 && everything[0].distance == 0.0f);
+
+    size_t found = 0, total = 0;
+    for (size_t qi = 0; qi < points.rows; qi += 13) {
+        const float* q = latents.row(qi);
+        std::vector<Neighbor> truth = brute_force(q);
+        std::vector<Neighbor> exact = index.search(q, 5, index.lists());
+        assert(exact.size() == 5);
+        for (size_t r = 0; r < 5; ++r) {
+            assert(approx(exact[r].distance, truth[r].distance, 1e-3f));
+        }
+        for (const Neighbor& n : index.search(q, 5, 2)) {
+            for (size_t r = 0; r < 5; ++r) {
+                found += n.row == truth[r].row;
+            }
+        }
+        total += 5;
+    }
+    assert(found >= total * 9 / 10);
+    assert(index.search(q0, 0, 4).empty());
+
+    std::ifstream in("/tmp/test_index.bin", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream("/tmp/test_index_cut.bin", std::ios::binary).write(bytes.data(), bytes.size() - 4);
+    assert(throws([] { LatentIndex("/tmp/test_index_cut.bin"); }));
+    assert(throws([] { LatentIndex("/tmp/test_index_latents.bin"); }));
+
+    printf("  PASS: latent index\n");
+}
+
+int main() {
+    printf("Running latent index tests...\n");
+    test_latent_index();
+    printf("All latent index tests passed!\n");
+    return 0;
+}
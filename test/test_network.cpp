@@ -3,12 +3,58 @@
 #include "nn/relu.h"
 #include "nn/sigmoid.h"
 #include "nn/mse_loss.h"
+#include "nn/quantized_dense.h"
 #include "optim/adam.h"
 #include "io/model_io.h"
+#include "io/checkpoint.h"
+#include "io/latent_file.h"
+#include "models/autoencoder.h"
+#include "math/bf16.h"
+#include "math/profiler.h"
+#include "math/thread_pool.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// Count every heap allocation in the process so the training step can be checked
+// for steady-state allocations
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// Tensor storage is allocated with 64-byte alignment
+void* operator new(size_t size, std::align_val_t align) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t a = static_cast<size_t>(align);
+    if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
 
 static bool approx(float a, float b, float eps = 1e-4f) {
     return std::fabs(a - b) < eps;
@@ -166,6 +212,508 @@ void test_model_save_load() {
     printf("  PASS: model save/load round-trip\n");
 }
 
+static std::shared_ptr<Network> small_network() {
+    auto net = std::make_shared<Network>();
+    net->add_layer(std::make_shared<DenseLayer>(4, 3, InitMethod::He));
+    net->add_layer(std::make_shared<ReLU>());
+    net->add_layer(std::make_shared<DenseLayer>(3, 2, InitMethod::He));
+    return net;
+}
+
+static bool throws(const std::function<void()>& fn) {
+    try {
+        fn();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void test_model_file_format() {
+    auto net = small_network();
+    auto params = net->parameters();
+    std::string arch = net->describe();
+    assert(arch == "Dense(4,3) ReLU Dense(3,2)");
+    ModelIO::save(params, "/tmp/test_model_v3.bin", arch);
+
+    // Header, then every tensor at a 64-byte aligned offset
+    std::ifstream in("/tmp/test_model_v3.bin", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(bytes.compare(0, 8, std::string("AEMODEL\0", 8)) == 0);
+    assert(bytes.size() % 64 == 0);
+
+    // Mapped weights are used in place, and outlive the network that mapped them
+    Tensor x(1, 4);
+    x[0]=0.5f; x[1]=-0.3f; x[2]=0.8f; x[3]=-0.1f;
+    auto y = net->forward(x);
+    auto mapped = small_network();
+    auto mapped_params = mapped->parameters();
+    ModelIO::map(mapped_params, "/tmp/test_model_v3.bin", arch);
+    for (size_t i = 0; i < params.size(); ++i) {
+        assert(mapped_params[i].value->data.borrowed());
+        assert(reinterpret_cast<uintptr_t>(mapped_params[i].value->data.data()) % 64 == 0);
+        assert(mapped_params[i].value->data == params[i].value->data);
+    }
+    auto y_mapped = mapped->forward(x);
+    for (size_t i = 0; i < y.size(); ++i) {
+        assert(y[i] == y_mapped[i]);
+    }
+
+    // Saving over a mapped file replaces it without touching the live mapping
+    std::vector<Tensor> saved;
+    for (auto& p : params) {
+        saved.push_back(*p.value);
+        *p.value = Tensor::scale(*p.value, 2.0f);
+    }
+    ModelIO::save(params, "/tmp/test_model_v3.bin", arch);
+    for (size_t i = 0; i < params.size(); ++i) {
+        assert(mapped_params[i].value->data == saved[i].data);
+    }
+    auto resaved = small_network();
+    auto resaved_params = resaved->parameters();
+    ModelIO::load(resaved_params, "/tmp/test_model_v3.bin", arch);
+    for (size_t i = 0; i < params.size(); ++i) {
+        assert(resaved_params[i].value->data == params[i].value->data);
+        *params[i].value = saved[i];
+    }
+
+    // Corruption, truncation and a different architecture are all rejected
+    auto other = small_network();
+    auto other_params = other->parameters();
+    ModelIO::load(other_params, "/tmp/test_model_v3.bin", arch);
+    assert(!other_params[0].value->data.borrowed());
+    std::string corrupt = bytes;
+    corrupt[corrupt.size() - 100] ^= 1;
+    std::ofstream("/tmp/test_model_corrupt.bin", std::ios::binary).write(corrupt.data(), corrupt.size());
+    assert(throws([&] { ModelIO::load(other_params, "/tmp/test_model_corrupt.bin"); }));
+    // Flipping the sign of two floats changes the checksum (each flip is bit 63 of
+    // its word, which a plain word-wise FNV multiply never propagates)
+    std::vector<float> floats(64, 1.5f);
+    uint64_t plain = ModelIO::checksum(floats.data(), floats.size() * sizeof(float));
+    floats[3] = -floats[3];
+    floats[41] = -floats[41];
+    assert(ModelIO::checksum(floats.data(), floats.size() * sizeof(float)) != plain);
+    floats[5] = -floats[5];
+    assert(ModelIO::checksum(floats.data(), floats.size() * sizeof(float)) != plain);
+
+    // Reading the description checks the header only; the checksum is left to map
+    assert(ModelIO::architecture("/tmp/test_model_corrupt.bin") == arch);
+    assert(throws([&] { ModelIO::map(other_params, "/tmp/test_model_corrupt.bin"); }));
+    std::ofstream("/tmp/test_model_cut.bin", std::ios::binary).write(bytes.data(), 200);
+    assert(throws([&] { ModelIO::map(other_params, "/tmp/test_model_cut.bin"); }));
+    assert(throws([&] { ModelIO::architecture("/tmp/test_model_cut.bin"); }));
+    assert(throws([&] {
+        ModelIO::load(other_params, "/tmp/test_model_v3.bin", "Dense(4,3) Sigmoid Dense(3,2)");
+    }));
+    // Only version 3 headers are read
+    std::string old_version = bytes;
+    old_version[8] = 2;
+    std::ofstream("/tmp/test_model_old.bin", std::ios::binary).write(old_version.data(), old_version.size());
+    assert(throws([&] { ModelIO::load(other_params, "/tmp/test_model_old.bin"); }));
+
+    // Version 1 files (no header) still load, by copy
+    {
+        std::ofstream v1("/tmp/test_model_v1.bin", std::ios::binary);
+        size_t n = params.size();
+        v1.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        for (auto& p : params) {
+            p.value->save(v1);
+        }
+    }
+    auto legacy = small_network();
+    auto legacy_params = legacy->parameters();
+    ModelIO::map(legacy_params, "/tmp/test_model_v1.bin", arch);
+    for (size_t i = 0; i < params.size(); ++i) {
+        assert(!legacy_params[i].value->data.borrowed());
+        assert(legacy_params[i].value->data == params[i].value->data);
+    }
+
+    printf("  PASS: model file format\n");
+}
+
+void test_inference_model_load() {
+    Autoencoder trained;
+    auto params = trained.parameters();
+    ModelIO::save(params, "/tmp/test_inference_model.bin");
+
+    // Skip-initialized layers own weight storage but no gradient buffers
+    Autoencoder model = Autoencoder::for_inference();
+    auto loaded = model.parameters();
+    assert(loaded.size() == params.size());
+    for (auto& p : loaded) {
+        assert(p.gradient->size() == 0);
+    }
+    ModelIO::load(loaded, "/tmp/test_inference_model.bin");
+    for (size_t i = 0; i < params.size(); ++i) {
+        assert(loaded[i].value->data == params[i].value->data);
+    }
+
+    Tensor x = Tensor::randn(2, 12288, 0.5f, 0.2f);
+    Tensor y_trained = trained.forward(x);
+    Tensor y = model.forward(x);
+    for (size_t i = 0; i < y.size(); ++i) {
+        assert(y[i] == y_trained[i]);
+    }
+
+    // A truncated file is rejected rather than leaving weights half-loaded silently
+    std::ifstream src("/tmp/test_inference_model.bin", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(src)), std::istreambuf_iterator<char>());
+    std::ofstream("/tmp/test_inference_model_cut.bin", std::ios::binary)
+        .write(bytes.data(), static_cast<std::streamsize>(bytes.size() / 2));
+    bool threw = false;
+    try {
+        ModelIO::load(loaded, "/tmp/test_inference_model_cut.bin");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    printf("  PASS: inference model load\n");
+}
+
+// The convolutional model: ~22x fewer parameters than the dense one, saves and
+// maps like it, learns, and trains without allocating at steady state
+void test_conv_autoencoder() {
+    Autoencoder model(ModelSpec::conv());
+    auto params = model.parameters();
+    size_t values = 0;
+    for (auto& p : params) {
+        values += p.value->size();
+    }
+    assert(values == 593811);
+
+    Tensor x = Tensor::randn(4, 12288, 0.5f, 0.2f);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = std::min(std::max(x[i], 0.0f), 1.0f);
+    }
+    Tensor latent = model.encode(x);
+    assert(latent.rows == 4 && latent.cols == Autoencoder::LATENT_SIZE);
+    Tensor y = model.forward(x);
+    assert(y.rows == 4 && y.cols == 12288);
+
+    ModelIO::save(params, "/tmp/test_model_conv.bin", model.architecture());
+    std::string architecture = ModelIO::architecture("/tmp/test_model_conv.bin");
+    Autoencoder loaded = Autoencoder::for_inference(precision_of(architecture),
+                                                    ModelSpec::of_architecture(architecture));
+    auto loaded_params = loaded.parameters();
+    ModelIO::map(loaded_params, "/tmp/test_model_conv.bin", loaded.architecture());
+    Tensor y_loaded = loaded.forward(x);
+    for (size_t i = 0; i < y.size(); ++i) {
+        assert(y_loaded[i] == y[i]);
+    }
+
+    Adam optimizer(params, 0.003f);
+    MSELoss loss;
+    Tensor out, grad;
+    float first = 0.0f, last = 0.0f;
+    for (int step = 0; step < 40; ++step) {
+        if (step == 2) {
+            // Buffers have their steady-state sizes after the first steps
+            size_t before = g_allocations.load();
+            model.forward_into(x, out);
+            loss.forward_backward(out, x, grad);
+            model.backward_into(grad, nullptr);
+            optimizer.step();
+            assert(g_allocations.load() == before);
+            continue;
+        }
+        model.forward_into(x, out);
+        float l = loss.forward_backward(out, x, grad);
+        model.backward_into(grad, nullptr);
+        optimizer.step();
+        first = step == 0 ? l : first;
+        last = l;
+    }
+    assert(last < first * 0.8f);
+
+    printf("  PASS: conv autoencoder (%zu parameters, loss %.4f -> %.4f)\n", values, first, last);
+}
+
+static bool spec_rejected(const std::string& text) {
+    try {
+        ModelSpec::parse(text);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Specs use the notation of stored layer descriptions, so built-in models, custom
+// spec files and the architecture of any saved model all parse to the same stacks
+void test_model_spec() {
+    assert(ModelSpec::dense().to_string() == Autoencoder().architecture());
+    assert(ModelSpec::conv().to_string() == Autoencoder(ModelSpec::conv()).architecture());
+    assert(ModelSpec::parse(ModelSpec::conv().to_string()).to_string() ==
+           ModelSpec::conv().to_string());
+    assert(ModelSpec::dense().multiply_adds() == 2 * (12288 * 512 + 512 * 128 + 128 * 64));
+    assert(ModelSpec::dense().encoder.back().init == InitMethod::He);
+    assert(ModelSpec::dense().decoder.back().init == InitMethod::Xavier);
+
+    // Int8 and bf16 descriptions read as the float32 stack they were built from
+    Autoencoder quantized = Autoencoder::for_inference(Precision::Int8);
+    assert(ModelSpec::of_architecture(quantized.architecture()).to_string() ==
+           ModelSpec::dense().to_string());
+    Autoencoder half = Autoencoder::for_inference(Precision::BF16);
+    assert(ModelSpec::of_architecture(half.architecture()).to_string() ==
+           ModelSpec::dense().to_string());
+    assert(ModelSpec::of_architecture("").to_string() == ModelSpec::dense().to_string());
+
+    const char* text =
+        "# smaller bottleneck, with a pooled conv front end\n"
+        "encoder:\n"
+        "  Conv2D(3,8,64x64,k3s1p1) ReLU   # NHWC by default\n"
+        "  MaxPool2D(8,64x64,4)\n"
+        "  Dense(2048,32) init=xavier\n"
+        "decoder:\n"
+        "  Dense(32,768) ReLU\n"
+        "  Upsample2D(3,16x16,4,NHWC)\n"
+        "  Conv2D(3,3,64x64,k1s1p0) Sigmoid\n";
+    std::ofstream("/tmp/test_model_spec.txt") << text;
+    ModelSpec spec = ModelSpec::load("/tmp/test_model_spec.txt");
+    assert(spec.input_size() == 12288 && spec.latent_size() == 32);
+    assert(spec.encoder.size() == 3 && spec.decoder.size() == 3);
+    assert(spec.encoder[2].init == InitMethod::Xavier);
+    assert(spec.decoder[2].init == InitMethod::Xavier);
+    assert(spec.to_string() ==
+           "encoder: Conv2D(3,8,64x64,k3s1p1,NHWC) ReLU MaxPool2D(8,64x64,4,NHWC) Dense(2048,32);"
+           " decoder: Dense(32,768) ReLU Upsample2D(3,16x16,4,NHWC) Conv2D(3,3,64x64,k1s1p0,NHWC)"
+           " Sigmoid");
+
+    Autoencoder model(spec);
+    assert(model.architecture() == spec.to_string());
+    assert(model.input_size() == 12288 && model.latent_size() == 32);
+    Tensor x = Tensor::randn(2, 12288, 0.5f, 0.2f);
+    Tensor latent = model.encode(x);
+    assert(latent.rows == 2 && latent.cols == 32);
+    Tensor y = model.forward(x);
+    assert(y.rows == 2 && y.cols == 12288);
+    Tensor grad = model.backward(Tensor::randn(2, 12288, 0.0f, 0.01f));
+    assert(grad.rows == 2 && grad.cols == 12288);
+
+    // A saved model rebuilds from its own file
+    ModelIO::save(model.parameters(), "/tmp/test_model_spec.bin", model.architecture());
+    std::string architecture = ModelIO::architecture("/tmp/test_model_spec.bin");
+    Autoencoder loaded = Autoencoder::for_inference(precision_of(architecture),
+                                                    ModelSpec::of_architecture(architecture));
+    auto params = loaded.parameters();
+    ModelIO::map(params, "/tmp/test_model_spec.bin", loaded.architecture());
+    Tensor y_loaded = loaded.forward(x);
+    for (size_t i = 0; i < y.size(); ++i) {
+        assert(y_loaded[i] == y[i]);
+    }
+
+    assert(spec_rejected(""));
+    assert(spec_rejected("encoder: Dense(12288,64)"));
+    assert(spec_rejected("Dense(12288,64) decoder: Dense(64,12288)"));
+    assert(spec_rejected("encoder: Dense(12288,64) decoder: Dense(32,12288)"));
+    assert(spec_rejected("encoder: Dense(12288,64) decoder: Dense(64,100)"));
+    assert(spec_rejected("encoder: Dense(12288,64) ReLU ReLU decoder: Dense(64,12288)"));
+    assert(spec_rejected("encoder: ReLU Dense(12288,64) decoder: Dense(64,12288)"));
+    assert(spec_rejected("encoder: Dense(12288,0) decoder: Dense(0,12288)"));
+    assert(spec_rejected("encoder: Dense(12288,6x) decoder: Dense(64,12288)"));
+    assert(spec_rejected("encoder: Linear(12288,64) decoder: Dense(64,12288)"));
+    assert(spec_rejected("encoder: Dense(12288,64 decoder: Dense(64,12288)"));
+    assert(spec_rejected("encoder: MaxPool2D(3,64x64,3) decoder: Dense(3,12288)"));
+    assert(spec_rejected("encoder: Conv2D(3,8,64x64,k3s1,NHWC) decoder: Dense(3,12288)"));
+
+    printf("  PASS: model spec\n");
+}
+
+void test_quantized_network() {
+    auto make = [](InitMethod init) {
+        auto net = std::make_shared<Network>();
+        net->add_layer(std::make_shared<DenseLayer>(48, 24, init, Activation::ReLU));
+        net->add_layer(std::make_shared<DenseLayer>(24, 10, init));
+        return net;
+    };
+    auto net = make(InitMethod::He);
+    Tensor x = Tensor::randn(5, 48, 0.0f, 1.0f);
+    Tensor y = net->forward(x);
+
+    // Post-training quantization keeps the outputs close to float32
+    net->quantize();
+    std::string arch = net->describe();
+    assert(arch == "QuantizedDense(48,24) ReLU QuantizedDense(24,10)");
+    assert(precision_of(arch) == Precision::Int8);
+    assert(precision_of(Autoencoder::for_inference(Precision::Int8).architecture()) ==
+           Precision::Int8);
+    Tensor yq = net->forward(x);
+    float max_err = 0.0f, max_abs = 0.0f;
+    for (size_t i = 0; i < y.size(); ++i) {
+        max_err = std::max(max_err, std::fabs(yq[i] - y[i]));
+        max_abs = std::max(max_abs, std::fabs(y[i]));
+    }
+    assert(max_err < 0.02f * max_abs);
+    bool threw = false;
+    try {
+        net->backward(yq);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Int8 models save and map like float32 ones, and are told apart by the file
+    auto params = net->parameters();
+    assert(params[0].dtype == DType::Int8 && params[1].dtype == DType::Float32);
+    ModelIO::save(params, "/tmp/test_model_int8.bin", arch);
+    assert(ModelIO::architecture("/tmp/test_model_int8.bin") == arch);
+    auto loaded = make(InitMethod::Skip);
+    loaded->quantize(false);
+    auto loaded_params = loaded->parameters();
+    ModelIO::map(loaded_params, "/tmp/test_model_int8.bin", arch);
+    Tensor y_loaded = loaded->forward(x);
+    for (size_t i = 0; i < yq.size(); ++i) {
+        assert(y_loaded[i] == yq[i]);
+    }
+    auto fp32_params = make(InitMethod::Skip)->parameters();
+    assert(throws([&] { ModelIO::load(fp32_params, "/tmp/test_model_int8.bin"); }));
+
+    printf("  PASS: quantized network\n");
+}
+
+void test_bf16_network() {
+    auto make = [](InitMethod init) {
+        auto net = std::make_shared<Network>();
+        net->add_layer(std::make_shared<DenseLayer>(48, 24, init, Activation::ReLU));
+        net->add_layer(std::make_shared<DenseLayer>(24, 10, init));
+        return net;
+    };
+    auto shadow_matches_master = [](const std::vector<Parameter>& params) {
+        for (const Parameter& p : params) {
+            if (!p.bf16_copy) continue;
+            auto half = reinterpret_cast<const uint16_t*>(p.bf16_copy->data.data());
+            for (size_t i = 0; i < p.value->size(); ++i) {
+                if (half[i] != float_to_bf16((*p.value)[i])) return false;
+            }
+        }
+        return true;
+    };
+
+    // Mixed precision: Adam updates the float32 master weights and refreshes their
+    // bf16 copies, which the forward and backward GEMMs read
+    auto net = make(InitMethod::He);
+    Tensor x = Tensor::randn(8, 48, 0.0f, 1.0f);
+    Tensor target = Tensor::randn(8, 10, 0.0f, 0.5f);
+    Tensor y = net->forward(x);
+    net->use_bf16_weights(true);
+    assert(net->describe() == "Dense(48,24) ReLU Dense(24,10)");
+    assert(precision_of(net->describe()) == Precision::Float32);
+    auto params = net->parameters();
+    assert(params[0].bf16_copy && params[0].dtype == DType::Float32 && params[0].gradient);
+    Tensor y16 = net->forward(x);
+    for (size_t i = 0; i < y.size(); ++i) {
+        assert(approx(y16[i], y[i], 0.02f * (1.0f + std::fabs(y[i]))));
+    }
+    Adam optimizer(params, 0.01f);
+    MSELoss loss_fn;
+    float first = 0.0f, last = 0.0f;
+    for (int step = 0; step < 30; ++step) {
+        net->zero_gradients();
+        Tensor out = net->forward(x);
+        float loss = loss_fn.forward(out, target);
+        net->backward(loss_fn.backward());
+        optimizer.step();
+        (step == 0 ? first : last) = loss;
+    }
+    assert(last < 0.5f * first);
+    assert(shadow_matches_master(params));
+
+    // A resumed checkpoint refreshes the copies too
+    Checkpoint c;
+    c.capture(params, optimizer);
+    auto resumed = make(InitMethod::He);
+    resumed->use_bf16_weights(true);
+    auto resumed_params = resumed->parameters();
+    Adam resumed_opt(resumed_params, 0.01f);
+    c.restore(resumed_params, resumed_opt);
+    assert(shadow_matches_master(resumed_params));
+
+    // Inference: the float32 weights are dropped and the model saves as bf16
+    net->use_bf16_weights(false);
+    std::string arch = net->describe();
+    assert(arch == "Dense(48,24,bf16) ReLU Dense(24,10,bf16)");
+    assert(precision_of(arch) == Precision::BF16);
+    bool threw = false;
+    try {
+        net->use_bf16_weights(true);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+    Tensor y_inf = net->forward(x);
+    auto inf_params = net->parameters();
+    assert(inf_params[0].dtype == DType::BF16 && !inf_params[0].gradient);
+    ModelIO::save(inf_params, "/tmp/test_model_bf16.bin", arch);
+    assert(ModelIO::architecture("/tmp/test_model_bf16.bin") == arch);
+    auto loaded = make(InitMethod::Skip);
+    loaded->use_bf16_weights(false, false);
+    auto loaded_params = loaded->parameters();
+    ModelIO::map(loaded_params, "/tmp/test_model_bf16.bin", arch);
+    Tensor y_loaded = loaded->forward(x);
+    for (size_t i = 0; i < y_inf.size(); ++i) {
+        assert(y_loaded[i] == y_inf[i]);
+    }
+    auto fp32_params = make(InitMethod::Skip)->parameters();
+    assert(throws([&] { ModelIO::load(fp32_params, "/tmp/test_model_bf16.bin"); }));
+
+    printf("  PASS: bf16 network\n");
+}
+
+// Encode-only path: encode_into matches the value API, and latents stream into a
+// matrix file that maps back row for row
+void test_latent_export() {
+    Autoencoder model;
+    Tensor a = Tensor::randn(3, 12288, 0.5f, 0.2f);
+    Tensor b = Tensor::randn(2, 12288, 0.5f, 0.2f);
+    Tensor expected_a = model.encode(a), expected_b = model.encode(b);
+    Tensor latent;
+    std::remove("/tmp/test_latents.bin");
+    {
+        LatentWriter writer("/tmp/test_latents.bin", Autoencoder::LATENT_SIZE);
+        model.encode_into(a, latent);
+        assert(latent.rows == 3 && latent.cols == Autoencoder::LATENT_SIZE);
+        assert(latent.data == expected_a.data);
+        writer.append(latent);
+        model.encode_into(b, latent);
+        writer.append(latent);
+        bool threw = false;
+        try {
+            writer.append(Tensor(1, 3));
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        assert(threw);
+        writer.finish();
+        assert(writer.rows() == 5);
+    }
+    LatentFile file("/tmp/test_latents.bin");
+    assert(file.rows() == 5 && file.cols() == Autoencoder::LATENT_SIZE);
+    for (size_t j = 0; j < file.cols(); ++j) {
+        assert(file.row(1)[j] == expected_a(1, j));
+        assert(file.row(4)[j] == expected_b(1, j));
+    }
+    assert(file.to_tensor()(3, 7) == expected_b(0, 7));
+
+    // A writer that never finishes leaves nothing behind
+    {
+        LatentWriter writer("/tmp/test_latents_partial.bin", Autoencoder::LATENT_SIZE);
+        writer.append(latent);
+    }
+    assert(!std::ifstream("/tmp/test_latents_partial.bin"));
+    assert(!std::ifstream("/tmp/test_latents_partial.bin.tmp"));
+
+    std::ifstream in("/tmp/test_latents.bin", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream("/tmp/test_latents_cut.bin", std::ios::binary).write(bytes.data(), bytes.size() - 4);
+    assert(throws([] { LatentFile("/tmp/test_latents_cut.bin"); }));
+    // Any other file, here a model file, is not mistaken for latents
+    auto other = small_network();
+    ModelIO::save(other->parameters(), "/tmp/test_latents_other.bin", other->describe());
+    assert(throws([] { LatentFile("/tmp/test_latents_other.bin"); }));
+
+    printf("  PASS: latent export\n");
+}
+
 void test_zero_gradients() {
     Network net;
     net.add_layer(std::make_shared<DenseLayer>(3, 2, InitMethod::He));
@@ -201,14 +749,304 @@ void test_zero_gradients() {
     printf("  PASS: zero gradients\n");
 }
 
+// The flattened multi-tensor sweep matches textbook Adam/AdamW applied per tensor,
+// across chunk boundaries that split parameters
+void test_adam_matches_reference() {
+    for (float wd : {0.0f, 0.1f}) {
+        std::vector<Tensor> values, grads;
+        for (size_t n : {3, 40000, 5, 70001}) {
+            values.push_back(Tensor::randn(1, n, 0.0f, 1.0f));
+            grads.push_back(Tensor(1, n));
+        }
+        std::vector<Tensor> ref = values;
+        std::vector<Tensor> m, v;
+        std::vector<Parameter> params;
+        for (size_t i = 0; i < values.size(); ++i) {
+            params.push_back({&values[i], &grads[i]});
+            m.push_back(Tensor(1, values[i].cols));
+            v.push_back(Tensor(1, values[i].cols));
+        }
+
+        const float lr = 0.01f, b1 = 0.9f, b2 = 0.999f, eps = 1e-8f;
+        Adam optimizer(params, lr, b1, b2, eps, wd);
+        for (int t = 1; t <= 3; ++t) {
+            for (auto& g : grads) {
+                g = Tensor::randn(1, g.cols, 0.0f, 1.0f);
+            }
+            optimizer.step();
+            float bc1 = 1.0f - std::pow(b1, static_cast<float>(t));
+            float bc2 = 1.0f - std::pow(b2, static_cast<float>(t));
+            for (size_t p = 0; p < ref.size(); ++p) {
+                for (size_t i = 0; i < ref[p].size(); ++i) {
+                    float g = grads[p][i];
+                    m[p][i] = b1 * m[p][i] + (1.0f - b1) * g;
+                    v[p][i] = b2 * v[p][i] + (1.0f - b2) * g * g;
+                    ref[p][i] -= lr * wd * ref[p][i];
+                    ref[p][i] -= lr * (m[p][i] / bc1) / (std::sqrt(v[p][i] / bc2) + eps);
+                }
+            }
+        }
+        for (size_t p = 0; p < ref.size(); ++p) {
+            for (size_t i = 0; i < ref[p].size(); ++i) {
+                assert(approx(values[p][i], ref[p][i], 1e-5f));
+            }
+        }
+    }
+    printf("  PASS: fused Adam/AdamW matches reference\n");
+}
+
+// Train a small network for `steps` steps on fixed data
+static void train_steps(Network& net, Adam& optimizer, int first, int last) {
+    MSELoss loss_fn;
+    Tensor output, grad;
+    for (int s = first; s < last; ++s) {
+        Tensor x = Tensor(2, 4, 0.1f * static_cast<float>(s % 5));
+        x[1] = 0.7f;
+        net.forward_into(x, output);
+        Tensor target(2, 2, 0.5f);
+        loss_fn.forward_backward(output, target, grad);
+        net.backward_into(grad, nullptr);
+        optimizer.step();
+    }
+}
+
+void test_checkpoint_resume() {
+    // Uninterrupted reference run
+    auto ref = small_network();
+    auto ref_params = ref->parameters();
+    std::vector<Tensor> initial;
+    for (auto& p : ref_params) {
+        initial.push_back(*p.value);
+    }
+    Adam ref_opt(ref_params, 0.01f, 0.9f, 0.999f, 1e-8f, 0.01f);
+    train_steps(*ref, ref_opt, 0, 10);
+
+    // Same start, checkpointed after 6 steps by the background writer
+    auto net = small_network();
+    auto params = net->parameters();
+    for (size_t i = 0; i < params.size(); ++i) {
+        *params[i].value = initial[i];
+    }
+    Adam opt(params, 0.01f, 0.9f, 0.999f, 1e-8f, 0.01f);
+    train_steps(*net, opt, 0, 6);
+    {
+        CheckpointWriter writer("/tmp/test_checkpoint.ckpt");
+        writer.submit([&](Checkpoint& c) {
+            c.capture(params, opt);
+            c.architecture = net->describe();
+            c.batches_done = 6;
+            c.batch_size = 2;
+            c.seed = 7;
+        });
+        // Training may continue while the snapshot is written
+        train_steps(*net, opt, 6, 8);
+        writer.wait();
+    }
+
+    // Resume into a fresh network and optimizer and finish the run
+    Checkpoint c = CheckpointIO::load("/tmp/test_checkpoint.ckpt");
+    assert(c.architecture == "Dense(4,3) ReLU Dense(3,2)");
+    assert(c.adam_step == 6 && c.batches_done == 6 && c.batch_size == 2 && c.seed == 7);
+    auto resumed = small_network();
+    auto resumed_params = resumed->parameters();
+    Adam resumed_opt(resumed_params, 0.01f, 0.9f, 0.999f, 1e-8f, 0.01f);
+    c.restore(resumed_params, resumed_opt);
+    train_steps(*resumed, resumed_opt, 6, 10);
+    assert(resumed_opt.timestep() == 10);
+    for (size_t i = 0; i < ref_params.size(); ++i) {
+        assert(resumed_params[i].value->data == ref_params[i].value->data);
+    }
+
+    // A damaged checkpoint is rejected
+    std::ifstream in("/tmp/test_checkpoint.ckpt", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    bytes[bytes.size() - 3] ^= 1;
+    std::ofstream("/tmp/test_checkpoint_bad.ckpt", std::ios::binary).write(bytes.data(), bytes.size());
+    assert(throws([] { CheckpointIO::load("/tmp/test_checkpoint_bad.ckpt"); }));
+
+    printf("  PASS: checkpoint resume matches uninterrupted training\n");
+}
+
+// Per-layer profiling: each layer call is timed under its network's label with the
+// work it reports, the optimizer step gets its own entry, and calls made while the
+// profiler is disabled are not recorded
+void test_profiler() {
+#ifdef AE_PROFILE
+    auto net = small_network();
+    net->fuse_activations();
+    net->set_name("net");
+    auto params = net->parameters();
+    Adam optimizer(params, 0.01f);
+    Tensor x(5, 4, 0.5f), y, dy(5, 2, 0.1f);
+
+    Profiler& profiler = Profiler::global();
+    profiler.reset();
+    profiler.enable(true);
+    for (int step = 0; step < 2; ++step) {
+        net->forward_into(x, y);
+        net->backward_into(dy, nullptr);
+        optimizer.step();
+    }
+    profiler.disable();
+    net->forward_into(x, y);
+
+    auto stats = profiler.stats();
+    auto find = [&](const std::string& label) -> const ProfileStat* {
+        for (const ProfileStat& s : stats) {
+            if (s.label == label) return &s;
+        }
+        return nullptr;
+    };
+    const ProfileStat* first = find("net[0] Dense(4,3) ReLU forward");
+    const ProfileStat* last = find("net[1] Dense(3,2) backward");
+    const ProfileStat* adam = find("Adam step");
+    assert(stats.size() == 5 && first && last && adam);
+    assert(first->calls == 2 && first->flops == 2 * 2.0 * 5 * 4 * 3 && first->bytes > 0.0);
+    assert(last->calls == 2 && last->flops == 2 * 4.0 * 5 * 3 * 2);
+    assert(adam->calls == 2 && adam->seconds > 0.0);
+    assert(find("net[0] Dense(4,3) ReLU backward")->flops == 2 * 2.0 * 5 * 4 * 3);  // no dx
+
+    std::ostringstream table, trace;
+    profiler.write_summary(table, 1.0);
+    assert(table.str().find("net[1] Dense(3,2) forward") != std::string::npos);
+    profiler.write_trace(trace);
+    assert(trace.str().find("\"traceEvents\"") != std::string::npos);
+    assert(trace.str().find("\"name\": \"Adam step\", \"ph\": \"X\"") != std::string::npos);
+
+    profiler.reset();
+    assert(profiler.stats().empty());
+    printf("  PASS: per-layer profiler\n");
+#else
+    printf("  SKIP: per-layer profiler (built with AE_PROFILE=OFF)\n");
+#endif
+}
+
+void test_training_step_no_allocations() {
+    ThreadPool::set_global_threads(2);
+
+    auto build = [] {
+        auto net = std::make_shared<Network>();
+        net->add_layer(std::make_shared<DenseLayer>(256, 64, InitMethod::He));
+        net->add_layer(std::make_shared<ReLU>());
+        net->add_layer(std::make_shared<DenseLayer>(64, 256, InitMethod::Xavier));
+        net->add_layer(std::make_shared<Sigmoid>());
+        return net;
+    };
+    auto net = build();
+    auto ref = build();
+    auto ref_params = ref->parameters();
+    auto params = net->parameters();
+    for (size_t i = 0; i < params.size(); ++i) {
+        *ref_params[i].value = *params[i].value;
+    }
+
+    Tensor x(8, 256);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = static_cast<float>((i * 37) % 101) / 100.0f;
+    }
+
+    // The into-API matches the value API
+    MSELoss loss;
+    MSELoss ref_loss;
+    Tensor y, grad;
+    net->forward_into(x, y);
+    float l = loss.forward_backward(y, x, grad);
+    Tensor ref_y = ref->forward(x);
+    float ref_l = ref_loss.forward(ref_y, x);
+    Tensor ref_grad = ref_loss.backward();
+    assert(approx(l, ref_l, 1e-6f));
+    for (size_t i = 0; i < y.size(); ++i) {
+        assert(approx(y[i], ref_y[i], 1e-6f));
+        assert(approx(grad[i], ref_grad[i], 1e-6f));
+    }
+    net->backward_into(grad, nullptr);
+    ref->zero_gradients();
+    ref->backward(ref_grad);
+    for (size_t p = 0; p < params.size(); ++p) {
+        for (size_t i = 0; i < params[p].gradient->size(); ++i) {
+            assert(approx((*params[p].gradient)[i], (*ref_params[p].gradient)[i], 1e-5f));
+        }
+    }
+
+    // After warm-up, forward + loss + backward + optimizer step never allocate
+    Adam optimizer(params, 0.001f);
+    for (int step = 0; step < 2; ++step) {
+        net->forward_into(x, y);
+        loss.forward_backward(y, x, grad);
+        net->backward_into(grad, nullptr);
+        optimizer.step();
+    }
+    size_t before = g_allocations.load();
+    for (int step = 0; step < 5; ++step) {
+        net->forward_into(x, y);
+        loss.forward_backward(y, x, grad);
+        net->backward_into(grad, nullptr);
+        optimizer.step();
+    }
+    size_t allocations = g_allocations.load() - before;
+    assert(allocations == 0);
+
+    // The value API returns fresh tensors each step, but they are recycled through
+    // the tensor storage pool, so it does not reach the heap at steady state either
+    for (int step = 0; step < 7; ++step) {
+        if (step == 2) {
+            before = g_allocations.load();
+        }
+        net->zero_gradients();
+        Tensor out = net->forward(x);
+        loss.forward(out, x);
+        net->backward(loss.backward());
+        optimizer.step();
+    }
+    allocations = g_allocations.load() - before;
+    assert(allocations == 0);
+
+    printf("  PASS: training step performs no heap allocations\n");
+}
+
+void test_gradient_hook() {
+    Network net;
+    net.add_layer(std::make_shared<DenseLayer>(3, 4, InitMethod::He));
+    net.add_layer(std::make_shared<ReLU>());
+    net.add_layer(std::make_shared<DenseLayer>(4, 2, InitMethod::He));
+    std::vector<std::pair<size_t, size_t>> ranges;
+    net.set_gradient_hook([&](size_t begin, size_t end) { ranges.emplace_back(begin, end); }, 10);
+
+    Tensor x(2, 3, 0.5f), out;
+    net.forward_into(x, out);
+    net.backward_into(Tensor(2, 2, 1.0f), nullptr);
+    // Last Dense first; the ReLU has no parameters to report
+    assert(ranges.size() == 2);
+    assert(ranges[0] == std::make_pair(size_t(12), size_t(14)));
+    assert(ranges[1] == std::make_pair(size_t(10), size_t(12)));
+
+    net.set_gradient_hook(nullptr);
+    net.backward_into(Tensor(2, 2, 1.0f), nullptr);
+    assert(ranges.size() == 2);
+
+    printf("  PASS: gradient hook\n");
+}
+
 int main() {
     printf("Running network tests...\n");
     test_network_forward_backward();
     test_mse_loss();
     test_mse_gradient_check();
     test_zero_gradients();
+    test_gradient_hook();
     test_tiny_autoencoder_convergence();
     test_model_save_load();
+    test_model_file_format();
+    test_inference_model_load();
+    test_conv_autoencoder();
+    test_model_spec();
+    test_quantized_network();
+    test_bf16_network();
+    test_latent_export();
+    test_adam_matches_reference();
+    test_checkpoint_resume();
+    test_training_step_no_allocations();
+    test_profiler();
     printf("All network tests passed!\n");
     return 0;
 }
@@ -1,8 +1,18 @@
 #include "math/tensor.h"
+#include "math/cpu.h"
+#include "math/gemm.h"
+#include "math/adam_kernel.h"
+#include "math/distance.h"
+#include "math/bf16.h"
+#include "math/int8_gemm.h"
+#include "math/storage.h"
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <fstream>
+#include <memory>
+#include <vector>
 
 static bool approx(float a, float b, float eps = 1e-5f) {
     return std::fabs(a - b) < eps;
@@ -57,6 +67,334 @@ void test_matmul() {
     printf("  PASS: matmul\n");
 }
 
+// Compare every supported SIMD kernel set against the scalar path, covering the
+// small-M (unpacked) path, full and partial register tiles, and multiple cache blocks
+void test_gemm_dispatch() {
+    const size_t shapes[][3] = {
+        {1, 1, 1}, {1, 37, 19}, {3, 130, 70}, {4, 64, 300}, {5, 17, 9},
+        {13, 33, 257}, {50, 70, 30}, {97, 2100, 40}, {200, 45, 520},
+    };
+    Isa original = active_isa();
+    for (auto& shape : shapes) {
+        size_t M = shape[0], N = shape[1], K = shape[2];
+        for (int variant = 0; variant < 8; ++variant) {
+            bool trans_a = variant & 1, trans_b = variant & 2, accumulate = variant & 4;
+            auto A = Tensor::randn(trans_a ? K : M, trans_a ? M : K, 0.0f, 1.0f);
+            auto B = Tensor::randn(trans_b ? N : K, trans_b ? K : N, 0.0f, 1.0f);
+            auto C0 = Tensor::randn(M, N, 0.0f, 1.0f);
+
+            GemmArgs g;
+            g.trans_a = trans_a; g.trans_b = trans_b; g.accumulate = accumulate;
+            g.M = M; g.N = N; g.K = K;
+            g.A = A.data.data(); g.lda = A.cols;
+            g.B = B.data.data(); g.ldb = B.cols;
+            g.ldc = N;
+
+            set_isa(Isa::Scalar);
+            Tensor expected = C0;
+            g.C = expected.data.data();
+            gemm(g);
+
+            for (Isa isa : {Isa::AVX2, Isa::AVX512}) {
+                if (isa > detected_isa()) continue;
+                set_isa(isa);
+                Tensor actual = C0;
+                g.C = actual.data.data();
+                gemm(g);
+                float tol = 1e-4f * static_cast<float>(K + 1);
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    assert(approx(actual[i], expected[i], tol));
+                }
+            }
+        }
+    }
+    set_isa(original);
+    printf("  PASS: gemm kernels match scalar path (active: %s)\n", isa_name(active_isa()));
+}
+
+// Bias + activation epilogue: every kernel set matches an unfused product followed
+// by the same elementwise operations
+void test_gemm_epilogue() {
+    const size_t shapes[][3] = {{1, 37, 19}, {3, 130, 70}, {13, 33, 257}, {50, 70, 300}};
+    Isa original = active_isa();
+    for (auto& shape : shapes) {
+        size_t M = shape[0], N = shape[1], K = shape[2];
+        auto X = Tensor::randn(M, K, 0.0f, 0.3f);
+        auto W = Tensor::randn(K, N, 0.0f, 0.3f);
+        auto b = Tensor::randn(1, N, 0.0f, 1.0f);
+        for (Activation act : {Activation::None, Activation::ReLU, Activation::Sigmoid}) {
+            for (Isa isa : {Isa::Scalar, Isa::AVX2, Isa::AVX512}) {
+                if (isa > detected_isa()) continue;
+                set_isa(isa);
+                auto expected = Tensor::add(Tensor::matmul(X, W), b);
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    float z = expected[i];
+                    if (act == Activation::ReLU) {
+                        expected[i] = z > 0.0f ? z : 0.0f;
+                    } else if (act == Activation::Sigmoid) {
+                        expected[i] = 1.0f / (1.0f + std::exp(-z));
+                    }
+                }
+                Tensor actual;
+                Tensor::linear_into(X, W, b, act, actual);
+                assert(actual.rows == M && actual.cols == N);
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    assert(approx(actual[i], expected[i], 1e-5f));
+                }
+            }
+        }
+    }
+    set_isa(original);
+    printf("  PASS: gemm bias/activation epilogue\n");
+}
+
+// Fused Adam kernel: every kernel set matches the scalar path, including the tail
+void test_adam_kernel_dispatch() {
+    AdamArgs args;
+    args.step_size = 0.01f;
+    args.inv_sqrt_bc2 = 1.3f;
+    args.decay = 0.999f;
+    Isa original = active_isa();
+    for (size_t n : {1, 7, 37, 1000}) {
+        auto p0 = Tensor::randn(1, n, 0.0f, 1.0f);
+        auto g = Tensor::randn(1, n, 0.0f, 1.0f);
+        auto m0 = Tensor::randn(1, n, 0.0f, 0.1f);
+        auto v0 = Tensor::scale(Tensor::multiply(m0, m0), 2.0f);
+
+        set_isa(Isa::Scalar);
+        Tensor p = p0, m = m0, v = v0;
+        adam_update(args, p.data.data(), g.data.data(), m.data.data(), v.data.data(), n);
+
+        for (Isa isa : {Isa::AVX2, Isa::AVX512}) {
+            if (isa > detected_isa()) continue;
+            set_isa(isa);
+            Tensor ps = p0, ms = m0, vs = v0;
+            adam_update(args, ps.data.data(), g.data.data(), ms.data.data(), vs.data.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                assert(approx(ps[i], p[i], 1e-6f));
+                assert(approx(ms[i], m[i], 1e-6f));
+                assert(approx(vs[i], v[i], 1e-6f));
+            }
+        }
+    }
+    set_isa(original);
+    printf("  PASS: adam kernels match scalar path\n");
+}
+
+// Distance kernels: every SIMD set matches the scalar path, including dimensions
+// that are not a multiple of the vector width and row counts outside the 4-row blocks
+void test_l2_distance_dispatch() {
+    Isa original = active_isa();
+    for (size_t dim : {1, 7, 16, 64, 67}) {
+        for (size_t n : {1, 3, 4, 9}) {
+            auto q = Tensor::randn(1, dim, 0.0f, 1.0f);
+            auto rows = Tensor::randn(n, dim, 0.0f, 1.0f);
+            std::vector<float> expected(n), out(n);
+            set_isa(Isa::Scalar);
+            l2_distances(q.data.data(), rows.data.data(), n, dim, expected.data());
+            for (size_t i = 0; i < n; ++i) {
+                float sum = 0.0f;
+                for (size_t d = 0; d < dim; ++d) {
+                    float diff = rows(i, d) - q[d];
+                    sum += diff * diff;
+                }
+                assert(approx(expected[i], sum, 1e-4f));
+            }
+            for (Isa isa : {Isa::AVX2, Isa::AVX512}) {
+                if (isa > detected_isa()) continue;
+                set_isa(isa);
+                l2_distances(q.data.data(), rows.data.data(), n, dim, out.data());
+                for (size_t i = 0; i < n; ++i) {
+                    assert(approx(out[i], expected[i], 1e-4f));
+                }
+            }
+        }
+    }
+    set_isa(original);
+    printf("  PASS: l2 distance kernels match scalar path\n");
+}
+
+// Int8 GEMM: the scalar kernel reproduces the integer dot products of the unpacked
+// quantized matrices exactly, every SIMD kernel set matches it (odd K, full and
+// partial column tiles, edge blocks, 1-4 row groups), and dequantized results track the float product
+void test_int8_gemm() {
+    const size_t shapes[][3] = {
+        {1, 1, 1}, {1, 37, 19}, {3, 130, 70}, {4, 16, 33}, {5, 17, 9}, {13, 33, 257},
+        {50, 70, 300}, {6, 200, 41},
+    };
+    Isa original = active_isa();
+    for (auto& shape : shapes) {
+        size_t M = shape[0], N = shape[1], K = shape[2];
+        auto X = Tensor::randn(M, K, 0.0f, 1.0f);
+        auto W = Tensor::randn(K, N, 0.0f, 0.1f);
+        auto b = Tensor::randn(1, N, 0.0f, 1.0f);
+
+        size_t lda = int8_row_stride(K);
+        std::vector<int16_t> xq(M * lda);
+        std::vector<int8_t> wq(K * N), packed(int8_packed_bytes(K, N));
+        std::vector<float> x_scale(M), w_scale(N);
+        quantize_rows(X.data.data(), M, K, K, xq.data(), x_scale.data());
+        quantize_columns(W.data.data(), K, N, wq.data(), w_scale.data());
+        pack_int8_weights(wq.data(), K, N, packed.data());
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t k = 0; k < K; ++k) {
+                int16_t q = xq[i * lda + k];
+                assert(q >= -127 && q <= 127);
+                assert(approx(q * x_scale[i], X(i, k), x_scale[i] * 0.5f + 1e-6f));
+            }
+            assert(lda == K || xq[i * lda + K] == 0);
+        }
+
+        // Rounding errors of up to half a step per factor, summed over K at random signs
+        float quant_tol = 0.01f * std::sqrt(static_cast<float>(K)) + 1e-3f;
+        for (Activation act : {Activation::None, Activation::ReLU, Activation::Sigmoid}) {
+            Int8GemmArgs g;
+            g.M = M; g.N = N; g.K = K;
+            g.A = xq.data(); g.lda = lda; g.a_scale = x_scale.data();
+            g.B = packed.data(); g.b_scale = w_scale.data();
+            g.ldc = N;
+            g.bias = b.data.data();
+            g.activation = act;
+
+            set_isa(Isa::Scalar);
+            Tensor expected(M, N);
+            g.C = expected.data.data();
+            int8_gemm(g);
+            if (act == Activation::None) {
+                auto reference = Tensor::add(Tensor::matmul(X, W), b);
+                for (size_t i = 0; i < M; ++i) {
+                    for (size_t j = 0; j < N; ++j) {
+                        int32_t sum = 0;
+                        for (size_t k = 0; k < K; ++k) {
+                            sum += int32_t(xq[i * lda + k]) * wq[k * N + j];
+                        }
+                        float exact = sum * (x_scale[i] * w_scale[j]) + b[j];
+                        assert(approx(expected(i, j), exact, 1e-5f));
+                        assert(approx(expected(i, j), reference(i, j), quant_tol));
+                    }
+                }
+            }
+
+            for (Isa isa : {Isa::AVX2, Isa::AVX512}) {
+                if (isa > detected_isa()) continue;
+                set_isa(isa);
+                Tensor actual(M, N);
+                g.C = actual.data.data();
+                int8_gemm(g);
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    assert(approx(actual[i], expected[i], 1e-5f));
+                }
+            }
+        }
+    }
+    set_isa(original);
+    printf("  PASS: int8 gemm kernels match scalar path (vnni: %s)\n",
+           cpu_has_avx512_vnni() ? "yes" : "no");
+}
+
+// bf16 weights: rounding is to nearest even, and every kernel set computes the
+// float32 product of the widened values (NN and NT, small-M and packed paths)
+void test_bf16_gemm() {
+    assert(float_to_bf16(1.0f) == 0x3f80);
+    assert(float_to_bf16(bf16_to_float(0x3f81)) == 0x3f81);
+    assert(float_to_bf16(1.0f + 1.0f / 256) == 0x3f80);       // tie rounds to even
+    assert(float_to_bf16(1.0f + 3.0f / 256) == 0x3f82);       // tie rounds to even
+    assert(float_to_bf16(1.0f + 1.5f / 256) == 0x3f81);
+    assert(float_to_bf16(-2.0f) == 0xc000);
+    assert(std::isnan(bf16_to_float(float_to_bf16(std::nanf("")))));
+    assert(std::isinf(bf16_to_float(float_to_bf16(INFINITY))));
+
+    const size_t shapes[][3] = {
+        {1, 37, 19}, {3, 130, 70}, {4, 64, 300}, {13, 33, 257}, {50, 70, 30}, {97, 210, 40},
+    };
+    Isa original = active_isa();
+    for (auto& shape : shapes) {
+        size_t M = shape[0], N = shape[1], K = shape[2];
+        for (bool trans_b : {false, true}) {
+            auto A = Tensor::randn(M, K, 0.0f, 1.0f);
+            auto B = Tensor::randn(trans_b ? N : K, trans_b ? K : N, 0.0f, 1.0f);
+            std::vector<uint16_t> half(B.size());
+            convert_to_bf16(B.data.data(), half.data(), B.size());
+            Tensor widened = B;
+            for (size_t i = 0; i < B.size(); ++i) {
+                assert(half[i] == float_to_bf16(B[i]));
+                widened[i] = bf16_to_float(half[i]);
+            }
+
+            GemmArgs g;
+            g.trans_b = trans_b;
+            g.M = M; g.N = N; g.K = K;
+            g.A = A.data.data(); g.lda = A.cols;
+            g.B = widened.data.data(); g.ldb = B.cols;
+            g.ldc = N;
+            set_isa(Isa::Scalar);
+            Tensor expected(M, N);
+            g.C = expected.data.data();
+            gemm(g);
+
+            g.B = nullptr;
+            g.B_bf16 = half.data();
+            for (Isa isa : {Isa::Scalar, Isa::AVX2, Isa::AVX512}) {
+                if (isa > detected_isa()) continue;
+                set_isa(isa);
+                Tensor actual(M, N);
+                g.C = actual.data.data();
+                gemm(g);
+                float tol = 1e-4f * static_cast<float>(K + 1);
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    assert(approx(actual[i], expected[i], tol));
+                }
+            }
+        }
+    }
+
+    // Adam writes the rounded copy of every updated parameter, tail included
+    AdamArgs args;
+    args.step_size = 0.01f;
+    args.inv_sqrt_bc2 = 1.3f;
+    args.decay = 0.999f;
+    for (Isa isa : {Isa::Scalar, Isa::AVX2, Isa::AVX512}) {
+        if (isa > detected_isa()) continue;
+        set_isa(isa);
+        for (size_t n : {1, 37, 1000}) {
+            auto p = Tensor::randn(1, n, 0.0f, 1.0f);
+            auto grad = Tensor::randn(1, n, 0.0f, 1.0f);
+            Tensor m(1, n), v(1, n);
+            std::vector<uint16_t> half(n);
+            adam_update(args, p.data.data(), grad.data.data(), m.data.data(), v.data.data(), n,
+                        half.data());
+            for (size_t i = 0; i < n; ++i) {
+                assert(half[i] == float_to_bf16(p[i]));
+            }
+        }
+    }
+    set_isa(original);
+    printf("  PASS: bf16 gemm and adam kernels\n");
+}
+
+void test_matmul_transposed() {
+    // A^T * B with A (3,2), B (3,2) -> (2,2); compare against explicit transpose
+    Tensor A(3, 2);
+    A(0,0)=1; A(0,1)=2; A(1,0)=3; A(1,1)=4; A(2,0)=5; A(2,1)=6;
+    Tensor B(3, 2);
+    B(0,0)=7; B(0,1)=8; B(1,0)=9; B(1,1)=10; B(2,0)=11; B(2,1)=12;
+
+    auto TN = Tensor::matmul_tn(A, B);
+    auto TN_ref = Tensor::matmul(Tensor::transpose(A), B);
+    assert(TN.rows == 2 && TN.cols == 2);
+    for (size_t i = 0; i < TN.size(); ++i) assert(approx(TN[i], TN_ref[i]));
+    assert(approx(TN(0,0), 89) && approx(TN(1,1), 128));
+
+    // A * B^T with A (3,2), B (3,2) -> (3,3)
+    auto NT = Tensor::matmul_nt(A, B);
+    auto NT_ref = Tensor::matmul(A, Tensor::transpose(B));
+    assert(NT.rows == 3 && NT.cols == 3);
+    for (size_t i = 0; i < NT.size(); ++i) assert(approx(NT[i], NT_ref[i]));
+    assert(approx(NT(0,0), 23) && approx(NT(2,2), 127));
+
+    printf("  PASS: transpose-free matmul\n");
+}
+
 void test_transpose() {
     Tensor A(2, 3);
     A(0,0)=1; A(0,1)=2; A(0,2)=3;
@@ -155,17 +493,93 @@ void test_save_load() {
     printf("  PASS: save/load round-trip\n");
 }
 
+static bool aligned64(const Tensor& t) {
+    return reinterpret_cast<uintptr_t>(t.data.data()) % TensorStorage::ALIGNMENT == 0;
+}
+
+void test_storage_pool() {
+    PoolStorage pool;
+    const float* first;
+    {
+        TensorStorage::Scope scope(pool);
+        Tensor a(3, 5);
+        assert(aligned64(a));
+        for (size_t i = 0; i < a.size(); ++i) assert(a[i] == 0.0f);
+        first = a.data.data();
+    }
+    assert(pool.cached_bytes() > 0);
+    {
+        // Same size class: the freed block is reused
+        TensorStorage::Scope scope(pool);
+        Tensor b = Tensor::uninitialized(4, 4);
+        assert(b.data.data() == first);
+        assert(pool.cached_bytes() == 0);
+
+        // A tensor created outside the scope still goes back to its own backend
+        Tensor c(3, 5);
+        assert(aligned64(c));
+    }
+    pool.trim();
+    assert(pool.cached_bytes() == 0);
+
+    // Default-backend temporaries are aligned too
+    Tensor x(7, 3, 1.0f);
+    Tensor y = Tensor::scale(Tensor::add(x, x), 0.5f);
+    assert(aligned64(y));
+    for (size_t i = 0; i < y.size(); ++i) assert(approx(y[i], 1.0f));
+
+    printf("  PASS: pool storage\n");
+}
+
+void test_borrowed_buffer() {
+    auto block = std::make_shared<Tensor>(2, 3, 1.5f);
+    Tensor view;
+    view.rows = 2;
+    view.cols = 3;
+    view.data = TensorBuffer::borrow(block->data.data(), 6, block);
+    assert(view.data.borrowed() && view.data.data() == block->data.data());
+
+    // Writes go to the borrowed memory; copies own their storage
+    view(1, 2) = 4.0f;
+    assert(approx((*block)(1, 2), 4.0f));
+    Tensor copy = view;
+    assert(!copy.data.borrowed() && copy.data == view.data);
+
+    // The owner stays alive while borrowed
+    std::weak_ptr<Tensor> weak = block;
+    block.reset();
+    assert(!weak.expired());
+
+    // Same-size resize keeps the view; any other size detaches, keeping the prefix
+    view.resize(3, 2);
+    assert(view.data.borrowed());
+    view.resize(4, 2);
+    assert(!view.data.borrowed() && aligned64(view));
+    assert(approx(view[0], 1.5f) && approx(view[5], 4.0f));
+    assert(weak.expired());
+    printf("  PASS: borrowed buffer\n");
+}
+
 int main() {
     printf("Running tensor tests...\n");
     test_construction();
     test_element_access();
     test_matmul();
+    test_gemm_dispatch();
+    test_gemm_epilogue();
+    test_adam_kernel_dispatch();
+    test_l2_distance_dispatch();
+    test_int8_gemm();
+    test_bf16_gemm();
+    test_matmul_transposed();
     test_transpose();
     test_add_broadcast();
     test_elementwise_ops();
     test_inplace();
     test_randn();
     test_save_load();
+    test_storage_pool();
+    test_borrowed_buffer();
     printf("All tensor tests passed!\n");
     return 0;
 }
@@ -0,0 +1,92 @@
+#include "math/thread_pool.h"
+#include "math/tensor.h"
+#include "nn/mse_loss.h"
+#include "nn/sigmoid.h"
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+void test_parallel_for_covers_range() {
+    ThreadPool pool(4);
+    assert(pool.num_threads() == 4);
+
+    for (size_t n : {0u, 1u, 7u, 1000u, 12345u}) {
+        std::vector<std::atomic<int>> hits(n);
+        pool.parallel_for(n, 16, [&](size_t begin, size_t end) {
+            assert(end - begin <= 16);
+            for (size_t i = begin; i < end; ++i) hits[i]++;
+        });
+        for (size_t i = 0; i < n; ++i) assert(hits[i] == 1);
+    }
+
+    printf("  PASS: parallel_for covers each index once\n");
+}
+
+void test_nested_parallel_for() {
+    ThreadPool pool(3);
+    std::atomic<int> total{0};
+    pool.parallel_for(8, 1, [&](size_t, size_t) {
+        // Runs inline on the calling participant instead of deadlocking
+        pool.parallel_for(10, 1, [&](size_t b, size_t e) { total += static_cast<int>(e - b); });
+    });
+    assert(total == 80);
+
+    printf("  PASS: nested parallel_for\n");
+}
+
+void test_parallel_sum_deterministic() {
+    std::vector<float> values(100000);
+    for (size_t i = 0; i < values.size(); ++i) values[i] = 1.0f / static_cast<float>(i + 1);
+
+    auto sum_with = [&](size_t threads) {
+        ThreadPool pool(threads);
+        return pool.parallel_sum(values.size(), 1000, [&](size_t b, size_t e) {
+            double s = 0.0;
+            for (size_t i = b; i < e; ++i) s += values[i];
+            return s;
+        });
+    };
+    double one = sum_with(1);
+    assert(sum_with(2) == one);
+    assert(sum_with(5) == one);
+
+    printf("  PASS: parallel_sum is deterministic\n");
+}
+
+// Kernels on the global pool must give bitwise-identical results for any thread count
+void test_kernels_thread_count_invariant() {
+    auto A = Tensor::randn(70, 600, 0.0f, 1.0f);
+    auto B = Tensor::randn(600, 300, 0.0f, 1.0f);
+    auto big = Tensor::randn(3, 40000, 0.0f, 1.0f);
+    auto target = Tensor::randn(3, 40000, 0.0f, 1.0f);
+
+    auto run = [&](size_t threads, Tensor& mm, Tensor& sig, float& loss) {
+        ThreadPool::set_global_threads(threads);
+        mm = Tensor::matmul(A, B);
+        Sigmoid s;
+        sig = s.forward(big);
+        MSELoss l;
+        loss = l.forward(sig, target);
+    };
+
+    Tensor mm1, sig1, mm4, sig4;
+    float loss1, loss4;
+    run(1, mm1, sig1, loss1);
+    run(4, mm4, sig4, loss4);
+    assert(mm1.data == mm4.data);
+    assert(sig1.data == sig4.data);
+    assert(loss1 == loss4);
+
+    printf("  PASS: kernels invariant to thread count\n");
+}
+
+int main() {
+    printf("Running thread pool tests...\n");
+    test_parallel_for_covers_range();
+    test_nested_parallel_for();
+    test_parallel_sum_deterministic();
+    test_kernels_thread_count_invariant();
+    printf("All thread pool tests passed!\n");
+    return 0;
+}